@@ -0,0 +1,326 @@
+/*======================================================================
+Vulkan Presentation : AssetBenchmark.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "AssetBenchmark.h"
+#include "VulkanFramework.h"    // VertexEstd::hash<Vertex>EparseModel()EreadFile()EupdateScene()
+
+#include <stb_image.h>          // VulkanFramework.cppiSTB_IMAGE_IMPLEMENTATIONj
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+//====================================================================================
+// 00X : vE̓f[^
+// Measurement/Inputs
+//====================================================================================
+
+namespace
+{
+	// 1̃x`}[Ňʁi1񂠂j
+	// result of one benchmark, per iteration
+	struct BenchmarkResult
+	{
+		std::string name;
+		uint32_t    iterations = 0;
+		double      milliseconds = 0.0;
+		double      items = 0.0;          // i_EnbVEsNZEXVj
+		const char* itemUnit = "";
+		double      bytes = 0.0;          // ̓oCgi0FȂj
+		double      allocations = 0.0;    // operator new̉
+	};
+
+	volatile size_t g_Sink = 0;    // ʂgāAœKŏȂ悤ɂ܂
+
+	// operator new̉񐔁iAssetBenchmarkMain.cpp̒u܂Arun()Őݒj
+	// operator new call count, kept by the replacement in AssetBenchmarkMain.cpp and handed over by run()
+	const std::atomic<uint64_t>* g_AllocationCount = nullptr;
+
+	// EH[Abv1̌Aiterationsv܂Bbody1̏EoCgԂ܂
+	// one warm-up run, then iterations timed runs; body reports the items and bytes it processed
+	BenchmarkResult measure(const std::string& name, uint32_t iterations, const char* itemUnit,
+		const std::function<void(double& items, double& bytes)>& body)
+	{
+		BenchmarkResult result;
+		result.name = name;
+		result.iterations = iterations;
+		result.itemUnit = itemUnit;
+
+		body(result.items, result.bytes);    // EH[Abv / warm-up
+
+		const uint64_t allocationsBefore = g_AllocationCount->load(std::memory_order_relaxed);
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			body(result.items, result.bytes);
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		const uint64_t allocationsAfter = g_AllocationCount->load(std::memory_order_relaxed);
+
+		result.milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count() / iterations;
+		result.allocations = static_cast<double>(allocationsAfter - allocationsBefore) / iterations;
+		return result;
+	}
+
+	// OBJFgridSize~gridSize̊iqi_EUVL̂ŁAdtB^[܂j
+	// synthetic OBJ: a gridSize x gridSize grid of quads whose corners share positions and UVs, so dedup has work to do
+	void writeSyntheticObj(const std::string& path, uint32_t gridSize)
+	{
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+		for (uint32_t y = 0; y <= gridSize; y++)
+		{
+			for (uint32_t x = 0; x <= gridSize; x++)
+			{
+				file << "v " << x << " " << y << " " << ((x * 7 + y * 13) % 5) * 0.1f << "\n";
+				file << "vt " << x / static_cast<float>(gridSize) << " " << y / static_cast<float>(gridSize) << "\n";
+			}
+		}
+		for (uint32_t y = 0; y < gridSize; y++)
+		{
+			for (uint32_t x = 0; x < gridSize; x++)
+			{
+				const uint32_t i0 = y * (gridSize + 1) + x + 1;    // OBJ̃CfbNX1
+				const uint32_t i1 = i0 + 1;
+				const uint32_t i2 = i0 + gridSize + 1;
+				const uint32_t i3 = i2 + 1;
+				file << "f " << i0 << "/" << i0 << " " << i1 << "/" << i1 << " " << i3 << "/" << i3 << " " << i2 << "/" << i2 << "\n";
+			}
+		}
+	}
+
+	// 摜FPNMiP6jRGBBstbi_load_from_memory()̃fR[ĥ݁it@CI/OȂj
+	// synthetic image: an in-memory binary PNM, so only stbi_load_from_memory()'s decode is timed, no file I/O
+	std::vector<unsigned char> makeSyntheticPnm(uint32_t width, uint32_t height)
+	{
+		const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+		std::vector<unsigned char> data(header.begin(), header.end());
+		std::mt19937 generator(12345);
+		data.reserve(data.size() + width * height * 3);
+		for (uint32_t i = 0; i < width * height * 3; i++)
+		{
+			data.push_back(static_cast<unsigned char>(generator()));
+		}
+		return data;
+	}
+
+	std::vector<Vertex> makeRandomVertices(size_t count)
+	{
+		std::mt19937 generator(12345);
+		std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+		std::vector<Vertex> vertices(count);
+		for (Vertex& vertex : vertices)
+		{
+			vertex.pos = glm::vec3(value(generator), value(generator), value(generator));
+			vertex.color = glm::vec3(1.0f);
+			vertex.texCoord = glm::vec2(value(generator), value(generator));
+		}
+		return vertices;
+	}
+
+	double getFileSize(const std::string& path)
+	{
+		return static_cast<double>(std::filesystem::file_size(path));
+	}
+}
+
+//====================================================================================
+// 10X : x`}[N
+// Benchmarks
+//====================================================================================
+
+int CAssetBenchmark::run(const std::string& jsonPath, const std::atomic<uint64_t>& allocationCount)
+{
+	g_AllocationCount = &allocationCount;
+
+	// ۂ̃AZbgiƃfBNg̑΃pXÂ݂̂݁j
+	// real assets, relative to the working directory; missing ones are skipped
+	const std::string modelPath = "Asset/Model/viking_room.obj";
+	const std::string texturePaths[] = { "Asset/Texture/viking_room.png", "Asset/Texture/texture.jpg" };
+	const std::string shaderPaths[] = { "shaders/vert.spv", "shaders/frag.spv", "shaders/cull.spv" };
+
+	const std::filesystem::path tempDirectory = std::filesystem::temp_directory_path();
+	const std::string syntheticObjPath = (tempDirectory / "asset_benchmark.obj").string();
+	const std::string syntheticBinaryPath = (tempDirectory / "asset_benchmark.bin").string();
+
+	std::vector<BenchmarkResult> results;
+
+	// OBJ̓ǂݍ݁E_dtB^[iFCfbNX͒_j
+	// OBJ parse + dedup; items are indices, i.e. input vertices
+	auto parseBenchmark = [](const std::string& path)
+	{
+		return [path](double& items, double& bytes)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			std::vector<Submesh> submeshes;
+			glm::vec4 boundingSphere;
+			CVulkanFramework::parseModel(path, vertices, indices, submeshes, boundingSphere);
+			items = static_cast<double>(indices.size());
+			bytes = getFileSize(path);
+			g_Sink = g_Sink + vertices.size();
+		};
+	};
+	writeSyntheticObj(syntheticObjPath, 256);
+	results.push_back(measure("obj_parse_dedup/synthetic_256", 10, "vertices", parseBenchmark(syntheticObjPath)));
+	if (std::filesystem::exists(modelPath))
+	{
+		results.push_back(measure("obj_parse_dedup/viking_room", 10, "vertices", parseBenchmark(modelPath)));
+	}
+	std::filesystem::remove(syntheticObjPath);
+
+	// std::hash<Vertex>idtB^[̃L[j
+	// std::hash<Vertex>, the dedup key
+	{
+		const std::vector<Vertex> vertices = makeRandomVertices(1000000);
+		results.push_back(measure("vertex_hash/random_1m", 20, "hashes", [&vertices](double& items, double& bytes)
+		{
+			size_t sum = 0;
+			for (const Vertex& vertex : vertices)
+			{
+				sum += std::hash<Vertex>()(vertex);
+			}
+			g_Sink = g_Sink + sum;
+			items = static_cast<double>(vertices.size());
+			bytes = static_cast<double>(vertices.size() * sizeof(Vertex));
+		}));
+	}
+
+	// stbi_load̃fR[hiFsNZAoCgFGR[hς݂̃TCYj
+	// stbi_load decode; items are pixels, bytes the encoded size
+	{
+		const std::vector<unsigned char> pnm = makeSyntheticPnm(1024, 1024);
+		results.push_back(measure("image_decode/synthetic_pnm_1024", 20, "pixels", [&pnm](double& items, double& bytes)
+		{
+			int width, height, channels;
+			stbi_uc* pixels = stbi_load_from_memory(pnm.data(), static_cast<int>(pnm.size()), &width, &height, &channels, STBI_rgb_alpha);
+			if (pixels == nullptr)
+			{
+				throw std::runtime_error("Failed to decode synthetic image!");
+			}
+			stbi_image_free(pixels);
+			items = static_cast<double>(width) * height;
+			bytes = static_cast<double>(pnm.size());
+		}));
+	}
+	for (const std::string& path : texturePaths)
+	{
+		if (std::filesystem::exists(path) == false)
+		{
+			continue;
+		}
+		// createTextureImage()ƓFt@Cǂݍ݁ARGBAɕϊ
+		// as in createTextureImage(): straight from the file, expanded to RGBA
+		results.push_back(measure("image_decode/" + std::filesystem::path(path).filename().string(), 5, "pixels", [path](double& items, double& bytes)
+		{
+			int width, height, channels;
+			stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+			if (pixels == nullptr)
+			{
+				throw std::runtime_error("Failed to load texture image!");
+			}
+			stbi_image_free(pixels);
+			items = static_cast<double>(width) * height;
+			bytes = getFileSize(path);
+		}));
+	}
+
+	// readFile()iSPIR-VEpCvCLbV̓ǂݍ݁j
+	// readFile(), which loads SPIR-V and the pipeline cache
+	auto readBenchmark = [](const std::string& path)
+	{
+		return [path](double& items, double& bytes)
+		{
+			const std::vector<char> data = CVulkanFramework::readFile(path);
+			items = 1.0;
+			bytes = static_cast<double>(data.size());
+			g_Sink = g_Sink + data.size();
+		};
+	};
+	{
+		std::ofstream file(syntheticBinaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		const std::vector<char> block(1 << 20, 'x');
+		for (int i = 0; i < 16; i++)
+		{
+			file.write(block.data(), block.size());
+		}
+	}
+	results.push_back(measure("read_file/synthetic_16mb", 10, "files", readBenchmark(syntheticBinaryPath)));
+	std::filesystem::remove(syntheticBinaryPath);
+	for (const std::string& path : shaderPaths)
+	{
+		if (std::filesystem::exists(path))
+		{
+			results.push_back(measure("read_file/" + std::filesystem::path(path).filename().string(), 100, "files", readBenchmark(path)));
+		}
+	}
+
+	// updateScene()FJsiUBOEvbV萔EJOsjBfoCX͏܂
+	// updateScene(): the camera, push constant and cull matrices; the device is never initialized
+	{
+		std::unique_ptr<CVulkanFramework> app = std::make_unique<CVulkanFramework>();
+		FrameSnapshot snapshot;
+		const uint32_t updatesPerIteration = 10000;
+		results.push_back(measure("scene_update/camera", 20, "updates", [&app, &snapshot, updatesPerIteration](double& items, double& bytes)
+		{
+			for (uint32_t i = 0; i < updatesPerIteration; i++)
+			{
+				app->updateScene(snapshot);
+			}
+			g_Sink = g_Sink + static_cast<size_t>(snapshot.cullMatrix[0][0]);
+			items = updatesPerIteration;
+			bytes = 0.0;
+		}));
+	}
+
+	std::cout << "Asset pipeline benchmark (per iteration):" << std::endl << std::fixed;
+	for (const BenchmarkResult& result : results)
+	{
+		const double seconds = result.milliseconds / 1000.0;
+		std::cout << "  " << std::left << std::setw(34) << result.name << std::right
+			<< std::setprecision(3) << std::setw(10) << result.milliseconds << " ms"
+			<< std::setprecision(2) << std::setw(12) << result.items / seconds / 1000000.0
+			<< " " << std::left << std::setw(12) << ("M " + std::string(result.itemUnit) + "/s") << std::right;
+		if (result.bytes > 0.0)
+		{
+			std::cout << std::setw(10) << result.bytes / seconds / (1024.0 * 1024.0) << " MB/s";
+		}
+		std::cout << std::setprecision(1) << std::setw(12) << result.allocations << " allocs" << std::endl;
+	}
+	std::cout << std::defaultfloat;
+
+	if (jsonPath.empty() == false)
+	{
+		std::ofstream file(jsonPath, std::ios::out | std::ios::trunc);
+		if (file.is_open() == false)
+		{
+			std::cerr << "Failed to write benchmark results to " << jsonPath << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		file << "{\"benchmarks\":[" << std::setprecision(9);
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const BenchmarkResult& result = results[i];
+			const double seconds = result.milliseconds / 1000.0;
+			file << (i == 0 ? "" : ",") << "\n{\"name\":\"" << result.name << "\",\"iterations\":" << result.iterations
+				<< ",\"ms\":" << result.milliseconds
+				<< ",\"items_per_second\":" << result.items / seconds << ",\"item_unit\":\"" << result.itemUnit << "\""
+				<< ",\"bytes_per_second\":" << result.bytes / seconds
+				<< ",\"allocations\":" << result.allocations << "}";
+		}
+		file << "\n]}\n";
+		std::cout << "Benchmark results written to " << jsonPath << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,30 @@
+/*======================================================================
+Vulkan Presentation : AssetBenchmark.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+// AZbgǂݍ݂CPŨ}CNx`}[NiGPUEEBhEsvj
+// CPU micro-benchmarks for the asset loading hot paths; needs neither a GPU nor a window
+//   OBJ̓ǂݍ݁E_dtB^[Astd::hash<Vertex>Astbi_load̃fR[hAreadFile()AupdateScene()̍svZ
+//   OBJ parse + vertex dedup, std::hash<Vertex>, stbi_load decode, readFile() and the matrix math in updateScene()
+//   f[^iŒV[hjƎۂ̃AZbgiȂꍇ͏ȗjŁA/boperator new̉񐔂v܂
+//   each runs on synthetic input (fixed seed) and on the real assets when present, reporting throughput per second
+//   and the number of operator new calls
+//   _[Ƃ͕ʂ̎st@CiAssetBenchmarkMain.cpp݂̂operator newu܂j
+//   built as its own executable; only AssetBenchmarkMain.cpp replaces the global operator new, never the renderer
+class CAssetBenchmark
+{
+public:
+
+	// ʂR\[ɏo͂AjsonPathłȂJSONi1s1x`}[NAR~bgԂ̔rpjɂ݂܂
+	// print the results and, when jsonPath is set, also write them as JSON, one benchmark per line, for diffing across commits
+	// allocationCountFoperator new̌Ăяo񐔁iv̑O̍1񂠂ŏój
+	// allocationCount is the running operator new count; each benchmark reports the difference across its timed runs
+	static int run(const std::string& jsonPath, const std::atomic<uint64_t>& allocationCount);
+};
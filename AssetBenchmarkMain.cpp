@@ -0,0 +1,96 @@
+/*======================================================================
+Vulkan Presentation : AssetBenchmarkMain.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "AssetBenchmark.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+
+//====================================================================================
+// 00X : [mۂ̌v
+// Allocation Counting
+//====================================================================================
+
+// operator new̒uF̃x`}[N̎st@Ĉ݁i_[ɂ͊܂߂܂j
+// replacement operator new, linked into this benchmark executable only and never into the renderer
+//   stb_imagemalloc()ĝŁAfR[h̉񐔂ɂ͊܂܂܂
+//   stb_image allocates with malloc(), so its decode buffers are not counted
+namespace
+{
+	std::atomic<uint64_t> g_AllocationCount{ 0 };
+}
+
+void* operator new(std::size_t size)
+{
+	g_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* memory = std::malloc(size == 0 ? 1 : size);
+	if (memory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+//====================================================================================
+// 10X : C֐
+// Main
+//====================================================================================
+
+// R}hCF
+//   [FILE]    JSON̏o͐i1s1x`}[NAR~bgԂ̔rpj
+//   ƃfBNgAsset/Eshaders/Ύۂ̃AZbgv܂iGPUEEBhEsvj
+int main(int argc, char* argv[])
+{
+	std::string jsonPath;
+	if (argc > 2 || (argc == 2 && argv[1][0] == '-'))
+	{
+		std::cerr << "Usage: " << argv[0] << " [FILE]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (argc == 2)
+	{
+		jsonPath = argv[1];
+	}
+
+	try
+	{
+		return CAssetBenchmark::run(jsonPath, g_AllocationCount);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
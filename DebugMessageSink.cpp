@@ -0,0 +1,261 @@
+/*======================================================================
+Vulkan Presentation : DebugMessageSink.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "DebugMessageSink.h"
+#include "Trace.h"
+
+namespace
+{
+	// K[XbhOmFԊuiݑ͒ʒm܂j
+	// how often the logger thread polls the ring; producers never signal it
+	const std::chrono::milliseconds POLL_INTERVAL(20);
+
+	// I[܂ŁA܂capacity - 1܂ŃRs[inullI[j
+	void copyTruncated(char* destination, const char* source, size_t capacity)
+	{
+		size_t length = 0;
+		if (source != nullptr)
+		{
+			while (length + 1 < capacity && source[length] != '\0')
+			{
+				destination[length] = source[length];
+				length++;
+			}
+		}
+		destination[length] = '\0';
+	}
+
+	const char* severityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity)
+	{
+		if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)   return "ERROR";
+		if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) return "WARNING";
+		if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT)    return "INFO";
+		return "VERBOSE";
+	}
+}
+
+CDebugMessageSink::CDebugMessageSink()
+	: m_Slots(new Slot[RING_SIZE])
+{
+	for (uint32_t i = 0; i < RING_SIZE; i++)
+	{
+		m_Slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+CDebugMessageSink::~CDebugMessageSink()
+{
+	stop();
+}
+
+//====================================================================================
+// 00X : ݑihCo[̃Xbhj
+//====================================================================================
+
+// LEMPSCL[iVyukovjFʒuCASŗ\񂵁AXbgsequenceŏ݊J܂
+// Bounded MPSC queue (Vyukov): a producer claims a position with a CAS and publishes the slot through its sequence
+void CDebugMessageSink::push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, const VkDebugUtilsMessengerCallbackDataEXT* callbackData)
+{
+	if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)        m_Error.fetch_add(1, std::memory_order_relaxed);
+	else if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) m_Warning.fetch_add(1, std::memory_order_relaxed);
+	else if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT)    m_Info.fetch_add(1, std::memory_order_relaxed);
+	else                                                                  m_Verbose.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t position = m_Head.load(std::memory_order_relaxed);
+	Slot* slot;
+	for (;;)
+	{
+		slot = &m_Slots[position & (RING_SIZE - 1)];
+		const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+		const int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+		if (difference == 0)
+		{
+			if (m_Head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)    // ÕbZ[W܂ǂ܂ĂȂFt
+		{
+			m_Dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else                        // ̐Y҂ɗ\񂵂
+		{
+			position = m_Head.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->message.severity = severity;
+	slot->message.messageId = callbackData->messageIdNumber;
+	copyTruncated(slot->message.name, callbackData->pMessageIdName, MAX_NAME_LENGTH);
+	copyTruncated(slot->message.text, callbackData->pMessage, MAX_MESSAGE_LENGTH);
+	slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+DebugMessageStats CDebugMessageSink::getStats() const
+{
+	DebugMessageStats stats;
+	stats.verbose = m_Verbose.load(std::memory_order_relaxed);
+	stats.info = m_Info.load(std::memory_order_relaxed);
+	stats.warning = m_Warning.load(std::memory_order_relaxed);
+	stats.error = m_Error.load(std::memory_order_relaxed);
+	stats.dropped = m_Dropped.load(std::memory_order_relaxed);
+	stats.suppressed = m_Suppressed.load(std::memory_order_relaxed);
+	return stats;
+}
+
+//====================================================================================
+// 00X : ǂݍݑiK[Xbhj
+//====================================================================================
+
+void CDebugMessageSink::start(std::ostream& out)
+{
+	if (m_Thread.joinable())
+	{
+		return;
+	}
+	m_Output = &out;
+	m_Stopping = false;
+	m_Thread = std::thread(&CDebugMessageSink::loggerLoop, this);
+}
+
+void CDebugMessageSink::stop()
+{
+	if (m_Thread.joinable() == false)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_Condition.notify_all();
+	m_Thread.join();
+
+	// dvxƂ̍vƁA}ID̍v
+	// per-severity totals, then every ID that had messages suppressed
+	const DebugMessageStats stats = getStats();
+	if (stats.error + stats.warning + stats.info + stats.verbose > 0)
+	{
+		*m_Output << "validation layer: " << stats.error << " errors, " << stats.warning << " warnings, "
+			<< stats.info << " info, " << stats.verbose << " verbose" << std::endl;
+	}
+	if (stats.suppressed > 0 || stats.dropped > 0)
+	{
+		*m_Output << "validation layer: " << stats.suppressed << " repeated messages suppressed, "
+			<< stats.dropped << " dropped (ring full)" << std::endl;
+		for (const auto& idState : m_IdStates)
+		{
+			if (idState.second.suppressedTotal > 0)
+			{
+				*m_Output << "  " << idState.second.name << ": " << idState.second.total << " total, "
+					<< idState.second.suppressedTotal << " suppressed" << std::endl;
+			}
+		}
+	}
+}
+
+// P̏ҁF݂Xbgisequence == ʒu + 1ĵݓǂݍ݁Äʒuŋ󂫂ɖ߂܂
+// single consumer: only a published slot (sequence == position + 1) is read, then freed for the next lap
+bool CDebugMessageSink::pop(Message& message)
+{
+	Slot& slot = m_Slots[m_Tail & (RING_SIZE - 1)];
+	if (slot.sequence.load(std::memory_order_acquire) != m_Tail + 1)
+	{
+		return false;
+	}
+
+	message = slot.message;
+	slot.sequence.store(m_Tail + RING_SIZE, std::memory_order_release);
+	m_Tail++;
+	return true;
+}
+
+// IDƂ1b̑ŏ𐔂܂BIɗ}1sŕ񍐂܂
+// Each ID is limited per one-second window; when a window closes, whatever it suppressed is reported in one line
+void CDebugMessageSink::write(const Message& message, std::string& output)
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	if (m_MaxPerSecond > 0)
+	{
+		m_IdKey.assign(message.name);    // ԍł0LʁX̃bZ[W܂Ƃ߂Ă܂
+		m_IdKey += '#';
+		m_IdKey += std::to_string(message.messageId);
+		IdState& idState = m_IdStates[m_IdKey];
+		if (idState.total == 0)
+		{
+			idState.name = message.name;
+			idState.windowStart = now;
+		}
+		idState.total++;
+
+		if (idState.printedInWindow >= m_MaxPerSecond)
+		{
+			idState.suppressedInWindow++;
+			idState.suppressedTotal++;
+			m_Suppressed.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		idState.printedInWindow++;
+	}
+
+	output += "validation layer [";
+	output += severityName(message.severity);
+	output += "]: ";
+	output += message.text;
+	output += '\n';
+}
+
+void CDebugMessageSink::drain(std::string& output)
+{
+	Message message;
+	while (pop(message))
+	{
+		write(message, output);
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	for (auto& idState : m_IdStates)
+	{
+		IdState& state = idState.second;
+		if (now - state.windowStart < std::chrono::seconds(1))
+		{
+			continue;
+		}
+		if (state.suppressedInWindow > 0)
+		{
+			output += "validation layer: " + std::to_string(state.suppressedInWindow) + " more \"" + state.name + "\" suppressed\n";
+		}
+		state.windowStart = now;
+		state.printedInWindow = 0;
+		state.suppressedInWindow = 0;
+	}
+}
+
+void CDebugMessageSink::loggerLoop()
+{
+	CTrace::setThreadName("debug messages");
+
+	std::string output;
+	bool stopping = false;
+	while (stopping == false)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait_for(lock, POLL_INTERVAL, [this]() { return m_Stopping; });
+			stopping = m_Stopping;
+		}
+
+		drain(output);    // ~Ōɂx
+		if (output.empty() == false)
+		{
+			*m_Output << output << std::flush;    // ܂Ƃ߂1ŏ
+			output.clear();
+		}
+	}
+}
@@ -0,0 +1,121 @@
+/*======================================================================
+Vulkan Presentation : DebugMessageSink.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+// fobObZ[W̏WvidvxƁj
+// Debug message counters, per severity
+struct DebugMessageStats
+{
+	uint64_t verbose = 0;
+	uint64_t info = 0;
+	uint64_t warning = 0;
+	uint64_t error = 0;
+	uint64_t dropped = 0;       // OtŎ̂ĂbZ[W
+	uint64_t suppressed = 0;    // IDƂ̏𒴂ďo͂ȂbZ[W
+};
+
+// fobObZ[W̃VNFdebugCallback()̓bNȂ̃OiMPSCjɏނŁA
+// o͂̓K[Xbhs܂ihCo[̃Xbhstd::cerrŎ~܂܂j
+// Debug message sink: debugCallback() only pushes into a lock-free multi-producer ring, and a logger thread
+// does the writing, so the driver's threads never block on std::cerr
+//   messageIdNumber1bmaxPerSecond܂ŏo͂Ac͐񍐂܂
+//   each messageIdNumber prints at most maxPerSecond times a second; the rest are only counted and summarized
+//   Ot̏ꍇ͎̂ĂĐ܂iR[obN͑ҋ@܂j
+//   when the ring is full the message is dropped and counted; the callback never waits
+class CDebugMessageSink
+{
+public:
+
+	CDebugMessageSink();
+	~CDebugMessageSink();
+
+	CDebugMessageSink(const CDebugMessageSink&) = delete;
+	CDebugMessageSink& operator=(const CDebugMessageSink&) = delete;
+
+	// 0FȂid̏W܂jBstart()̑Oɐݒ肵܂
+	// 0 disables the limit and the deduplication; set before start()
+	void setRateLimit(uint32_t maxPerSecond) { m_MaxPerSecond = maxPerSecond; }
+
+	void start(std::ostream& out);
+	void stop();    // co͂āA}ID̍v񍐂܂
+
+	// ǂ̃XbhłĂяo܂i[mہEbNȂj
+	// callable from any thread; never allocates or locks
+	void push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, const VkDebugUtilsMessengerCallbackDataEXT* callbackData);
+
+	DebugMessageStats getStats() const;
+
+private:
+
+	static const uint32_t RING_SIZE = 1024;            // 2̗ݏ
+	static const size_t   MAX_MESSAGE_LENGTH = 1024;   // ͐؂̂
+	static const size_t   MAX_NAME_LENGTH = 64;
+
+	struct Message
+	{
+		VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+		int32_t                                messageId;
+		char                                   name[MAX_NAME_LENGTH];
+		char                                   text[MAX_MESSAGE_LENGTH];
+	};
+
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence{ 0 };    // 󂫁FʒuAݍς݁Fʒu + 1iƂRING_SIZEiށj
+		Message               message;
+	};
+
+	// IDƂ̏o͏󋵁iK[Xbĥ݁AL[͔ԍƖOj
+	// per-ID state keyed on the number and the name, touched by the logger thread only
+	struct IdState
+	{
+		std::string                           name;
+		std::chrono::steady_clock::time_point windowStart;
+		uint32_t                              printedInWindow = 0;
+		uint64_t                              suppressedInWindow = 0;
+		uint64_t                              total = 0;
+		uint64_t                              suppressedTotal = 0;
+	};
+
+	bool pop(Message& message);
+	void drain(std::string& output);
+	void write(const Message& message, std::string& output);
+	void loggerLoop();
+
+	std::unique_ptr<Slot[]>                 m_Slots;
+	std::atomic<uint64_t>                   m_Head{ 0 };     // ɏވʒuiY҂j
+	uint64_t                                m_Tail = 0;      // ɓǂݍވʒuiK[Xbĥ݁j
+
+	std::atomic<uint64_t>                   m_Verbose{ 0 };
+	std::atomic<uint64_t>                   m_Info{ 0 };
+	std::atomic<uint64_t>                   m_Warning{ 0 };
+	std::atomic<uint64_t>                   m_Error{ 0 };
+	std::atomic<uint64_t>                   m_Dropped{ 0 };
+	std::atomic<uint64_t>                   m_Suppressed{ 0 };
+
+	uint32_t                                m_MaxPerSecond = 5;
+	std::unordered_map<std::string, IdState> m_IdStates;
+	std::string                             m_IdKey;         // pimۂȂ悤ėpj
+	std::ostream*                           m_Output = nullptr;
+
+	std::thread                             m_Thread;
+	std::mutex                              m_Mutex;         // ҋ@p̂݁ipush()͎g܂j
+	std::condition_variable                 m_Condition;
+	bool                                    m_Stopping = false;
+};
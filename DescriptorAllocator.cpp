@@ -0,0 +1,367 @@
+/*======================================================================
+Vulkan Presentation : DescriptorAllocator.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "DescriptorAllocator.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t SETS_PER_POOL = 64;    // v[1̃Zbg
+
+	// FNV-1ai64rbgj
+	void hashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	}
+
+	template <typename T>
+	void hashValue(uint64_t& hash, const T& value)
+	{
+		hashBytes(hash, &value, sizeof(value));
+	}
+
+	// C[WñfXNv^[iVkDescriptorImageInfojAobt@[niVkDescriptorBufferInfoj
+	// whether a descriptor type reads a VkDescriptorImageInfo or a VkDescriptorBufferInfo
+	bool isImageDescriptor(VkDescriptorType type)
+	{
+		switch (type)
+		{
+		case VK_DESCRIPTOR_TYPE_SAMPLER:
+		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+		case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+		case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+		case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+			return true;
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+			return false;
+		default:
+			throw std::runtime_error("Descriptor type not supported by the descriptor allocator!");
+		}
+	}
+
+	uint32_t getDescriptorCount(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+	{
+		uint32_t count = 0;
+		for (const VkDescriptorSetLayoutBinding& binding : bindings)
+		{
+			count += binding.descriptorCount;
+		}
+		return count;
+	}
+}
+
+DescriptorInfo DescriptorInfo::fromBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	DescriptorInfo info;
+	memset(&info, 0, sizeof(info));    // nbVEr͎go[݂̂łAÔ߃[Ŗ߂܂
+	info.buffer.buffer = buffer;
+	info.buffer.offset = offset;
+	info.buffer.range = range;
+	return info;
+}
+
+DescriptorInfo DescriptorInfo::fromImage(VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout)
+{
+	DescriptorInfo info;
+	memset(&info, 0, sizeof(info));
+	info.image.sampler = sampler;
+	info.image.imageView = imageView;
+	info.image.imageLayout = imageLayout;
+	return info;
+}
+
+//====================================================================================
+// EЕt
+// Setup and teardown
+//====================================================================================
+
+void CDescriptorAllocator::init(VkDevice device, uint32_t frameCount, const std::vector<VkDescriptorPoolSize>& descriptorsPerSet,
+	const VkAllocationCallbacks* allocator)
+{
+	m_Device = device;
+	m_Allocator = allocator;
+	m_DescriptorsPerSet = descriptorsPerSet;
+	m_FramePools.resize(frameCount);
+	m_CurrentFrame = 0;
+}
+
+void CDescriptorAllocator::destroy()
+{
+	for (auto& updateTemplate : m_Templates)
+	{
+		vkDestroyDescriptorUpdateTemplate(m_Device, updateTemplate.second, m_Allocator);
+	}
+	m_Templates.clear();
+
+	for (PoolChain& chain : m_FramePools)
+	{
+		for (VkDescriptorPool pool : chain.pools)
+		{
+			vkDestroyDescriptorPool(m_Device, pool, m_Allocator);
+		}
+	}
+	m_FramePools.clear();
+
+	for (VkDescriptorPool pool : m_CachePools.pools)
+	{
+		vkDestroyDescriptorPool(m_Device, pool, m_Allocator);
+	}
+	m_CachePools = PoolChain{};
+	m_SetCache.clear();
+}
+
+VkDescriptorPool CDescriptorAllocator::createPool()
+{
+	std::vector<VkDescriptorPoolSize> poolSizes = m_DescriptorsPerSet;
+	for (VkDescriptorPoolSize& poolSize : poolSizes)
+	{
+		poolSize.descriptorCount *= SETS_PER_POOL;
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo{};    // fXNv^[v[\
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = 0;                       // ʂɉȂiv[ƃZbgj
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = SETS_PER_POOL;
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(m_Device, &poolInfo, m_Allocator, &pool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create descriptor pool!");
+	}
+	return pool;
+}
+
+//====================================================================================
+// m
+// Allocation
+//====================================================================================
+
+VkDescriptorSet CDescriptorAllocator::allocate(PoolChain& chain, VkDescriptorSetLayout layout)
+{
+	// ݂̃v[ŊmہAȂΎ̃v[1񂾂蒼܂
+	// allocate from the current pool; when it is exhausted, retry once from the next one
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		if (chain.current == chain.pools.size())
+		{
+			chain.pools.push_back(createPool());
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = chain.pools[chain.current];
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		const VkResult result = vkAllocateDescriptorSets(m_Device, &allocInfo, &set);
+		if (result == VK_SUCCESS)
+		{
+			return set;
+		}
+		if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+		{
+			break;
+		}
+
+		chain.current++;
+	}
+
+	throw std::runtime_error("Failed to allocate descriptor set!");
+}
+
+void CDescriptorAllocator::resetChain(PoolChain& chain)
+{
+	// v[͎cčėp܂
+	// keep the pools around for reuse
+	for (VkDescriptorPool pool : chain.pools)
+	{
+		vkResetDescriptorPool(m_Device, pool, 0);
+	}
+	chain.current = 0;
+}
+
+void CDescriptorAllocator::beginFrame(uint32_t frameIndex)
+{
+	m_CurrentFrame = frameIndex;
+	resetChain(m_FramePools[frameIndex]);
+}
+
+VkDescriptorSet CDescriptorAllocator::allocateTransient(VkDescriptorSetLayout layout)
+{
+	return allocate(m_FramePools[m_CurrentFrame], layout);
+}
+
+void CDescriptorAllocator::resetCache()
+{
+	resetChain(m_CachePools);
+	m_SetCache.clear();
+}
+
+size_t CDescriptorAllocator::getPoolCount() const
+{
+	size_t count = m_CachePools.pools.size();
+	for (const PoolChain& chain : m_FramePools)
+	{
+		count += chain.pools.size();
+	}
+	return count;
+}
+
+//====================================================================================
+// ݁ELbV
+// Writing and caching
+//====================================================================================
+
+// XVev[gFDescriptorInfo̔zoCfBOɓǂ݂܂iCAEgƂ1쐬j
+// Update template reading a DescriptorInfo array in binding order, created once per layout
+VkDescriptorUpdateTemplate CDescriptorAllocator::getTemplate(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+	auto it = m_Templates.find(layout);
+	if (it != m_Templates.end())
+	{
+		return it->second;
+	}
+
+	std::vector<VkDescriptorUpdateTemplateEntry> entries(bindings.size());
+	size_t offset = 0;
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		entries[i].dstBinding = bindings[i].binding;
+		entries[i].dstArrayElement = 0;
+		entries[i].descriptorCount = bindings[i].descriptorCount;
+		entries[i].descriptorType = bindings[i].descriptorType;
+		entries[i].offset = offset;
+		entries[i].stride = sizeof(DescriptorInfo);
+		offset += sizeof(DescriptorInfo) * bindings[i].descriptorCount;
+	}
+
+	VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+	templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+	templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+	templateInfo.pDescriptorUpdateEntries = entries.data();
+	templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+	templateInfo.descriptorSetLayout = layout;
+
+	VkDescriptorUpdateTemplate updateTemplate;
+	if (vkCreateDescriptorUpdateTemplate(m_Device, &templateInfo, m_Allocator, &updateTemplate) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create descriptor update template!");
+	}
+
+	m_Templates.emplace(layout, updateTemplate);
+	return updateTemplate;
+}
+
+void CDescriptorAllocator::write(VkDescriptorSet set, VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	const std::vector<DescriptorInfo>& infos)
+{
+	if (infos.size() != getDescriptorCount(bindings))
+	{
+		throw std::runtime_error("Descriptor resources do not match the set layout!");
+	}
+
+	vkUpdateDescriptorSetWithTemplate(m_Device, set, getTemplate(layout, bindings), infos.data());
+}
+
+// ނɍo[nbV܂
+// hash only the union member each descriptor type actually uses
+uint64_t CDescriptorAllocator::hashSet(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	const std::vector<DescriptorInfo>& infos)
+{
+	uint64_t hash = 14695981039346656037ull;
+	hashValue(hash, layout);
+
+	size_t index = 0;
+	for (const VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		const bool image = isImageDescriptor(binding.descriptorType);
+		for (uint32_t i = 0; i < binding.descriptorCount; i++, index++)
+		{
+			const DescriptorInfo& info = infos[index];
+			if (image)
+			{
+				hashValue(hash, info.image.sampler);
+				hashValue(hash, info.image.imageView);
+				hashValue(hash, info.image.imageLayout);
+			}
+			else
+			{
+				hashValue(hash, info.buffer.buffer);
+				hashValue(hash, info.buffer.offset);
+				hashValue(hash, info.buffer.range);
+			}
+		}
+	}
+	return hash;
+}
+
+bool CDescriptorAllocator::isSameSet(const CachedSet& cached, VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	const std::vector<DescriptorInfo>& infos)
+{
+	if (cached.layout != layout || cached.infos.size() != infos.size())
+	{
+		return false;
+	}
+
+	size_t index = 0;
+	for (const VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		const bool image = isImageDescriptor(binding.descriptorType);
+		for (uint32_t i = 0; i < binding.descriptorCount; i++, index++)
+		{
+			const DescriptorInfo& a = cached.infos[index];
+			const DescriptorInfo& b = infos[index];
+			const bool equal = image
+				? (a.image.sampler == b.image.sampler && a.image.imageView == b.image.imageView && a.image.imageLayout == b.image.imageLayout)
+				: (a.buffer.buffer == b.buffer.buffer && a.buffer.offset == b.buffer.offset && a.buffer.range == b.buffer.range);
+			if (!equal)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+VkDescriptorSet CDescriptorAllocator::getSet(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	const std::vector<DescriptorInfo>& infos)
+{
+	if (infos.size() != getDescriptorCount(bindings))
+	{
+		throw std::runtime_error("Descriptor resources do not match the set layout!");
+	}
+
+	const uint64_t hash = hashSet(layout, bindings, infos);
+	auto range = m_SetCache.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (isSameSet(it->second, layout, bindings, infos))
+		{
+			return it->second.set;
+		}
+	}
+
+	CachedSet cachedSet;
+	cachedSet.layout = layout;
+	cachedSet.infos = infos;
+	cachedSet.set = allocate(m_CachePools, layout);
+	write(cachedSet.set, layout, bindings, infos);
+
+	m_SetCache.emplace(hash, cachedSet);
+	return cachedSet.set;
+}
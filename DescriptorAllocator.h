@@ -0,0 +1,97 @@
+/*======================================================================
+Vulkan Presentation : DescriptorAllocator.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// fXNv^[1̏ݓeiXVev[g̃f[^FCAEg̃oCfBOAz͗vfj
+// What one descriptor points at; the update template reads these in binding order, array elements in a row
+union DescriptorInfo
+{
+	VkDescriptorBufferInfo buffer;
+	VkDescriptorImageInfo  image;
+
+	static DescriptorInfo fromBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+	static DescriptorInfo fromImage(VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout);
+};
+
+// fXNv^[AP[^[Fv[g؂玟̃v[ǉ܂
+// Descriptor allocator; each pool chain grows by another pool when the current one runs out
+//   t[Ƃ̃v[FbeginFrame()ł܂Ƃ߂ăZbgĩt[gZbgAFGPUJÕZbgj
+//   per-frame pools, reset wholesale by beginFrame(), for sets used within one frame such as the culling set
+//   LbVFCAEgƏݓẽnbVœZbgėpi݂͏̂݁AXVev[gŁj
+//   cache: sets are reused by layout + contents hash, written once through an update template
+class CDescriptorAllocator
+{
+public:
+
+	// descriptorsPerSetFZbg1̕σfXNv^[iނƁjAv[TCY̔䗦ɂȂ܂
+	// descriptorsPerSet: average descriptors of each type per set; pools are sized in this ratio
+	void init(VkDevice device, uint32_t frameCount, const std::vector<VkDescriptorPoolSize>& descriptorsPerSet,
+		const VkAllocationCallbacks* allocator = nullptr);
+	void destroy();
+
+	// ̃t[̃v[Zbgi^CCł̃t[̊mFĂj
+	// reset this frame's pools; call once the frame timeline shows the frame has completed
+	void beginFrame(uint32_t frameIndex);
+	VkDescriptorSet allocateTransient(VkDescriptorSetLayout layout);    // ݂̃t[̂ݗL
+
+	// CAEgE\[X̃Zbg΂ԂAȂΊmۂď݂܂
+	// returns the cached set for this layout and these resources, or allocates and writes a new one
+	VkDescriptorSet getSet(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		const std::vector<DescriptorInfo>& infos);
+
+	// XVev[gŏ݂܂iallocateTransient()̃ZbgȂǁj
+	// write a set through its layout's update template (e.g. one from allocateTransient())
+	void write(VkDescriptorSet set, VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		const std::vector<DescriptorInfo>& infos);
+
+	// LbṼZbgSĉiGPUǂ̃ZbggĂȂ̂݁j
+	// release every cached set; only while the GPU uses none of them
+	void resetCache();
+
+	size_t getCachedSetCount() const { return m_SetCache.size(); }
+	size_t getPoolCount() const;
+
+private:
+
+	// v[̗Fcurrentg؂玟ցAȂ΍܂
+	// a chain of pools; when current is exhausted move on to the next, creating it if needed
+	struct PoolChain
+	{
+		std::vector<VkDescriptorPool> pools;
+		size_t                        current = 0;
+	};
+
+	struct CachedSet
+	{
+		VkDescriptorSetLayout       layout;
+		std::vector<DescriptorInfo> infos;
+		VkDescriptorSet             set;
+	};
+
+	VkDescriptorSet allocate(PoolChain& chain, VkDescriptorSetLayout layout);
+	void resetChain(PoolChain& chain);
+	VkDescriptorPool createPool();
+	VkDescriptorUpdateTemplate getTemplate(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+	static uint64_t hashSet(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		const std::vector<DescriptorInfo>& infos);
+	static bool isSameSet(const CachedSet& cached, VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		const std::vector<DescriptorInfo>& infos);
+
+	VkDevice                                                          m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks*                                      m_Allocator = nullptr;
+	std::vector<VkDescriptorPoolSize>                                 m_DescriptorsPerSet;
+	std::vector<PoolChain>                                            m_FramePools;     // t[
+	uint32_t                                                          m_CurrentFrame = 0;
+	PoolChain                                                         m_CachePools;     // LbṼZbg
+	std::unordered_multimap<uint64_t, CachedSet>                      m_SetCache;       // nbVՓ˂ꍇ͓er܂
+	std::unordered_map<VkDescriptorSetLayout, VkDescriptorUpdateTemplate> m_Templates;  // CAEgƂ̍XVev[g
+};
@@ -0,0 +1,166 @@
+/*======================================================================
+Vulkan Presentation : DrawQueue.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "DrawQueue.h"
+
+#include <algorithm>
+
+const uint32_t DEPTH_BITS = 24;
+const uint32_t MESH_BITS = 16;
+const uint32_t MATERIAL_BITS = 16;
+const uint32_t PIPELINE_BITS = 8;
+
+//====================================================================================
+// 10X : L[EpPbgo^
+// Key Creation/Packet Submission
+//====================================================================================
+
+uint64_t CDrawQueue::makeKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, float depth)
+{
+	// fvXi0`1j24rbgɗʎqFO牜ցis̃A[[Zj
+	// quantize 0..1 depth to 24 bits, front to back (early-Z friendly for opaque draws)
+	const float clampedDepth = std::min(std::max(depth, 0.0f), 1.0f);
+	const uint64_t quantizedDepth = static_cast<uint64_t>(clampedDepth * float((1u << DEPTH_BITS) - 1));
+
+	return (uint64_t(pipelineId & ((1u << PIPELINE_BITS) - 1)) << (DEPTH_BITS + MESH_BITS + MATERIAL_BITS))
+		| (uint64_t(materialId & ((1u << MATERIAL_BITS) - 1)) << (DEPTH_BITS + MESH_BITS))
+		| (uint64_t(meshId & ((1u << MESH_BITS) - 1)) << DEPTH_BITS)
+		| quantizedDepth;
+}
+
+void CDrawQueue::clear()
+{
+	m_Packets.clear();
+	m_Keys.clear();
+	m_Order.clear();
+}
+
+void CDrawQueue::submit(const DrawPacket& packet)
+{
+	m_Order.push_back(static_cast<uint32_t>(m_Packets.size()));
+	m_Keys.push_back(packet.key);
+	m_Packets.push_back(packet);
+}
+
+//====================================================================================
+// 20X : \[gER}ho^
+// Sorting/Command Recording
+//====================================================================================
+
+// LSD\[gi8rbg~8pXjFL[ƃCfbNX݈̂ړASoCgpX͏ȗ܂
+// LSD radix sort, 8 passes of 8 bits over (key, index) pairs; passes where every key shares the byte are skipped
+void CDrawQueue::sort()
+{
+	const size_t count = m_Keys.size();
+	if (count < 2)
+	{
+		return;
+	}
+
+	// SpX̃qXgO1̑ō܂
+	// build the histograms for all eight passes in a single sweep
+	uint32_t histograms[8][256] = {};
+	for (uint64_t key : m_Keys)
+	{
+		for (int pass = 0; pass < 8; pass++)
+		{
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+		}
+	}
+
+	m_KeysTemp.resize(count);
+	m_OrderTemp.resize(count);
+
+	for (int pass = 0; pass < 8; pass++)
+	{
+		uint32_t* histogram = histograms[pass];
+		const uint32_t shift = pass * 8;
+
+		// SL[oCg̏ꍇÃpX͏ς܂
+		// every key has the same byte here, so this pass would not change the order
+		if (histogram[(m_Keys[0] >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		// qXgO  eoPbg݈̏ʒu
+		// histogram -> starting offset of each bucket
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			const uint32_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t destination = histogram[(m_Keys[i] >> shift) & 0xFF]++;
+			m_KeysTemp[destination] = m_Keys[i];
+			m_OrderTemp[destination] = m_Order[i];
+		}
+
+		m_Keys.swap(m_KeysTemp);
+		m_Order.swap(m_OrderTemp);
+	}
+}
+
+// \[gɕ`o^FOƓXe[g̃oCh͏ȗ܂
+// Record the draws in sorted order, skipping binds whose state matches the previous draw
+void CDrawQueue::record(VkCommandBuffer commandBuffer)
+{
+	m_Stats = DrawQueueStats{};
+
+	VkPipeline currentPipeline = VK_NULL_HANDLE;
+	VkDescriptorSet currentDescriptorSet = VK_NULL_HANDLE;
+	VkBuffer currentVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer currentInstanceBuffer = VK_NULL_HANDLE;
+
+	for (uint32_t index : m_Order)
+	{
+		const DrawPacket& packet = m_Packets[index];
+
+		// pCvCςƃCAEgς\̂ŁAfXNv^[ZbgoCh܂
+		// a new pipeline may bring a new layout, so the descriptor set is rebound with it
+		if (packet.pipeline != currentPipeline)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline);
+			currentPipeline = packet.pipeline;
+			currentDescriptorSet = VK_NULL_HANDLE;
+			m_Stats.pipelineBinds++;
+		}
+
+		if (packet.descriptorSet != currentDescriptorSet)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipelineLayout,
+				0, 1, &packet.descriptorSet, 0, nullptr);
+			currentDescriptorSet = packet.descriptorSet;
+			m_Stats.descriptorSetBinds++;
+		}
+
+		if (packet.vertexBuffer != currentVertexBuffer || packet.instanceBuffer != currentInstanceBuffer)
+		{
+			VkBuffer vertexBuffers[] = { packet.vertexBuffer, packet.instanceBuffer };
+			VkDeviceSize offsets[] = { 0, 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+			currentVertexBuffer = packet.vertexBuffer;
+			currentInstanceBuffer = packet.instanceBuffer;
+			m_Stats.vertexBufferBinds++;
+		}
+
+		// vbV萔͕`悲ƁiR}hXg[ւ݂̏̂݁j
+		// push constants are per draw; they only cost a command-stream write
+		vkCmdPushConstants(commandBuffer, packet.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			0, sizeof(DrawPushConstants), &packet.pushConstants);
+
+		vkCmdDrawIndexed(commandBuffer, packet.indexCount, packet.instanceCount, packet.firstIndex, 0, 0);
+		m_Stats.drawCount++;
+	}
+
+	// \[gȂEȗȂ̏ꍇ͕`悲Ƃ3oCh܂
+	// without sorting and elision every draw would bind all three
+	m_Stats.bindsSaved = m_Stats.drawCount * 3
+		- (m_Stats.pipelineBinds + m_Stats.descriptorSetBinds + m_Stats.vertexBufferBinds);
+}
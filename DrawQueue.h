@@ -0,0 +1,75 @@
+/*======================================================================
+Vulkan Presentation : DrawQueue.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// `悲Ƃ̃vbV萔FR}hobt@[ɒڏ܂܂iobt@[EfXNv^[XVȂj
+// Per-draw push constants, written straight into the command stream (no buffer traffic, no descriptor changes)
+struct DrawPushConstants
+{
+	glm::mat4 model;            // fs (offset 0)
+	uint32_t  materialIndex;    // }eAԍ (offset 64)
+};
+
+// `pPbgF\[gL[{`ɕKvȃXe[gE
+// Draw packet: sort key plus the state and arguments needed to record the draw
+struct DrawPacket
+{
+	uint64_t          key;               // CDrawQueue::makeKey()
+	VkPipeline        pipeline;
+	VkPipelineLayout  pipelineLayout;
+	VkDescriptorSet   descriptorSet;     // Zbg0i}eAj
+	VkBuffer          vertexBuffer;      // oCfBO0
+	VkBuffer          instanceBuffer;    // oCfBO1
+	uint32_t          indexCount;
+	uint32_t          firstIndex;
+	uint32_t          instanceCount;
+	DrawPushConstants pushConstants;
+};
+
+// t[Ƃ̓vFȗłoChȂ
+// per-frame statistics, including how many bind calls were elided
+struct DrawQueueStats
+{
+	uint32_t drawCount = 0;
+	uint32_t pipelineBinds = 0;
+	uint32_t descriptorSetBinds = 0;
+	uint32_t vertexBufferBinds = 0;
+	uint32_t bindsSaved = 0;        // \[gȂŖoChꍇƂ̍
+};
+
+// `L[FpPbg64rbgL[Ŋ\[gāAdoChȗēo^܂
+// Draw queue: radix-sorts packets by a 64-bit state key and records them with redundant binds elided
+class CDrawQueue
+{
+public:
+
+	// L[FpCvC(8) | }eA(16) | bV(16) | fvX(24)Arbgقǐ؂ւdXe[g
+	// key layout, most expensive state change in the highest bits: pipeline(8) | material(16) | mesh(16) | depth(24)
+	static uint64_t makeKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, float depth);
+
+	void clear();
+	void submit(const DrawPacket& packet);
+	void sort();
+	void record(VkCommandBuffer commandBuffer);
+
+	size_t size() const { return m_Packets.size(); }
+	const DrawQueueStats& getStats() const { return m_Stats; }
+
+private:
+
+	std::vector<DrawPacket> m_Packets;      // o^̂܂܁i\[g̓CfbNX̂݁j
+	std::vector<uint64_t>   m_Keys;         // \[gpiL[ƃCfbNX݈̂ړ܂j
+	std::vector<uint64_t>   m_KeysTemp;
+	std::vector<uint32_t>   m_Order;        // \[g̕`揇
+	std::vector<uint32_t>   m_OrderTemp;
+	DrawQueueStats          m_Stats;
+};
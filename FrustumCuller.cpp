@@ -0,0 +1,472 @@
+/*======================================================================
+Vulkan Presentation : FrustumCuller.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "FrustumCuller.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <array>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <stdexcept>
+
+// SIMD߃Zbg̔ix86SSE2OAAVX2͎sɊmF܂j
+// instruction set detection: SSE2 is the x86 baseline, AVX2 is checked at runtime
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRUSTUM_CULLER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FRUSTUM_CULLER_TARGET_AVX2
+#else
+#define FRUSTUM_CULLER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define FRUSTUM_CULLER_NEON
+#include <arm_neon.h>
+#endif
+
+const size_t SIMD_WIDTH = 8;    // 1[vŔ肷IuWFNg / objects tested per iteration
+
+namespace
+{
+	// }XNi1rbg1IuWFNgj[̔ԍl߂e[uiAVX2̈kݗpj
+	// per-mask table of packed visible lane numbers, one byte each (used by the AVX2 compaction)
+	struct CompactionTable
+	{
+		uint64_t lanes[256];
+		uint8_t  counts[256];
+
+		CompactionTable()
+		{
+			for (uint32_t mask = 0; mask < 256; mask++)
+			{
+				uint64_t packed = 0;
+				uint8_t count = 0;
+				for (uint32_t lane = 0; lane < SIMD_WIDTH; lane++)
+				{
+					if (mask & (1u << lane))
+					{
+						packed |= static_cast<uint64_t>(lane) << (8 * count);
+						count++;
+					}
+				}
+				lanes[mask] = packed;
+				counts[mask] = count;
+			}
+		}
+	};
+
+	const CompactionTable s_CompactionTable;
+
+	// XJ[ŁFx`}[NƑ̃J[l̔r
+	// scalar reference kernel
+	size_t cullScalar(const float* centerX, const float* centerY, const float* centerZ, const float* radius,
+		size_t paddedCount, const float planes[6][4], uint32_t* visible)
+	{
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < paddedCount; i++)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6; p++)
+			{
+				const float distance = planes[p][0] * centerX[i] + planes[p][1] * centerY[i] + planes[p][2] * centerZ[i] + planes[p][3];
+				inside = inside & (distance >= -radius[i]);
+			}
+
+			// Ȃ̈k݁FɏŁA̏ꍇi߂
+			// branchless compaction: always write, only advance when visible
+			visible[visibleCount] = static_cast<uint32_t>(i);
+			visibleCount += inside ? 1 : 0;
+		}
+		return visibleCount;
+	}
+
+#if defined(FRUSTUM_CULLER_X86)
+
+	// SSE2ŁF1[v4IuWFNg肵܂
+	// SSE2 kernel: four objects per iteration
+	size_t cullSSE(const float* centerX, const float* centerY, const float* centerZ, const float* radius,
+		size_t paddedCount, const float planes[6][4], uint32_t* visible)
+	{
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; p++)
+		{
+			planeX[p] = _mm_set1_ps(planes[p][0]);
+			planeY[p] = _mm_set1_ps(planes[p][1]);
+			planeZ[p] = _mm_set1_ps(planes[p][2]);
+			planeW[p] = _mm_set1_ps(planes[p][3]);
+		}
+
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < paddedCount; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(centerX + i);
+			const __m128 y = _mm_loadu_ps(centerY + i);
+			const __m128 z = _mm_loadu_ps(centerZ + i);
+			const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], x), planeW[p]);
+				distance = _mm_add_ps(distance, _mm_mul_ps(planeY[p], y));
+				distance = _mm_add_ps(distance, _mm_mul_ps(planeZ[p], z));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+			}
+
+			const int mask = _mm_movemask_ps(inside);
+			const uint32_t base = static_cast<uint32_t>(i);
+			visible[visibleCount] = base + 0;	visibleCount += (mask >> 0) & 1;
+			visible[visibleCount] = base + 1;	visibleCount += (mask >> 1) & 1;
+			visible[visibleCount] = base + 2;	visibleCount += (mask >> 2) & 1;
+			visible[visibleCount] = base + 3;	visibleCount += (mask >> 3) & 1;
+		}
+		return visibleCount;
+	}
+
+	// AVX2ŁF8肵āAe[uŉCfbNXבւĈxɏ݂܂
+	// AVX2 kernel: 8 objects per iteration, visible indices compacted with a permute and one store
+	FRUSTUM_CULLER_TARGET_AVX2
+	size_t cullAVX2(const float* centerX, const float* centerY, const float* centerZ, const float* radius,
+		size_t paddedCount, const float planes[6][4], uint32_t* visible)
+	{
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; p++)
+		{
+			planeX[p] = _mm256_set1_ps(planes[p][0]);
+			planeY[p] = _mm256_set1_ps(planes[p][1]);
+			planeZ[p] = _mm256_set1_ps(planes[p][2]);
+			planeW[p] = _mm256_set1_ps(planes[p][3]);
+		}
+
+		const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < paddedCount; i += SIMD_WIDTH)
+		{
+			const __m256 x = _mm256_loadu_ps(centerX + i);
+			const __m256 y = _mm256_loadu_ps(centerY + i);
+			const __m256 z = _mm256_loadu_ps(centerZ + i);
+			const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_mul_ps(planeX[p], x), planeW[p]);
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(planeY[p], y));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(planeZ[p], z));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+			}
+
+			const int mask = _mm256_movemask_ps(inside);
+			const __m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), laneOffsets);
+			const __m256i permutation = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&s_CompactionTable.lanes[mask])));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(visible + visibleCount), _mm256_permutevar8x32_epi32(indices, permutation));
+			visibleCount += s_CompactionTable.counts[mask];
+		}
+		return visibleCount;
+	}
+
+	bool isAVX2Supported()
+	{
+#if defined(_MSC_VER)
+		// CPUID.7.EBX[5]AVX2AOSYMMWX^ۑĂ邩iXCR0jmF܂
+		// AVX2 is CPUID.7.EBX[5]; the OS must also save the YMM registers (XCR0)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+#elif defined(FRUSTUM_CULLER_NEON)
+
+	// NEONŁF4~28IuWFNg/[v
+	// NEON kernel: two 4-wide halves per 8-object iteration
+	size_t cullNEON(const float* centerX, const float* centerY, const float* centerZ, const float* radius,
+		size_t paddedCount, const float planes[6][4], uint32_t* visible)
+	{
+		float32x4_t planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; p++)
+		{
+			planeX[p] = vdupq_n_f32(planes[p][0]);
+			planeY[p] = vdupq_n_f32(planes[p][1]);
+			planeZ[p] = vdupq_n_f32(planes[p][2]);
+			planeW[p] = vdupq_n_f32(planes[p][3]);
+		}
+
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < paddedCount; i += 4)
+		{
+			const float32x4_t x = vld1q_f32(centerX + i);
+			const float32x4_t y = vld1q_f32(centerY + i);
+			const float32x4_t z = vld1q_f32(centerZ + i);
+			const float32x4_t negRadius = vnegq_f32(vld1q_f32(radius + i));
+
+			uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+			for (int p = 0; p < 6; p++)
+			{
+				float32x4_t distance = vmlaq_f32(planeW[p], planeX[p], x);
+				distance = vmlaq_f32(distance, planeY[p], y);
+				distance = vmlaq_f32(distance, planeZ[p], z);
+				inside = vandq_u32(inside, vcgeq_f32(distance, negRadius));
+			}
+
+			const uint32_t base = static_cast<uint32_t>(i);
+			visible[visibleCount] = base + 0;	visibleCount += vgetq_lane_u32(inside, 0) & 1;
+			visible[visibleCount] = base + 1;	visibleCount += vgetq_lane_u32(inside, 1) & 1;
+			visible[visibleCount] = base + 2;	visibleCount += vgetq_lane_u32(inside, 2) & 1;
+			visible[visibleCount] = base + 3;	visibleCount += vgetq_lane_u32(inside, 3) & 1;
+		}
+		return visibleCount;
+	}
+
+#endif
+}
+
+//====================================================================================
+// 10X : IuWFNgo^Eʐݒp֐
+// Object Registration/Plane Setup Functions
+//====================================================================================
+
+void CFrustumCuller::clear()
+{
+	m_CenterX.clear();
+	m_CenterY.clear();
+	m_CenterZ.clear();
+	m_Radius.clear();
+	m_Count = 0;
+}
+
+void CFrustumCuller::reserve(size_t count)
+{
+	const size_t paddedCount = (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	m_CenterX.reserve(paddedCount);
+	m_CenterY.reserve(paddedCount);
+	m_CenterZ.reserve(paddedCount);
+	m_Radius.reserve(paddedCount);
+}
+
+uint32_t CFrustumCuller::addSphere(const glm::vec3& center, float radius)
+{
+	// pfBOg؂ꍇASIMD̕ǉ܂iKJO鋅j
+	// out of padding: grow by one SIMD width of spheres that always fail the test
+	if (m_Count == m_Radius.size())
+	{
+		m_CenterX.resize(m_Count + SIMD_WIDTH, 0.0f);
+		m_CenterY.resize(m_Count + SIMD_WIDTH, 0.0f);
+		m_CenterZ.resize(m_Count + SIMD_WIDTH, 0.0f);
+		m_Radius.resize(m_Count + SIMD_WIDTH, -FLT_MAX);
+	}
+
+	m_CenterX[m_Count] = center.x;
+	m_CenterY[m_Count] = center.y;
+	m_CenterZ[m_Count] = center.z;
+	m_Radius[m_Count] = radius;
+	return static_cast<uint32_t>(m_Count++);
+}
+
+void CFrustumCuller::setPlanes(const glm::mat4& viewProj)
+{
+	// glm͗DFsr(m[0][r], m[1][r], m[2][r], m[3][r])
+	// glm is column-major: row r is (m[0][r], m[1][r], m[2][r], m[3][r])
+	auto row = [&viewProj](int r)
+	{
+		return glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+	};
+
+	const glm::vec4 planes[6] =
+	{
+		row(3) + row(0),    // left
+		row(3) - row(0),    // right
+		row(3) + row(1),    // bottom
+		row(3) - row(1),    // top
+		row(2),             // neariVulkañfvX0`1 / Vulkan depth is 0..1j
+		row(3) - row(2)     // far
+	};
+
+	for (int p = 0; p < 6; p++)
+	{
+		const float length = std::sqrt(planes[p].x * planes[p].x + planes[p].y * planes[p].y + planes[p].z * planes[p].z);
+		m_Planes[p][0] = planes[p].x / length;
+		m_Planes[p][1] = planes[p].y / length;
+		m_Planes[p][2] = planes[p].z / length;
+		m_Planes[p][3] = planes[p].w / length;
+	}
+}
+
+//====================================================================================
+// 20X : JO֐
+// Culling Functions
+//====================================================================================
+
+size_t CFrustumCuller::cull(std::vector<uint32_t>& visible, Kernel kernel) const
+{
+	if (kernel == Kernel::Best)
+	{
+		kernel = isKernelSupported(Kernel::AVX2) ? Kernel::AVX2
+			: isKernelSupported(Kernel::SSE) ? Kernel::SSE
+			: isKernelSupported(Kernel::NEON) ? Kernel::NEON
+			: Kernel::Scalar;
+	}
+	if (!isKernelSupported(kernel))
+	{
+		throw std::runtime_error("Failed to cull: kernel not supported on this CPU!");
+	}
+
+	// J[l͏ɏނ̂ŁASIMD̗̕]Tmۂ܂
+	// kernels always store a full SIMD width, so leave that much slack at the end
+	const size_t paddedCount = m_Radius.size();
+	visible.resize(paddedCount + SIMD_WIDTH);
+
+	size_t visibleCount = 0;
+	switch (kernel)
+	{
+#if defined(FRUSTUM_CULLER_X86)
+	case Kernel::AVX2:
+		visibleCount = cullAVX2(m_CenterX.data(), m_CenterY.data(), m_CenterZ.data(), m_Radius.data(), paddedCount, m_Planes, visible.data());
+		break;
+	case Kernel::SSE:
+		visibleCount = cullSSE(m_CenterX.data(), m_CenterY.data(), m_CenterZ.data(), m_Radius.data(), paddedCount, m_Planes, visible.data());
+		break;
+#elif defined(FRUSTUM_CULLER_NEON)
+	case Kernel::NEON:
+		visibleCount = cullNEON(m_CenterX.data(), m_CenterY.data(), m_CenterZ.data(), m_Radius.data(), paddedCount, m_Planes, visible.data());
+		break;
+#endif
+	default:
+		visibleCount = cullScalar(m_CenterX.data(), m_CenterY.data(), m_CenterZ.data(), m_Radius.data(), paddedCount, m_Planes, visible.data());
+		break;
+	}
+
+	visible.resize(visibleCount);
+	return visibleCount;
+}
+
+//====================================================================================
+// 30X : J[lNG[p֐
+// Kernel Query Functions
+//====================================================================================
+
+bool CFrustumCuller::isKernelSupported(Kernel kernel)
+{
+	switch (kernel)
+	{
+	case Kernel::Best:
+	case Kernel::Scalar:
+		return true;
+#if defined(FRUSTUM_CULLER_X86)
+	case Kernel::SSE:
+		return true;
+	case Kernel::AVX2:
+	{
+		static const bool supported = isAVX2Supported();
+		return supported;
+	}
+#elif defined(FRUSTUM_CULLER_NEON)
+	case Kernel::NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* CFrustumCuller::getKernelName(Kernel kernel)
+{
+	switch (kernel)
+	{
+	case Kernel::Best:		return "Best";
+	case Kernel::Scalar:	return "Scalar";
+	case Kernel::SSE:		return "SSE2";
+	case Kernel::AVX2:		return "AVX2";
+	case Kernel::NEON:		return "NEON";
+	default:				return "Unknown";
+	}
+}
+
+//====================================================================================
+// 50X : x`}[N
+// Benchmark
+//====================================================================================
+
+int CFrustumCuller::runBenchmark(size_t objectCount)
+{
+	// _ȋiŒV[hjƃTvƓJ
+	// random spheres (fixed seed) seen from the same camera as the sample
+	std::mt19937 generator(12345);
+	std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> size(0.1f, 1.0f);
+
+	CFrustumCuller culler;
+	culler.reserve(objectCount);
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		culler.addSphere(glm::vec3(position(generator), position(generator), position(generator)), size(generator));
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	proj[1][1] *= -1;
+	culler.setPlanes(proj * view);
+
+	const int iterations = 50;
+	std::vector<uint32_t> reference;
+	culler.cull(reference, Kernel::Scalar);
+
+	std::cout << "Frustum culling benchmark: " << objectCount << " objects, "
+		<< reference.size() << " visible, " << iterations << " iterations" << std::endl;
+
+	bool mismatch = false;
+	const Kernel kernels[] = { Kernel::Scalar, Kernel::SSE, Kernel::AVX2, Kernel::NEON };
+	for (Kernel kernel : kernels)
+	{
+		if (!isKernelSupported(kernel))
+		{
+			continue;
+		}
+
+		std::vector<uint32_t> visible;
+		culler.cull(visible, kernel);    // EH[Abv / warm-up
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			culler.cull(visible, kernel);
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		const double nanoseconds = std::chrono::duration<double, std::nano>(endTime - startTime).count() / iterations;
+		const bool matches = (visible == reference);
+		mismatch = mismatch || !matches;
+
+		std::cout << "  " << std::left << std::setw(8) << getKernelName(kernel) << std::right
+			<< std::fixed << std::setprecision(3)
+			<< std::setw(10) << nanoseconds / 1000000.0 << " ms  "
+			<< std::setw(8) << objectCount / nanoseconds << " objects/ns"
+			<< (matches ? "" : "  MISMATCH") << std::endl;
+	}
+
+	return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+/*======================================================================
+Vulkan Presentation : FrustumCuller.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// CPUJOFESoAiStructure of ArraysjŊi[āASIMD8eXg܂
+// CPU frustum culler: bounding spheres stored as structure-of-arrays, tested 8 at a time with SIMD
+class CFrustumCuller
+{
+public:
+
+	// JOJ[liBest͎sɎgԑ́j
+	// culling kernels; Best picks the fastest one available at runtime
+	enum class Kernel
+	{
+		Best,
+		Scalar,
+		SSE,
+		AVX2,
+		NEON
+	};
+
+	void clear();
+	void reserve(size_t count);
+	uint32_t addSphere(const glm::vec3& center, float radius);    // ߂lFIuWFNgCfbNX
+	size_t size() const { return m_Count; }
+
+	// 6ʂproj * viewiproj * view * modelj璊o܂iGribb-HartmannA0`1fvXj
+	// extract the six frustum planes from proj * view (Gribb-Hartmann, 0..1 depth as in Vulkan)
+	void setPlanes(const glm::mat4& viewProj);
+
+	// IuWFNg̃CfbNXl߂visibleɏ݁A̐Ԃ܂
+	// write the indices of visible objects, compacted, into visible and return how many there are
+	size_t cull(std::vector<uint32_t>& visible, Kernel kernel = Kernel::Best) const;
+
+	static bool isKernelSupported(Kernel kernel);
+	static const char* getKernelName(Kernel kernel);
+
+	// x`}[NF_ȋŃJ[lƂ̏xiIuWFNg/nsjv܂
+	// benchmark every supported kernel on random spheres and report objects per nanosecond
+	static int runBenchmark(size_t objectCount);
+
+private:
+
+	// SIMD̕i8j̔{܂ŃpfBOGpfBO̔a-FLT_MAXiKJOj
+	// padded to a multiple of the SIMD width (8); padding radius is -FLT_MAX so it always fails
+	std::vector<float> m_CenterX;
+	std::vector<float> m_CenterY;
+	std::vector<float> m_CenterZ;
+	std::vector<float> m_Radius;
+	size_t             m_Count = 0;
+
+	float              m_Planes[6][4] = {};    // Kς (nx, ny, nz, d)F dot(n, p) + d >= 0
+};
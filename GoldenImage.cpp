@@ -0,0 +1,83 @@
+/*======================================================================
+Vulkan Presentation : GoldenImage.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "GoldenImage.h"
+
+#include <stb_image.h>          // VulkanFramework.cppiSTB_IMAGE_IMPLEMENTATIONj
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>    // S[f摜̏
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// ő̐FiƔ̓拗jFYIQ̏d݂ŐK܂
+	// the largest possible squared delta (black against white), used to normalize to 0.0 - 1.0
+	const double MAX_YIQ_DELTA = 35215.0;
+
+	// YIQFԂł̓拗iKotsarenko & RamosA邳0.5053EF0.299E0.1957j
+	// squared distance in YIQ space, weighted 0.5053 / 0.299 / 0.1957 (Kotsarenko & Ramos)
+	double yiqDelta(const uint8_t* a, const uint8_t* b)
+	{
+		const double r1 = a[0], g1 = a[1], b1 = a[2];
+		const double r2 = b[0], g2 = b[1], b2 = b[2];
+
+		const double y = (r1 * 0.29889531 + g1 * 0.58662247 + b1 * 0.11448223) - (r2 * 0.29889531 + g2 * 0.58662247 + b2 * 0.11448223);
+		const double i = (r1 * 0.59597799 - g1 * 0.27417610 - b1 * 0.32180189) - (r2 * 0.59597799 - g2 * 0.27417610 - b2 * 0.32180189);
+		const double q = (r1 * 0.21147017 - g1 * 0.52261711 + b1 * 0.31114694) - (r2 * 0.21147017 - g2 * 0.52261711 + b2 * 0.31114694);
+
+		return 0.5053 * y * y + 0.299 * i * i + 0.1957 * q * q;
+	}
+}
+
+bool CGoldenImage::load(const std::string& path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& pixels)
+{
+	int imageWidth, imageHeight, channels;
+	stbi_uc* data = stbi_load(path.c_str(), &imageWidth, &imageHeight, &channels, STBI_rgb_alpha);
+	if (data == nullptr)
+	{
+		return false;
+	}
+
+	width = static_cast<uint32_t>(imageWidth);
+	height = static_cast<uint32_t>(imageHeight);
+	pixels.assign(data, data + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(data);
+	return true;
+}
+
+bool CGoldenImage::save(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& pixels)
+{
+	return stbi_write_png(path.c_str(), static_cast<int>(width), static_cast<int>(height), 4, pixels.data(), static_cast<int>(width * 4)) != 0;
+}
+
+ImageDifference CGoldenImage::compare(const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual,
+	uint32_t width, uint32_t height, double pixelThreshold)
+{
+	ImageDifference difference;
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	if (pixelCount == 0)
+	{
+		return difference;
+	}
+
+	double deltaSum = 0.0;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		const double delta = std::sqrt(yiqDelta(&expected[i * 4], &actual[i * 4]) / MAX_YIQ_DELTA);    // 0.0`1.0
+		deltaSum += delta;
+		difference.maxDelta = std::max(difference.maxDelta, delta);
+		if (delta > pixelThreshold)
+		{
+			difference.mismatchedPixels++;
+		}
+	}
+
+	difference.mismatchedPercent = difference.mismatchedPixels * 100.0 / pixelCount;
+	difference.meanDelta = deltaSum / pixelCount;
+	return difference;
+}
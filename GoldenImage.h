@@ -0,0 +1,40 @@
+/*======================================================================
+Vulkan Presentation : GoldenImage.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// 2̉摜̍imoIȐFFYIQA0.0`1.0j
+// Difference between two images, measured as a perceptual YIQ color delta from 0.0 to 1.0
+struct ImageDifference
+{
+	uint32_t mismatchedPixels = 0;      // FsNZ臒l𒴂sNZ
+	double   mismatchedPercent = 0.0;
+	double   meanDelta = 0.0;
+	double   maxDelta = 0.0;
+};
+
+// S[f摜FPNG̓ǂݏƔri`挋ʂ̉AeXgpj
+// Golden images: PNG load/save and comparison, for render output regression tests
+//   F͖邳dYIQil̖ڂɋ߂jȂ̂ŁAA`GCAXtB^[̔ȈႢ͋eł܂
+//   the delta weighs luma over chroma like the eye does, so small filtering or anti-aliasing differences stay under
+//   the per-pixel threshold while real regressions do not
+class CGoldenImage
+{
+public:
+
+	// RGBA8i1sNZ4oCgAs̋l߂Ȃj
+	// RGBA8, four bytes per pixel, tightly packed rows
+	static bool load(const std::string& path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& pixels);
+	static bool save(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& pixels);
+
+	// pixelThresholdFsNZƂ̐F臒li𒴂ƕsvjBAt@͔r܂
+	// pixelThreshold: a pixel whose delta exceeds it counts as mismatched; alpha is not compared
+	static ImageDifference compare(const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual,
+		uint32_t width, uint32_t height, double pixelThreshold = 0.1);
+};
@@ -0,0 +1,367 @@
+/*======================================================================
+Vulkan Presentation : GpuProfiler.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+	// CpXŏWv铝viʂ͂̃rbgɕт܂j
+	// the statistics collected around the main pass; results come back in this bit order
+	const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+	const uint32_t PIPELINE_STATISTICS_COUNT = 5;
+}
+
+//====================================================================================
+// 00X : EЕt
+// Initialization/Cleanup
+//====================================================================================
+
+void CGpuProfiler::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount,
+	bool pipelineStatistics, const VkAllocationCallbacks* allocator)
+{
+	m_Device = device;
+	m_Allocator = allocator;
+	m_Frames.resize(frameCount);
+
+	// pCvCvi^CX^vƂ͓Ɨj
+	// pipeline statistics, independent of timestamp support
+	m_StatisticsSupported = pipelineStatistics;
+	if (m_StatisticsSupported)
+	{
+		for (FrameQueries& frame : m_Frames)
+		{
+			VkQueryPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			poolInfo.queryCount = 1;
+			poolInfo.pipelineStatistics = PIPELINE_STATISTICS;
+
+			if (vkCreateQueryPool(m_Device, &poolInfo, m_Allocator, &frame.statisticsPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create pipeline statistics query pool!");
+			}
+		}
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	// timestampValidBits0̃L[ł̓^CX^v߂܂ivt@C[͉܂j
+	// a queue family with zero timestampValidBits cannot write timestamps; the profiler then does nothing
+	const uint32_t validBits = (queueFamilyIndex < queueFamilyCount) ? queueFamilies[queueFamilyIndex].timestampValidBits : 0;
+	m_Supported = (validBits > 0) && (properties.limits.timestampPeriod > 0.0f);
+	if (!m_Supported)
+	{
+		std::cerr << "GPU profiler disabled: the graphics queue does not support timestamps." << std::endl;
+		return;
+	}
+
+	m_TimestampPeriod = properties.limits.timestampPeriod;
+	m_TimestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+	for (FrameQueries& frame : m_Frames)
+	{
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = MAX_SCOPES_PER_FRAME * 2;
+
+		if (vkCreateQueryPool(m_Device, &poolInfo, m_Allocator, &frame.pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create timestamp query pool!");
+		}
+	}
+}
+
+void CGpuProfiler::destroy()
+{
+	for (FrameQueries& frame : m_Frames)
+	{
+		vkDestroyQueryPool(m_Device, frame.pool, m_Allocator);
+		vkDestroyQueryPool(m_Device, frame.statisticsPool, m_Allocator);
+	}
+	m_Frames.clear();
+	m_Supported = false;
+	m_StatisticsSupported = false;
+}
+
+//====================================================================================
+// 10X : v
+// Measurement
+//====================================================================================
+
+void CGpuProfiler::beginFrame(uint32_t frameIndex)
+{
+	m_QueriesReset = false;
+	if (!m_Supported && !m_StatisticsSupported)
+	{
+		return;
+	}
+
+	m_CurrentFrame = frameIndex;
+	FrameQueries& frame = m_Frames[frameIndex];
+	collectPipelineStatistics(frame);
+	if (frame.queryScopes.empty())
+	{
+		return;
+	}
+
+	// t[͊ς݂Ȃ̂ŁAWAITȂőSXR[v̌ʂĂ܂iNOT_READYȂ炱̃t[͎̂Ă܂j
+	// the frame has completed, so every result is available without WAIT; on VK_NOT_READY the frame is dropped
+	const uint32_t queryCount = static_cast<uint32_t>(frame.queryScopes.size() * 2);
+	std::vector<uint64_t> timestamps(queryCount);
+	const VkResult result = vkGetQueryPoolResults(m_Device, frame.pool, 0, queryCount,
+		timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	if (result == VK_SUCCESS)
+	{
+		for (size_t i = 0; i < frame.queryScopes.size(); i++)
+		{
+			const uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & m_TimestampMask;
+			const double milliseconds = ticks * m_TimestampPeriod / 1000000.0;
+
+			ScopeHistory& scope = m_Scopes[frame.queryScopes[i]];
+			if (scope.samples.size() < HISTORY_SIZE)
+			{
+				scope.samples.push_back(milliseconds);
+			}
+			else
+			{
+				scope.samples[scope.next] = milliseconds;
+				scope.next = (scope.next + 1) % HISTORY_SIZE;
+			}
+		}
+	}
+	frame.queryScopes.clear();
+}
+
+void CGpuProfiler::resetQueries(VkCommandBuffer commandBuffer)
+{
+	if (!m_Supported && !m_StatisticsSupported)
+	{
+		return;
+	}
+
+	FrameQueries& frame = m_Frames[m_CurrentFrame];
+	frame.queryScopes.clear();
+	frame.statisticsRecorded = false;
+	if (m_Supported)
+	{
+		vkCmdResetQueryPool(commandBuffer, frame.pool, 0, MAX_SCOPES_PER_FRAME * 2);
+	}
+	if (m_StatisticsSupported)
+	{
+		vkCmdResetQueryPool(commandBuffer, frame.statisticsPool, 0, 1);
+	}
+	m_QueriesReset = true;
+}
+
+uint32_t CGpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name, VkPipelineStageFlagBits stage)
+{
+	// ZbgĂȂNGɂ͏߂܂iF`惋[vÕR}hobt@[j
+	// queries that were not reset cannot be written, e.g. from command buffers outside the frame loop
+	FrameQueries* frame = (m_Supported && m_QueriesReset) ? &m_Frames[m_CurrentFrame] : nullptr;
+	if (frame == nullptr || frame->queryScopes.size() >= MAX_SCOPES_PER_FRAME)
+	{
+		return UINT32_MAX;
+	}
+
+	const uint32_t query = static_cast<uint32_t>(frame->queryScopes.size() * 2);
+	frame->queryScopes.push_back(getScopeIndex(name));
+	vkCmdWriteTimestamp(commandBuffer, stage, frame->pool, query);
+	return query;
+}
+
+void CGpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t query, VkPipelineStageFlagBits stage)
+{
+	if (query == UINT32_MAX)
+	{
+		return;
+	}
+	vkCmdWriteTimestamp(commandBuffer, stage, m_Frames[m_CurrentFrame].pool, query + 1);
+}
+
+void CGpuProfiler::beginPipelineStatistics(VkCommandBuffer commandBuffer)
+{
+	// ZbgĂȂNG͊Jnł܂
+	// a query that was not reset cannot be begun
+	if (!m_StatisticsSupported || !m_QueriesReset || m_StatisticsActive)
+	{
+		return;
+	}
+	FrameQueries& frame = m_Frames[m_CurrentFrame];
+	if (frame.statisticsRecorded)    // 1t[1
+	{
+		return;
+	}
+	vkCmdBeginQuery(commandBuffer, frame.statisticsPool, 0, 0);
+	m_StatisticsActive = true;
+}
+
+void CGpuProfiler::endPipelineStatistics(VkCommandBuffer commandBuffer)
+{
+	if (!m_StatisticsActive)
+	{
+		return;
+	}
+	FrameQueries& frame = m_Frames[m_CurrentFrame];
+	vkCmdEndQuery(commandBuffer, frame.statisticsPool, 0);
+	frame.statisticsRecorded = true;
+	m_StatisticsActive = false;
+}
+
+// t[͊ς݂Ȃ̂ŁAWAITȂŌʂĂ܂iNOT_READYȂ炱̃t[͎̂Ă܂j
+// the frame has completed, so the result is available without WAIT; on VK_NOT_READY the frame is dropped
+void CGpuProfiler::collectPipelineStatistics(FrameQueries& frame)
+{
+	if (!frame.statisticsRecorded)
+	{
+		return;
+	}
+	frame.statisticsRecorded = false;
+
+	uint64_t values[PIPELINE_STATISTICS_COUNT] = {};
+	const VkResult result = vkGetQueryPoolResults(m_Device, frame.statisticsPool, 0, 1,
+		sizeof(values), values, sizeof(values), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+	{
+		return;
+	}
+
+	m_LastStatistics.inputAssemblyVertices = values[0];
+	m_LastStatistics.inputAssemblyPrimitives = values[1];
+	m_LastStatistics.vertexShaderInvocations = values[2];
+	m_LastStatistics.clippingPrimitives = values[3];
+	m_LastStatistics.fragmentShaderInvocations = values[4];
+
+	if (m_StatisticsHistory.size() < HISTORY_SIZE)
+	{
+		m_StatisticsHistory.push_back(m_LastStatistics);
+	}
+	else
+	{
+		m_StatisticsHistory[m_StatisticsNext] = m_LastStatistics;
+		m_StatisticsNext = (m_StatisticsNext + 1) % HISTORY_SIZE;
+	}
+}
+
+uint32_t CGpuProfiler::getScopeIndex(const char* name)
+{
+	const auto found = m_ScopeIndices.find(name);
+	if (found != m_ScopeIndices.end())
+	{
+		return found->second;
+	}
+
+	const uint32_t index = static_cast<uint32_t>(m_Scopes.size());
+	m_Scopes.push_back({ name, {}, 0 });
+	m_ScopeIndices.emplace(name, index);
+	return index;
+}
+
+//====================================================================================
+// 20X : WvEo
+// Statistics/Reporting
+//====================================================================================
+
+std::vector<GpuScopeStats> CGpuProfiler::getStats() const
+{
+	std::vector<GpuScopeStats> stats;
+	for (const ScopeHistory& scope : m_Scopes)
+	{
+		GpuScopeStats scopeStats;
+		scopeStats.name = scope.name;
+		scopeStats.sampleCount = static_cast<uint32_t>(scope.samples.size());
+		if (!scope.samples.empty())
+		{
+			std::vector<double> sorted = scope.samples;
+			std::sort(sorted.begin(), sorted.end());
+
+			double sum = 0.0;
+			for (double sample : sorted)
+			{
+				sum += sample;
+			}
+
+			// p99F99%̃Tv̒lȉiŋߖTʖ@j
+			// p99 by nearest rank: 99% of samples are at or below it
+			const size_t p99Index = (sorted.size() * 99 + 99) / 100 - 1;
+			scopeStats.minMs = sorted.front();
+			scopeStats.avgMs = sum / sorted.size();
+			scopeStats.p99Ms = sorted[std::min(p99Index, sorted.size() - 1)];
+		}
+		stats.push_back(scopeStats);
+	}
+	return stats;
+}
+
+PipelineStatistics CGpuProfiler::getAveragePipelineStatistics() const
+{
+	PipelineStatistics average;
+	if (m_StatisticsHistory.empty())
+	{
+		return average;
+	}
+
+	for (const PipelineStatistics& frame : m_StatisticsHistory)
+	{
+		average.inputAssemblyVertices += frame.inputAssemblyVertices;
+		average.inputAssemblyPrimitives += frame.inputAssemblyPrimitives;
+		average.vertexShaderInvocations += frame.vertexShaderInvocations;
+		average.clippingPrimitives += frame.clippingPrimitives;
+		average.fragmentShaderInvocations += frame.fragmentShaderInvocations;
+	}
+
+	const uint64_t frameCount = m_StatisticsHistory.size();
+	average.inputAssemblyVertices /= frameCount;
+	average.inputAssemblyPrimitives /= frameCount;
+	average.vertexShaderInvocations /= frameCount;
+	average.clippingPrimitives /= frameCount;
+	average.fragmentShaderInvocations /= frameCount;
+	return average;
+}
+
+void CGpuProfiler::report(std::ostream& out) const
+{
+	if (!m_StatisticsHistory.empty())
+	{
+		const PipelineStatistics average = getAveragePipelineStatistics();
+		out << "Pipeline statistics (main pass, average of last " << m_StatisticsHistory.size() << " frames):" << std::endl
+			<< "  IA vertices      " << average.inputAssemblyVertices << std::endl
+			<< "  IA primitives    " << average.inputAssemblyPrimitives << std::endl
+			<< "  VS invocations   " << average.vertexShaderInvocations << std::endl
+			<< "  clip primitives  " << average.clippingPrimitives << std::endl
+			<< "  FS invocations   " << average.fragmentShaderInvocations << std::endl;
+	}
+
+	if (!m_Supported)
+	{
+		return;
+	}
+
+	out << "GPU timings (last " << HISTORY_SIZE << " frames, ms):" << std::endl;
+	for (const GpuScopeStats& stats : getStats())
+	{
+		out << "  " << std::left << std::setw(14) << stats.name << std::right << std::fixed << std::setprecision(3)
+			<< " min " << stats.minMs << "  avg " << stats.avgMs << "  p99 " << stats.p99Ms
+			<< "  (" << stats.sampleCount << " samples)" << std::endl;
+	}
+	out << std::defaultfloat;
+}
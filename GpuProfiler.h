@@ -0,0 +1,150 @@
+/*======================================================================
+Vulkan Presentation : GpuProfiler.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <ostream>
+#include <cstdint>
+
+// XR[vƂ̏Wvi߂̃TvA~bj
+// Rolling statistics of one scope over its most recent samples, in milliseconds
+struct GpuScopeStats
+{
+	std::string name;
+	double      minMs = 0.0;
+	double      avgMs = 0.0;
+	double      p99Ms = 0.0;
+	uint32_t    sampleCount = 0;
+};
+
+// CpX̃pCvCvi1t[j
+// Pipeline statistics of the main pass for one frame
+struct PipelineStatistics
+{
+	uint64_t inputAssemblyVertices = 0;
+	uint64_t inputAssemblyPrimitives = 0;
+	uint64_t vertexShaderInvocations = 0;
+	uint64_t clippingPrimitives = 0;          // NbsOɎcv~eBuiJǑʁj
+	uint64_t fragmentShaderInvocations = 0;   // TvVF[fBOiminSampleShadingǰ
+};
+
+// GPUvt@C[Ft[Ƃ̃^CX^vNGv[ŁAOtXR[v̊JnEIv܂
+// GPU profiler: named scopes timed with begin/end timestamps from one query pool per frame in flight
+//   ʂ̓t[̊^CCŊmFĂǂݍނ̂ŁAҋ@͂܂
+//   results are read once the frame timeline shows the frame has completed, so reading never stalls
+//   pipelineStatisticsQueryɑΉĂ΁ACpX̃pCvCv悤ɏWv܂
+//   with pipelineStatisticsQuery enabled, the main pass's pipeline statistics are collected the same way
+class CGpuProfiler
+{
+public:
+
+	// queueFamilyIndexF^CX^vރL[̃t@~[itimestampValidBits̊mFj
+	// queueFamilyIndex: family of the queue the timestamps are written on, for its timestampValidBits
+	// pipelineStatisticsFfoCXpipelineStatisticsQueryLɂꍇ̂true
+	// pipelineStatistics: only true when the device was created with pipelineStatisticsQuery enabled
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount,
+		bool pipelineStatistics = false, const VkAllocationCallbacks* allocator = nullptr);
+	void destroy();
+	bool isSupported() const { return m_Supported; }
+	bool isPipelineStatisticsSupported() const { return m_StatisticsSupported; }
+
+	// ̃t[g̑ǑʂWv܂iGPUŊς݂̏ꍇ̂݁j
+	// collect this frame slot's previous results; only once the GPU has finished that frame
+	void beginFrame(uint32_t frameIndex);
+
+	// R}hobt@[̐擪i_[pX̊OjŁF̃t[̃NGZbg
+	// at the start of the command buffer, outside a render pass: reset this frame's queries
+	void resetQueries(VkCommandBuffer commandBuffer);
+
+	// XR[v̊JnEIiʏCGpuScopeg܂jBNGȂEΉ̏ꍇUINT32_MAXi܂j
+	// begin/end a scope, normally through CGpuScope; UINT32_MAX (a no-op scope) if unsupported or out of queries
+	uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	void endScope(VkCommandBuffer commandBuffer, uint32_t query, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+	// pCvCv̊JnEIi_[pX̊OŁA1t[1j
+	// begin/end the pipeline statistics query; outside the render pass, once per frame
+	void beginPipelineStatistics(VkCommandBuffer commandBuffer);
+	void endPipelineStatistics(VkCommandBuffer commandBuffer);
+
+	std::vector<GpuScopeStats> getStats() const;    // ŏɌv
+	const PipelineStatistics& getLastPipelineStatistics() const { return m_LastStatistics; }    // ŌɏWvt[
+	PipelineStatistics getAveragePipelineStatistics() const;                                     // ߂̃t[̕
+	void report(std::ostream& out) const;
+
+private:
+
+	static const uint32_t MAX_SCOPES_PER_FRAME = 32;     // NG͂2{
+	static const size_t   HISTORY_SIZE = 256;            // XR[vƂ̃Tv
+
+	// t[gƂ̃NGFqueryScopes[i]̓NG2iiJnjE2i + 1iIj̃XR[v
+	// per frame slot; queryScopes[i] is the scope of queries 2i (begin) and 2i + 1 (end)
+	struct FrameQueries
+	{
+		VkQueryPool           pool = VK_NULL_HANDLE;
+		std::vector<uint32_t> queryScopes;
+		VkQueryPool           statisticsPool = VK_NULL_HANDLE;    // pCvCviNG1j
+		bool                  statisticsRecorded = false;
+	};
+
+	// XR[v̒߂̃TviOobt@[j
+	// a scope's most recent samples, as a ring buffer
+	struct ScopeHistory
+	{
+		std::string         name;
+		std::vector<double> samples;
+		size_t              next = 0;
+	};
+
+	uint32_t getScopeIndex(const char* name);
+	void collectPipelineStatistics(FrameQueries& frame);
+
+	VkDevice                                  m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks*              m_Allocator = nullptr;
+	bool                                      m_Supported = false;
+	double                                    m_TimestampPeriod = 1.0;    // 1eBbÑimb
+	uint64_t                                  m_TimestampMask = ~0ull;    // timestampValidBits̃}XN
+	std::vector<FrameQueries>                 m_Frames;
+	uint32_t                                  m_CurrentFrame = 0;
+	bool                                      m_QueriesReset = false;     // resetQueries()Ãt[̃XR[vL^ł܂
+	std::vector<ScopeHistory>                 m_Scopes;
+	std::unordered_map<std::string, uint32_t> m_ScopeIndices;
+
+	bool                                      m_StatisticsSupported = false;
+	bool                                      m_StatisticsActive = false;    // beginPipelineStatistics()
+	PipelineStatistics                        m_LastStatistics;
+	std::vector<PipelineStatistics>           m_StatisticsHistory;           // ߂̃t[iOobt@[j
+	size_t                                    m_StatisticsNext = 0;
+};
+
+// RAIĨXR[vFRXgN^[ŊJnAfXgN^[ŏĨ^CX^v݂܂
+// RAII scope: writes the begin timestamp on construction and the end timestamp on destruction
+class CGpuScope
+{
+public:
+
+	CGpuScope(CGpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+		: m_Profiler(profiler), m_CommandBuffer(commandBuffer), m_Query(profiler.beginScope(commandBuffer, name))
+	{
+	}
+
+	~CGpuScope()
+	{
+		m_Profiler.endScope(m_CommandBuffer, m_Query);
+	}
+
+	CGpuScope(const CGpuScope&) = delete;
+	CGpuScope& operator=(const CGpuScope&) = delete;
+
+private:
+
+	CGpuProfiler&   m_Profiler;
+	VkCommandBuffer m_CommandBuffer;
+	uint32_t        m_Query;
+};
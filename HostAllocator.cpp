@@ -0,0 +1,307 @@
+/*======================================================================
+Vulkan Presentation : HostAllocator.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+namespace
+{
+	// mۂubN̎Oɒuwb_[i[U[|C^[̒O16oCgj
+	// header stored in the 16 bytes right in front of the pointer handed to the driver
+	struct BlockHeader
+	{
+		size_t   size;         // vTCY
+		uint32_t offset;       // malloc()̐擪烆[U[|C^[܂
+		uint8_t  scope;
+		uint8_t  sizeClass;    // NO_SIZE_CLASSFv[ł͂Ȃmalloc()
+	};
+
+	const size_t  HEADER_SPACE = 16;
+	const size_t  MIN_ALIGNMENT = 16;    // wb_[ƃv[̃ubN̔zu
+	const uint8_t NO_SIZE_CLASS = 0xFF;
+
+	static_assert(sizeof(BlockHeader) <= HEADER_SPACE, "BlockHeader must fit in front of the allocation");
+
+	BlockHeader* getHeader(void* memory)
+	{
+		return reinterpret_cast<BlockHeader*>(static_cast<char*>(memory) - HEADER_SPACE);
+	}
+
+	uint32_t getScopeIndex(VkSystemAllocationScope scope)
+	{
+		return std::min(static_cast<uint32_t>(scope), static_cast<uint32_t>(VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE));
+	}
+
+	const char* getScopeName(uint32_t scope)
+	{
+		const char* names[] = { "command", "object", "cache", "device", "instance" };
+		return names[scope];
+	}
+}
+
+//====================================================================================
+// 00X : EЕt
+// Initialization/Cleanup
+//====================================================================================
+
+CHostAllocator::CHostAllocator()
+{
+	m_Callbacks.pUserData = this;
+	m_Callbacks.pfnAllocation = allocate;
+	m_Callbacks.pfnReallocation = reallocate;
+	m_Callbacks.pfnFree = free;
+	m_Callbacks.pfnInternalAllocation = internalAllocate;
+	m_Callbacks.pfnInternalFree = internalFree;
+}
+
+CHostAllocator::~CHostAllocator()
+{
+	for (SizeClass& sizeClass : m_SizeClasses)
+	{
+		for (void* chunk : sizeClass.chunks)
+		{
+			std::free(chunk);
+		}
+	}
+}
+
+//====================================================================================
+// 10X : R[obN
+// Callbacks
+//====================================================================================
+
+VKAPI_ATTR void* VKAPI_CALL CHostAllocator::allocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	CHostAllocator* allocator = static_cast<CHostAllocator*>(userData);
+	allocator->m_Scopes[getScopeIndex(scope)].allocations.fetch_add(1, std::memory_order_relaxed);
+	return allocator->allocateBlock(size, alignment, scope);
+}
+
+// VubNɈڂĂÂubN܂ioriginalFnullptrȂmۂ̂݁AsizeF0Ȃ̂݁j
+// move to a new block, then free the old one; a null original only allocates, a zero size only frees
+VKAPI_ATTR void* VKAPI_CALL CHostAllocator::reallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	CHostAllocator* allocator = static_cast<CHostAllocator*>(userData);
+	allocator->m_Scopes[getScopeIndex(scope)].reallocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (size == 0)
+	{
+		allocator->freeBlock(original);
+		return nullptr;
+	}
+
+	void* memory = allocator->allocateBlock(size, alignment, scope);
+	if (memory != nullptr && original != nullptr)
+	{
+		std::memcpy(memory, original, std::min(size, getHeader(original)->size));
+		allocator->freeBlock(original);
+	}
+	return memory;    // sꍇAoriginal͂̂܂܁idlǂj
+}
+
+VKAPI_ATTR void VKAPI_CALL CHostAllocator::free(void* userData, void* memory)
+{
+	if (memory == nullptr)
+	{
+		return;
+	}
+
+	CHostAllocator* allocator = static_cast<CHostAllocator*>(userData);
+	allocator->m_Scopes[getHeader(memory)->scope].frees.fetch_add(1, std::memory_order_relaxed);
+	allocator->freeBlock(memory);
+}
+
+// hCo[g̊mہiOS璼ڂȂǁj̒ʒmFoCĝ݋L^܂
+// notification of memory the driver allocated by itself, e.g. straight from the OS; only the bytes are recorded
+VKAPI_ATTR void VKAPI_CALL CHostAllocator::internalAllocate(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	CHostAllocator* allocator = static_cast<CHostAllocator*>(userData);
+	allocator->m_Scopes[getScopeIndex(scope)].internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL CHostAllocator::internalFree(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	CHostAllocator* allocator = static_cast<CHostAllocator*>(userData);
+	allocator->m_Scopes[getScopeIndex(scope)].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+//====================================================================================
+// 20X : ubN̊mہE
+// Block Allocation
+//====================================================================================
+
+void* CHostAllocator::allocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	alignment = std::max(alignment, MIN_ALIGNMENT);
+
+	// v[Fwb_[݂Ŏ܂ŏ̃NXi傫ȊmہEȔzumalloc()j
+	// pool: the smallest class that holds the block with its header; large or over-aligned requests use malloc()
+	uint8_t sizeClass = NO_SIZE_CLASS;
+	if (m_PoolEnabled && alignment == MIN_ALIGNMENT)
+	{
+		for (uint32_t i = 0; i < SIZE_CLASS_COUNT; i++)
+		{
+			if (size + HEADER_SPACE <= (size_t(1) << (MIN_BLOCK_SHIFT + i)))
+			{
+				sizeClass = static_cast<uint8_t>(i);
+				break;
+			}
+		}
+	}
+
+	char* memory = nullptr;
+	uint32_t offset = static_cast<uint32_t>(HEADER_SPACE);
+	if (sizeClass != NO_SIZE_CLASS)
+	{
+		char* block = static_cast<char*>(popPoolBlock(sizeClass));
+		if (block == nullptr)
+		{
+			return nullptr;
+		}
+		memory = block + HEADER_SPACE;
+	}
+	else
+	{
+		char* raw = static_cast<char*>(std::malloc(size + HEADER_SPACE + alignment));
+		if (raw == nullptr)
+		{
+			return nullptr;
+		}
+		const uintptr_t address = (reinterpret_cast<uintptr_t>(raw) + HEADER_SPACE + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+		memory = reinterpret_cast<char*>(address);
+		offset = static_cast<uint32_t>(memory - raw);
+	}
+
+	const uint32_t scopeIndex = getScopeIndex(scope);
+	BlockHeader* header = getHeader(memory);
+	header->size = size;
+	header->offset = offset;
+	header->scope = static_cast<uint8_t>(scopeIndex);
+	header->sizeClass = sizeClass;
+
+	ScopeCounters& counters = m_Scopes[scopeIndex];
+	counters.blocks.fetch_add(1, std::memory_order_relaxed);
+	const uint64_t currentBytes = counters.currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	uint64_t peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+	while (currentBytes > peakBytes && !counters.peakBytes.compare_exchange_weak(peakBytes, currentBytes, std::memory_order_relaxed))
+	{
+	}
+	return memory;
+}
+
+void CHostAllocator::freeBlock(void* memory)
+{
+	if (memory == nullptr)
+	{
+		return;
+	}
+
+	const BlockHeader header = *getHeader(memory);
+	m_Scopes[header.scope].currentBytes.fetch_sub(header.size, std::memory_order_relaxed);
+	m_Scopes[header.scope].releases.fetch_add(1, std::memory_order_relaxed);
+
+	char* block = static_cast<char*>(memory) - header.offset;
+	if (header.sizeClass == NO_SIZE_CLASS)
+	{
+		std::free(block);
+		return;
+	}
+
+	SizeClass& sizeClass = m_SizeClasses[header.sizeClass];
+	std::lock_guard<std::mutex> lock(sizeClass.mutex);
+	*reinterpret_cast<void**>(block) = sizeClass.freeList;
+	sizeClass.freeList = block;
+}
+
+// t[XgȂV`N𓯂TCỸubNɕĒǉ܂
+// when the free list is empty, carve a new chunk into blocks of this class
+void* CHostAllocator::popPoolBlock(uint32_t sizeClassIndex)
+{
+	SizeClass& sizeClass = m_SizeClasses[sizeClassIndex];
+	const size_t blockSize = size_t(1) << (MIN_BLOCK_SHIFT + sizeClassIndex);
+
+	std::lock_guard<std::mutex> lock(sizeClass.mutex);
+	if (sizeClass.freeList == nullptr)
+	{
+		char* chunk = static_cast<char*>(std::malloc(CHUNK_SIZE + MIN_ALIGNMENT));
+		if (chunk == nullptr)
+		{
+			return nullptr;
+		}
+		sizeClass.chunks.push_back(chunk);
+
+		// malloc()̔zu16oCgƂ͌Ȃ̂ŁA擪𑵂܂
+		// malloc() does not promise 16-byte alignment everywhere, so align the first block
+		char* first = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(chunk) + MIN_ALIGNMENT - 1) & ~(static_cast<uintptr_t>(MIN_ALIGNMENT) - 1));
+		for (size_t i = CHUNK_SIZE / blockSize; i-- > 0; )
+		{
+			char* block = first + i * blockSize;
+			*reinterpret_cast<void**>(block) = sizeClass.freeList;
+			sizeClass.freeList = block;
+		}
+	}
+
+	void* block = sizeClass.freeList;
+	sizeClass.freeList = *reinterpret_cast<void**>(block);
+	return block;
+}
+
+//====================================================================================
+// 30X : WvEo
+// Statistics/Reporting
+//====================================================================================
+
+HostAllocationStats CHostAllocator::getStats(VkSystemAllocationScope scope) const
+{
+	const ScopeCounters& counters = m_Scopes[getScopeIndex(scope)];
+
+	HostAllocationStats stats;
+	stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+	stats.reallocations = counters.reallocations.load(std::memory_order_relaxed);
+	stats.frees = counters.frees.load(std::memory_order_relaxed);
+	stats.liveAllocations = counters.blocks.load(std::memory_order_relaxed) - counters.releases.load(std::memory_order_relaxed);
+	stats.currentBytes = counters.currentBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+	stats.internalBytes = counters.internalBytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+bool CHostAllocator::checkLeaks(std::ostream& out) const
+{
+	bool leaked = false;
+	for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++)
+	{
+		const HostAllocationStats stats = getStats(static_cast<VkSystemAllocationScope>(scope));
+		if (stats.liveAllocations > 0)
+		{
+			out << "Host allocator: " << stats.liveAllocations << " " << getScopeName(scope) << "-scope allocations ("
+				<< stats.currentBytes << " bytes) still live after cleanup" << std::endl;
+			leaked = true;
+		}
+	}
+	return leaked == false;
+}
+
+void CHostAllocator::report(std::ostream& out) const
+{
+	out << "Host allocations (VkAllocationCallbacks" << (m_PoolEnabled ? ", size-class pool" : "") << "):" << std::endl
+		<< "  " << std::left << std::setw(10) << "scope" << std::right
+		<< std::setw(10) << "allocs" << std::setw(10) << "reallocs" << std::setw(10) << "frees" << std::setw(8) << "live"
+		<< std::setw(12) << "current KB" << std::setw(10) << "peak KB" << std::setw(13) << "internal KB" << std::endl
+		<< std::fixed << std::setprecision(1);
+	for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++)
+	{
+		const HostAllocationStats stats = getStats(static_cast<VkSystemAllocationScope>(scope));
+		out << "  " << std::left << std::setw(10) << getScopeName(scope) << std::right
+			<< std::setw(10) << stats.allocations << std::setw(10) << stats.reallocations << std::setw(10) << stats.frees
+			<< std::setw(8) << stats.liveAllocations << std::setw(12) << stats.currentBytes / 1024.0
+			<< std::setw(10) << stats.peakBytes / 1024.0 << std::setw(13) << stats.internalBytes / 1024.0 << std::endl;
+	}
+	out << std::defaultfloat;
+}
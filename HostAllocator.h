@@ -0,0 +1,105 @@
+/*======================================================================
+Vulkan Presentation : HostAllocator.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+// zXg[̊mۏ󋵁iVkSystemAllocationScopeƁj
+// Host allocation statistics of one VkSystemAllocationScope
+struct HostAllocationStats
+{
+	uint64_t allocations = 0;       // pfnAllocation̉
+	uint64_t reallocations = 0;
+	uint64_t frees = 0;
+	uint64_t liveAllocations = 0;   // ̐
+	uint64_t currentBytes = 0;
+	uint64_t peakBytes = 0;
+	uint64_t internalBytes = 0;     // hCo[Ŋmۂ[iʒm̂݁j
+};
+
+// zXgAP[^[FVkAllocationCallbacksŃhCo[E[_[̃zXg[mۂ𐔂܂
+// Host allocator: VkAllocationCallbacks that count the driver's and loader's host allocations
+//   XR[vƂ̉񐔁EoCgi݁Es[NjL^AcheckLeaks()Ŗ̃[񍐂܂
+//   calls and bytes (current and peak) are tracked per scope, and checkLeaks() reports anything left allocated
+//   TCYNX̃v[iCӁjFȊmۂ2̗ݏ̃ubNɊۂ߂āAt[Xgōėp܂
+//   optional size-class pool: small allocations are rounded up to power-of-two blocks recycled through free lists
+//   ǂ̃XbhłĂяo܂ihCo[̓pCvC̃[J[Xbhmۂ܂j
+//   safe from any thread; the driver also allocates from the pipeline worker threads
+class CHostAllocator
+{
+public:
+
+	CHostAllocator();
+	~CHostAllocator();
+
+	CHostAllocator(const CHostAllocator&) = delete;
+	CHostAllocator& operator=(const CHostAllocator&) = delete;
+
+	// v[̗LEiŏ̊mۂ̑Oɐݒ肵܂j
+	// enable the size-class pool; set before the first allocation
+	void setPoolEnabled(bool enable) { m_PoolEnabled = enable; }
+
+	// SĂvkCreate*EvkDestroy*EvkAllocateMemoryɓnR[obNi쐬ƍ폜œ̂nƁj
+	// the callbacks to pass to every vkCreate*, vkDestroy*, vkAllocateMemory etc.; creation and destruction must match
+	const VkAllocationCallbacks* getCallbacks() const { return &m_Callbacks; }
+
+	HostAllocationStats getStats(VkSystemAllocationScope scope) const;
+
+	// ̊mۂΏo͂falseivkDestroyInstance()̌ɌĂяo܂j
+	// print and return false if anything is still allocated; call after vkDestroyInstance()
+	bool checkLeaks(std::ostream& out) const;
+	void report(std::ostream& out) const;
+
+private:
+
+	static const uint32_t SCOPE_COUNT = 5;             // VK_SYSTEM_ALLOCATION_SCOPE_COMMAND`INSTANCE
+	static const uint32_t SIZE_CLASS_COUNT = 8;        // 32`4096oCg
+	static const uint32_t MIN_BLOCK_SHIFT = 5;         // ŏubNF32oCg
+	static const size_t   CHUNK_SIZE = 64 * 1024;      // v[܂Ƃ߂ĊmۂP
+
+	struct ScopeCounters
+	{
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> reallocations{ 0 };
+		std::atomic<uint64_t> frees{ 0 };
+		std::atomic<uint64_t> blocks{ 0 };          // mۂubNiĊmۂ܂ށj
+		std::atomic<uint64_t> releases{ 0 };        // ubNiĊmۂ܂ށj
+		std::atomic<uint64_t> currentBytes{ 0 };
+		std::atomic<uint64_t> peakBytes{ 0 };
+		std::atomic<uint64_t> internalBytes{ 0 };
+	};
+
+	// TCYNXƂ̃t[XgiꂽubN̐擪Ɏ̃ubN݂܂j
+	// one free list per size class; a free block stores the next free block in its first bytes
+	struct SizeClass
+	{
+		std::mutex         mutex;
+		void*              freeList = nullptr;
+		std::vector<void*> chunks;
+	};
+
+	static VKAPI_ATTR void* VKAPI_CALL allocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void* VKAPI_CALL reallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL free(void* userData, void* memory);
+	static VKAPI_ATTR void VKAPI_CALL internalAllocate(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL internalFree(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+	void* allocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void freeBlock(void* memory);
+	void* popPoolBlock(uint32_t sizeClass);
+
+	VkAllocationCallbacks                     m_Callbacks;
+	bool                                      m_PoolEnabled = false;
+	std::array<ScopeCounters, SCOPE_COUNT>    m_Scopes;
+	std::array<SizeClass, SIZE_CLASS_COUNT>   m_SizeClasses;
+};
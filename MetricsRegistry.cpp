@@ -0,0 +1,392 @@
+/*======================================================================
+Vulkan Presentation : MetricsRegistry.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "MetricsRegistry.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <filesystem>    // std::filesystem::rename : o̒u
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Unix\Pbg̐ڑmFԊu
+	// how often the exporter thread checks the Unix socket for connections
+	const std::chrono::milliseconds SOCKET_POLL_INTERVAL(100);
+
+	// o͂镪ʐiPrometheussummaryj
+	const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+
+	uint32_t highestBit(uint64_t value)
+	{
+		uint32_t bit = 0;
+		while (value >>= 1)
+		{
+			bit++;
+		}
+		return bit;
+	}
+
+	// name{labels}A܂̓xǉname{labels,extra}
+	// name{labels}, or with one more label appended
+	std::string series(const std::string& name, const std::string& labels, const std::string& extra = "")
+	{
+		if (labels.empty() && extra.empty())
+		{
+			return name;
+		}
+		return name + "{" + labels + ((labels.empty() || extra.empty()) ? "" : ",") + extra + "}";
+	}
+}
+
+//====================================================================================
+// 00X : qXgO
+// Histogram
+//====================================================================================
+
+// 32͂̂܂܁Aȏ͍ŏʃrbg5rbgi2̗ݏ悲Ƃ32j
+// values below 32 map to themselves; above that, the top five bits after the leading one pick the sub-bucket
+uint32_t CMetricHistogram::bucketIndex(uint64_t value)
+{
+	if (value < SUB_BUCKET_COUNT)
+	{
+		return static_cast<uint32_t>(value);
+	}
+
+	const uint32_t shift = highestBit(value) - SUB_BUCKET_BITS;
+	if (shift > MAX_SHIFT)
+	{
+		return BUCKET_COUNT - 1;
+	}
+	return (shift + 1) * SUB_BUCKET_COUNT + static_cast<uint32_t>((value >> shift) - SUB_BUCKET_COUNT);
+}
+
+uint64_t CMetricHistogram::bucketValue(uint32_t index)
+{
+	if (index < SUB_BUCKET_COUNT)
+	{
+		return index;
+	}
+
+	const uint32_t shift = index / SUB_BUCKET_COUNT - 1;
+	const uint64_t lower = static_cast<uint64_t>(SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT) << shift;
+	return lower + ((1ull << shift) >> 1);
+}
+
+void CMetricHistogram::record(uint64_t value)
+{
+	m_Buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	m_Sum.fetch_add(value, std::memory_order_relaxed);
+	m_Count.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t CMetricHistogram::getQuantile(double quantile) const
+{
+	// L^ƕsēǂނ̂ŁAv̓oPbg琔܂
+	// recording may run concurrently, so the total is recounted from the buckets themselves
+	std::array<uint64_t, BUCKET_COUNT> counts;
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < BUCKET_COUNT; i++)
+	{
+		counts[i] = m_Buckets[i].load(std::memory_order_relaxed);
+		total += counts[i];
+	}
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * total + 0.999999));    // ŋߖTʖ@
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < BUCKET_COUNT; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			return bucketValue(i);
+		}
+	}
+	return bucketValue(BUCKET_COUNT - 1);
+}
+
+//====================================================================================
+// 10X : o^Eo
+// Registration/Export
+//====================================================================================
+
+CMetricsRegistry::~CMetricsRegistry()
+{
+	stopExporter();
+}
+
+void CMetricsRegistry::addCounter(const std::string& name, const std::string& help, const CMetricCounter& counter, const std::string& labels)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Entry entry{ MetricType::Counter, name, help, labels };
+	entry.counter = &counter;
+	m_Entries.push_back(entry);
+}
+
+void CMetricsRegistry::addGauge(const std::string& name, const std::string& help, const CMetricGauge& gauge, const std::string& labels)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Entry entry{ MetricType::Gauge, name, help, labels };
+	entry.gauge = &gauge;
+	m_Entries.push_back(entry);
+}
+
+void CMetricsRegistry::addHistogram(const std::string& name, const std::string& help, const CMetricHistogram& histogram, double unitScale)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Entry entry{ MetricType::Histogram, name, help, "" };
+	entry.histogram = &histogram;
+	entry.unitScale = unitScale;
+	m_Entries.push_back(entry);
+}
+
+void CMetricsRegistry::addCollector(std::function<void()> collector)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Collectors.push_back(std::move(collector));
+}
+
+// Prometheus̃eLXg`i0.0.4jBqXgO͕ʐsummaryƂďo͂܂
+// Prometheus text format 0.0.4; histograms are exported as summaries with fixed quantiles
+void CMetricsRegistry::writePrometheus(std::ostream& out)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	for (const std::function<void()>& collector : m_Collectors)
+	{
+		collector();
+	}
+
+	out << std::setprecision(10);
+	const std::string* previousName = nullptr;
+	for (const Entry& entry : m_Entries)
+	{
+		if (previousName == nullptr || *previousName != entry.name)    // HELPETYPE͖OƂ1
+		{
+			const char* type = (entry.type == MetricType::Counter) ? "counter" : (entry.type == MetricType::Gauge) ? "gauge" : "summary";
+			out << "# HELP " << entry.name << " " << entry.help << "\n"
+				<< "# TYPE " << entry.name << " " << type << "\n";
+			previousName = &entry.name;
+		}
+
+		switch (entry.type)
+		{
+		case MetricType::Counter:
+			out << series(entry.name, entry.labels) << " " << entry.counter->get() << "\n";
+			break;
+
+		case MetricType::Gauge:
+			out << series(entry.name, entry.labels) << " " << entry.gauge->get() << "\n";
+			break;
+
+		case MetricType::Histogram:
+			for (double quantile : QUANTILES)
+			{
+				std::ostringstream label;
+				label << "quantile=\"" << quantile << "\"";
+				out << series(entry.name, entry.labels, label.str()) << " "
+					<< entry.histogram->getQuantile(quantile) * entry.unitScale << "\n";
+			}
+			out << series(entry.name + "_sum", entry.labels) << " " << entry.histogram->getSum() * entry.unitScale << "\n"
+				<< series(entry.name + "_count", entry.labels) << " " << entry.histogram->getCount() << "\n";
+			break;
+		}
+	}
+	out << std::defaultfloat;
+}
+
+//====================================================================================
+// 20X : oXbh
+// Exporter thread
+//====================================================================================
+
+bool CMetricsRegistry::startExporter(const std::string& target, double intervalSeconds)
+{
+	if (m_Thread.joinable() || target.empty())
+	{
+		return false;
+	}
+
+	if ((intervalSeconds > 0.0) == false)
+	{
+		std::cerr << "Invalid metrics interval: " << intervalSeconds << " s" << std::endl;
+		return false;
+	}
+
+	m_IntervalSeconds = intervalSeconds;
+	m_FilePath.clear();
+	m_SocketPath.clear();
+
+	const std::string socketPrefix = "unix:";
+	if (target.compare(0, socketPrefix.size(), socketPrefix) == 0)
+	{
+#if defined(_WIN32)
+		std::cerr << "Metrics export to a Unix socket is not supported on this platform." << std::endl;
+		return false;
+#else
+		m_SocketPath = target.substr(socketPrefix.size());
+
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (m_SocketPath.empty() || m_SocketPath.size() >= sizeof(address.sun_path))
+		{
+			std::cerr << "Invalid metrics socket path: " << m_SocketPath << std::endl;
+			return false;
+		}
+		std::strcpy(address.sun_path, m_SocketPath.c_str());
+
+		const int listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink(m_SocketPath.c_str());    // O̎sŎc\Pbg
+		if (listenSocket < 0
+			|| bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+			|| listen(listenSocket, 4) != 0
+			|| fcntl(listenSocket, F_SETFL, fcntl(listenSocket, F_GETFL) | O_NONBLOCK) != 0)
+		{
+			std::cerr << "Failed to listen on metrics socket " << m_SocketPath << ": " << std::strerror(errno) << std::endl;
+			if (listenSocket >= 0)
+			{
+				close(listenSocket);
+			}
+			return false;
+		}
+		m_Socket = listenSocket;
+#endif
+	}
+	else
+	{
+		m_FilePath = target;
+	}
+
+	m_Stopping = false;
+	m_Thread = std::thread(&CMetricsRegistry::exporterLoop, this);
+	return true;
+}
+
+void CMetricsRegistry::stopExporter()
+{
+	if (m_Thread.joinable() == false)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_StopMutex);
+		m_Stopping = true;
+	}
+	m_StopCondition.notify_all();
+	m_Thread.join();
+
+#if !defined(_WIN32)
+	if (m_Socket >= 0)
+	{
+		close(static_cast<int>(m_Socket));
+		unlink(m_SocketPath.c_str());
+		m_Socket = -1;
+	}
+#endif
+}
+
+void CMetricsRegistry::exporterLoop()
+{
+	const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_IntervalSeconds));
+	const auto wait = (m_Socket >= 0) ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(SOCKET_POLL_INTERVAL) : interval;
+	auto nextWrite = std::chrono::steady_clock::now();
+
+	for (;;)
+	{
+		if (m_FilePath.empty() == false && std::chrono::steady_clock::now() >= nextWrite)
+		{
+			writeFile();
+			nextWrite += interval;
+		}
+		if (m_Socket >= 0)
+		{
+			serveSocket();
+		}
+
+		std::unique_lock<std::mutex> lock(m_StopMutex);
+		if (m_StopCondition.wait_for(lock, wait, [this]() { return m_Stopping; }))
+		{
+			break;
+		}
+	}
+
+	if (m_FilePath.empty() == false)    // I̍ŏIl
+	{
+		writeFile();
+	}
+}
+
+// ꎞt@CɏĂûŁAǂݍݑ̃t@C邱Ƃ͂܂
+// written to a temporary file and renamed over the target, so a scraper never sees a partial file
+void CMetricsRegistry::writeFile()
+{
+	const std::string tempPath = m_FilePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::trunc);
+		writePrometheus(file);
+		if (file.good() == false)
+		{
+			std::cerr << "Failed to write " << tempPath << "!" << std::endl;
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, m_FilePath, error);
+	if (error)
+	{
+		std::cerr << "Failed to replace " << m_FilePath << ": " << error.message() << std::endl;
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+// ҂ĂڑƂɌ݂̒lŕ܂iFsocat - UNIX-CONNECT:pXj
+// answer every pending connection with the current values and close it, e.g. socat - UNIX-CONNECT:PATH
+void CMetricsRegistry::serveSocket()
+{
+#if !defined(_WIN32)
+	for (;;)
+	{
+		const int connection = accept(static_cast<int>(m_Socket), nullptr, nullptr);
+		if (connection < 0)
+		{
+			return;    // EAGAINF҂ĂڑȂ
+		}
+
+		std::ostringstream text;
+		writePrometheus(text);
+		const std::string body = text.str();
+
+		size_t written = 0;
+		while (written < body.size())
+		{
+			const ssize_t result = send(connection, body.data() + written, body.size() - written, MSG_NOSIGNAL);
+			if (result <= 0)
+			{
+				break;
+			}
+			written += static_cast<size_t>(result);
+		}
+		close(connection);
+	}
+#endif
+}
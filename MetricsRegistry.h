@@ -0,0 +1,141 @@
+/*======================================================================
+Vulkan Presentation : MetricsRegistry.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include <cstdint>
+
+// JE^[F邾̍viǂ̃XbhłAbNȂj
+// Counter: a monotonically increasing total, lock-free from any thread
+class CMetricCounter
+{
+public:
+
+	void add(uint64_t value = 1) { m_Value.fetch_add(value, std::memory_order_relaxed); }
+	void set(uint64_t total) { m_Value.store(total, std::memory_order_relaxed); }    // ŐĂ鍇vʂꍇ
+	uint64_t get() const { return m_Value.load(std::memory_order_relaxed); }
+
+private:
+
+	std::atomic<uint64_t> m_Value{ 0 };
+};
+
+// Q[WF݂̒liǂ̃XbhłAbNȂj
+// Gauge: the current value, lock-free from any thread
+class CMetricGauge
+{
+public:
+
+	void set(double value) { m_Value.store(value, std::memory_order_relaxed); }
+	double get() const { return m_Value.load(std::memory_order_relaxed); }
+
+private:
+
+	std::atomic<double> m_Value{ 0.0 };
+};
+
+// HDR`̃qXgOF2̗ݏ悲Ƃ32̐`̃oPbgiΌ덷3%ȓjAL^̓bNȂ
+// HDR-style histogram: 32 linear sub-buckets per power of two (within 3% relative error); recording is lock-free
+//   l͐iF}CNbjŋL^Ao͎unitScale|܂iF1e-6ŕbj
+//   values are recorded as integers (e.g. microseconds) and multiplied by unitScale on export (1e-6 for seconds)
+class CMetricHistogram
+{
+public:
+
+	void record(uint64_t value);
+	uint64_t getCount() const { return m_Count.load(std::memory_order_relaxed); }
+	uint64_t getSum() const { return m_Sum.load(std::memory_order_relaxed); }
+
+	// quantileF0.0`1.0BL^łĂяo܂i̎_̋ߎlj
+	// quantile in 0.0 - 1.0; safe while other threads record, giving an approximate snapshot
+	uint64_t getQuantile(double quantile) const;
+
+private:
+
+	static const uint32_t SUB_BUCKET_BITS = 5;
+	static const uint32_t SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+	static const uint32_t MAX_SHIFT = 40;                                   // 2^45܂Łi}CNbŖ1Nj
+	static const uint32_t BUCKET_COUNT = (MAX_SHIFT + 2) * SUB_BUCKET_COUNT;
+
+	static uint32_t bucketIndex(uint64_t value);
+	static uint64_t bucketValue(uint32_t index);    // oPbg̒l
+
+	std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_Buckets{};
+	std::atomic<uint64_t>                           m_Count{ 0 };
+	std::atomic<uint64_t>                           m_Sum{ 0 };
+};
+
+// gNX̃WXgFo^gNXPrometheus̃eLXg`ŒIɏo܂
+// Metrics registry: periodically exports the registered metrics in the Prometheus text format
+//   gNX͌ĂяoL܂iWXg͎QƂ̂݁Ao͐Ă邱Ɓj
+//   the caller owns the metrics; the registry only references them, so they must outlive the exporter
+//   o͐Ft@Ciꎞt@CɏĂujA܂"unix:pX"Ń[JUnix\PbgiڑƂ1j
+//   target: a file, rewritten through a temporary file, or "unix:PATH" for a local Unix socket answering each connection
+//   Unix\Pbg͔Windowŝ݁iWindowsł̓t@CɏoĂj
+//   Unix sockets are POSIX only; on Windows export to a file
+class CMetricsRegistry
+{
+public:
+
+	~CMetricsRegistry();
+
+	// labelsFPrometheus̃xiF"severity=\"error\""jBO͑ēo^܂
+	// labels are Prometheus labels such as severity="error"; register metrics sharing a name one after another
+	void addCounter(const std::string& name, const std::string& help, const CMetricCounter& counter, const std::string& labels = "");
+	void addGauge(const std::string& name, const std::string& help, const CMetricGauge& gauge, const std::string& labels = "");
+	void addHistogram(const std::string& name, const std::string& help, const CMetricHistogram& histogram, double unitScale);
+
+	// o̒OɌĂяo܂iŐĂlgNXɎʂꍇAoXbhŎsj
+	// called right before every export, on the exporter thread; for copying values counted elsewhere into metrics
+	void addCollector(std::function<void()> collector);
+
+	void writePrometheus(std::ostream& out);
+
+	bool startExporter(const std::string& target, double intervalSeconds);
+	void stopExporter();    // t@CFŌɂxo܂
+
+private:
+
+	enum class MetricType { Counter, Gauge, Histogram };
+
+	struct Entry
+	{
+		MetricType              type;
+		std::string             name;
+		std::string             help;
+		std::string             labels;
+		const CMetricCounter*   counter = nullptr;
+		const CMetricGauge*     gauge = nullptr;
+		const CMetricHistogram* histogram = nullptr;
+		double                  unitScale = 1.0;
+	};
+
+	void exporterLoop();
+	void writeFile();
+	void serveSocket();
+
+	std::mutex                          m_Mutex;         // o^Eo
+	std::vector<Entry>                  m_Entries;
+	std::vector<std::function<void()>>  m_Collectors;
+
+	std::string                         m_FilePath;
+	std::string                         m_SocketPath;
+	intptr_t                            m_Socket = -1;   // ҂󂯃\PbgiUnix\Pbĝ݁j
+	double                              m_IntervalSeconds = 10.0;
+
+	std::thread                         m_Thread;
+	std::mutex                          m_StopMutex;
+	std::condition_variable             m_StopCondition;
+	bool                                m_Stopping = false;
+};
@@ -0,0 +1,663 @@
+/*======================================================================
+Vulkan Presentation : PipelineManager.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "PipelineManager.h"
+#include "VulkanFramework.h"    // CVulkanFramework::readFile()
+#include "Trace.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace
+{
+	// FNV-1ai64rbgj
+	void hashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	}
+
+	template <typename T>
+	void hashValue(uint64_t& hash, const T& value)
+	{
+		hashBytes(hash, &value, sizeof(value));
+	}
+
+	// 0ȏ̐iuint32_tĵݎ󂯕t܂istd::stoulƈႢAO𓊂܂j
+	// accepts a plain non-negative integer that fits uint32_t; unlike std::stoul it never throws
+	bool parseUnsigned(const std::string& text, uint32_t& value)
+	{
+		if (text.empty() || text.size() > 10 || std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; }) == false)
+		{
+			return false;
+		}
+		const uint64_t parsed = std::stoull(text);
+		if (parsed > UINT32_MAX)
+		{
+			return false;
+		}
+		value = static_cast<uint32_t>(parsed);
+		return true;
+	}
+
+	VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code, const VkAllocationCallbacks* allocator)
+	{
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(device, &createInfo, allocator, &shaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create shader module!");
+		}
+		return shaderModule;
+	}
+}
+
+uint64_t GraphicsPipelineDesc::hash() const
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	hashBytes(hash, vertShaderPath.data(), vertShaderPath.size());
+	hashValue(hash, '\0');
+	hashBytes(hash, fragShaderPath.data(), fragShaderPath.size());
+	hashValue(hash, '\0');
+
+	// \̂̃pfBO邽߁Ao[ƂɃnbV܂
+	// hash member by member so struct padding never leaks in
+	for (const VkVertexInputBindingDescription& binding : vertexBindings)
+	{
+		hashValue(hash, binding.binding);
+		hashValue(hash, binding.stride);
+		hashValue(hash, binding.inputRate);
+	}
+	for (const VkVertexInputAttributeDescription& attribute : vertexAttributes)
+	{
+		hashValue(hash, attribute.location);
+		hashValue(hash, attribute.binding);
+		hashValue(hash, attribute.format);
+		hashValue(hash, attribute.offset);
+	}
+
+	hashValue(hash, topology);
+	hashValue(hash, polygonMode);
+	hashValue(hash, cullMode);
+	hashValue(hash, frontFace);
+	hashValue(hash, samples);
+	hashValue(hash, sampleShading);
+	hashValue(hash, depthTest);
+	hashValue(hash, depthWrite);
+	hashValue(hash, depthCompareOp);
+	hashValue(hash, alphaBlend);
+
+	hashValue(hash, specializationConstants.size());
+	for (uint32_t constant : specializationConstants)
+	{
+		hashValue(hash, constant);
+	}
+
+	hashValue(hash, layout);
+	hashValue(hash, renderPassKey);
+	hashValue(hash, subpass);
+	return hash;
+}
+
+//====================================================================================
+// 10X : EЕt
+// Initialization/Cleanup
+//====================================================================================
+
+void CPipelineManager::init(VkDevice device, VkPipelineCache pipelineCache, uint32_t workerCount, const VkAllocationCallbacks* allocator)
+{
+	m_Device = device;
+	m_Allocator = allocator;
+	m_PipelineCache = pipelineCache;
+	m_Stopping = false;
+
+	for (uint32_t i = 0; i < std::max(workerCount, 1u); i++)
+	{
+		m_Workers.emplace_back(&CPipelineManager::workerLoop, this);
+	}
+}
+
+void CPipelineManager::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+		m_CompileQueue.clear();    // ̃RpC͔j / drop variants no worker has started
+	}
+	m_QueueCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+	m_Workers.clear();
+
+	for (auto& pipeline : m_Pipelines)
+	{
+		if (pipeline.second.pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(m_Device, pipeline.second.pipeline, m_Allocator);
+		}
+	}
+	m_Pipelines.clear();
+
+	for (VkRenderPass renderPass : m_RetiredRenderPasses)    // [J[͑SďIς
+	{
+		vkDestroyRenderPass(m_Device, renderPass, m_Allocator);
+	}
+	m_RetiredRenderPasses.clear();
+	m_RenderPassUses.clear();
+}
+
+//====================================================================================
+// 20X : pCvC擾
+// Pipeline Lookup
+//====================================================================================
+
+VkPipeline CPipelineManager::getPipeline(const GraphicsPipelineDesc& desc)
+{
+	const uint64_t key = desc.hash();
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto it = m_Pipelines.find(key);
+	if (it == m_Pipelines.end())
+	{
+		requestLocked(key, desc);
+		m_QueueCondition.notify_one();
+		return VK_NULL_HANDLE;
+	}
+	return it->second.pipeline;    // PendingEFailedFVK_NULL_HANDLE
+}
+
+VkPipeline CPipelineManager::getPipelineBlocking(const GraphicsPipelineDesc& desc)
+{
+	const uint64_t key = desc.hash();
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	auto it = m_Pipelines.find(key);
+	if (it != m_Pipelines.end())
+	{
+		// [J[RpC̏ꍇ͊҂܂BL[ő҂Ă邾Ȃ炱ŃRpC܂
+		// wait if a worker is already compiling it; if it is only queued, compile it here instead
+		auto queued = std::find(m_CompileQueue.begin(), m_CompileQueue.end(), key);
+		if (queued == m_CompileQueue.end())
+		{
+			m_ReadyCondition.wait(lock, [&]() { return m_Pipelines[key].state != EntryState::Pending; });
+			if (m_Pipelines[key].state == EntryState::Failed)
+			{
+				throw std::runtime_error("Failed to create graphics pipeline!");
+			}
+			return m_Pipelines[key].pipeline;
+		}
+		m_CompileQueue.erase(queued);
+	}
+	else
+	{
+		Entry entry;
+		entry.desc = desc;
+		m_Pipelines.emplace(key, entry);
+	}
+	m_RenderPassUses[desc.renderPass]++;
+	lock.unlock();
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	try
+	{
+		pipeline = createPipeline(desc);
+	}
+	catch (...)
+	{
+		lock.lock();
+		m_Pipelines[key].state = EntryState::Failed;
+		const VkRenderPass retired = releaseRenderPassUseLocked(desc.renderPass);
+		m_ReadyCondition.notify_all();
+		lock.unlock();
+		if (retired != VK_NULL_HANDLE)
+		{
+			vkDestroyRenderPass(m_Device, retired, m_Allocator);
+		}
+		throw;
+	}
+
+	lock.lock();
+	m_Pipelines[key].pipeline = pipeline;
+	m_Pipelines[key].state = EntryState::Ready;
+	const VkRenderPass retired = releaseRenderPassUseLocked(desc.renderPass);
+	m_ReadyCondition.notify_all();
+	lock.unlock();
+	if (retired != VK_NULL_HANDLE)
+	{
+		vkDestroyRenderPass(m_Device, retired, m_Allocator);
+	}
+	return pipeline;
+}
+
+size_t CPipelineManager::prewarm(const std::string& manifestPath, const GraphicsPipelineDesc& baseDesc)
+{
+	// }jtFXgF1s1oAgAx[X̃Xe[g key=value ŏ㏑܂i#ȍ~̓Rgj
+	// manifest: one variant per line, key=value pairs overriding the base state ('#' starts a comment)
+	//   vert=shaders/vert.spv frag=shaders/frag.spv cull=back blend=0 depthTest=1 depthWrite=1 spec=1,0
+	std::ifstream file(manifestPath);
+	if (file.is_open() == false)
+	{
+		return 0;
+	}
+
+	size_t queuedCount = 0;
+	size_t lineNumber = 0;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream tokens(line);
+
+		GraphicsPipelineDesc desc = baseDesc;
+		bool hasToken = false;
+		bool valid = true;
+		std::string token;
+		while (valid && tokens >> token)
+		{
+			const size_t separator = token.find('=');
+			if (separator == std::string::npos)
+			{
+				std::cerr << "Pipeline manifest: ignoring '" << token << "'" << std::endl;
+				continue;
+			}
+			const std::string key = token.substr(0, separator);
+			const std::string value = token.substr(separator + 1);
+			hasToken = true;
+
+			if (key == "vert")				desc.vertShaderPath = value;
+			else if (key == "frag")			desc.fragShaderPath = value;
+			else if (key == "blend")		desc.alphaBlend = (value == "1");
+			else if (key == "depthTest")	desc.depthTest = (value == "1");
+			else if (key == "depthWrite")	desc.depthWrite = (value == "1");
+			else if (key == "cull")
+			{
+				desc.cullMode = (value == "back") ? VK_CULL_MODE_BACK_BIT
+					: (value == "front") ? VK_CULL_MODE_FRONT_BIT
+					: VK_CULL_MODE_NONE;
+			}
+			else if (key == "spec")
+			{
+				desc.specializationConstants.clear();
+				std::istringstream values(value);
+				std::string constant;
+				while (std::getline(values, constant, ','))
+				{
+					uint32_t number = 0;
+					if (parseUnsigned(constant, number) == false)
+					{
+						// sȒl̍s͊ۂƔ΂܂iꕔKpoAg͍܂j
+						// skip the whole line rather than queue a half-applied variant
+						std::cerr << "Pipeline manifest line " << lineNumber << ": invalid spec value '" << constant
+							<< "', skipping the line" << std::endl;
+						valid = false;
+						break;
+					}
+					desc.specializationConstants.push_back(number);
+				}
+			}
+			else
+			{
+				std::cerr << "Pipeline manifest: unknown key '" << key << "'" << std::endl;
+			}
+		}
+
+		if (hasToken == false || valid == false)
+		{
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (requestLocked(desc.hash(), desc))
+		{
+			queuedCount++;
+		}
+	}
+
+	m_QueueCondition.notify_all();
+	return queuedCount;
+}
+
+void CPipelineManager::retireRenderPass(VkRenderPass renderPass)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		// oAg͎ɗvꂽɁAV_[pXŃRpC܂
+		// cancelled variants are compiled again against the new render pass the next time they are requested
+		for (auto it = m_CompileQueue.begin(); it != m_CompileQueue.end();)
+		{
+			if (m_Pipelines[*it].desc.renderPass == renderPass)
+			{
+				m_Pipelines.erase(*it);
+				it = m_CompileQueue.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		// RpCFŌɎgI[J[폜܂
+		// still compiling: the worker that finishes last destroys it
+		auto uses = m_RenderPassUses.find(renderPass);
+		if (uses != m_RenderPassUses.end() && uses->second > 0)
+		{
+			m_RetiredRenderPasses.push_back(renderPass);
+			return;
+		}
+	}
+
+	vkDestroyRenderPass(m_Device, renderPass, m_Allocator);
+}
+
+VkRenderPass CPipelineManager::releaseRenderPassUseLocked(VkRenderPass renderPass)
+{
+	auto uses = m_RenderPassUses.find(renderPass);
+	if (uses == m_RenderPassUses.end() || --uses->second > 0)
+	{
+		return VK_NULL_HANDLE;
+	}
+	m_RenderPassUses.erase(uses);
+
+	auto retired = std::find(m_RetiredRenderPasses.begin(), m_RetiredRenderPasses.end(), renderPass);
+	if (retired == m_RetiredRenderPasses.end())
+	{
+		return VK_NULL_HANDLE;
+	}
+	m_RetiredRenderPasses.erase(retired);
+	return renderPass;
+}
+
+size_t CPipelineManager::getPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_CompileQueue.size() + m_CompilingCount;
+}
+
+bool CPipelineManager::requestLocked(uint64_t key, const GraphicsPipelineDesc& desc)
+{
+	if (m_Stopping == true || m_Pipelines.count(key) > 0)
+	{
+		return false;
+	}
+
+	Entry entry;
+	entry.desc = desc;
+	m_Pipelines.emplace(key, entry);
+	m_CompileQueue.push_back(key);
+	return true;
+}
+
+//====================================================================================
+// 30X : RpCi[J[Xbhj
+// Compilation (worker threads)
+//====================================================================================
+
+void CPipelineManager::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (true)
+	{
+		m_QueueCondition.wait(lock, [this]() { return m_Stopping || m_CompileQueue.empty() == false; });
+		if (m_Stopping == true)
+		{
+			return;
+		}
+
+		const uint64_t key = m_CompileQueue.front();
+		m_CompileQueue.pop_front();
+		const GraphicsPipelineDesc desc = m_Pipelines[key].desc;
+		m_CompilingCount++;
+		m_RenderPassUses[desc.renderPass]++;    // bNOOɐ܂iretireRenderPass()ɍ폜Ȃ悤Ɂj
+		lock.unlock();
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		try
+		{
+			// RpCԂ̓g[XɋL^܂i--tracej
+			// compile times go to the trace (--trace) instead of the console
+			TRACE_SCOPE("Pipeline variant compile");
+			pipeline = createPipeline(desc);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Background pipeline compile failed: " << e.what() << std::endl;
+		}
+
+		lock.lock();
+		m_CompilingCount--;
+		Entry& entry = m_Pipelines[key];
+		entry.pipeline = pipeline;
+		entry.state = (pipeline != VK_NULL_HANDLE) ? EntryState::Ready : EntryState::Failed;
+		m_ReadyCondition.notify_all();
+
+		const VkRenderPass retired = releaseRenderPassUseLocked(desc.renderPass);
+		if (retired != VK_NULL_HANDLE)
+		{
+			lock.unlock();
+			vkDestroyRenderPass(m_Device, retired, m_Allocator);
+			lock.lock();
+		}
+	}
+}
+
+
+// pCvCFGraphicsPipelineDesc̓eŊeiKݒ肵܂iǂ̃XbhłĂяo܂j
+// Build a pipeline from its description; safe to call from any thread
+VkPipeline CPipelineManager::createPipeline(const GraphicsPipelineDesc& desc)
+{
+	const std::vector<char> vertShaderCode = CVulkanFramework::readFile(desc.vertShaderPath);    // _VF[_[Ot@C̓ǂݍ
+	const std::vector<char> fragShaderCode = CVulkanFramework::readFile(desc.fragShaderPath);    // tOgVF[_[Ot@C̓ǂݍ
+
+	VkShaderModule vertShaderModule = createShaderModule(m_Device, vertShaderCode, m_Allocator);   // _VF[_[W[
+	VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+	try
+	{
+		fragShaderModule = createShaderModule(m_Device, fragShaderCode, m_Allocator);              // tOgVF[_[W[
+	}
+	catch (...)
+	{
+		vkDestroyShaderModule(m_Device, vertShaderModule, m_Allocator);
+		throw;
+	}
+
+	// ꉻ萔Fconstant_id = 0, 1, 2... ̏ɗXe[WŋL܂
+	// specialization constants: constant_id 0, 1, 2... in order, shared by both stages
+	std::vector<VkSpecializationMapEntry> specializationEntries(desc.specializationConstants.size());
+	for (uint32_t i = 0; i < specializationEntries.size(); i++)
+	{
+		specializationEntries[i].constantID = i;
+		specializationEntries[i].offset = i * sizeof(uint32_t);
+		specializationEntries[i].size = sizeof(uint32_t);
+	}
+
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = desc.specializationConstants.size() * sizeof(uint32_t);
+	specializationInfo.pData = desc.specializationConstants.data();
+
+	const VkSpecializationInfo* pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
+
+	// VF[_Xe[WFpCvCŃVF[_[𗘗piK	
+	// Shader Stages: Assigning shader code to its specific pipeline stage
+	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};                    // _VF[_[Xe[W\
+	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;                   // enum for programmable stages in Graphics Pipeline: Intro
+	vertShaderStageInfo.module = vertShaderModule;
+	vertShaderStageInfo.pName = "main";                                       // _VF[_[Gg[|Cg֐(shaders.vert)
+	vertShaderStageInfo.pSpecializationInfo = pSpecializationInfo;
+
+	VkPipelineShaderStageCreateInfo fragShaderStageInfo{};                    // tOgVF[_[Xe[W\
+	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragShaderStageInfo.module = fragShaderModule;
+	fragShaderStageInfo.pName = "main";                                       // tOgVF[_[Gg[|Cg֐(shaders.frag)
+	fragShaderStageInfo.pSpecializationInfo = pSpecializationInfo;
+
+	// pCvC̃^C~OŎg`ɂ܂B
+	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };    // VF[_[\̔z
+
+	// pCvC̍ۂɕKvȒiK necessary steps in creating a graphics pipeline
+
+	// 1.) _CvbgF_VF[_[ɓn钸_̃tH[}bg
+	// Vertex Input: Format of the vertex data to be passed to the vertex shader
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};    // _Cvbg\
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.vertexBindings.size());
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertexAttributes.size());
+	vertexInputInfo.pVertexBindingDescriptions = desc.vertexBindings.data();
+	vertexInputInfo.pVertexAttributeDescriptions = desc.vertexAttributes.data();
+
+	// 2.) CvbgAZu[F _ǂȃWIg[`悳邩Aăg|W[o[ݒ
+	// Input Assembly: What kind of geometry will be drawn from the vertices, topology member settings
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = desc.topology;              // POINT_LISTALINE_LISTALINE_STRIPATRIANGLE_LISTATRIANGLE_STRIP
+	inputAssembly.primitiveRestartEnable = VK_FALSE;     //@STRIP̏ꍇACƎOp𕪎Uł܂
+
+	// 3.) r[|[gEVU[lpF_Ci~bNXe[girecordCommandBuffer()ŐݒjȂ̂ŁAł͐̂ݎg܂
+	// Viewports and Scissor Rectangles: dynamic (set in recordCommandBuffer()), so only the counts are used here
+
+	VkPipelineViewportStateCreateInfo viewportState{};    // r[|[gXe[giԁj\
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	// 4.) X^CU[F_VF[_[̃WIg[iVF[vjtOgisNZjɕϊĐFt܂B 
+	// Rasterizer: Takes geomerty shaped from the vertex shader and turns it into fragments (pixels) to be colored by the fragment shader.
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};    // X^CU[\
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = desc.polygonMode;    // FILLȊȌꍇAGPU@\IɂKv܂B
+	rasterizer.lineWidth = 1.0f;                  // ČisNZPʁjLine thickness (in pixels)
+	rasterizer.cullMode = desc.cullMode;          // JOݒiʏFBackfaceCulling)
+	rasterizer.frontFace = desc.frontFace;        // _̏Ԃɂ\ʁEʂ𔻒fݒivEvj
+	rasterizer.depthBiasEnable = VK_FALSE;        // VK_TRUE: DepthliVhE}bsOjAdjusting depth values i.e. for shadow mapping
+
+	// 5.) }`TvOiA`GCAVOpjFTv̓_[pXƓ
+	// Multisampling (method to perform anti-aliasing); the sample count must match the render pass
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};    // }`TvO\
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = desc.sampleShading ? VK_TRUE : VK_FALSE;    // TvVF[fBO
+	multisampling.rasterizationSamples = desc.samples;       // }`TvO
+	multisampling.minSampleShading = 0.2f;                   // 1.0ɋ߂΋߂قǃX[YȂ
+
+	// 6.)@fvXEXeV
+	// Depth and Stencil Testing 
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;      // VtOg̃fvXfvXobt@[Ɣr邩idiscard)
+	depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;    // fvXeXgitOg̃fvXfvXobt@[ɏނ
+	depthStencil.depthCompareOp = desc.depthCompareOp;   // LESS: fvXႢF߂
+	depthStencil.depthBoundsTestEnable = VK_FALSE;       // fvXoEheXgpiTRUE: Bounds̃tOgۗ܂j
+	depthStencil.minDepthBounds = 0.0f;                  // C optional
+	depthStencil.maxDepthBounds = 1.0f;                  // C optional
+	depthStencil.stencilTestEnable = VK_FALSE;           // XeVobt@[p
+
+	// 7.) J[ufBOFAt@ufBO̗L
+	// finalColor.rgb = newAlpha * newColor + (1 - newAlpha) * oldColor;
+	// Color Blending: optional alpha blending as above
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};         // J[uh\
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT
+		| VK_COLOR_COMPONENT_G_BIT
+		| VK_COLOR_COMPONENT_B_BIT
+		| VK_COLOR_COMPONENT_A_BIT;
+	if (desc.alphaBlend == true)
+	{
+		colorBlendAttachment.blendEnable = VK_TRUE;
+		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	}
+	else
+	{
+		colorBlendAttachment.blendEnable = VK_FALSE;
+		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+	}
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};    // pCvCJ[uhXe[g\
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.logicOp = VK_LOGIC_OP_COPY;     // C optional
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	// 8.) _Ci~bNXe[gFr[|[gEVU[̓R}hobt@[Őݒ肵܂iTCYŃpCvC蒼Ȃj
+	// Dynamic state: viewport and scissor are set per command buffer, so a resize does not rebuild the pipeline
+	VkDynamicState dynamicStates[] =
+	{
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	// 9.) OtBbNXpCvCFS̒iKgݍ킹ăpCvC𐶐܂B
+	// Graphics Pipeline creation: Putting everything together to create the pipeline
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};    // pCvC\
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;                    // VF[_[Xe[Wɍ킹	 Make sure this info is aligned with Shader Stages above
+	pipelineInfo.pStages = shaderStages;            // VF[_[Xe[Wz̃|C^[
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;     // r[|[gEVU[
+	pipelineInfo.layout = desc.layout;              // pCvCCAEginhj
+	pipelineInfo.renderPass = desc.renderPass;      // ݊̂郌_[pXł΁Aǂł
+	pipelineInfo.subpass = desc.subpass;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;    // C optional
+	pipelineInfo.basePipelineIndex = -1;                 // C optional
+
+	// pCvCLbV͓œ̂ŁA[J[Xbh瓯Ɏg܂
+	// the pipeline cache is internally synchronized, so worker threads can share it
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	const VkResult result = vkCreateGraphicsPipelines(m_Device, m_PipelineCache, 1, &pipelineInfo, m_Allocator, &pipeline);
+
+	// pς݂̃VF[_[W[폜܂B
+	vkDestroyShaderModule(m_Device, fragShaderModule, m_Allocator);
+	vkDestroyShaderModule(m_Device, vertShaderModule, m_Allocator);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create graphics pipeline!");
+	}
+	return pipeline;
+}
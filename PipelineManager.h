@@ -0,0 +1,119 @@
+/*======================================================================
+Vulkan Presentation : PipelineManager.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// OtBbNXpCvC̑SXe[gFhash()pCvCoAg̃L[ɂȂ܂
+// Full graphics pipeline state; hash() is the key of the pipeline variant
+struct GraphicsPipelineDesc
+{
+	std::string                                    vertShaderPath;
+	std::string                                    fragShaderPath;
+	std::vector<VkVertexInputBindingDescription>   vertexBindings;
+	std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+
+	VkPrimitiveTopology   topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkPolygonMode         polygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags       cullMode = VK_CULL_MODE_NONE;
+	VkFrontFace           frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	bool                  sampleShading = true;       // TvVF[fBOiminSampleShading = 0.2j
+	bool                  depthTest = true;
+	bool                  depthWrite = true;
+	VkCompareOp           depthCompareOp = VK_COMPARE_OP_LESS;
+	bool                  alphaBlend = false;         // At@ufBOisrc alpha, 1 - src alphaj
+
+	std::vector<uint32_t> specializationConstants;    // constant_id = 0, 1, 2... ̏
+
+	VkPipelineLayout      layout = VK_NULL_HANDLE;
+	VkRenderPass          renderPass = VK_NULL_HANDLE;
+	uint64_t              renderPassKey = 0;          // _[pX݊itH[}bgETvj̃nbV
+	uint32_t              subpass = 0;
+
+	// _[pX̓nhł͂Ȃ݊L[ŃnbV܂i݊Ȃ蒼ĂpCvCg܂j
+	// the render pass enters the hash through its compatibility key, so a compatible rebuild reuses the variant
+	uint64_t hash() const;
+};
+
+// pCvCǗFoAgnbVŊǗāAȂ̂[J[XbhŃRpC܂
+// Pipeline manager: variants keyed by state hash, missing ones compiled on worker threads
+class CPipelineManager
+{
+public:
+
+	void init(VkDevice device, VkPipelineCache pipelineCache, uint32_t workerCount, const VkAllocationCallbacks* allocator = nullptr);
+	void shutdown();    // [J[IASpCvC폜
+
+	// mubLOFRpCVK_NULL_HANDLEip̃pCvCgA`XLbvj
+	// non-blocking; returns VK_NULL_HANDLE while the variant compiles (draw with a fallback or skip)
+	VkPipeline getPipeline(const GraphicsPipelineDesc& desc);
+
+	// ubLOF̃ftHgipjpCvCp
+	// blocking; for the default/fallback pipeline at startup
+	VkPipeline getPipelineBlocking(const GraphicsPipelineDesc& desc);
+
+	// }jtFXgɏꂽoAgOɃRpCi[J[XbhjAL[ɒǉԂ܂
+	// queue the variants listed in a manifest for background compilation; returns how many were queued
+	size_t prewarm(const std::string& manifestPath, const GraphicsPipelineDesc& baseDesc);
+
+	// gȂȂ_[pXn܂i폜͂ōs܂jF̃RpCA
+	// RpĈ̂Ȃ΂ɁA΃[J[ŌɎgIɍ폜܂iҋ@܂j
+	// hand over a render pass that is no longer used; queued compiles against it are dropped and it is destroyed
+	// right away, or by the worker that finishes the last compile still using it; never blocks
+	void retireRenderPass(VkRenderPass renderPass);
+
+	size_t getPendingCount() const;
+
+private:
+
+	enum class EntryState
+	{
+		Pending,
+		Ready,
+		Failed
+	};
+
+	struct Entry
+	{
+		GraphicsPipelineDesc desc;
+		EntryState           state = EntryState::Pending;
+		VkPipeline           pipeline = VK_NULL_HANDLE;
+	};
+
+	bool requestLocked(uint64_t key, const GraphicsPipelineDesc& desc);    // m_MutexbNԂŌĂяo܂
+	VkPipeline createPipeline(const GraphicsPipelineDesc& desc);
+
+	// gp̐炵A0ɂȂލς݂̃_[pXԂ܂im_MutexbNԂŁj
+	// drop one use; returns the render pass if that was the last use of a retired one (call with m_Mutex held)
+	VkRenderPass releaseRenderPassUseLocked(VkRenderPass renderPass);
+	void workerLoop();
+
+	VkDevice                             m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks*         m_Allocator = nullptr;    // [J[Xbhgp
+	VkPipelineCache                      m_PipelineCache = VK_NULL_HANDLE;
+
+	std::unordered_map<uint64_t, Entry>  m_Pipelines;            // L[FGraphicsPipelineDesc::hash()
+	std::deque<uint64_t>                 m_CompileQueue;         // RpC҂̃L[
+	size_t                               m_CompilingCount = 0;   // [J[RpC̐
+	std::unordered_map<VkRenderPass, uint32_t> m_RenderPassUses;    // RpC̃pCvCgĂ鐔
+	std::vector<VkRenderPass>            m_RetiredRenderPasses;  // gp̂ߍ폜҂Ă郌_[pX
+
+	std::vector<std::thread>             m_Workers;
+	mutable std::mutex                   m_Mutex;
+	std::condition_variable              m_QueueCondition;       // [J[FRpC҂
+	std::condition_variable              m_ReadyCondition;       // getPipelineBlocking()FRpC
+	bool                                 m_Stopping = false;
+};
@@ -0,0 +1,543 @@
+/*======================================================================
+Vulkan Presentation : RenderGraph.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	// gƂ̃Xe[WEANZXECAEgiobt@[̓CAEg𖳎j
+	// stage, access and layout per usage; buffers ignore the layout
+	struct UsageInfo
+	{
+		VkPipelineStageFlags stages;
+		VkAccessFlags        access;
+		VkImageLayout        layout;
+	};
+
+	const VkAccessFlags SHADER_READ_ACCESS = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+	const VkPipelineStageFlags DEPTH_TEST_STAGES = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+	// ݃ANZXFsrcAccessMaskɂ͂ꂾ܂iǂݍ݂̓tbVsvj
+	// write accesses; only these go into srcAccessMask since reads have nothing to flush
+	const VkAccessFlags WRITE_ACCESS =
+		VK_ACCESS_SHADER_WRITE_BIT |
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_TRANSFER_WRITE_BIT |
+		VK_ACCESS_HOST_WRITE_BIT |
+		VK_ACCESS_MEMORY_WRITE_BIT;
+
+	UsageInfo getUsageInfo(ResourceUsage usage)
+	{
+		switch (usage)
+		{
+		case ResourceUsage::TransferRead:
+			return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+		case ResourceUsage::TransferWrite:
+			return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+		case ResourceUsage::VertexBufferRead:
+			return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+		case ResourceUsage::IndexBufferRead:
+			return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+		case ResourceUsage::IndirectRead:
+			return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+		case ResourceUsage::VertexShaderRead:
+			return { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, SHADER_READ_ACCESS, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		case ResourceUsage::FragmentShaderRead:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, SHADER_READ_ACCESS, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		case ResourceUsage::ComputeRead:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, SHADER_READ_ACCESS, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		case ResourceUsage::ComputeWrite:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+		case ResourceUsage::ColorAttachmentWrite:
+			return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		case ResourceUsage::DepthAttachmentWrite:
+			return { DEPTH_TEST_STAGES,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+		case ResourceUsage::DepthAttachmentRead:
+			return { DEPTH_TEST_STAGES, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		case ResourceUsage::Present:
+			return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+		}
+
+		throw std::runtime_error("Unknown render graph resource usage!");
+	}
+}
+
+bool RenderGraphImageDesc::operator==(const RenderGraphImageDesc& other) const
+{
+	return format == other.format
+		&& extent.width == other.extent.width
+		&& extent.height == other.extent.height
+		&& samples == other.samples
+		&& usage == other.usage
+		&& aspect == other.aspect
+		&& mipLevels == other.mipLevels;
+}
+
+void BarrierBatch::record(VkCommandBuffer commandBuffer) const
+{
+	if (empty())
+	{
+		return;
+	}
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		srcStageMask,
+		dstStageMask,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+		static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data()
+	);
+}
+
+
+
+//====================================================================================
+// Ot̍\z
+// Building the graph
+//====================================================================================
+
+void CRenderGraph::reset()
+{
+	// clear()Ft[蒼Ăvector̗eʂ͍ėp܂
+	// clear() keeps the vectors' capacity when the graph is rebuilt every frame
+	m_Resources.clear();
+	m_Passes.clear();
+	m_PhysicalImages.clear();
+	m_FinalBarriers = BarrierBatch{};
+}
+
+CRenderGraph::ResourceHandle CRenderGraph::importBuffer(const std::string& name, VkBuffer buffer)
+{
+	for (size_t i = 0; i < m_Resources.size(); i++)
+	{
+		if (!m_Resources[i].isImage && m_Resources[i].buffer == buffer)
+		{
+			return static_cast<ResourceHandle>(i);
+		}
+	}
+
+	Resource resource;
+	resource.name = name;
+	resource.buffer = buffer;
+	m_Resources.push_back(resource);
+	return static_cast<ResourceHandle>(m_Resources.size() - 1);
+}
+
+CRenderGraph::ResourceHandle CRenderGraph::importImage(const std::string& name, VkImage image, VkImageAspectFlags aspect, uint32_t mipLevels,
+	VkImageLayout currentLayout, VkImageLayout finalLayout)
+{
+	for (size_t i = 0; i < m_Resources.size(); i++)
+	{
+		if (m_Resources[i].isImage && !m_Resources[i].transient && m_Resources[i].image == image)
+		{
+			return static_cast<ResourceHandle>(i);
+		}
+	}
+
+	Resource resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.image = image;
+	resource.aspect = aspect;
+	resource.mipLevels = mipLevels;
+	resource.initialLayout = currentLayout;
+	resource.finalLayout = finalLayout;
+	m_Resources.push_back(resource);
+	return static_cast<ResourceHandle>(m_Resources.size() - 1);
+}
+
+CRenderGraph::ResourceHandle CRenderGraph::createTransientImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.transient = true;
+	resource.aspect = desc.aspect;
+	resource.mipLevels = desc.mipLevels;
+	resource.desc = desc;
+	m_Resources.push_back(resource);
+	return static_cast<ResourceHandle>(m_Resources.size() - 1);
+}
+
+uint32_t CRenderGraph::addPass(const std::string& name, PassCallback callback)
+{
+	Pass pass;
+	pass.name = name;
+	pass.callback = std::move(callback);
+	m_Passes.push_back(std::move(pass));
+	return static_cast<uint32_t>(m_Passes.size() - 1);
+}
+
+void CRenderGraph::use(uint32_t pass, ResourceHandle resource, ResourceUsage usage)
+{
+	if (pass >= m_Passes.size() || resource >= m_Resources.size())
+	{
+		throw std::runtime_error("Invalid render graph pass or resource!");
+	}
+
+	m_Passes[pass].uses.push_back({ resource, usage });
+
+	Resource& res = m_Resources[resource];
+	res.firstPass = std::min(res.firstPass, pass);
+	res.lastPass = std::max(res.lastPass, pass);
+}
+
+void CRenderGraph::setPhysicalImage(uint32_t physicalIndex, VkImage image)
+{
+	m_PhysicalImages[physicalIndex].image = image;
+	for (Resource& resource : m_Resources)
+	{
+		if (resource.transient && resource.physicalIndex == physicalIndex)
+		{
+			resource.image = image;
+		}
+	}
+
+	// oAɋL^ς݂̃nhւ܂
+	// patch the handle into the barriers compile() already built
+	auto patch = [physicalIndex, image](BarrierBatch& batch)
+	{
+		for (size_t i = 0; i < batch.imageBarriers.size(); i++)
+		{
+			if (batch.imagePhysicalIndices[i] == physicalIndex)
+			{
+				batch.imageBarriers[i].image = image;
+			}
+		}
+	};
+
+	for (Pass& pass : m_Passes)
+	{
+		patch(pass.barriers);
+	}
+	patch(m_FinalBarriers);
+}
+
+//====================================================================================
+// RpCFgWFg摜̋LAoǍvZ
+// Compiling: aliasing transient images and computing the barriers
+//====================================================================================
+
+// gWFg摜̊JnɕׂāAdlŎI摜΍ėp܂
+// walk transients by first use and reuse any physical image with an equal description whose last user has finished
+void CRenderGraph::assignPhysicalImages()
+{
+	std::vector<ResourceHandle> transients;
+	for (size_t i = 0; i < m_Resources.size(); i++)
+	{
+		if (m_Resources[i].transient && m_Resources[i].firstPass != UINT32_MAX)
+		{
+			transients.push_back(static_cast<ResourceHandle>(i));
+		}
+	}
+
+	std::stable_sort(transients.begin(), transients.end(), [this](ResourceHandle a, ResourceHandle b)
+		{
+			return m_Resources[a].firstPass < m_Resources[b].firstPass;
+		});
+
+	for (ResourceHandle handle : transients)
+	{
+		Resource& resource = m_Resources[handle];
+
+		resource.physicalIndex = UINT32_MAX;
+		for (uint32_t i = 0; i < m_PhysicalImages.size(); i++)
+		{
+			if (m_PhysicalImages[i].lastPass < resource.firstPass && m_PhysicalImages[i].desc == resource.desc)
+			{
+				resource.physicalIndex = i;
+				break;
+			}
+		}
+
+		if (resource.physicalIndex == UINT32_MAX)
+		{
+			PhysicalImage physical;
+			physical.desc = resource.desc;
+			m_PhysicalImages.push_back(physical);
+			resource.physicalIndex = static_cast<uint32_t>(m_PhysicalImages.size() - 1);
+		}
+
+		m_PhysicalImages[resource.physicalIndex].lastPass = resource.lastPass;
+		m_PhysicalImages[resource.physicalIndex].lastResource = handle;
+		resource.image = m_PhysicalImages[resource.physicalIndex].image;
+	}
+}
+
+// Ō̃pXł̎gɂ铯ԁiO̎s̏ȈԂƂĎg܂j
+// the synchronization state left by a resource's uses in its last pass, i.e. where the previous execution ended
+CRenderGraph::SyncState CRenderGraph::getLastUseState(ResourceHandle resource) const
+{
+	VkPipelineStageFlags stages = 0;
+	VkAccessFlags access = 0;
+	for (const Use& use : m_Passes[m_Resources[resource].lastPass].uses)
+	{
+		if (use.resource == resource)
+		{
+			const UsageInfo info = getUsageInfo(use.usage);
+			stages |= info.stages;
+			access |= info.access;
+		}
+	}
+
+	SyncState state;
+	if ((access & WRITE_ACCESS) != 0)
+	{
+		state.writeStages = stages;
+		state.writeAccess = access & WRITE_ACCESS;
+	}
+	else
+	{
+		state.readStages = stages;
+	}
+	return state;
+}
+
+// \[XƂ̏ԃCfbNXFO\[X͂̂܂܁AgWFg͕摜̌ɕׂ܂
+// state slot per physical resource: imported ones by handle, transients after them by physical image
+uint32_t CRenderGraph::getStateIndex(ResourceHandle resource) const
+{
+	const Resource& res = m_Resources[resource];
+	if (res.transient)
+	{
+		return static_cast<uint32_t>(m_Resources.size()) + res.physicalIndex;
+	}
+	return resource;
+}
+
+// 1̃\[X̎gpɕKvȃoAob`ɒǉāAԂXV܂
+// add whatever barrier one use of a resource needs to the batch, then advance its state
+//   ݌̓ǂݍ݁iRAWjF݂܂ĂȂXe[WEANZX̂
+//   read after write: only when the write is not yet visible to these stages and accesses
+//   ǂݍ݌̏݁iWARjFǂݍ݂҂sˑ̂݁itbVȂj
+//   write after read: an execution dependency on the readers, nothing to flush
+//   ݌̏݁iWAWjECAEgύXFȌ݂Ɠǂݍ݂̗҂܂
+//   write after write, or a layout change: wait for both the last write and the reads since
+void CRenderGraph::addBarrier(BarrierBatch& batch, const Resource& resource, SyncState& state,
+	VkPipelineStageFlags dstStages, VkAccessFlags dstAccess, VkImageLayout newLayout) const
+{
+	const bool isWrite = (dstAccess & WRITE_ACCESS) != 0;
+	const bool layoutChange = resource.isImage && newLayout != state.layout;
+
+	VkPipelineStageFlags srcStages = 0;
+	VkAccessFlags srcAccess = 0;
+	bool needBarrier = false;
+
+	if (isWrite || layoutChange)
+	{
+		srcStages = state.writeStages | state.readStages;
+		srcAccess = state.writeAccess;
+		needBarrier = layoutChange || srcStages != 0;
+	}
+	else if (state.writeStages != 0
+		&& ((dstStages & ~state.visibleStages) != 0 || (dstAccess & ~state.visibleAccess) != 0))
+	{
+		srcStages = state.writeStages;
+		srcAccess = state.writeAccess;
+		needBarrier = true;
+	}
+
+	if (needBarrier)
+	{
+		// ҂̂Ȃŏ̑JڂTOP_OF_PIPE
+		// a first transition with nothing to wait on starts at TOP_OF_PIPE
+		if (srcStages == 0)
+		{
+			srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		}
+		batch.srcStageMask |= srcStages;
+		batch.dstStageMask |= dstStages;
+
+		if (resource.isImage)
+		{
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dstAccess;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = resource.image;
+			barrier.subresourceRange.aspectMask = resource.aspect;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = resource.mipLevels;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+			batch.imageBarriers.push_back(barrier);
+			batch.imagePhysicalIndices.push_back(resource.transient ? resource.physicalIndex : UINT32_MAX);
+		}
+		else
+		{
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dstAccess;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = resource.buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			batch.bufferBarriers.push_back(barrier);
+		}
+	}
+
+	if (isWrite)
+	{
+		state.writeStages = dstStages;
+		state.writeAccess = dstAccess & WRITE_ACCESS;
+		state.readStages = 0;
+		state.visibleStages = 0;
+		state.visibleAccess = 0;
+	}
+	else if (layoutChange)
+	{
+		// CAEgύX̓oA̒̏݁FdstStages̑Oɕۏ؂AdstAccessɂ͌Ă܂
+		// the transition is itself a write, done before dstStages and already visible to dstAccess
+		state.writeStages = dstStages;
+		state.writeAccess = 0;
+		state.readStages = dstStages;
+		state.visibleStages = dstStages;
+		state.visibleAccess = dstAccess;
+	}
+	else
+	{
+		state.readStages |= dstStages;
+		if (needBarrier)
+		{
+			state.visibleStages |= dstStages;
+			state.visibleAccess |= dstAccess;
+		}
+	}
+
+	if (resource.isImage)
+	{
+		state.layout = newLayout;
+	}
+}
+
+void CRenderGraph::compile()
+{
+	m_PhysicalImages.clear();
+	assignPhysicalImages();
+
+	std::vector<SyncState> states(m_Resources.size() + m_PhysicalImages.size());
+	for (size_t i = 0; i < m_Resources.size(); i++)
+	{
+		if (!m_Resources[i].transient)
+		{
+			states[i].layout = m_Resources[i].initialLayout;
+		}
+	}
+
+	// 摜͑O̎s̍Ō̎gpn܂܂i摜𖈉g߁AFt[Ɓj
+	// each physical image starts from its last use in the previous execution, since the same image is reused every time
+	for (size_t i = 0; i < m_PhysicalImages.size(); i++)
+	{
+		states[m_Resources.size() + i] = getLastUseState(m_PhysicalImages[i].lastResource);
+	}
+
+	for (uint32_t passIndex = 0; passIndex < m_Passes.size(); passIndex++)
+	{
+		Pass& pass = m_Passes[passIndex];
+		pass.barriers = BarrierBatch{};
+
+		// pXł̓\[X̎g͂܂Ƃ߂܂iFXg[W̓ǂݍ݁{݁j
+		// several uses of one resource in a pass are merged, e.g. a storage read plus write
+		std::vector<ResourceHandle> resources;
+		std::vector<UsageInfo> infos;
+		for (const Use& use : pass.uses)
+		{
+			const UsageInfo info = getUsageInfo(use.usage);
+			const auto it = std::find(resources.begin(), resources.end(), use.resource);
+			if (it == resources.end())
+			{
+				resources.push_back(use.resource);
+				infos.push_back(info);
+				continue;
+			}
+
+			UsageInfo& merged = infos[it - resources.begin()];
+			if (m_Resources[use.resource].isImage && merged.layout != info.layout)
+			{
+				throw std::runtime_error("Render graph pass '" + pass.name + "' uses image '"
+					+ m_Resources[use.resource].name + "' in two layouts!");
+			}
+			merged.stages |= info.stages;
+			merged.access |= info.access;
+		}
+
+		for (size_t i = 0; i < resources.size(); i++)
+		{
+			const Resource& resource = m_Resources[resources[i]];
+			SyncState& state = states[getStateIndex(resources[i])];
+
+			// L摜̍ŏ̎gpFO̎̓e͔jiUNDEFINEDjA̎gp͑҂܂
+			// first use of an aliased image: discard the previous occupant's contents but still wait on its work
+			if (resource.transient && resource.firstPass == passIndex)
+			{
+				state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			}
+
+			addBarrier(pass.barriers, resource, state, infos[i].stages, infos[i].access, infos[i].layout);
+		}
+	}
+
+	// O摜w肳ꂽŏICAEg
+	// move imported images to their requested final layout
+	m_FinalBarriers = BarrierBatch{};
+	for (size_t i = 0; i < m_Resources.size(); i++)
+	{
+		const Resource& resource = m_Resources[i];
+		if (!resource.isImage || resource.transient || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED
+			|| resource.finalLayout == states[i].layout)
+		{
+			continue;
+		}
+
+		// \BOTTOM_OF_PIPEiZ}tHœjAȊO̓OtO̎̎gp킩ȂߑSR}h
+		// presentation syncs through a semaphore; anything else has an unknown consumer outside the graph
+		const bool present = resource.finalLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		addBarrier(m_FinalBarriers, resource, states[i],
+			present ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			present ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+			resource.finalLayout);
+	}
+}
+
+void CRenderGraph::execute(VkCommandBuffer commandBuffer) const
+{
+	for (const Pass& pass : m_Passes)
+	{
+		pass.barriers.record(commandBuffer);
+		if (pass.callback)
+		{
+			pass.callback(commandBuffer);
+		}
+	}
+
+	m_FinalBarriers.record(commandBuffer);
+}
+
+size_t CRenderGraph::getBarrierCount() const
+{
+	size_t count = m_FinalBarriers.empty() ? 0 : 1;
+	for (const Pass& pass : m_Passes)
+	{
+		if (!pass.barriers.empty())
+		{
+			count++;
+		}
+	}
+	return count;
+}
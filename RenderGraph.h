@@ -0,0 +1,174 @@
+/*======================================================================
+Vulkan Presentation : RenderGraph.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+// \[X̎gFXe[WEANZXECAEg͂猈܂܂
+// How a pass uses a resource; the stage, access mask and image layout all follow from it
+enum class ResourceUsage
+{
+	TransferRead,
+	TransferWrite,
+	VertexBufferRead,        // _ECX^Xobt@[
+	IndexBufferRead,
+	IndirectRead,            // Ԑڕ`R}h
+	VertexShaderRead,        // UBOETvOi_VF[_[j
+	FragmentShaderRead,      // UBOETvOitOgVF[_[j
+	ComputeRead,             // UBOEXg[WETvOiRs[gj
+	ComputeWrite,            // Xg[WiǂݏAatomic܂ށj
+	ColorAttachmentWrite,
+	DepthAttachmentWrite,
+	DepthAttachmentRead,
+	Present
+};
+
+// gWFg摜̎dlFdlŎdȂȂ摜1̕摜L܂
+// Transient image description; transients with equal descriptions and disjoint lifetimes share one physical image
+struct RenderGraphImageDesc
+{
+	VkFormat              format = VK_FORMAT_UNDEFINED;
+	VkExtent2D            extent = { 0, 0 };
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	VkImageUsageFlags     usage = 0;
+	VkImageAspectFlags    aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	uint32_t              mipLevels = 1;
+
+	bool operator==(const RenderGraphImageDesc& other) const;
+};
+
+// pXÕoAF1vkCmdPipelineBarrier()ɂ܂Ƃ߂܂
+// Barriers ahead of a pass, merged into a single vkCmdPipelineBarrier()
+struct BarrierBatch
+{
+	VkPipelineStageFlags               srcStageMask = 0;
+	VkPipelineStageFlags               dstStageMask = 0;
+	std::vector<VkImageMemoryBarrier>  imageBarriers;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	std::vector<uint32_t>              imagePhysicalIndices;    // imageBarriersƓFgWFg̕摜iOUINT32_MAXj
+
+	bool empty() const { return imageBarriers.empty() && bufferBarriers.empty(); }
+	void record(VkCommandBuffer commandBuffer) const;
+};
+
+// _[OtFpX\[X̓ǂݏ錾ƁAoAƃgWFg摜̋LŌ߂܂
+// Render graph: passes declare how they use resources; the graph derives the barriers and aliases transient images
+// compile()CPÛ݁iGPUȂŃeXg\jAexecute()ŃR}hobt@[ɓo^܂
+// compile() is CPU-only (testable without a GPU); execute() records into a command buffer
+class CRenderGraph
+{
+public:
+
+	typedef uint32_t ResourceHandle;
+	typedef std::function<void(VkCommandBuffer)> PassCallback;
+
+	void reset();
+
+	// O\[XFnh2o^ƓResourceHandleԂ܂
+	// external resources; importing the same handle twice returns the same ResourceHandle
+	ResourceHandle importBuffer(const std::string& name, VkBuffer buffer);
+	ResourceHandle importImage(const std::string& name, VkImage image, VkImageAspectFlags aspect, uint32_t mipLevels,
+		VkImageLayout currentLayout, VkImageLayout finalLayout);
+
+	// gWFg摜FOtł̂ݎgAŏ̎gpœe͔j܂
+	// transient image: only lives inside the graph; contents are undefined at its first use
+	//   摜͎s܂ōėp̂ŁAŏ̎gp͑O̎sł̍Ō̎gp҂܂
+	//   physical images are reused from one execution to the next, so the first use waits on the last use of the previous one
+	ResourceHandle createTransientImage(const std::string& name, const RenderGraphImageDesc& desc);
+
+	// pXFcallbacknullptȑꍇ̓oÂ݁iĂяǒɓo^j
+	// a pass with no callback only emits its barriers; the caller records the work right after execute()
+	uint32_t addPass(const std::string& name, PassCallback callback);
+	void use(uint32_t pass, ResourceHandle resource, ResourceUsage usage);
+
+	void compile();
+	void execute(VkCommandBuffer commandBuffer) const;
+
+	// compile()̌
+	// results of compile()
+	const BarrierBatch& getPassBarriers(uint32_t pass) const { return m_Passes[pass].barriers; }
+	const BarrierBatch& getFinalBarriers() const { return m_FinalBarriers; }
+	size_t getBarrierCount() const;
+
+	// FŏƍŌɎgpXiuse()Ō܂܂AgpfirstPass = UINT32_MAXj
+	// lifetime: the first and last pass that use the resource, as declared through use(); UINT32_MAX when unused
+	uint32_t getFirstPass(ResourceHandle resource) const { return m_Resources[resource].firstPass; }
+	uint32_t getLastPass(ResourceHandle resource) const { return m_Resources[resource].lastPass; }
+
+	uint32_t getPhysicalImageCount() const { return static_cast<uint32_t>(m_PhysicalImages.size()); }
+	const RenderGraphImageDesc& getPhysicalImageDesc(uint32_t physicalIndex) const { return m_PhysicalImages[physicalIndex].desc; }
+	uint32_t getPhysicalImageIndex(ResourceHandle resource) const { return m_Resources[resource].physicalIndex; }
+	void setPhysicalImage(uint32_t physicalIndex, VkImage image);    // compile()̌AgWFg摜̎̂n܂
+
+private:
+
+	struct Resource
+	{
+		std::string          name;
+		bool                 isImage = false;
+		bool                 transient = false;
+		VkBuffer             buffer = VK_NULL_HANDLE;
+		VkImage              image = VK_NULL_HANDLE;
+		VkImageAspectFlags   aspect = 0;
+		uint32_t             mipLevels = 1;
+		VkImageLayout        initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout        finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;    // UNDEFINEDFŌ̑JڂȂ
+		RenderGraphImageDesc desc;
+		uint32_t             physicalIndex = UINT32_MAX;                 // gWFĝ
+		uint32_t             firstPass = UINT32_MAX;
+		uint32_t             lastPass = 0;
+	};
+
+	struct Use
+	{
+		ResourceHandle resource;
+		ResourceUsage  usage;
+	};
+
+	struct Pass
+	{
+		std::string      name;
+		PassCallback     callback;
+		std::vector<Use> uses;
+		BarrierBatch     barriers;
+	};
+
+	// \[XƂ̓ԁigWFg͋L镨摜Ɓj
+	// synchronization state per physical resource (aliased transients share one)
+	struct SyncState
+	{
+		VkPipelineStageFlags writeStages = 0;     // Ō̏
+		VkAccessFlags        writeAccess = 0;
+		VkPipelineStageFlags readStages = 0;      // Ō݈̏ȍ~̓ǂݍ
+		VkPipelineStageFlags visibleStages = 0;   // ݂悤ɂȂXe[WEANZX
+		VkAccessFlags        visibleAccess = 0;
+		VkImageLayout        layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	};
+
+	struct PhysicalImage
+	{
+		RenderGraphImageDesc desc;
+		uint32_t             lastPass;
+		ResourceHandle       lastResource;    // ŌɎggWFgi̎s̍ŏ̎gp҂j
+		VkImage              image = VK_NULL_HANDLE;
+	};
+
+	void assignPhysicalImages();
+	SyncState getLastUseState(ResourceHandle resource) const;
+	void addBarrier(BarrierBatch& batch, const Resource& resource, SyncState& state,
+		VkPipelineStageFlags dstStages, VkAccessFlags dstAccess, VkImageLayout newLayout) const;
+	uint32_t getStateIndex(ResourceHandle resource) const;
+
+	std::vector<Resource>      m_Resources;
+	std::vector<Pass>          m_Passes;
+	std::vector<PhysicalImage> m_PhysicalImages;
+	BarrierBatch               m_FinalBarriers;    // O摜ŏICAEg
+};
@@ -0,0 +1,624 @@
+/*======================================================================
+Vulkan Presentation : ShaderReflection.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "ShaderReflection.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// SPIR-Vdl̒liKvȂ̂̂݁j
+// values from the SPIR-V specification, only the ones this parser needs
+namespace SpirV
+{
+	const uint32_t MAGIC_NUMBER = 0x07230203;
+	const uint32_t HEADER_WORDS = 5;
+
+	enum Op : uint32_t
+	{
+		OpEntryPoint = 15,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+	};
+
+	enum Decoration : uint32_t
+	{
+		Block = 2,
+		BufferBlock = 3,
+		ArrayStride = 6,
+		MatrixStride = 7,
+		BuiltIn = 11,
+		Location = 30,
+		Binding = 33,
+		DescriptorSet = 34,
+		Offset = 35,
+	};
+
+	enum StorageClass : uint32_t
+	{
+		UniformConstant = 0,
+		Input = 1,
+		Uniform = 2,
+		PushConstant = 9,
+		StorageBuffer = 12,
+	};
+
+	enum Dim : uint32_t
+	{
+		DimBuffer = 5,
+		DimSubpassData = 6,
+	};
+}
+
+namespace
+{
+	// ͒̃W[FIDƂ̌^߁EfR[V
+	// module being parsed: type instructions and decorations per result id
+	struct Module
+	{
+		std::unordered_map<uint32_t, std::vector<uint32_t>>           types;              // ID  ߁iIyR[h{Iyhj
+		std::unordered_map<uint32_t, uint32_t>                        constants;          // ID  32rbgl
+		std::unordered_map<uint32_t, std::map<uint32_t, uint32_t>>    decorations;        // ID  fR[V  l
+		std::unordered_map<uint32_t, std::map<uint32_t, uint32_t>>    memberOffsets;      // \ID  o[  Offset
+		std::unordered_map<uint32_t, std::map<uint32_t, uint32_t>>    memberMatrixStrides;
+
+		bool hasDecoration(uint32_t id, uint32_t decoration) const
+		{
+			auto it = decorations.find(id);
+			return it != decorations.end() && it->second.count(decoration) > 0;
+		}
+
+		uint32_t getDecoration(uint32_t id, uint32_t decoration, uint32_t defaultValue) const
+		{
+			auto it = decorations.find(id);
+			if (it == decorations.end())
+			{
+				return defaultValue;
+			}
+			auto value = it->second.find(decoration);
+			return (value != it->second.end()) ? value->second : defaultValue;
+		}
+
+		const std::vector<uint32_t>& getType(uint32_t id) const
+		{
+			auto it = types.find(id);
+			if (it == types.end())
+			{
+				throw std::runtime_error("SPIR-V reflection: unknown type id " + std::to_string(id) + "!");
+			}
+			return it->second;
+		}
+
+		uint32_t getArrayLength(const std::vector<uint32_t>& arrayType) const
+		{
+			auto it = constants.find(arrayType[3]);
+			return (it != constants.end()) ? it->second : 1;
+		}
+	};
+
+	// ^̃oCgTCYivbV萔ubNpFOffsetEMatrixStrideEArrayStridẽfR[Vɏ]܂j
+	// byte size of a type, following the Offset/MatrixStride/ArrayStride decorations of the block
+	uint32_t getTypeSize(const Module& module, uint32_t typeId, uint32_t matrixStride = 0)
+	{
+		const std::vector<uint32_t>& type = module.getType(typeId);
+		switch (type[0])
+		{
+		case SpirV::OpTypeInt:
+		case SpirV::OpTypeFloat:
+			return type[2] / 8;
+
+		case SpirV::OpTypeVector:
+			return type[3] * getTypeSize(module, type[2]);
+
+		case SpirV::OpTypeMatrix:
+			return type[3] * ((matrixStride != 0) ? matrixStride : getTypeSize(module, type[2]));
+
+		case SpirV::OpTypeArray:
+		{
+			const uint32_t stride = module.getDecoration(typeId, SpirV::ArrayStride, 0);
+			return module.getArrayLength(type) * ((stride != 0) ? stride : getTypeSize(module, type[2], matrixStride));
+		}
+
+		case SpirV::OpTypeRuntimeArray:
+			return 0;
+
+		case SpirV::OpTypeStruct:
+		{
+			uint32_t size = 0;
+			for (uint32_t member = 0; member + 2 < type.size(); member++)
+			{
+				auto offsets = module.memberOffsets.find(typeId);
+				auto strides = module.memberMatrixStrides.find(typeId);
+				const uint32_t offset = (offsets != module.memberOffsets.end() && offsets->second.count(member) > 0) ? offsets->second.at(member) : size;
+				const uint32_t stride = (strides != module.memberMatrixStrides.end() && strides->second.count(member) > 0) ? strides->second.at(member) : 0;
+				size = std::max(size, offset + getTypeSize(module, type[2 + member], stride));
+			}
+			return size;
+		}
+
+		default:
+			throw std::runtime_error("SPIR-V reflection: unsupported type in push constant block!");
+		}
+	}
+
+	// _͂̃tH[}bgF32rbg̃XJ[ExNĝ
+	// vertex input format; 32-bit scalars and vectors only
+	VkFormat getVertexFormat(const Module& module, const std::vector<uint32_t>& type)
+	{
+		uint32_t componentCount = 1;
+		const std::vector<uint32_t>* componentType = &type;
+		if (type[0] == SpirV::OpTypeVector)
+		{
+			componentCount = type[3];
+			componentType = &module.getType(type[2]);
+		}
+
+		if ((*componentType)[2] != 32)
+		{
+			throw std::runtime_error("SPIR-V reflection: only 32-bit vertex inputs are supported!");
+		}
+
+		static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+		static const VkFormat sintFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+		static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+		if ((*componentType)[0] == SpirV::OpTypeFloat)
+		{
+			return floatFormats[componentCount - 1];
+		}
+		return ((*componentType)[3] != 0) ? sintFormats[componentCount - 1] : uintFormats[componentCount - 1];
+	}
+
+	uint32_t getFormatSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R32_SFLOAT:          case VK_FORMAT_R32_SINT:          case VK_FORMAT_R32_UINT:          return 4;
+		case VK_FORMAT_R32G32_SFLOAT:       case VK_FORMAT_R32G32_SINT:       case VK_FORMAT_R32G32_UINT:       return 8;
+		case VK_FORMAT_R32G32B32_SFLOAT:    case VK_FORMAT_R32G32B32_SINT:    case VK_FORMAT_R32G32B32_UINT:    return 12;
+		case VK_FORMAT_R32G32B32A32_SFLOAT: case VK_FORMAT_R32G32B32A32_SINT: case VK_FORMAT_R32G32B32A32_UINT: return 16;
+		default: return 0;
+		}
+	}
+
+	VkShaderStageFlagBits getStage(uint32_t executionModel)
+	{
+		switch (executionModel)
+		{
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+		default:
+			throw std::runtime_error("SPIR-V reflection: unsupported execution model!");
+		}
+	}
+
+	// ϐ̌^fXNv^[̎ނ𔻒f܂
+	// descriptor type from the variable's pointee type and storage class
+	VkDescriptorType getDescriptorType(const Module& module, uint32_t typeId, uint32_t storageClass)
+	{
+		const std::vector<uint32_t>& type = module.getType(typeId);
+		switch (type[0])
+		{
+		case SpirV::OpTypeStruct:
+			if (storageClass == SpirV::StorageBuffer || module.hasDecoration(typeId, SpirV::BufferBlock))
+			{
+				return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			}
+			return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+		case SpirV::OpTypeSampledImage:
+			return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+		case SpirV::OpTypeSampler:
+			return VK_DESCRIPTOR_TYPE_SAMPLER;
+
+		case SpirV::OpTypeImage:
+			// SampledF1 = TvOpA2 = Xg[WC[W
+			// Sampled operand: 1 = used with a sampler, 2 = storage image
+			if (type[3] == SpirV::DimSubpassData)
+			{
+				return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			}
+			if (type[3] == SpirV::DimBuffer)
+			{
+				return (type[7] == 2) ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+			return (type[7] == 2) ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+
+		default:
+			throw std::runtime_error("SPIR-V reflection: unsupported descriptor type!");
+		}
+	}
+}
+
+//====================================================================================
+// 10X : SPIR-V
+// SPIR-V Parsing
+//====================================================================================
+
+CShaderReflection CShaderReflection::reflect(const std::vector<char>& code)
+{
+	if (code.size() % sizeof(uint32_t) != 0 || code.size() < SpirV::HEADER_WORDS * sizeof(uint32_t))
+	{
+		throw std::runtime_error("SPIR-V reflection: invalid module size!");
+	}
+
+	std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+	std::copy(code.begin(), code.end(), reinterpret_cast<char*>(words.data()));
+	if (words[0] != SpirV::MAGIC_NUMBER)
+	{
+		throw std::runtime_error("SPIR-V reflection: invalid magic number!");
+	}
+
+	// 1ڂ̑F^E萔EfR[VEϐW߂܂iϐ͌^SĂ珈j
+	// first pass: collect types, constants, decorations and variables; variables are resolved once every type is known
+	Module module;
+	CShaderReflection reflection;
+	std::vector<std::vector<uint32_t>> variables;
+
+	size_t position = SpirV::HEADER_WORDS;
+	while (position < words.size())
+	{
+		const uint32_t wordCount = words[position] >> 16;
+		const uint32_t opcode = words[position] & 0xFFFF;
+		if (wordCount == 0 || position + wordCount > words.size())
+		{
+			throw std::runtime_error("SPIR-V reflection: truncated instruction!");
+		}
+
+		// operands[0]FIyR[hAȍ~̓Iyh
+		// operands[0] holds the opcode, the operands follow
+		std::vector<uint32_t> operands(words.begin() + position, words.begin() + position + wordCount);
+		operands[0] = opcode;
+
+		switch (opcode)
+		{
+		case SpirV::OpEntryPoint:
+			reflection.m_Stages |= getStage(operands[1]);
+			break;
+
+		case SpirV::OpTypeInt:
+		case SpirV::OpTypeFloat:
+		case SpirV::OpTypeVector:
+		case SpirV::OpTypeMatrix:
+		case SpirV::OpTypeImage:
+		case SpirV::OpTypeSampler:
+		case SpirV::OpTypeSampledImage:
+		case SpirV::OpTypeArray:
+		case SpirV::OpTypeRuntimeArray:
+		case SpirV::OpTypeStruct:
+		case SpirV::OpTypePointer:
+			module.types[operands[1]] = operands;
+			break;
+
+		case SpirV::OpConstant:
+			module.constants[operands[2]] = operands[3];
+			break;
+
+		case SpirV::OpDecorate:
+			module.decorations[operands[1]][operands[2]] = (wordCount > 3) ? operands[3] : 0;
+			break;
+
+		case SpirV::OpMemberDecorate:
+			if (operands[3] == SpirV::Offset)
+			{
+				module.memberOffsets[operands[1]][operands[2]] = operands[4];
+			}
+			else if (operands[3] == SpirV::MatrixStride)
+			{
+				module.memberMatrixStrides[operands[1]][operands[2]] = operands[4];
+			}
+			break;
+
+		case SpirV::OpVariable:
+			variables.push_back(operands);
+			break;
+		}
+
+		position += wordCount;
+	}
+
+	// 2ځFϐƂɃfXNv^[EvbV萔E_͂܂
+	// second pass: turn each variable into a descriptor, push constant range or vertex input
+	for (const std::vector<uint32_t>& variable : variables)
+	{
+		const uint32_t variableId = variable[2];
+		const uint32_t storageClass = variable[3];
+		const std::vector<uint32_t>& pointerType = module.getType(variable[1]);
+		const uint32_t typeId = pointerType[3];
+
+		if (storageClass == SpirV::UniformConstant || storageClass == SpirV::Uniform || storageClass == SpirV::StorageBuffer)
+		{
+			// z̏ꍇdescriptorCount = z̒i^Cz1j
+			// arrays of resources become descriptorCount (1 for runtime arrays)
+			uint32_t resourceTypeId = typeId;
+			uint32_t descriptorCount = 1;
+			const std::vector<uint32_t>& type = module.getType(typeId);
+			if (type[0] == SpirV::OpTypeArray || type[0] == SpirV::OpTypeRuntimeArray)
+			{
+				descriptorCount = (type[0] == SpirV::OpTypeArray) ? module.getArrayLength(type) : 1;
+				resourceTypeId = type[2];
+			}
+
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = module.getDecoration(variableId, SpirV::Binding, 0);
+			binding.descriptorType = getDescriptorType(module, resourceTypeId, storageClass);
+			binding.descriptorCount = descriptorCount;
+			binding.stageFlags = reflection.m_Stages;
+			binding.pImmutableSamplers = nullptr;
+
+			const uint32_t set = module.getDecoration(variableId, SpirV::DescriptorSet, 0);
+			reflection.m_Sets[set].push_back(binding);
+		}
+		else if (storageClass == SpirV::PushConstant)
+		{
+			// ubN̍ŏ̃o[OffsetŌ̃o[̏I܂
+			// from the first member's offset to the end of the last member
+			uint32_t firstOffset = 0;
+			auto offsets = module.memberOffsets.find(typeId);
+			if (offsets != module.memberOffsets.end() && offsets->second.empty() == false)
+			{
+				firstOffset = UINT32_MAX;
+				for (const auto& offset : offsets->second)
+				{
+					firstOffset = std::min(firstOffset, offset.second);
+				}
+			}
+
+			reflection.m_PushConstantRange.stageFlags = reflection.m_Stages;
+			reflection.m_PushConstantRange.offset = firstOffset;
+			reflection.m_PushConstantRange.size = getTypeSize(module, typeId) - firstOffset;
+		}
+		else if (storageClass == SpirV::Input && (reflection.m_Stages & VK_SHADER_STAGE_VERTEX_BIT)
+			&& module.hasDecoration(variableId, SpirV::BuiltIn) == false)
+		{
+			// sEz͘A郍P[Vg܂imat4F4P[Vj
+			// matrices and arrays take consecutive locations (a mat4 uses four)
+			uint32_t location = module.getDecoration(variableId, SpirV::Location, 0);
+			uint32_t elementCount = 1;
+			const std::vector<uint32_t>* type = &module.getType(typeId);
+			if ((*type)[0] == SpirV::OpTypeArray)
+			{
+				elementCount = module.getArrayLength(*type);
+				type = &module.getType((*type)[2]);
+			}
+
+			uint32_t columnCount = 1;
+			if ((*type)[0] == SpirV::OpTypeMatrix)
+			{
+				columnCount = (*type)[3];
+				type = &module.getType((*type)[2]);
+			}
+
+			const VkFormat format = getVertexFormat(module, *type);
+			for (uint32_t i = 0; i < elementCount * columnCount; i++)
+			{
+				VkVertexInputAttributeDescription attribute{};
+				attribute.location = location++;
+				attribute.format = format;
+				reflection.m_VertexInputs.push_back(attribute);
+			}
+		}
+	}
+
+	for (auto& set : reflection.m_Sets)
+	{
+		std::sort(set.second.begin(), set.second.end(),
+			[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+	}
+	std::sort(reflection.m_VertexInputs.begin(), reflection.m_VertexInputs.end(),
+		[](const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b) { return a.location < b.location; });
+
+	return reflection;
+}
+
+void CShaderReflection::merge(const CShaderReflection& other)
+{
+	m_Stages |= other.m_Stages;
+
+	for (const auto& otherSet : other.m_Sets)
+	{
+		std::vector<VkDescriptorSetLayoutBinding>& bindings = m_Sets[otherSet.first];
+		for (const VkDescriptorSetLayoutBinding& otherBinding : otherSet.second)
+		{
+			auto it = std::find_if(bindings.begin(), bindings.end(),
+				[&](const VkDescriptorSetLayoutBinding& binding) { return binding.binding == otherBinding.binding; });
+			if (it == bindings.end())
+			{
+				bindings.push_back(otherBinding);
+				continue;
+			}
+
+			if (it->descriptorType != otherBinding.descriptorType || it->descriptorCount != otherBinding.descriptorCount)
+			{
+				throw std::runtime_error("SPIR-V reflection: set " + std::to_string(otherSet.first) + " binding "
+					+ std::to_string(otherBinding.binding) + " differs between shader stages!");
+			}
+			it->stageFlags |= otherBinding.stageFlags;
+		}
+
+		std::sort(bindings.begin(), bindings.end(),
+			[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+	}
+
+	// vbV萔FSXe[WJo[1͈̔
+	// push constants: one range covering every stage's block
+	if (other.m_PushConstantRange.size > 0)
+	{
+		if (m_PushConstantRange.size == 0)
+		{
+			m_PushConstantRange = other.m_PushConstantRange;
+		}
+		else
+		{
+			const uint32_t end = std::max(m_PushConstantRange.offset + m_PushConstantRange.size,
+				other.m_PushConstantRange.offset + other.m_PushConstantRange.size);
+			m_PushConstantRange.offset = std::min(m_PushConstantRange.offset, other.m_PushConstantRange.offset);
+			m_PushConstantRange.size = end - m_PushConstantRange.offset;
+			m_PushConstantRange.stageFlags |= other.m_PushConstantRange.stageFlags;
+		}
+	}
+
+	// _͂͒_VF[_[̂
+	// only the vertex stage has vertex inputs
+	if (m_VertexInputs.empty())
+	{
+		m_VertexInputs = other.m_VertexInputs;
+	}
+}
+
+//====================================================================================
+// 20X : CAEgE_͂̐
+// Layout and Vertex Input Generation
+//====================================================================================
+
+const std::vector<VkDescriptorSetLayoutBinding>& CShaderReflection::getBindings(uint32_t set) const
+{
+	static const std::vector<VkDescriptorSetLayoutBinding> noBindings;
+	auto it = m_Sets.find(set);
+	return (it != m_Sets.end()) ? it->second : noBindings;
+}
+
+void CShaderReflection::getVertexInput(const std::vector<VertexInputBinding>& layout,
+	std::vector<VkVertexInputBindingDescription>& bindings,
+	std::vector<VkVertexInputAttributeDescription>& attributes) const
+{
+	bindings.clear();
+	attributes.clear();
+
+	for (size_t i = 0; i < layout.size(); i++)
+	{
+		const uint32_t endLocation = (i + 1 < layout.size()) ? layout[i + 1].firstLocation : UINT32_MAX;
+
+		VkVertexInputBindingDescription binding{};
+		binding.binding = layout[i].binding;
+		binding.inputRate = layout[i].inputRate;
+
+		for (const VkVertexInputAttributeDescription& input : m_VertexInputs)
+		{
+			if (input.location < layout[i].firstLocation || input.location >= endLocation)
+			{
+				continue;
+			}
+
+			VkVertexInputAttributeDescription attribute = input;
+			attribute.binding = binding.binding;
+			attribute.offset = binding.stride;
+			attributes.push_back(attribute);
+			binding.stride += getFormatSize(input.format);
+		}
+
+		// C++̍\̂ƃVF[_[ĂȂmF܂
+		// catch drift between the C++ struct and the shader declarations
+		if (layout[i].expectedStride != 0 && binding.stride != layout[i].expectedStride)
+		{
+			throw std::runtime_error("Vertex input binding " + std::to_string(binding.binding) + " is "
+				+ std::to_string(binding.stride) + " bytes in the shader but "
+				+ std::to_string(layout[i].expectedStride) + " bytes on the CPU!");
+		}
+		bindings.push_back(binding);
+	}
+}
+
+void CShaderReflection::addPoolSizes(std::vector<VkDescriptorPoolSize>& poolSizes,
+	const std::vector<VkDescriptorSetLayoutBinding>& bindings, uint32_t setCount)
+{
+	for (const VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		auto it = std::find_if(poolSizes.begin(), poolSizes.end(),
+			[&](const VkDescriptorPoolSize& poolSize) { return poolSize.type == binding.descriptorType; });
+		if (it == poolSizes.end())
+		{
+			poolSizes.push_back({ binding.descriptorType, 0 });
+			it = poolSizes.end() - 1;
+		}
+		it->descriptorCount += binding.descriptorCount * setCount;
+	}
+}
+
+//====================================================================================
+// 30X : fXNv^[ZbgCAEgLbV
+// Descriptor Set Layout Cache
+//====================================================================================
+
+VkDescriptorSetLayout CDescriptorLayoutCache::getLayout(VkDevice device, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	const VkAllocationCallbacks* allocator)
+{
+	// FNV-1aio[ƁApfBO܂߂Ȃj
+	// FNV-1a over the members, never the struct padding
+	uint64_t hash = 14695981039346656037ull;
+	auto hashValue = [&hash](uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			hash ^= (value >> (i * 8)) & 0xFF;
+			hash *= 1099511628211ull;
+		}
+	};
+	for (const VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		hashValue(binding.binding);
+		hashValue(static_cast<uint32_t>(binding.descriptorType));
+		hashValue(binding.descriptorCount);
+		hashValue(binding.stageFlags);
+	}
+
+	auto range = m_Layouts.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		const std::vector<VkDescriptorSetLayoutBinding>& cached = it->second.bindings;
+		const bool equal = cached.size() == bindings.size() && std::equal(cached.begin(), cached.end(), bindings.begin(),
+			[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+			{
+				return a.binding == b.binding && a.descriptorType == b.descriptorType
+					&& a.descriptorCount == b.descriptorCount && a.stageFlags == b.stageFlags;
+			});
+		if (equal)
+		{
+			return it->second.layout;
+		}
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	CachedLayout cachedLayout;
+	cachedLayout.bindings = bindings;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, allocator, &cachedLayout.layout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create descriptor set layout!");
+	}
+
+	m_Layouts.emplace(hash, cachedLayout);
+	return cachedLayout.layout;
+}
+
+void CDescriptorLayoutCache::destroy(VkDevice device, const VkAllocationCallbacks* allocator)
+{
+	for (auto& layout : m_Layouts)
+	{
+		vkDestroyDescriptorSetLayout(device, layout.second.layout, allocator);
+	}
+	m_Layouts.clear();
+}
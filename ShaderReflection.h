@@ -0,0 +1,84 @@
+/*======================================================================
+Vulkan Presentation : ShaderReflection.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+
+// _oCfBO̊蓖āFfirstLocationȍ~̃P[VĩoCfBO܂Łj̃oCfBOɋl߂܂
+// Vertex binding assignment: locations from firstLocation up to the next binding are packed into this binding
+struct VertexInputBinding
+{
+	uint32_t          binding;
+	uint32_t          firstLocation;
+	VkVertexInputRate inputRate;
+	uint32_t          expectedStride;    // C++̍\̃TCYi0F`FbNȂj
+};
+
+// SPIR-VtNVFVF[_[̃oCi𒼐ډ͂āAfXNv^[EvbV萔E_͂o܂
+// SPIR-V reflection: parses the shader binary directly for descriptors, push constants and vertex inputs
+class CShaderReflection
+{
+public:
+
+	// readFile()œǂݍSPIR-V͂܂iXe[Wmerge()ōj
+	// parse a SPIR-V module as loaded by readFile(); combine stages with merge()
+	static CShaderReflection reflect(const std::vector<char>& code);
+
+	// oCfBO͎gXe[WORōA^Ⴄꍇ͗O
+	// the same binding in several stages ORs the stage flags; a type mismatch throws
+	void merge(const CShaderReflection& other);
+
+	VkShaderStageFlags getStages() const { return m_Stages; }
+	const std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>>& getSets() const { return m_Sets; }
+	const std::vector<VkDescriptorSetLayoutBinding>& getBindings(uint32_t set) const;
+	const VkPushConstantRange& getPushConstantRange() const { return m_PushConstantRange; }    // size 0FvbV萔Ȃ
+
+	// _́FP[VɃoCfBO֋l߂ăItZbgEXgCh߂܂
+	// vertex input: attributes are packed in location order to derive offsets and strides
+	void getVertexInput(const std::vector<VertexInputBinding>& layout,
+		std::vector<VkVertexInputBindingDescription>& bindings,
+		std::vector<VkVertexInputAttributeDescription>& attributes) const;
+
+	// fXNv^[v[TCYɉZisetCountF̃CAEgŊmۂZbgj
+	// add this set's descriptors to the pool sizes, times the number of sets allocated from it
+	static void addPoolSizes(std::vector<VkDescriptorPoolSize>& poolSizes,
+		const std::vector<VkDescriptorSetLayoutBinding>& bindings, uint32_t setCount);
+
+private:
+
+	VkShaderStageFlags                                            m_Stages = 0;
+	std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> m_Sets;                  // Zbgԍ  oCfBOioCfBOj
+	VkPushConstantRange                                           m_PushConstantRange{};
+	std::vector<VkVertexInputAttributeDescription>                m_VertexInputs;          // P[VibindingEoffset͖j
+};
+
+// fXNv^[ZbgCAEgLbVFoCfBÕCAEg̓nbVŋL܂
+// Descriptor set layout cache: identical binding lists share one VkDescriptorSetLayout, looked up by hash
+class CDescriptorLayoutCache
+{
+public:
+
+	VkDescriptorSetLayout getLayout(VkDevice device, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		const VkAllocationCallbacks* allocator = nullptr);
+	void destroy(VkDevice device, const VkAllocationCallbacks* allocator = nullptr);
+
+	size_t size() const { return m_Layouts.size(); }
+
+private:
+
+	struct CachedLayout
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		VkDescriptorSetLayout                     layout;
+	};
+
+	std::unordered_multimap<uint64_t, CachedLayout> m_Layouts;    // nbVՓ˂ꍇ̓oCfBOr܂
+};
@@ -3,17 +3,43 @@
 
 layout(binding = 1) uniform sampler2D texSampler;
 
+// per-draw data (DrawPushConstants); materialIndex selects the material once there is more than one
+layout(push_constant) uniform PushConstants
+{
+	mat4 model;
+	uint materialIndex;
+}pc;
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
+// specialization constants (ShaderFeatures), fixed per pipeline so the unused paths are compiled out
+layout(constant_id = 0) const uint TEXTURE_TILING = 1;       // texture repeat count (sampler uses REPEAT)
+layout(constant_id = 1) const bool USE_VERTEX_COLOR = false; // modulate the texture by the vertex color
+layout(constant_id = 2) const bool ALPHA_TEST = false;       // discard fragments with alpha below 0.5
+layout(constant_id = 3) const bool DEBUG_UV = false;         // Green: Horizontal,  Red: Vertical
+
 // main shader code
 void main() {	
 
-	outColor = texture(texSampler, fragTexCoord);
+	if (DEBUG_UV)
+	{
+		outColor = vec4(fragTexCoord, 0.0, 1.0);
+		return;
+	}
+
+	outColor = texture(texSampler, fragTexCoord * float(TEXTURE_TILING));
+
+	if (USE_VERTEX_COLOR)
+	{
+		outColor.rgb *= fragColor;
+	}
 
-	// outColor = vec4(fragTexCoord, 0.0, 1.0);               // Green: Horizontal,  Red: Vertical
-    // outColor = texture(texSampler, fragTexCoord * 2.0);    // Tiling
+	if (ALPHA_TEST && outColor.a < 0.5)
+	{
+		discard;
+	}
 }
 
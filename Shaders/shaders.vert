@@ -3,20 +3,29 @@
 
 layout(binding = 0) uniform UniformBufferObject
 {
-	mat4 model;
 	mat4 view;
 	mat4 proj;
 }ubo;
 
+// per-draw data (DrawPushConstants), written into the command buffer
+layout(push_constant) uniform PushConstants
+{
+	mat4 model;
+	uint materialIndex;
+}pc;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+// per-instance model matrix (binding 1, VK_VERTEX_INPUT_RATE_INSTANCE); a mat4 takes locations 3-6
+layout(location = 3) in mat4 inInstanceModel;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * pc.model * inInstanceModel * vec4(inPosition, 1.0);
     fragColor = inColor;
 	fragTexCoord = inTexCoord;
 }
@@ -0,0 +1,100 @@
+/*======================================================================
+Vulkan Presentation : SnapshotMailbox.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+// XibvVbg̃[{bNXigvobt@[jFݑEǂݍݑꂼ1̃XbgA
+// 3ڂ̃XbgiŐVjƃCfbNX܂Bf[^̃Rs[͂܂
+// Triple-buffered snapshot mailbox: the writer and the reader each own one slot and swap indices with the
+// third (latest) slot, so snapshots are never copied and neither side touches the other's slot
+//   ݑ1܂ŁFǂݍݑŐV󂯎܂waitForConsumer()ő҂܂
+//   the writer runs at most one snapshot ahead; waitForConsumer() blocks until the latest one is taken
+template<typename T>
+class CSnapshotMailbox
+{
+public:
+
+	// ݑF̃Xbgɏłpublish()
+	// writer: fill this slot, then publish() it
+	T& getWriteSlot() { return m_Slots[m_WriteIndex]; }
+
+	void publish()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			std::swap(m_WriteIndex, m_LatestIndex);
+			m_HasLatest = true;
+		}
+		m_Condition.notify_all();
+	}
+
+	// ǂݍݑŐV󂯎܂ő҂܂iclose()ꂽꍇfalsej
+	// wait until the reader has taken the latest snapshot; false once close() has been called
+	bool waitForConsumer()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Condition.wait(lock, [this]() { return m_Closed || m_HasLatest == false; });
+		return m_Closed == false;
+	}
+
+	// ǂݍݑFVXibvVbgΎ󂯎AȂΑỐiwaitFV̂҂j
+	// reader: take the newest snapshot if there is one, otherwise keep the previous; wait blocks for a new one
+	// ߂l͎acquire()܂ŗLAclose()ɉ󂯎ĂȂnullptr
+	// the result stays valid until the next acquire(); nullptr if closed before anything was published
+	const T* acquire(bool wait)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			if (wait)
+			{
+				m_Condition.wait(lock, [this]() { return m_Closed || m_HasLatest; });
+			}
+			if (m_HasLatest)
+			{
+				std::swap(m_ReadIndex, m_LatestIndex);
+				m_HasLatest = false;
+				m_HasRead = true;
+			}
+		}
+		m_Condition.notify_all();
+		return m_HasRead ? &m_Slots[m_ReadIndex] : nullptr;
+	}
+
+	// ҋ@̏ݑEǂݍݑNďI܂
+	// wake both sides and make their waits return
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Closed = true;
+		}
+		m_Condition.notify_all();
+	}
+
+	// ̏Ԃɖ߂܂iǂ̃XbhgĂȂ̂݁j
+	// back to empty; only while neither side is using the mailbox
+	void reset()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_HasLatest = false;
+		m_HasRead = false;
+		m_Closed = false;
+	}
+
+private:
+
+	T                       m_Slots[3];
+	int                     m_WriteIndex = 0;     // ݑ̂
+	int                     m_LatestIndex = 1;    // m_Mutexŕی
+	int                     m_ReadIndex = 2;      // ǂݍݑ̂
+	bool                    m_HasLatest = false;  // m_LatestIndex
+	bool                    m_HasRead = false;    // ǂݍݑ̃XbgɗLȃXibvVbg
+	bool                    m_Closed = false;
+	std::mutex              m_Mutex;
+	std::condition_variable m_Condition;
+};
@@ -0,0 +1,557 @@
+/*======================================================================
+Vulkan Presentation : RenderGraphTest.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+// CRenderGraphCPÛ݂̃eXgiGPUEVulkan[_[svAwb_[̂ݎgpj
+// CPU-only tests for CRenderGraph; needs the Vulkan headers but neither a GPU nor the loader
+#include "RenderGraph.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+	int g_Failures = 0;
+
+	// vkCmdPipelineBarrier()̑FBarrierBatch::record()̌Ăяo𐔂܂
+	// stands in for vkCmdPipelineBarrier() so that BarrierBatch::record() can be checked
+	uint32_t g_RecordedCalls = 0;
+	uint32_t g_RecordedBufferBarriers = 0;
+	uint32_t g_RecordedImageBarriers = 0;
+
+	// fBXpb`nh32rbgł͐Ȃ̂ŁACLXg
+	// non-dispatchable handles are integers on 32-bit targets, hence the C casts
+	const VkBuffer BUFFER_A = (VkBuffer)0x10;
+	const VkBuffer BUFFER_B = (VkBuffer)0x20;
+	const VkBuffer BUFFER_C = (VkBuffer)0x30;
+	const VkImage  IMAGE_A = (VkImage)0x40;
+	const VkImage  IMAGE_B = (VkImage)0x48;
+	const VkCommandBuffer COMMAND_BUFFER = (VkCommandBuffer)0x50;
+
+	const VkAccessFlags SHADER_READ_ACCESS = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+
+	// gWFg摜̎dliMSAÃJ[EfvXƓ`j
+	// transient descriptions shaped like the renderer's MSAA color and depth attachments
+	RenderGraphImageDesc colorDesc()
+	{
+		RenderGraphImageDesc desc;
+		desc.format = VK_FORMAT_B8G8R8A8_SRGB;
+		desc.extent = { 800, 600 };
+		desc.samples = VK_SAMPLE_COUNT_4_BIT;
+		desc.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		desc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+		return desc;
+	}
+
+	RenderGraphImageDesc depthDesc()
+	{
+		RenderGraphImageDesc desc = colorDesc();
+		desc.format = VK_FORMAT_D32_SFLOAT;
+		desc.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		desc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		return desc;
+	}
+}
+
+// CHECKFs𐔂đsAREQUIREFs炻̃eXg𒆎~i̓YANZX̑OɁj
+// CHECK counts a failure and carries on; REQUIRE also leaves the test, guarding the indexing that follows
+#define CHECK(condition) \
+	do { if (!(condition)) { std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; g_Failures++; } } while (0)
+#define REQUIRE(condition) \
+	do { if (!(condition)) { std::cerr << __FILE__ << ":" << __LINE__ << ": REQUIRE(" #condition ") failed" << std::endl; g_Failures++; return; } } while (0)
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags, VkPipelineStageFlags,
+	VkDependencyFlags, uint32_t, const VkMemoryBarrier*, uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier*,
+	uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier*)
+{
+	CHECK(commandBuffer == COMMAND_BUFFER);
+	g_RecordedCalls++;
+	g_RecordedBufferBarriers += bufferMemoryBarrierCount;
+	g_RecordedImageBarriers += imageMemoryBarrierCount;
+}
+
+//====================================================================================
+// 00X : obt@[iRAWEWAREWAWj
+// Buffers: RAW, WAR, WAW
+//====================================================================================
+
+// ݌̓ǂݍ݁F݂̃tbVƓǂݍ݂ւ̉
+// read after write flushes the write and makes it visible to the reader
+void testReadAfterWrite()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle buffer = graph.importBuffer("buffer", BUFFER_A);
+	const uint32_t write = graph.addPass("write", nullptr);
+	const uint32_t read = graph.addPass("read", nullptr);
+	graph.use(write, buffer, ResourceUsage::TransferWrite);
+	graph.use(read, buffer, ResourceUsage::ComputeRead);
+	graph.compile();
+
+	CHECK(graph.getPassBarriers(write).empty());    // ŏ̏݁F҂̂Ȃ
+
+	const BarrierBatch& barriers = graph.getPassBarriers(read);
+	CHECK(barriers.srcStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT);
+	CHECK(barriers.dstStageMask == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	REQUIRE(barriers.bufferBarriers.size() == 1);
+	CHECK(barriers.bufferBarriers[0].buffer == BUFFER_A);
+	CHECK(barriers.bufferBarriers[0].srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+	CHECK(barriers.bufferBarriers[0].dstAccessMask == SHADER_READ_ACCESS);
+	CHECK(graph.getBarrierCount() == 1);
+}
+
+// ɌĂ鏑݂̓ǂݍ݂̓oAȂAʂ̃Xe[W̓ǂݍ݂͒ǉ̃oA
+// a reader the write is already visible to needs no barrier; a reader in a new stage does
+void testRepeatedReads()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle buffer = graph.importBuffer("buffer", BUFFER_A);
+	const uint32_t write = graph.addPass("write", nullptr);
+	const uint32_t firstRead = graph.addPass("first read", nullptr);
+	const uint32_t secondRead = graph.addPass("second read", nullptr);
+	const uint32_t vertexRead = graph.addPass("vertex read", nullptr);
+	graph.use(write, buffer, ResourceUsage::ComputeWrite);
+	graph.use(firstRead, buffer, ResourceUsage::ComputeRead);
+	graph.use(secondRead, buffer, ResourceUsage::ComputeRead);
+	graph.use(vertexRead, buffer, ResourceUsage::VertexBufferRead);
+	graph.compile();
+
+	REQUIRE(graph.getPassBarriers(firstRead).bufferBarriers.size() == 1);
+	CHECK(graph.getPassBarriers(secondRead).empty());
+
+	const BarrierBatch& barriers = graph.getPassBarriers(vertexRead);
+	CHECK(barriers.srcStageMask == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	CHECK(barriers.dstStageMask == VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	REQUIRE(barriers.bufferBarriers.size() == 1);
+	CHECK(barriers.bufferBarriers[0].srcAccessMask == VK_ACCESS_SHADER_WRITE_BIT);
+	CHECK(barriers.bufferBarriers[0].dstAccessMask == VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+// ǂݍ݌̏݁Fǂݍ݂̃Xe[W҂sˑ̂݁isrcAccessMask0j
+// write after read is an execution dependency on the readers only, with an empty srcAccessMask
+void testWriteAfterRead()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle buffer = graph.importBuffer("buffer", BUFFER_A);
+	const uint32_t read = graph.addPass("read", nullptr);
+	const uint32_t write = graph.addPass("write", nullptr);
+	graph.use(read, buffer, ResourceUsage::IndirectRead);
+	graph.use(write, buffer, ResourceUsage::TransferWrite);
+	graph.compile();
+
+	CHECK(graph.getPassBarriers(read).empty());    // O\[X̍ŏ̓ǂݍ݁FOt݂̏Ȃ
+
+	const BarrierBatch& barriers = graph.getPassBarriers(write);
+	CHECK(barriers.srcStageMask == VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+	CHECK(barriers.dstStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT);
+	REQUIRE(barriers.bufferBarriers.size() == 1);
+	CHECK(barriers.bufferBarriers[0].srcAccessMask == 0);
+	CHECK(barriers.bufferBarriers[0].dstAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+}
+
+// ݌̏݁FȌ݂ƁǍ̓ǂݍ݂̗҂܂
+// write after write waits on the previous write and on every read since
+void testWriteAfterWrite()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle buffer = graph.importBuffer("buffer", BUFFER_A);
+	const uint32_t clear = graph.addPass("clear", nullptr);
+	const uint32_t read = graph.addPass("read", nullptr);
+	const uint32_t write = graph.addPass("write", nullptr);
+	graph.use(clear, buffer, ResourceUsage::TransferWrite);
+	graph.use(read, buffer, ResourceUsage::VertexBufferRead);
+	graph.use(write, buffer, ResourceUsage::ComputeWrite);
+	graph.compile();
+
+	const BarrierBatch& barriers = graph.getPassBarriers(write);
+	CHECK(barriers.srcStageMask == (VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT));
+	CHECK(barriers.dstStageMask == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	REQUIRE(barriers.bufferBarriers.size() == 1);
+	CHECK(barriers.bufferBarriers[0].srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+	CHECK(barriers.bufferBarriers[0].dstAccessMask == (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
+}
+
+//====================================================================================
+// 10X : oÂ܂Ƃ
+// Barrier merging
+//====================================================================================
+
+// 1̃pX̑SẴoA1̃ob`ivkCmdPipelineBarrier()1jɁA\[X̎̕g1̃oA
+// every barrier of a pass lands in one batch (one vkCmdPipelineBarrier()); several uses of one resource become one barrier
+void testBarrierMerging()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle indirect = graph.importBuffer("indirect", BUFFER_A);
+	const CRenderGraph::ResourceHandle uniforms = graph.importBuffer("uniforms", BUFFER_B);
+	const CRenderGraph::ResourceHandle instances = graph.importBuffer("instances", BUFFER_C);
+	CHECK(graph.importBuffer("indirect again", BUFFER_A) == indirect);    // nh͓\[X
+
+	const uint32_t reset = graph.addPass("reset", nullptr);
+	graph.use(reset, indirect, ResourceUsage::TransferWrite);
+	graph.use(reset, uniforms, ResourceUsage::TransferWrite);
+
+	const uint32_t cull = graph.addPass("cull", nullptr);
+	graph.use(cull, uniforms, ResourceUsage::ComputeRead);
+	graph.use(cull, indirect, ResourceUsage::ComputeRead);
+	graph.use(cull, indirect, ResourceUsage::ComputeWrite);
+	graph.use(cull, instances, ResourceUsage::ComputeRead);
+
+	const uint32_t draw = graph.addPass("draw", nullptr);
+	graph.use(draw, indirect, ResourceUsage::IndirectRead);
+	graph.use(draw, instances, ResourceUsage::VertexBufferRead);
+	graph.compile();
+
+	const BarrierBatch& barriers = graph.getPassBarriers(cull);
+	CHECK(barriers.srcStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT);
+	CHECK(barriers.dstStageMask == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	REQUIRE(barriers.bufferBarriers.size() == 2);    // uniformsEindirectiinstances̓Ot݂̏Ȃj
+	for (const VkBufferMemoryBarrier& barrier : barriers.bufferBarriers)
+	{
+		CHECK(barrier.srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+		if (barrier.buffer == BUFFER_A)
+		{
+			CHECK(barrier.dstAccessMask == (SHADER_READ_ACCESS | VK_ACCESS_SHADER_WRITE_BIT));
+		}
+		else
+		{
+			CHECK(barrier.buffer == BUFFER_B);
+			CHECK(barrier.dstAccessMask == SHADER_READ_ACCESS);
+		}
+	}
+
+	// instances̓Rs[gœǂ񂾂Ȃ̂ŁA`O͊Ԑڕ`̃oÂ
+	// instances were only read by compute, so the draw only needs the indirect buffer's barrier
+	const BarrierBatch& drawBarriers = graph.getPassBarriers(draw);
+	REQUIRE(drawBarriers.bufferBarriers.size() == 1);
+	CHECK(drawBarriers.bufferBarriers[0].buffer == BUFFER_A);
+	CHECK(drawBarriers.dstStageMask == VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+	CHECK(graph.getBarrierCount() == 2);
+
+	g_RecordedCalls = 0;
+	g_RecordedBufferBarriers = 0;
+	g_RecordedImageBarriers = 0;
+	graph.execute(COMMAND_BUFFER);
+	CHECK(g_RecordedCalls == 2);
+	CHECK(g_RecordedBufferBarriers == 3);
+	CHECK(g_RecordedImageBarriers == 0);
+}
+
+// R[obN̓oǍApX̏ɌĂ΂܂
+// callbacks run in pass order, each after its own barriers
+void testExecuteOrder()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle buffer = graph.importBuffer("buffer", BUFFER_A);
+	uint32_t callsBeforeFirst = UINT32_MAX;
+	uint32_t callsBeforeSecond = UINT32_MAX;
+	const uint32_t first = graph.addPass("first", [&](VkCommandBuffer) { callsBeforeFirst = g_RecordedCalls; });
+	const uint32_t second = graph.addPass("second", [&](VkCommandBuffer) { callsBeforeSecond = g_RecordedCalls; });
+	graph.use(first, buffer, ResourceUsage::TransferWrite);
+	graph.use(second, buffer, ResourceUsage::TransferRead);
+	graph.compile();
+
+	g_RecordedCalls = 0;
+	graph.execute(COMMAND_BUFFER);
+	CHECK(callsBeforeFirst == 0);
+	CHECK(callsBeforeSecond == 1);
+}
+
+//====================================================================================
+// 20X : 摜̃CAEg
+// Image layouts
+//====================================================================================
+
+// ŏ̑JڂTOP_OF_PIPEACAEgύX͏݂ƂĈAŌɎw̃CAEg
+// the first transition starts at TOP_OF_PIPE, layout changes order like writes, and the image ends in its final layout
+void testImageLayouts()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle image = graph.importImage("texture", IMAGE_A, VK_IMAGE_ASPECT_COLOR_BIT, 4,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	const CRenderGraph::ResourceHandle staging = graph.importBuffer("staging", BUFFER_A);
+	const uint32_t upload = graph.addPass("upload", nullptr);
+	graph.use(upload, staging, ResourceUsage::TransferRead);
+	graph.use(upload, image, ResourceUsage::TransferWrite);
+	const uint32_t blit = graph.addPass("blit", nullptr);
+	graph.use(blit, image, ResourceUsage::TransferRead);
+	graph.compile();
+
+	const BarrierBatch& uploadBarriers = graph.getPassBarriers(upload);
+	CHECK(uploadBarriers.srcStageMask == VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	CHECK(uploadBarriers.bufferBarriers.empty());
+	REQUIRE(uploadBarriers.imageBarriers.size() == 1);
+	CHECK(uploadBarriers.imageBarriers[0].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	CHECK(uploadBarriers.imageBarriers[0].newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	CHECK(uploadBarriers.imageBarriers[0].srcAccessMask == 0);
+	CHECK(uploadBarriers.imageBarriers[0].subresourceRange.levelCount == 4);
+
+	// Xe[WłCAEgς΃oAĩ݂tbVj
+	// a layout change needs a barrier even within one stage, flushing the write
+	const BarrierBatch& blitBarriers = graph.getPassBarriers(blit);
+	CHECK(blitBarriers.srcStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT);
+	CHECK(blitBarriers.dstStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT);
+	REQUIRE(blitBarriers.imageBarriers.size() == 1);
+	CHECK(blitBarriers.imageBarriers[0].oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	CHECK(blitBarriers.imageBarriers[0].newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	CHECK(blitBarriers.imageBarriers[0].srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+	CHECK(blitBarriers.imageBarriers[0].dstAccessMask == VK_ACCESS_TRANSFER_READ_BIT);
+
+	const BarrierBatch& finalBarriers = graph.getFinalBarriers();
+	REQUIRE(finalBarriers.imageBarriers.size() == 1);
+	CHECK(finalBarriers.imageBarriers[0].oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	CHECK(finalBarriers.imageBarriers[0].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	CHECK(finalBarriers.srcStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT);
+	CHECK(finalBarriers.dstStageMask == VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	CHECK(graph.getBarrierCount() == 3);
+}
+
+// Ō̎gpɍŏICAEgȂŌ̃oAȂA\BOTTOM_OF_PIPE
+// no final barrier when the last use already left the image in its final layout; presentation goes to BOTTOM_OF_PIPE
+void testFinalLayouts()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle image = graph.importImage("image", IMAGE_A, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	const uint32_t draw = graph.addPass("draw", nullptr);
+	graph.use(draw, image, ResourceUsage::ColorAttachmentWrite);
+	graph.compile();
+	CHECK(graph.getFinalBarriers().empty());
+
+	CRenderGraph presentGraph;
+	const CRenderGraph::ResourceHandle swapImage = presentGraph.importImage("swap chain", IMAGE_A, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	const uint32_t overlay = presentGraph.addPass("overlay", nullptr);
+	presentGraph.use(overlay, swapImage, ResourceUsage::ColorAttachmentWrite);
+	presentGraph.compile();
+	CHECK(presentGraph.getPassBarriers(overlay).empty());    // COLOR_ATTACHMENT_OPTIMALAOt̑O̎gpȂ
+
+	const BarrierBatch& finalBarriers = presentGraph.getFinalBarriers();
+	CHECK(finalBarriers.srcStageMask == VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	CHECK(finalBarriers.dstStageMask == VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	REQUIRE(finalBarriers.imageBarriers.size() == 1);
+	CHECK(finalBarriers.imageBarriers[0].srcAccessMask == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+	CHECK(finalBarriers.imageBarriers[0].dstAccessMask == 0);
+	CHECK(finalBarriers.imageBarriers[0].newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+}
+
+// 1̃pXœ摜2̃CAEgŎgcompile()ŗO
+// compile() rejects a pass that uses one image in two layouts
+void testConflictingLayouts()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle image = graph.importImage("image", IMAGE_A, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED);
+	const uint32_t pass = graph.addPass("copy", nullptr);
+	graph.use(pass, image, ResourceUsage::TransferRead);
+	graph.use(pass, image, ResourceUsage::TransferWrite);
+
+	bool threw = false;
+	try
+	{
+		graph.compile();
+	}
+	catch (const std::runtime_error&)
+	{
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+// reset()̌͐VOtiȌԂ͎c܂j
+// after reset() the graph starts over with no state carried across
+void testReset()
+{
+	CRenderGraph graph;
+	for (int frame = 0; frame < 2; frame++)
+	{
+		graph.reset();
+		const CRenderGraph::ResourceHandle buffer = graph.importBuffer("buffer", BUFFER_A);
+		CHECK(buffer == 0);
+		const uint32_t write = graph.addPass("write", nullptr);
+		graph.use(write, buffer, ResourceUsage::TransferWrite);
+		graph.compile();
+		CHECK(graph.getPassBarriers(write).empty());
+		CHECK(graph.getBarrierCount() == 0);
+	}
+}
+
+//====================================================================================
+// 30X : gWFg摜̎ƋL
+// Transient image lifetimes and aliasing
+//====================================================================================
+
+// use()Ő錾ŏƍŌ̃pXAgp̃gWFg͕摜Ȃ
+// a lifetime spans the first and last pass declared through use(); an unused transient gets no physical image
+void testTransientLifetimes()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle color = graph.createTransientImage("color", colorDesc());
+	const CRenderGraph::ResourceHandle unused = graph.createTransientImage("unused", colorDesc());
+	const uint32_t first = graph.addPass("first", nullptr);
+	const uint32_t middle = graph.addPass("middle", nullptr);
+	const uint32_t last = graph.addPass("last", nullptr);
+	graph.use(last, color, ResourceUsage::FragmentShaderRead);
+	graph.use(first, color, ResourceUsage::ColorAttachmentWrite);
+	graph.compile();
+
+	CHECK(graph.getFirstPass(color) == first);
+	CHECK(graph.getLastPass(color) == last);
+	CHECK(graph.getFirstPass(unused) == UINT32_MAX);
+	CHECK(graph.getPhysicalImageCount() == 1);
+	CHECK(graph.getPhysicalImageIndex(unused) == UINT32_MAX);
+	CHECK(graph.getPassBarriers(middle).empty());
+}
+
+// dlŎdȂȂ21̕摜LA̎gp͑O݂̎̏҂UNDEFINED
+// two transients with equal descriptions and disjoint lifetimes share one image; the later one starts from UNDEFINED
+// but still waits on the earlier occupant's writes
+void testAliasingDisjointLifetimes()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle shadow = graph.createTransientImage("shadow", colorDesc());
+	const CRenderGraph::ResourceHandle bloom = graph.createTransientImage("bloom", colorDesc());
+	const uint32_t shadowPass = graph.addPass("shadow", nullptr);
+	const uint32_t sample = graph.addPass("sample", nullptr);
+	const uint32_t bloomPass = graph.addPass("bloom", nullptr);
+	graph.use(shadowPass, shadow, ResourceUsage::ColorAttachmentWrite);
+	graph.use(sample, shadow, ResourceUsage::FragmentShaderRead);
+	graph.use(bloomPass, bloom, ResourceUsage::ColorAttachmentWrite);
+	graph.compile();
+
+	REQUIRE(graph.getPhysicalImageCount() == 1);
+	CHECK(graph.getPhysicalImageIndex(shadow) == 0);
+	CHECK(graph.getPhysicalImageIndex(bloom) == 0);
+	CHECK(graph.getPhysicalImageDesc(0) == colorDesc());
+
+	const BarrierBatch& barriers = graph.getPassBarriers(bloomPass);
+	REQUIRE(barriers.imageBarriers.size() == 1);
+	CHECK(barriers.imageBarriers[0].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	CHECK(barriers.imageBarriers[0].newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	CHECK(barriers.srcStageMask == VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);    // O̎̍Ō̓ǂݍ݁iWARj
+	CHECK(barriers.imageBarriers[0].srcAccessMask == 0);
+	CHECK(graph.getFinalBarriers().empty());    // gWFg͍ŏICAEgȂ
+}
+
+// dȂ΁ipXŏIĎn܂ꍇjAdlłʂ̕摜
+// overlapping lifetimes, including one ending in the pass where the other starts, never share an image
+void testNoAliasingOverlappingLifetimes()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle first = graph.createTransientImage("first", colorDesc());
+	const CRenderGraph::ResourceHandle second = graph.createTransientImage("second", colorDesc());
+	const uint32_t write = graph.addPass("write", nullptr);
+	const uint32_t copy = graph.addPass("copy", nullptr);
+	graph.use(write, first, ResourceUsage::ColorAttachmentWrite);
+	graph.use(copy, first, ResourceUsage::FragmentShaderRead);
+	graph.use(copy, second, ResourceUsage::ColorAttachmentWrite);
+	graph.compile();
+
+	CHECK(graph.getPhysicalImageCount() == 2);
+	CHECK(graph.getPhysicalImageIndex(first) != graph.getPhysicalImageIndex(second));
+}
+
+// dlႦΎdȂȂĂL܂B1̃pXMSAAJ[ƃfvXꂼ̉摜
+// different descriptions never alias, even with disjoint lifetimes; MSAA color and depth in one pass get one image each
+void testNoAliasingDifferentDescs()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle color = graph.createTransientImage("color", colorDesc());
+	const CRenderGraph::ResourceHandle depth = graph.createTransientImage("depth", depthDesc());
+	const uint32_t colorPass = graph.addPass("color", nullptr);
+	const uint32_t depthPass = graph.addPass("depth", nullptr);
+	graph.use(colorPass, color, ResourceUsage::ColorAttachmentWrite);
+	graph.use(depthPass, depth, ResourceUsage::DepthAttachmentWrite);
+	graph.compile();
+	CHECK(graph.getPhysicalImageCount() == 2);
+
+	CRenderGraph mainGraph;
+	const CRenderGraph::ResourceHandle msaaColor = mainGraph.createTransientImage("msaa color", colorDesc());
+	const CRenderGraph::ResourceHandle msaaDepth = mainGraph.createTransientImage("depth", depthDesc());
+	const uint32_t draw = mainGraph.addPass("draw", nullptr);
+	mainGraph.use(draw, msaaColor, ResourceUsage::ColorAttachmentWrite);
+	mainGraph.use(draw, msaaDepth, ResourceUsage::DepthAttachmentWrite);
+	mainGraph.compile();
+	REQUIRE(mainGraph.getPhysicalImageCount() == 2);
+	CHECK(mainGraph.getPhysicalImageDesc(mainGraph.getPhysicalImageIndex(msaaDepth)) == depthDesc());
+}
+
+// 摜͎s܂ōėp̂ŁAŏ̎gp͑O̎sł̍Ō̎gp҂܂iWAWj
+// physical images carry over between executions, so a first use waits on the previous execution's last use (WAW)
+void testTransientFirstUse()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle color = graph.createTransientImage("msaa color", colorDesc());
+	const CRenderGraph::ResourceHandle depth = graph.createTransientImage("depth", depthDesc());
+	const uint32_t draw = graph.addPass("draw", nullptr);
+	graph.use(draw, color, ResourceUsage::ColorAttachmentWrite);
+	graph.use(draw, depth, ResourceUsage::DepthAttachmentWrite);
+	graph.compile();
+
+	const BarrierBatch& barriers = graph.getPassBarriers(draw);
+	REQUIRE(barriers.imageBarriers.size() == 2);
+	CHECK(barriers.srcStageMask == (VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+		| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT));
+	CHECK(barriers.imageBarriers[0].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	CHECK(barriers.imageBarriers[0].newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	CHECK(barriers.imageBarriers[0].srcAccessMask == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+	CHECK(barriers.imageBarriers[1].newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	CHECK(barriers.imageBarriers[1].srcAccessMask == VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+	CHECK(barriers.imageBarriers[1].subresourceRange.aspectMask == VK_IMAGE_ASPECT_DEPTH_BIT);
+}
+
+// compile()̌ɓn̂́AgWFg̃oÂ݂ɓ܂iO摜͂̂܂܁j
+// images handed over after compile() are patched into the transients' barriers only, leaving imported images alone
+void testSetPhysicalImage()
+{
+	CRenderGraph graph;
+	const CRenderGraph::ResourceHandle imported = graph.importImage("texture", IMAGE_A, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED);
+	const CRenderGraph::ResourceHandle color = graph.createTransientImage("color", colorDesc());
+	const uint32_t draw = graph.addPass("draw", nullptr);
+	graph.use(draw, imported, ResourceUsage::FragmentShaderRead);
+	graph.use(draw, color, ResourceUsage::ColorAttachmentWrite);
+	graph.compile();
+
+	const BarrierBatch& barriers = graph.getPassBarriers(draw);
+	REQUIRE(barriers.imageBarriers.size() == 2);
+	CHECK(barriers.imageBarriers[1].image == VK_NULL_HANDLE);    // ̂͂܂܂
+
+	graph.setPhysicalImage(graph.getPhysicalImageIndex(color), IMAGE_B);
+	CHECK(barriers.imageBarriers[0].image == IMAGE_A);
+	CHECK(barriers.imageBarriers[1].image == IMAGE_B);
+	CHECK(barriers.imagePhysicalIndices[0] == UINT32_MAX);
+
+	// O摜ƓnhłAgWFg͕ʂ̃\[X
+	// a transient is never merged with an imported image, even one with the same handle
+	CHECK(graph.importImage("swap chain", IMAGE_B, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED) != color);
+}
+
+int main()
+{
+	testReadAfterWrite();
+	testRepeatedReads();
+	testWriteAfterRead();
+	testWriteAfterWrite();
+	testBarrierMerging();
+	testExecuteOrder();
+	testImageLayouts();
+	testFinalLayouts();
+	testConflictingLayouts();
+	testReset();
+	testTransientLifetimes();
+	testAliasingDisjointLifetimes();
+	testNoAliasingOverlappingLifetimes();
+	testNoAliasingDifferentDescs();
+	testTransientFirstUse();
+	testSetPhysicalImage();
+
+	if (g_Failures > 0)
+	{
+		std::cerr << g_Failures << " render graph check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All render graph tests passed" << std::endl;
+	return EXIT_SUCCESS;
+}
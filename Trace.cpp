@@ -0,0 +1,203 @@
+/*======================================================================
+Vulkan Presentation : Trace.cpp
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#include "Trace.h"
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+
+std::atomic<bool> CTrace::s_Enabled{ false };
+
+namespace
+{
+	const size_t RING_SIZE = 16384;    // XbhƂ̃Cxgi2̗ݏj
+
+	struct TraceEvent
+	{
+		const char* name;         // ICxgnullptr
+		uint64_t    timestamp;    // imbivZXJnj
+		bool        isBegin;
+	};
+
+	// XbhƂ̃OF݂͏LXbĥ݁Awritten͏񂾑
+	// one per thread; only the owning thread writes, written counts every event ever pushed
+	struct TraceRing
+	{
+		std::array<TraceEvent, RING_SIZE> events;
+		std::atomic<uint64_t>             written{ 0 };
+		uint32_t                          threadId = 0;
+		std::string                       threadName;    // g_RingsMutexŕی
+	};
+
+	// O̓XbhIc܂iIXbh̃Cxgo悤Ɂj
+	// rings outlive their threads so a finished thread's events can still be exported
+	std::mutex                              g_RingsMutex;
+	std::vector<std::unique_ptr<TraceRing>> g_Rings;
+	thread_local TraceRing*                 t_Ring = nullptr;
+
+	const std::chrono::steady_clock::time_point g_Epoch = std::chrono::steady_clock::now();
+
+	uint64_t now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_Epoch).count());
+	}
+
+	TraceRing& getRing()
+	{
+		if (t_Ring == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(g_RingsMutex);
+			g_Rings.push_back(std::make_unique<TraceRing>());
+			t_Ring = g_Rings.back().get();
+			t_Ring->threadId = static_cast<uint32_t>(g_Rings.size());
+		}
+		return *t_Ring;
+	}
+
+	void push(const char* name, bool isBegin)
+	{
+		TraceRing& ring = getRing();
+		const uint64_t index = ring.written.load(std::memory_order_relaxed);
+		ring.events[index % RING_SIZE] = { name, now(), isBegin };
+		ring.written.store(index + 1, std::memory_order_release);
+	}
+
+	void writeJsonString(std::ofstream& file, const char* text)
+	{
+		file << '"';
+		for (const char* c = text; *c != '\0'; c++)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				file << '\\';
+			}
+			file << *c;
+		}
+		file << '"';
+	}
+}
+
+void CTrace::setEnabled(bool enable)
+{
+	s_Enabled.store(enable, std::memory_order_relaxed);
+}
+
+void CTrace::begin(const char* name)
+{
+	push(name, true);
+}
+
+void CTrace::end()
+{
+	push(nullptr, false);
+}
+
+void CTrace::setThreadName(const char* name)
+{
+	TraceRing& ring = getRing();
+	std::lock_guard<std::mutex> lock(g_RingsMutex);
+	ring.threadName = name;
+}
+
+bool CTrace::writeChromeJson(const std::string& path, double lastSeconds)
+{
+	const uint64_t endTime = now();
+	const uint64_t startTime = (lastSeconds > 0.0) ? endTime - std::min(endTime, static_cast<uint64_t>(lastSeconds * 1e9)) : 0;
+
+	// bN̓ÖꗗƃXbĥ݃Rs[At@C݂̏̓bN̊Oōs܂iVXbh~߂܂j
+	// only the ring list and thread names are copied under the lock; file I/O happens outside it so new threads never wait on it
+	struct RingSnapshot
+	{
+		const TraceRing* ring;
+		uint32_t         threadId;
+		std::string      threadName;
+	};
+	std::vector<RingSnapshot> rings;
+	{
+		std::lock_guard<std::mutex> lock(g_RingsMutex);
+		rings.reserve(g_Rings.size());
+		for (const std::unique_ptr<TraceRing>& ring : g_Rings)
+		{
+			rings.push_back({ ring.get(), ring->threadId, ring->threadName });    // O͍폜܂
+		}
+	}
+
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+
+	for (const RingSnapshot& snapshot : rings)
+	{
+		const TraceRing* ring = snapshot.ring;
+		if (!snapshot.threadName.empty())
+		{
+			file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << snapshot.threadId << ",\"args\":{\"name\":";
+			writeJsonString(file, snapshot.threadName.c_str());
+			file << "}}";
+			first = false;
+		}
+
+		// L^̃OFRs[̌ɏ㏑ꂽ\̂ÂCxĝĂ܂
+		// the ring may be written meanwhile; after copying, drop anything that could have been overwritten
+		const uint64_t written = ring->written.load(std::memory_order_acquire);
+		const uint64_t oldest = (written > RING_SIZE) ? written - RING_SIZE : 0;
+		std::vector<TraceEvent> events;
+		events.reserve(static_cast<size_t>(written - oldest));
+		for (uint64_t i = oldest; i < written; i++)
+		{
+			events.push_back(ring->events[i % RING_SIZE]);
+		}
+
+		// ݑwritteni߂OɃXbg߁AwrittenAfterԖڂ̃Cxgݒ̉\܂
+		// ĩXbgwrittenAfter - RING_SIZEԖڂ܂ŁA܂+1̂Ă܂j
+		// the writer fills slot writtenAfter before publishing it, so event writtenAfter - RING_SIZE may be half
+		// overwritten as well; everything through it is dropped, hence the + 1
+		const uint64_t writtenAfter = ring->written.load(std::memory_order_acquire);
+		const uint64_t overwritten = (writtenAfter + 1 > RING_SIZE) ? writtenAfter + 1 - RING_SIZE : 0;
+		const size_t skip = static_cast<size_t>(std::min<uint64_t>(events.size(), (overwritten > oldest) ? overwritten - oldest : 0));
+
+		// ΉJncĂȂICxgiÖEԊOj͏o܂
+		// end events whose begin is gone (wrapped away or before the window) are not written
+		uint32_t depth = 0;
+		for (size_t i = skip; i < events.size(); i++)
+		{
+			const TraceEvent& event = events[i];
+			if (event.timestamp < startTime)
+			{
+				continue;
+			}
+			if (!event.isBegin && depth == 0)
+			{
+				continue;
+			}
+			depth = event.isBegin ? depth + 1 : depth - 1;
+
+			file << (first ? "" : ",") << "\n{\"ph\":\"" << (event.isBegin ? 'B' : 'E') << "\",\"pid\":1,\"tid\":" << snapshot.threadId
+				<< ",\"ts\":" << std::fixed << std::setprecision(3) << event.timestamp / 1000.0;
+			if (event.isBegin)
+			{
+				file << ",\"name\":";
+				writeJsonString(file, event.name);
+			}
+			file << "}";
+			first = false;
+		}
+	}
+
+	file << "\n]}\n";
+	return file.good();
+}
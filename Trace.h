@@ -0,0 +1,85 @@
+/*======================================================================
+Vulkan Presentation : Trace.h
+Author:			Sim Luigi
+Last Modified:	2020.12.13
+=======================================================================*/
+#pragma once
+
+#include <atomic>
+#include <string>
+
+// CPUg[XFXbhƂ̃Oobt@[ɊJnEICxgL^AChrome/PerfettoJSONɏo܂
+// CPU trace: begin/end events go into a per-thread ring buffer and are exported as Chrome trace-event JSON (Perfetto)
+//   L^̓bNȂiXbh̃Ô݁jB̓tO̓ǂݍ1̂݁ATRACE_DISABLEDŃ}Nƍ폜
+//   recording is lock-free (each thread only writes its own ring); when disabled a scope costs one flag load,
+//   and defining TRACE_DISABLED compiles the macros out entirely
+//   OƌÂCxg㏑܂i߂̃Cxĝݎc܂j
+//   a full ring overwrites its oldest events, so only the most recent ones are kept
+class CTrace
+{
+public:
+
+	static void setEnabled(bool enable);
+	static bool isEnabled() { return s_Enabled.load(std::memory_order_relaxed); }
+
+	// name͕񃊃ei|C^[̂݋L^܂j
+	// name must be a string literal; only the pointer is recorded
+	static void begin(const char* name);
+	static void end();
+
+	static void setThreadName(const char* name);    // JSOÑXbhĩXbhj
+
+	// SXbh̃Cxgo܂ilastSeconds > 0F߂̂̕b̂݁jBL^łĂяo܂
+	// write every thread's events, or only the last lastSeconds seconds of them; safe while other threads record
+	static bool writeChromeJson(const std::string& path, double lastSeconds = 0.0);
+
+private:
+
+	static std::atomic<bool> s_Enabled;
+};
+
+// RAIĨXR[vFRXgN^[ŊJnAfXgN^[ŏIiJnɖȂ牽܂j
+// RAII scope: begin on construction, end on destruction; a scope started while disabled records nothing
+class CTraceScope
+{
+public:
+
+	explicit CTraceScope(const char* name)
+		: m_Active(CTrace::isEnabled())
+	{
+		if (m_Active)
+		{
+			CTrace::begin(name);
+		}
+	}
+
+	~CTraceScope()
+	{
+		if (m_Active)
+		{
+			CTrace::end();
+		}
+	}
+
+	CTraceScope(const CTraceScope&) = delete;
+	CTraceScope& operator=(const CTraceScope&) = delete;
+
+private:
+
+	bool m_Active;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#if defined(TRACE_DISABLED)
+#define TRACE_SCOPE(name)
+#define TRACE_FUNCTION()
+#define TRACE_BEGIN(name)
+#define TRACE_END()
+#else
+#define TRACE_SCOPE(name) CTraceScope TRACE_CONCAT(traceScope, __LINE__)(name)    // ̃ubN̏I܂
+#define TRACE_FUNCTION() TRACE_SCOPE(__func__)                                      // ֐̃XR[v
+#define TRACE_BEGIN(name) do { if (CTrace::isEnabled()) CTrace::begin(name); } while (0)
+#define TRACE_END() do { if (CTrace::isEnabled()) CTrace::end(); } while (0)       // TRACE_BEGINƑ΂
+#endif
@@ -20,7 +20,7 @@ Last Modified:	2020.12.13
 	1.) IuWFNg\́uCreateInfov쐬܂B        VkInstanceCreateInfo createInfo{};
 	2.) \̂̎ނI܂B                                createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	3.) \̂̐ݒEtbO`܂B                      createInfo.flags = 0;
-	4.) CreateInfo\̂ɊÂăIuWFNĝ𐶐܂B  vkCreateInstance(&createInfo, nullptr, &m_Instance):
+	4.) CreateInfo\̂ɊÂăIuWFNĝ𐶐܂B  vkCreateInstance(&createInfo, m_Allocator, &m_Instance):
 
 	Vulkanp̃fobO@\uValidation Layervuof[VC[vɂāF
 	GłAȒPɃC[WƁA摜ҏW\tgiPhotoshopAGIMPȂǁj̃C[Ɠ悤ɏd˂Ă̕z₷łB
@@ -57,6 +57,8 @@ Last Modified:	2020.12.13
 
 =======================================================================*/
 #include "VulkanFramework.h"
+#include "Trace.h"              // CPUg[X
+#include "GoldenImage.h"        // S[f摜̔r
 
 #define TINYOBJLOADER_IMPLEMENTATION        // tinyobjloaderfǂݍ
 #include <tiny_obj_loader.h>
@@ -84,9 +86,12 @@ Last Modified:	2020.12.13
 #include <optional>     // C++17 and above
 #include <algorithm>    // std::min/max : chooseSwapExtent()
 #include <cstdint>      // UINT32_MAX   : in chooseSwapExtent()
+#include <cfloat>       // FLT_MAX      : loadModel()̋E{bNX
 #include <stdexcept>    // std::runtime errorAȂ
 #include <cstdlib>      // EXIT_SUCCESSEEXIT_FAILURE : main()
 #include <fstream>      // VF[_[̃oCif[^ǂݍށ@for loading shader binary data
+#include <filesystem>   // std::filesystem::rename : pCvCLbV̏
+#include <iomanip>      // std::setprecision : wbhXx`}[N̏o
 #include <glm/glm.hpp>  // glm::vec2, vec3 : Vertex\
 
 const uint32_t WIDTH = 800;
@@ -95,9 +100,39 @@ const uint32_t HEIGHT = 600;
 const std::string MODEL_PATH = "Asset/Model/viking_room.obj";
 const std::string TEXTURE_PATH = "Asset/Texture/viking_room.png";
 
-// ɏt[̍ő吔 
-// how many frames should be processed concurrently 
-const int MAX_FRAMES_IN_FLIGHT = 2;		
+// pCvCLbVt@Cicleanup()ŏ݁A̋Nœǂݍ݁j
+// pipeline cache file, written at cleanup() and seeded from on the next start
+const std::string PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+const std::string BENCHMARK_PIPELINE_CACHE_PATH = "pipeline_cache.bench.bin";    // Nx`}[NpiIɍ폜j
+const std::string PIPELINE_MANIFEST_PATH = "shaders/pipelines.manifest";    // ORpCpCvCoAg
+
+// ɏt[̍ő吔iLatencyPolicy::framesInFlight̏j
+// the most frames that may be processed concurrently; the upper bound for LatencyPolicy::framesInFlight
+const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+// CX^Xobt@[̗eʁi1̃h[R[ŕ`łőCX^Xj
+// capacity of each instance buffer: the most instances a single draw call can render
+//   摜ƂɃCX^X64MBizXgj{Ԑڕ`R}h20MB ~ TubVifoCX[Jj
+//   per swap chain image: 64 MB of instances (host visible) plus 20 MB of indirect commands per submesh (device local)
+const uint32_t MAX_INSTANCE_COUNT = 1000000;
+
+// GPUJO̊Ԑڕ`͈̔́ipCvCoAgj̍ő吔F`搔͔͈͂Ƃ1icull.compdrawCountsj
+// the most indirect draw ranges (pipeline variants) GPU culling supports; one draw count each (drawCounts in cull.comp)
+const uint32_t MAX_DRAW_RANGES = 64;
+
+// Ԑڕ`obt@[̃R}hz̊JnʒuiO͔͈͂Ƃ̕`搔j
+// offset of the command array inside each indirect buffer; the per-range draw counts sit in front of it
+const VkDeviceSize INDIRECT_COMMANDS_OFFSET = sizeof(uint32_t) * MAX_DRAW_RANGES;
+
+// 擾E\̑҂ziFIFOF̊ԊuȂF0jȏ㒴ꍇAgNXŕ\̒؂ƂĐ܂
+// an acquire + present that blocks this much longer than expected (one vblank interval under FIFO, zero otherwise)
+// counts as a present stall in the metrics
+const double PRESENT_STALL_MARGIN_MILLISECONDS = 4.0;
+const double DEFAULT_REFRESH_RATE = 60.0;    // j^[̃tbV[g擾łȂꍇ
+
+#if defined(HEADLESS_ONLY)
+const char* const NO_WINDOW_ERROR = "Built without GLFW (HEADLESS_ONLY): no window, use --headless, --golden or --validate-cull!";
+#endif
 
 // Vulkañof[VC[FSDK̃G[`FbNdg
 // Vulkan Validation layers: SDK's own error checking implementation
@@ -171,7 +206,17 @@ VKAPI_ATTR VkBool32 VKAPI_CALL CVulkanFramework::debugCallback(
 	const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
 	void* pUserData)
 {
-	std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+	// VNɓnio͂̓K[XbhjBVNȂΏ]ʂ肱ŏo
+	// hand the message to the sink, whose logger thread does the writing; without one, print it here as before
+	CDebugMessageSink* sink = static_cast<CDebugMessageSink*>(pUserData);
+	if (sink != nullptr)
+	{
+		sink->push(messageSeverity, pCallbackData);
+	}
+	else
+	{
+		std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+	}
 
 	// boolean indicating if Vulkan call that triggered the validation layer message should be aborted
 	// if callback returns true, call is aborted with VK_ERROR_VALIDATION_FAILED_EXT error. 
@@ -187,19 +232,24 @@ void CVulkanFramework::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCre
 	createInfo.messageSeverity = /*VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT|*/ VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
 	createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
 	createInfo.pfnUserCallback = debugCallback;
+	createInfo.pUserData = &m_DebugSink;    // vkCreateInstance()̃bZ[WOɗ܂܂
 
 }
 
 // fobObZ[Wݒ
 void CVulkanFramework::setupDebugMessenger()
 {
+	TRACE_FUNCTION();
+
 	if (enableValidationLayers == false)    // fobO[hł͂ȂꍇA܂  Only works in debug mode
 		return;
 
+	m_DebugSink.start(std::cerr);
+
 	VkDebugUtilsMessengerCreateInfoEXT createInfo{};
 	populateDebugMessengerCreateInfo(createInfo);
 
-	if (CreateDebugUtilsMessengerEXT(m_Instance, &createInfo, nullptr, &m_DebugMessenger) != VK_SUCCESS)
+	if (CreateDebugUtilsMessengerEXT(m_Instance, &createInfo, m_Allocator, &m_DebugMessenger) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to set up debug messenger!");
 	}
@@ -242,11 +292,20 @@ bool CVulkanFramework::checkValidationLayerSupport()
 // returns the list of extensions based on whether validation layers are enabled or not
 std::vector<const char*> CVulkanFramework::getRequiredExtensions()
 {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions;
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	// wbhXFEBhEȂ̂ŁAGLFW̃GNXeViVK_KHR_surfacej͕svł
+	// headless: no window, so none of GLFW's surface extensions
+#if !defined(HEADLESS_ONLY)
+	if (m_Headless == false)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
+#endif
 
 	if (enableValidationLayers == true)
 	{
@@ -262,24 +321,79 @@ std::vector<const char*> CVulkanFramework::getRequiredExtensions()
 
 void CVulkanFramework::run()
 {
-	initWindow();
-	initVulkan();
+	m_StartTime = std::chrono::high_resolution_clock::now();    // ŏ̃t[܂ł̎Ԃv
+	m_StartupStages.clear();
+
+	// g[XFo͐悪ݒ肳Ăꍇ̂݋L^܂
+	// trace recording is only switched on when an output file is set
+	CTrace::setEnabled(m_TracePath.empty() == false);
+	CTrace::setThreadName("main");
+
+	runInitStage("initWindow", &CVulkanFramework::initWindow);
+	{
+		TRACE_SCOPE("initVulkan");
+		initVulkan();
+	}
 	mainLoop();
 	cleanup();
+
+	writeTrace();
 }
 
 // C[v
 void CVulkanFramework::mainLoop()
 {
-	while (glfwWindowShouldClose(m_Window) == false)
+#if defined(HEADLESS_ONLY)
+	throw std::runtime_error(NO_WINDOW_ERROR);
+#else
+	startUpdateThread();    // V[̍XV͍XVXbhŁiȂdrawFrame()̒Łj
+	startMetricsExport();
+
+	auto frameStartTime = std::chrono::high_resolution_clock::now();
+	try
+	{
+		while (glfwWindowShouldClose(m_Window) == false)
+		{
+			// ͂̒Oɂ̃t[g̑O̒o҂ƁAdrawFrame()̑ҋ@ȂȂ͂V܂ܕ`悳܂
+			// waiting for this frame slot's previous submit right before input leaves drawFrame() nothing to wait on,
+			// so the input it renders is as fresh as possible
+			if (m_LatencyPolicy.waitBeforeInput)
+			{
+				waitForSerial(m_FrameSubmitSerials[m_CurrentFrame]);
+			}
+
+			m_InputTime = std::chrono::high_resolution_clock::now();
+			TRACE_BEGIN("glfwPollEvents");
+			glfwPollEvents();    // Cxgҋ@  Update/event checker
+			TRACE_END();
+			drawFrame();         // t[`
+
+			// t[ԁFÕt[̊Jn炱̃t[̊Jn܂Łi\̑ҋ@܂݂܂j
+			// frame time runs from one iteration's start to the next, present waits included
+			const auto now = std::chrono::high_resolution_clock::now();
+			m_FrameTimeMetric.record(static_cast<uint64_t>(std::chrono::duration<double, std::micro>(now - frameStartTime).count()));
+			m_FrameCountMetric.add();
+			frameStartTime = now;
+		}
+	}
+	catch (...)
 	{
-		glfwPollEvents();    // Cxgҋ@  Update/event checker
-		drawFrame();         // t[`
+		stopUpdateThread();
+		m_Metrics.stopExporter();
+		throw;
 	}
+	stopUpdateThread();
+	m_Metrics.stopExporter();    // ŏIlo܂
 
 	// vOIiЕtj̑OɁAɓĂ鏈ς܂܂B
 	// let logical device finish operations before exiting the main loop 
 	vkDeviceWaitIdle(m_LogicalDevice);
+
+	if (m_GpuProfileReport)
+	{
+		m_GpuProfiler.report(std::cout);
+	}
+#endif
 }
 
 
@@ -293,6 +407,9 @@ void CVulkanFramework::mainLoop()
 // EChE
 void CVulkanFramework::initWindow()
 {
+#if defined(HEADLESS_ONLY)
+	throw std::runtime_error(NO_WINDOW_ERROR);
+#else
 	glfwInit();    // GLFW
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);    // OPENGLReNXg쐬ȂI
@@ -301,41 +418,68 @@ void CVulkanFramework::initWindow()
 	m_Window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);    // L̃p[^ŃEBhE𐶐܂
 	glfwSetWindowUserPointer(m_Window, this);
 	glfwSetFramebufferSizeCallback(m_Window, framebufferResizeCallback);
+	glfwSetKeyCallback(m_Window, keyCallback);
+#endif
 }
 
+// ̒iKvĎs܂iiK͊֐j
+// time one initialization stage, named after its function
+#define INIT_STAGE(stage) runInitStage(#stage, &CVulkanFramework::stage)
+
 // Vulkan
 void CVulkanFramework::initVulkan()
 {
-	createInstance();			    // CX^X			
-	setupDebugMessenger();          // fobOR[obNݒ
-	createSurface();                // EChET[tFX
-	pickPhysicalDevice();           // VulkanΏۃOtBbNXJ[h̑I
-	createLogicalDevice();          // OtBbNXJ[hƃC^[tF[XfoCXݒ
-	createSwapChain();              // SwapChain
-	createImageViews();             // SwapChainp̉摜r[
-	createRenderPass();             // _[pX
-	createDescriptorSetLayout();    // \[XŃXNv^[CAEg 
-	createGraphicsPipeline();       // OtBbNXpCvC
-	createColorResources();         // J[\[XiMSAA)
-	createDepthResources();         // fvX\[X
-	createFramebuffers();           // t[obt@ifvX\[X̌j
-	createCommandPool();            // R}hobt@[i[v[𐶐
-	createTextureImage();           // eNX`[}bsOp摜
-	createTextureImageView();       // eNX`[ANZX邽߂̃C[Wr[
-	createTextureSampler();         // eNX`[Tv[
-	loadModel();                    // ff[^ǂݍ
-	createVertexBuffer();           // _obt@[
-	createIndexBuffer();		      // CfbNXobt@[
-	createUniformBuffers();         // jtH[obt@[
-	createDescriptorPool();         // fXNv^[Zbgi[v[𐶐
-	createDescriptorSets();         // fXNv^[Zbg𐶐
-	createCommandBuffers();         // R}hobt@[
-	createSyncObjects();            // IuWFNg
+	INIT_STAGE(createInstance);             // CX^X
+	INIT_STAGE(setupDebugMessenger);        // fobOR[obNݒ
+	INIT_STAGE(createSurface);              // EChET[tFX
+	INIT_STAGE(pickPhysicalDevice);         // VulkanΏۃOtBbNXJ[h̑I
+	INIT_STAGE(createLogicalDevice);        // OtBbNXJ[hƃC^[tF[XfoCXݒ
+	INIT_STAGE(createSwapChain);            // SwapChain
+	INIT_STAGE(createImageViews);           // SwapChainp̉摜r[
+	INIT_STAGE(createRenderPass);           // _[pX
+	INIT_STAGE(createDescriptorSetLayout);  // \[XŃXNv^[CAEg
+	INIT_STAGE(createPipelineCache);        // pCvCLbVit@Cǂݍ݁j
+	INIT_STAGE(createPipelineManager);      // pCvCRpCp[J[XbhN
+	INIT_STAGE(createPipelineLayout);       // pCvCCAEg
+	INIT_STAGE(createGraphicsPipeline);     // OtBbNXpCvC
+	INIT_STAGE(createCullPipeline);         // GPUJOpRs[gpCvC
+	INIT_STAGE(createAttachmentResources);  // MSAAJ[EfvXi_[Ot̃gWFgj
+	INIT_STAGE(createFramebuffers);         // t[obt@ifvX\[X̌j
+	INIT_STAGE(createCommandPool);          // R}hobt@[i[v[𐶐
+	INIT_STAGE(createFrameTimeline);        // t[^CCiAbv[h̒oVOi܂j
+	INIT_STAGE(createTextureImage);         // eNX`[}bsOp摜
+	INIT_STAGE(createTextureImageView);     // eNX`[ANZX邽߂̃C[Wr[
+	INIT_STAGE(createTextureSampler);       // eNX`[Tv[
+	INIT_STAGE(loadModel);                  // ff[^ǂݍ
+	INIT_STAGE(createVertexBuffer);         // _obt@[
+	INIT_STAGE(createIndexBuffer);          // CfbNXobt@[
+	INIT_STAGE(createSubmeshBuffer);        // TubViEjobt@[
+	INIT_STAGE(createUniformBuffers);       // jtH[obt@[
+	INIT_STAGE(createInstanceBuffers);      // CX^Xobt@[
+	INIT_STAGE(createIndirectBuffers);      // Ԑڕ`obt@[
+	INIT_STAGE(createDescriptorAllocator);  // fXNv^[Zbgi[v[it[ƁELbVj
+	INIT_STAGE(createDescriptorSets);       // fXNv^[Zbg𐶐
+	INIT_STAGE(createCommandBuffers);       // R}hobt@[
+	INIT_STAGE(createSyncObjects);          // IuWFNg
+	INIT_STAGE(createGpuProfiler);          // GPU^CX^vpNGv[
+}
+
+#undef INIT_STAGE
+
+// ̒iKsAԂm_StartupStagesɋL^܂
+// run one initialization stage and record its time in m_StartupStages
+void CVulkanFramework::runInitStage(const char* name, void (CVulkanFramework::*stage)())
+{
+	const auto stageStartTime = std::chrono::high_resolution_clock::now();
+	(this->*stage)();
+	m_StartupStages.push_back({ name, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - stageStartTime).count() });
 }
 
 // VulkanCX^X Create Vulkan Instance
 void CVulkanFramework::createInstance()
 {
+	TRACE_FUNCTION();
+
 	if (enableValidationLayers && !checkValidationLayerSupport())    // fobO[h̐ݒŃof[VC[@\T|[gȂꍇ
 	{
 		throw std::runtime_error("Validation layers requested, but not available!");
@@ -347,7 +491,7 @@ void CVulkanFramework::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_2;    // ^CCZ}tHAvkUpdateDescriptorSetWithTemplate()
 
 	VkInstanceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -376,7 +520,7 @@ void CVulkanFramework::createInstance()
 	}
 
 	// L̍\̂̏ɊÂĎۂ̃CX^X𐶐܂B
-	if (vkCreateInstance(&createInfo, nullptr, &m_Instance) != VK_SUCCESS)
+	if (vkCreateInstance(&createInfo, m_Allocator, &m_Instance) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create instance!");
 	}
@@ -386,15 +530,26 @@ void CVulkanFramework::createInstance()
 // Surface Creation
 void CVulkanFramework::createSurface()
 {
-	if (glfwCreateWindowSurface(m_Instance, m_Window, nullptr, &m_Surface) != VK_SUCCESS)
+	TRACE_FUNCTION();
+
+	if (m_Headless)    // wbhXFEBhEET[tFXȂ
+	{
+		return;
+	}
+
+#if !defined(HEADLESS_ONLY)
+	if (glfwCreateWindowSurface(m_Instance, m_Window, m_Allocator, &m_Surface) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create window surface!");
 	}
+#endif
 }
 
 // foCXiOtBbNXJ[hIjSelect compatible GPU
 void CVulkanFramework::pickPhysicalDevice()
 {
+	TRACE_FUNCTION();
+
 	uint32_t deviceCount = 0;
 	vkEnumeratePhysicalDevices(m_Instance, &deviceCount, nullptr);    // VulkanΉ̃foCXiGPU)𐔂
 	if (deviceCount == 0)                                             // ȂꍇAG[\
@@ -423,6 +578,8 @@ void CVulkanFramework::pickPhysicalDevice()
 // WJfoCX Create Logical Device to interface with GPU
 void CVulkanFramework::createLogicalDevice()
 {
+	TRACE_FUNCTION();
+
 	QueueFamilyIndices indices = findQueueFamilies(m_PhysicalDevice);    // WJfoCXL[@Preparing logical device queue
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;               // WJfoCXL[
@@ -441,10 +598,58 @@ void CVulkanFramework::createLogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;    // AnisotropyL
 	deviceFeatures.sampleRateShading = VK_TRUE;    // TvVF[fBOL
 
+	// pCvCvNGiCӁjFCpX̒_Ev~eBuEVF[_[N
+	// optional pipeline statistics queries: vertices, primitives and shader invocations of the main pass
+	deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+	m_PipelineStatisticsSupported = (supportedFeatures.pipelineStatisticsQuery == VK_TRUE);
+
+	// GPU쓮JOpiCӁjFԐڕ`firstInstanceŃCX^XwÅԐڕ`1̃R}h
+	// optional, for GPU-driven culling: firstInstance selects the instance, multiDrawIndirect batches the draws
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	m_MultiDrawIndirectSupported = (supportedFeatures.multiDrawIndirect == VK_TRUE);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+	m_MaxDrawIndirectCount = m_MultiDrawIndirectSupported ? properties.limits.maxDrawIndirectCount : 1;
+
+	// JO̓OtBbNXL[ŃfBXpb`̂ŁARs[gΉKvł
+	// the cull dispatch goes on the graphics queue, so that family must support compute too
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	// multiDrawIndirectK{FȂꍇ̓IuWFNgƂ1̊Ԑڕ`ɂȂACPU̕`xȂ܂
+	// ΉĂmaxDrawIndirectCount2^16-1ȏidl̕ۏؒljȂ̂ŁA`̓IuWFNg65535Ƃ1ł
+	// multiDrawIndirect is required as well: without it every object would need its own indirect draw call, which
+	// is slower than the CPU path. With it the spec guarantees maxDrawIndirectCount >= 2^16-1, so the chunked
+	// fallback issues at most one call per 65535 objects
+	m_GpuCullingSupported = (supportedFeatures.drawIndirectFirstInstance == VK_TRUE)
+		&& m_MultiDrawIndirectSupported
+		&& (queueFamilies[indices.graphicsFamily.value()].queueFlags & VK_QUEUE_COMPUTE_BIT);
+
+	if (m_GpuDrivenCulling && !m_GpuCullingSupported)
+	{
+		std::cerr << "GPU-driven culling is not supported on this device (requires drawIndirectFirstInstance, "
+			"multiDrawIndirect and compute on the graphics queue); falling back to CPU-issued draws." << std::endl;
+	}
+
+	// VK_KHR_draw_indirect_countF`搔GPUǂݍ݂܂iCӁj
+	std::vector<const char*> enabledExtensions = getDeviceExtensions();
+	const bool drawIndirectCountAvailable = isDeviceExtensionAvailable(m_PhysicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	if (drawIndirectCountAvailable)
+	{
+		enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	}
+
 
 	VkDeviceCreateInfo createInfo{};    // WJfoCX\
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -454,23 +659,46 @@ void CVulkanFramework::createLogicalDevice()
 
 	createInfo.pEnabledFeatures = &deviceFeatures;             // currently empty (will revisit later)
 
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	// ^CCZ}tHiisDeviceSuitable()őΉmFς݁j
+	// timeline semaphores; isDeviceSuitable() already checked for support
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+	createInfo.pNext = &timelineFeatures;
+
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	// L̃p[^ɊÂĎۂ̃WJfoCX𐶐܂B
 	// Creating the logical device itself
-	if (vkCreateDevice(m_PhysicalDevice, &createInfo, nullptr, &m_LogicalDevice) != VK_SUCCESS)
+	if (vkCreateDevice(m_PhysicalDevice, &createInfo, m_Allocator, &m_LogicalDevice) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create logical device!");
 	}
 
 	vkGetDeviceQueue(m_LogicalDevice, indices.graphicsFamily.value(), 0, &m_GraphicsQueue);    //@OtBbNXL[ graphics queue
 	vkGetDeviceQueue(m_LogicalDevice, indices.presentFamily.value(), 0, &m_PresentQueue);      //@v[e[VL[ presentation queue
+
+	// GNXeV֐FIɃ[hĂ܂ifobObZW[Ɠj
+	// extension function, not loaded automatically (same as the debug messenger)
+	if (drawIndirectCountAvailable)
+	{
+		m_pfnCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)
+			vkGetDeviceProcAddr(m_LogicalDevice, "vkCmdDrawIndexedIndirectCountKHR");
+	}
 }
 
 // Xbv`FCi摜̐؂ւj
 void CVulkanFramework::createSwapChain()
 {
+	TRACE_FUNCTION();
+
+	if (m_Headless)    // wbhXFSwapChain̑ɃItXN[摜
+	{
+		createOffscreenTargets();
+		return;
+	}
+
 	// GPUSwapChainT|[gǂݍ
 	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(m_PhysicalDevice);
 
@@ -485,7 +713,13 @@ void CVulkanFramework::createSwapChain()
 	// why +1?
 	// sometimes we may have to wait on the driver to perform internal operations before we can acquire
 	// another image to render to. Therefore it is recommended to request at least one more image than the minimum.
+	// CeV[|V[ŉ摜w肵ꍇ͂g܂iȂFxZAFX[vbgDj
+	// a latency policy may ask for a specific count: fewer images for latency, more for throughput
 	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+	if (m_LatencyPolicy.swapChainImages > 0)
+	{
+		imageCount = std::max(m_LatencyPolicy.swapChainImages, swapChainSupport.capabilities.minImageCount);
+	}
 	if (swapChainSupport.capabilities.maxImageCount > 0                 // zero here means there is no maximum!
 		&& imageCount > swapChainSupport.capabilities.maxImageCount)
 	{
@@ -523,25 +757,83 @@ void CVulkanFramework::createSwapChain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;    // At@`lFs
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;               // TRUE : IN[WꂽsNZ̐F𖳎@don't care about color of obscured pixels
-	createInfo.oldSwapchain = VK_NULL_HANDLE;	// SwapChain̂݁@for now, only create one swap chain
+	createInfo.oldSwapchain = m_SwapChain;		// Đ̏ꍇ͌ÂSwapChaini\[Xp܂j@the swap chain being replaced, if any
 
 	// L̏ɊÂSwapChain𐶐܂B
-	if (vkCreateSwapchainKHR(m_LogicalDevice, &createInfo, nullptr, &m_SwapChain) != VK_SUCCESS)
+	VkSwapchainKHR newSwapChain;
+	if (vkCreateSwapchainKHR(m_LogicalDevice, &createInfo, m_Allocator, &newSwapChain) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create swap chain!");
 	}
 
+	// ÂSwapChaińẢ摜gĂ`悪IĂ폜܂
+	// the retired swap chain is destroyed once the frames using its images have finished
+	if (m_SwapChain != VK_NULL_HANDLE)
+	{
+		VkSwapchainKHR oldSwapChain = m_SwapChain;
+		deferDestruction([this, oldSwapChain]() { vkDestroySwapchainKHR(m_LogicalDevice, oldSwapChain, m_Allocator); });
+	}
+	m_SwapChain = newSwapChain;
+
 	vkGetSwapchainImagesKHR(m_LogicalDevice, m_SwapChain, &imageCount, nullptr);                    // SwapChaiñC[Wl
 	m_SwapChainImages.resize(imageCount);
 	vkGetSwapchainImagesKHR(m_LogicalDevice, m_SwapChain, &imageCount, m_SwapChainImages.data());   // m_SwapChainImagesɑ
 
 	m_SwapChainImageFormat = surfaceFormat.format;
 	m_SwapChainExtent = extent;
+
+	// FIFOł͎擾E\1񕪑҂̂͐łi؂ƂĐ܂j
+	// under FIFO, waiting up to one vblank in acquire and present is normal and not a stall
+	m_ExpectedPresentWaitMilliseconds = 0.0;
+	if (presentMode == VK_PRESENT_MODE_FIFO_KHR || presentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+	{
+#if defined(HEADLESS_ONLY)
+		const double refreshRate = DEFAULT_REFRESH_RATE;
+#else
+		const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+		const double refreshRate = (videoMode != nullptr && videoMode->refreshRate > 0) ? videoMode->refreshRate : DEFAULT_REFRESH_RATE;
+#endif
+		m_ExpectedPresentWaitMilliseconds = 1000.0 / refreshRate;
+	}
+
+	// XVXbh͎̃XibvVbg炱̏cg܂iTCY1t[͑O̔䗦̂܂܁j
+	// the update thread picks the new aspect ratio up from its next snapshot; one frame after a resize may still use the old one
+	m_AspectRatio = extent.width / (float)extent.height;
+}
+
+// wbhXFSwapChain̉摜̑ɁAt[gƂ̃ItXN[̃J[摜ɕ`悵܂
+// Headless: render into one offscreen color image per frame in flight, standing in for the swap chain images
+void CVulkanFramework::createOffscreenTargets()
+{
+	const VkFormat format = VK_FORMAT_B8G8R8A8_SRGB;    // chooseSwapSurfaceFormat()ʏIԃtH[}bgiJ[A^b`gΉ͕K{j
+
+	m_SwapChainImages.resize(m_FramesInFlight);
+	m_OffscreenImagesMemory.resize(m_FramesInFlight);
+	for (uint32_t i = 0; i < m_FramesInFlight; i++)
+	{
+		createImage(
+			WIDTH,
+			HEIGHT,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,    // ǂݖ߂pTRANSFER_SRC
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			m_SwapChainImages[i],
+			m_OffscreenImagesMemory[i]);
+	}
+
+	m_SwapChainImageFormat = format;
+	m_SwapChainExtent = { WIDTH, HEIGHT };
+	m_AspectRatio = WIDTH / (float)HEIGHT;
 }
 
 // vOpC[Wr[
 void CVulkanFramework::createImageViews()
 {
+	TRACE_FUNCTION();
+
 	m_SwapChainImageViews.resize(m_SwapChainImages.size());    // C[WJEgɂăxNgTCYύX܂allocate enough size to fit all image views 					
 	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
 	{
@@ -552,6 +844,8 @@ void CVulkanFramework::createImageViews()
 // _[pX
 void CVulkanFramework::createRenderPass()
 {
+	TRACE_FUNCTION();
+
 	VkAttachmentDescription colorAttachment{};           // J[A^b`g
 	colorAttachment.format = m_SwapChainImageFormat;    // SwapChaintH[}bgƓ@format of color attachment = format of swap chain images
 	colorAttachment.samples = m_MSAASamples;             // }`TvOrbg
@@ -571,7 +865,8 @@ void CVulkanFramework::createRenderPass()
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;     // XeVobt@[gĂȂ
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;    // not using stencil buffer
 
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;                 // _OÕC[WCAEg image layout before render pass
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;  // _OÕC[WCAEgF_[OtJڂ܂
+																				// image layout before render pass; the render graph transitions it
 	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;    // _OÕC[WCAEg layout to automatically transition to after pass
 
 	// ʂ̃CAEg Common Layouts:
@@ -597,6 +892,12 @@ void CVulkanFramework::createRenderPass()
 	colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;    // \[uAv[g邱Ƃł܂
+	if (m_Headless)
+	{
+		// wbhXFPRESENT_SRCVK_KHR_swapchainKvȂ̂ŁAǂݖ߂Ɏg郌CAEgɂ܂
+		// headless: PRESENT_SRC needs VK_KHR_swapchain, so end in a layout a readback can copy from
+		colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	}
 
 	VkAttachmentReference colorAttachmentResolveReference{};
 	colorAttachmentResolveReference.attachment = 2;
@@ -610,7 +911,7 @@ void CVulkanFramework::createRenderPass()
 	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;    // _[OtJڂ܂
 	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 	// fvXA^b`gt@X
@@ -648,358 +949,332 @@ void CVulkanFramework::createRenderPass()
 	renderPassInfo.pDependencies = &dependency;
 
 	// L̍\̂̏ɊÂĎۂ̃_[pX𐶐܂B
-	if (vkCreateRenderPass(m_LogicalDevice, &renderPassInfo, nullptr, &m_RenderPass) != VK_SUCCESS)
+	if (vkCreateRenderPass(m_LogicalDevice, &renderPassInfo, m_Allocator, &m_RenderPass) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create render pass!");
 	}
 }
 
 // \[XCAEgFǂȃ\[Xiobt@[AC[WȂǁjOtBbNXpCvCɃANZX邩
+// SPIR-VtNVŃVF[_[̐錾܂iCAEg̓LbVŋLj
+// Derived from the shaders' own declarations by SPIR-V reflection; identical layouts are shared through the cache
 void CVulkanFramework::createDescriptorSetLayout()
 {
-	VkDescriptorSetLayoutBinding uboLayoutBinding{};    // UniversalBufferObjectCAEgoCfBO\
-	uboLayoutBinding.binding = 0;
-	uboLayoutBinding.descriptorCount = 1;               // MVPgXtH[1̃obt@[IuWFNgɊi[Ă܂
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	uboLayoutBinding.pImmutableSamplers = nullptr;               // C optional, image samplingp
-	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;    // QƂłVF[_[Xe[Wi݁A_VF[_[ŃXNv^[j
+	TRACE_FUNCTION();
 
-	// C[WTv[p Combined Image Sampler
-	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-	samplerLayoutBinding.binding = 1;
-	samplerLayoutBinding.descriptorCount = 1;
-	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerLayoutBinding.pImmutableSamplers = nullptr;
-	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;    // VERTEX_BIT: Heightmap, etc
+	// `pF_VF[_[i0 UBOj{tOgVF[_[i1 Combined Image Samplerj
+	// drawing: vertex shader (0 UBO) plus fragment shader (1 combined image sampler)
+	m_GraphicsReflection = CShaderReflection::reflect(readFile("shaders/vert.spv"));
+	m_GraphicsReflection.merge(CShaderReflection::reflect(readFile("shaders/frag.spv")));
 
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
-	VkDescriptorSetLayoutCreateInfo layoutInfo{};
-	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-	layoutInfo.pBindings = bindings.data();
+	// GPUJOpicull.compjF0 UBOA1 TubVA2 CX^XA3 Ԑڕ`obt@[
+	// culling (cull.comp): 0 UBO, 1 submeshes, 2 instance transforms, 3 indirect draw buffer
+	m_CullReflection = CShaderReflection::reflect(readFile("shaders/cull.spv"));
 
-	if (vkCreateDescriptorSetLayout(m_LogicalDevice, &layoutInfo, nullptr, &m_DescriptorSetLayout) != VK_SUCCESS)
+	// oCĥ̓Zbg0̂
+	// only set 0 is ever bound
+	if (m_GraphicsReflection.getSets().size() > 1 || m_CullReflection.getSets().size() > 1)
 	{
-		throw std::runtime_error("Failed to create descriptor set layout!");
+		throw std::runtime_error("Shaders declare descriptor sets other than set 0!");
 	}
+
+	m_DescriptorSetLayout = m_DescriptorLayoutCache.getLayout(m_LogicalDevice, m_GraphicsReflection.getBindings(0), m_Allocator);
+	m_CullDescriptorSetLayout = m_DescriptorLayoutCache.getLayout(m_LogicalDevice, m_CullReflection.getBindings(0), m_Allocator);
 }
 
-// OtBbNXpCvC
-void CVulkanFramework::createGraphicsPipeline()
+// pCvCLbVFÕLbVt@C̃foCX̂̂łΓǂݍ݂܂
+// Create the pipeline cache, seeded from the cache file if its header matches this device
+void CVulkanFramework::createPipelineCache()
 {
-	const std::vector<char> vertShaderCode = readFile("shaders/vert.spv");    // _VF[_[Ot@C̓ǂݍ
-	const std::vector<char> fragShaderCode = readFile("shaders/frag.spv");    // tOgVF[_[Ot@C̓ǂݍ
-
-	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);     // _VF[_[W[i_f[^AFf[^܂߁j
-	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);     // tOgVF[_[W[
-
-	// VF[_Xe[WFpCvCŃVF[_[𗘗piK	
-	// Shader Stages: Assigning shader code to its specific pipeline stage
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};                    // _VF[_[Xe[W\
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;                   // enum for programmable stages in Graphics Pipeline: Intro
-	vertShaderStageInfo.module = vertShaderModule;
-	vertShaderStageInfo.pName = "main";                                       // _VF[_[Gg[|Cg֐(shaders.vert)
+	TRACE_FUNCTION();
 
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo{};                    // tOgVF[_[Xe[W\
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = fragShaderModule;
-	fragShaderStageInfo.pName = "main";                                       // tOgVF[_[Gg[|Cg֐(shaders.frag)
+	auto startTime = std::chrono::high_resolution_clock::now();
 
-	// pCvC̃^C~OŎg`ɂ܂B
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };    // VF[_[\̔z
-
-	// pCvC̍ۂɕKvȒiK necessary steps in creating a graphics pipeline
-
-	// 1.) _CvbgF_VF[_[ɓn钸_̃tH[}bg
-	// Vertex Input: Format of the vertex data to be passed to the vertex shader
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};    // _Cvbg\
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-	// Vertex\̂VertexBindingDescriptionVertexAttributeDescriptionɎQƂ܂
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+	std::vector<char> cacheData;
+	if (m_PipelineCacheEnabled == true)
+	{
+		std::ifstream file(m_PipelineCachePath.empty() ? PIPELINE_CACHE_PATH : m_PipelineCachePath, std::ios::ate | std::ios::binary);
+		if (file.is_open() == true)
+		{
+			cacheData.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(cacheData.data(), cacheData.size());
+		}
 
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+		if (cacheData.empty() == false && isPipelineCacheCompatible(cacheData) == false)
+		{
+			std::cout << "Pipeline cache file is from another device or driver, starting empty." << std::endl;
+			cacheData.clear();
+		}
+	}
 
-	// 2.) CvbgAZu[F _ǂȃWIg[`悳邩Aăg|W[o[ݒ
-	// Input Assembly: What kind of geometry will be drawn from the vertices, topology member settings
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = cacheData.size();
+	cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
 
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;    // POINT_LISTALINE_LISTALINE_STRIPATRIANGLE_STRIP
-	inputAssembly.primitiveRestartEnable = VK_FALSE;                 //@STRIP̏ꍇACƎOp𕪎Uł܂
+	if (vkCreatePipelineCache(m_LogicalDevice, &cacheInfo, m_Allocator, &m_PipelineCache) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create pipeline cache!");
+	}
+	m_PipelineCacheLoadedSize = cacheData.size();
 
-	// 3.) r[|[gEVU[lp
-	// Viewports and Scissor Rectangles
+	if (m_PipelineCacheLoadedSize > 0)
+	{
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		std::cout << "Pipeline cache loaded: " << m_PipelineCacheLoadedSize << " bytes (" << milliseconds << " ms)" << std::endl;
+	}
+}
 
-	// r[|[gFC[Wt[obt@[܂ł́ugXtH[v        Viewport: 'transformation' from the image to the framebuffer
-	// VU[lpFsNZf[^i[̈Gʏŕ`悳utB^[v  Scissor rectangle: 'filter' in which region pixels will be stored. 
+// pCvC}l[W[NFȂoAg̓[J[XbhŃRpC܂iCXbhE`Xbhcj
+// Start the pipeline manager; missing variants compile on worker threads, leaving cores for the main and render threads
+void CVulkanFramework::createPipelineManager()
+{
+	TRACE_FUNCTION();
 
-	VkViewport viewport{};                                // r[|[g\
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)m_SwapChainExtent.width;      // `惌][VƓ
-	viewport.height = (float)m_SwapChainExtent.height;    // `惌][VƓ
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
+	const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+	const uint32_t workerCount = (hardwareThreads > 2) ? std::min(hardwareThreads - 2, 4u) : 1;
 
-	VkRect2D scissor{};                     // VU[lp\				
-	scissor.offset = { 0, 0 };              // ItZbgȂ
-	scissor.extent = m_SwapChainExtent;     // t[obt@[Ŝ`悷ݒ set to draw the entire framebuffer
-
-	VkPipelineViewportStateCreateInfo viewportState{};    // r[|[gXe[giԁj\
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;                 // r[|[g̃|C^[
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;                   // VU[lp̃|C^[
-
-	// 4.) X^CU[F_VF[_[̃WIg[iVF[vjtOgisNZjɕϊĐFt܂B 
-	// Rasterizer: Takes geomerty shaped from the vertex shader and turns it into fragments (pixels) to be colored by the fragment shader.
-
-	VkPipelineRasterizationStateCreateInfo rasterizer{};    // X^CU[\
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	// VK_TRUE: jA\Et@[̈̃tOĝĂɋEɃNv܂BVhE}bsOɕ֗B
-	// VK_TRUE: fragments beyond near and far planes are clamped to them rather than discarding them; useful with shadow mapping
-
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	// FILL: tOgɖߍ fill area of polygon with fragments
-	// LINE: Cŕ`iC[t[j@polygon edges drawn as lines (i.e. wireframe)
-	// POINT: _ŕ`@polygon vertices are drawn as points
-	// FILLȊȌꍇAGPU@\IɂKv܂BUsing anything other than FILL requires enabling a GPU feature.
-
-	rasterizer.lineWidth = 1.0f;    // ČisNZPʁjLine thickness (in pixels)
-	// 1.0ȏ̌̏ꍇAGPU@\IɂKv܂BUsing line width greater than 1.0f requires enabling a GPU feature.
-
-	rasterizer.cullMode = VK_CULL_MODE_NONE;                    // JOݒiʏFBackfaceCulling)
-																// VK_CULL_MODE_BACK_BIT
-
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;     // _̏Ԃɂ\ʁEʂ𔻒fݒivEvj
-																// determines front-facing by vertex order (CLOCKWISE or COUNTER_CLOCKWISE) 
-	rasterizer.depthBiasEnable = VK_FALSE;        // VK_TRUE: DepthliVhE}bsOjAdjusting depth values i.e. for shadow mapping
-	rasterizer.depthBiasConstantFactor = 0.0f;    // C optional
-	rasterizer.depthBiasClamp = 0.0f;             // C optional
-	rasterizer.depthBiasSlopeFactor = 0.0f;       // C optional
-
-	// 5.) }`TvOiA`GCAVOpj 
-	// Multisampling (method to perform anti-aliasing)
-
-	VkPipelineMultisampleStateCreateInfo multisampling{};    // }`TvO\
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_TRUE;             // TvVF[fBOL
-	multisampling.rasterizationSamples = m_MSAASamples;      // }`TvOL
-	multisampling.minSampleShading = 0.2f;                   // 1.0ɋ߂΋߂قǃX[YȂ
-	multisampling.pSampleMask = nullptr;                     // C optional
-	multisampling.alphaToCoverageEnable = VK_FALSE;          // C optional
-	multisampling.alphaToOneEnable = VK_FALSE;               // C optionall
-
-	// 6.)@fvXEXeV
-	// Depth and Stencil Testing 
-
-	VkPipelineDepthStencilStateCreateInfo depthStencil{};
-	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;     // VtOg̃fvXfvXobt@[Ɣr邩idiscard)
-	depthStencil.depthWriteEnable = VK_TRUE;    // fvXeXgitOg̃fvXfvXobt@[ɏނ
-
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;    // fvXႢF߂
-	depthStencil.depthBoundsTestEnable = VK_FALSE;       // fvXoEheXgpiTRUE: Bounds̃tOgۗ܂j
-	depthStencil.minDepthBounds = 0.0f;                  // C optional
-	depthStencil.maxDepthBounds = 1.0f;                  // C optional
-
-	depthStencil.stencilTestEnable = VK_FALSE;           // XeVobt@[p
-	depthStencil.front = {};                             // C optional
-	depthStencil.back = {};                              // C optional  
-
-	// 7.) J[ufBOF@t[obt@[̊̐Fƍ邩AAOƐVlBitwiseZō邩
-	// Color Blending: Either @ mix the old value (in the framebuffer) and new value, or A perform a bitwise operation with the two values
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment{};         // J[uh\
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT      // @̃ufBO
-		| VK_COLOR_COMPONENT_G_BIT
-		| VK_COLOR_COMPONENT_B_BIT
-		| VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;                        // L̃RgB
-	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;     // C optional
-	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;    // C optional
-	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;                // C optional
-	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;     // C optional
-	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;    // C optional
-	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;                // C optional
-
-	// blendEnableVK_TRUȄꍇ̃ufBOݒi^j
-	// if (blendEnable) 
-	//	{
-	//		finalColor.rgb = (srcColorBlendFactor * newColor.rgb) < colorBlendOp > (dstColorBlendFactor * oldColor.rgb);
-	//		finalColor.a = (srcAlphaBlendFactor * newColor.a) < alphaBlendOp > (dstAlphaBlendFactor * oldColor.a);
-	// }
-	// else 
-	// {
-	//		finalColor = newColor;
-	// }
-	// finalColor = finalColor & colorWriteMask;
-
-	// At@ufBO̗i^j
-	// Alpha Blending Implementation: (pseudocode)
-	// finalColor.rgb = newAlpha * newColor + (1 - newAlpha) * oldColor;
-	// finalAlpha.a = newAlpha.a;
-
-	// At@ufBOݒF
-	//colorBlendAttachment.blendEnable = VK_TRUE;
-	//colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	//colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	//colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-	//colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	//colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	//colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending{};    // pCvCJ[uhXe[g\
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;       // VK_TRUE: ÃxfBO
-	colorBlending.logicOp = VK_LOGIC_OP_COPY;     // C optional
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-	colorBlending.blendConstants[0] = 0.0f;       // C optional
-	colorBlending.blendConstants[1] = 0.0f;       // C optional
-	colorBlending.blendConstants[2] = 0.0f;       // C optional
-	colorBlending.blendConstants[3] = 0.0f;       // C optional
-
-	// 8.) _Ci~bNXe[giŏڂׂ܂j
-	VkDynamicState dynamicStates[] =
-	{
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_LINE_WIDTH
-	};
+	m_PipelineManager.init(m_LogicalDevice, m_PipelineCache, workerCount, m_Allocator);
+}
 
-	VkPipelineDynamicStateCreateInfo dynamicState{};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = 2;
-	dynamicState.pDynamicStates = dynamicStates;
+// pCvCCAEgFfXNv^[Zbg{`悲Ƃ̃vbV萔i_[pXɈˑȂ߁A1񂾂j
+// Pipeline Layout: descriptor set plus per-draw push constants; independent of the render pass, so created once
+void CVulkanFramework::createPipelineLayout()
+{
+	TRACE_FUNCTION();
 
-	// 9.) pCvCCAEgiŏڂׂ܂j
-	// Pipeline Layout (empty for now, revisit later)
+	// vbV萔ifsE}eAԍjFtNV͈̔͂DrawPushConstantsƍĂ邩mF܂
+	// push constants (model matrix, material index); the reflected range must match DrawPushConstants
+	const VkPushConstantRange pushConstantRange = m_GraphicsReflection.getPushConstantRange();
+	if (pushConstantRange.offset != 0 || pushConstantRange.size != sizeof(DrawPushConstants))
+	{
+		throw std::runtime_error("Shader push constant block does not match DrawPushConstants!");
+	}
 
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};     // pCvCCAEg\
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutInfo.setLayoutCount = 1;
 	pipelineLayoutInfo.pSetLayouts = &m_DescriptorSetLayout;     // ŃXNv^[ZbgCAEg
-	pipelineLayoutInfo.pushConstantRangeCount = 0;               // C optional
-	pipelineLayoutInfo.pPushConstantRanges = nullptr;            // C optional
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 	// L̍\̂̏ɊÂĎۂ̃pCvCCAEg𐶐܂B
-	if (vkCreatePipelineLayout(m_LogicalDevice, &pipelineLayoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
+	if (vkCreatePipelineLayout(m_LogicalDevice, &pipelineLayoutInfo, m_Allocator, &m_PipelineLayout) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create pipeline layout!");
 	}
+}
 
-	// 10.) OtBbNXpCvCFS̒iKgݍ킹ăpCvC𐶐܂B
-	// ȂOɂ̂悤ɃOtBbNXpCvC\̂𐶐Kv܂B
-	// Graphics Pipeline creation: Putting everything together to create the pipeline!!
-	// ...but before that, we need to create a Pipeline info struct:
-
-	VkGraphicsPipelineCreateInfo pipelineInfo{};    // pCvC\
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;                    // VF[_[Xe[Wɍ킹	 Make sure this info is aligned with Shader Stages above
-	pipelineInfo.pStages = shaderStages;            // VF[_[Xe[Wz̃|C^[
-
-	// ܂ł̒iKpCvC\̏|C^[ɎQƂ܂B
-	// reference all the structures described in the previous stages
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = &depthStencil;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr;             // C optional
+// OtBbNXpCvCFXe[gCPipelineManagerŃnbVAoAgƂĊǗ܂
+// Describe the default pipeline state; CPipelineManager hashes it and owns the resulting variant
+void CVulkanFramework::createGraphicsPipeline()
+{
+	TRACE_FUNCTION();
 
-	// pipelineInfo.flags - ݂ȂBL basePipelineHandleƁ@basePipelineHandleIndexB
-	// none at the moment; see basePipelineHandle and basePipelineIndex below
+	m_GraphicsPipelineDesc = GraphicsPipelineDesc{};
+	m_GraphicsPipelineDesc.vertShaderPath = "shaders/vert.spv";    // _VF[_[Ot@C
+	m_GraphicsPipelineDesc.fragShaderPath = "shaders/frag.spv";    // tOgVF[_[Ot@C
 
-	// pCvCCAEgF\̃|C^[ł͂ȂAVulkannh
-	// pipeline layout: Vulkan handle, NOT struct pointer
-	pipelineInfo.layout = m_PipelineLayout;
+	// _͂͒_VF[_[̃tNVFP[V0`2̓oCfBO0i_ƁAVertexjA
+	// P[V3ȍ~̓oCfBO1iCX^XƁAInstanceDatajBXgCh͍\̂̃TCYƔr܂
+	// vertex input from the reflected vertex shader: locations 0-2 go to binding 0 (per vertex, Vertex),
+	// locations 3+ to binding 1 (per instance, InstanceData); strides are checked against the C++ structs
+	m_GraphicsReflection.getVertexInput(
+		{
+			{ 0, 0, VK_VERTEX_INPUT_RATE_VERTEX, sizeof(Vertex) },
+			{ 1, 3, VK_VERTEX_INPUT_RATE_INSTANCE, sizeof(InstanceData) }
+		},
+		m_GraphicsPipelineDesc.vertexBindings,
+		m_GraphicsPipelineDesc.vertexAttributes);
+
+	m_GraphicsPipelineDesc.cullMode = VK_CULL_MODE_NONE;       // JOݒiʏFBackfaceCulling)
+	m_GraphicsPipelineDesc.samples = m_MSAASamples;            // }`TvOL
+	m_GraphicsPipelineDesc.layout = m_PipelineLayout;
+	m_GraphicsPipelineDesc.renderPass = m_RenderPass;
+	m_GraphicsPipelineDesc.subpass = 0;
+
+	// ꉻ萔F^COE_J[EAt@eXgȂǂ̓pCvCɌŒiSPIR-V1̂܂܁j
+	// specialization constants fix tiling, vertex color, alpha test etc. at pipeline creation from a single SPIR-V
+	m_GraphicsPipelineDesc.specializationConstants = m_ShaderFeatures.getSpecializationConstants();
+
+	// _[pX݊FA^b`g̃tH[}bgƃTvł΁ApCvCg܂
+	// render pass compatibility: attachments with the same formats and sample counts can share pipelines
+	m_GraphicsPipelineDesc.renderPassKey = (uint64_t(m_SwapChainImageFormat) << 32)
+		| (uint64_t(findDepthFormat()) << 8)
+		| uint64_t(m_MSAASamples);
+
+	// ftHgpCvC͑pitH[obNjɂȂ̂ŁA̓RpC҂܂
+	// the default pipeline doubles as the fallback, so this is the one variant we wait for
+	auto pipelineStartTime = std::chrono::high_resolution_clock::now();
+	m_GraphicsPipeline = m_PipelineManager.getPipelineBlocking(m_GraphicsPipelineDesc);
+	m_PipelineBuildMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelineStartTime).count();
+
+	// }jtFXg̃oAg̓[J[XbhŎORpCĩ_[pXpj
+	// pre-warm the manifest variants for this render pass on the worker threads
+	const size_t prewarmCount = m_PipelineManager.prewarm(PIPELINE_MANIFEST_PATH, m_GraphicsPipelineDesc);
+	if (prewarmCount > 0)
+	{
+		std::cout << "Pre-warming " << prewarmCount << " pipeline variants in the background" << std::endl;
+	}
 
-	// _[pXƃTupX̎Q
-	// reference to the render pass and the subpass index
-	pipelineInfo.renderPass = m_RenderPass;
-	pipelineInfo.subpass = 0;
+	createSubmeshPipelines();    // f̓ǂݍݑOij͉܂
+}
 
-	// pipelineInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT̏ꍇF
-	// ̃pCvC̏VȃpCvCɎgp܂B
-	// these values are only used if the VK_PIPELINE_CREATE_DERIVATIVE_BIT flag 
-	// is also specified in the flags field of VkGraphicsPipelineCreateInfo
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;    // C optional
-	pipelineInfo.basePipelineIndex = -1;                 // C optional
+// TubVƂ̃oAgFftHg̃Xe[gɃ}eA𔽉f܂i}jtFXg̎ORpCƓXe[gj
+// Per-submesh variants: the default state with the material applied, matching the pre-warmed manifest lines
+void CVulkanFramework::createSubmeshPipelines()
+{
+	m_SubmeshPipelines.clear();
+	std::vector<uint64_t> variantKeys = { m_GraphicsPipelineDesc.hash() };    // ԍ0FftHg
 
-	// L̍\̂̏ɊÂāA悤₭ۂ̃OtBbNXpCvCł܂B
-	// 2ڂ̈FpCvCLbV(Œׂ܂j
-	// Creating the actual graphics pipeline from data struct
-	// Second argument: pipeline cache (revisit later)
-	if (vkCreateGraphicsPipelines(m_LogicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_GraphicsPipeline) != VK_SUCCESS)
+	for (const SubmeshMaterial& material : m_SubmeshMaterials)
 	{
-		throw std::runtime_error("Failed to create graphics pipeline!");
+		SubmeshPipeline submeshPipeline;
+		submeshPipeline.desc = m_GraphicsPipelineDesc;
+		if (material.transparent)
+		{
+			submeshPipeline.desc.alphaBlend = true;
+			submeshPipeline.desc.depthWrite = false;
+		}
+		if (material.alphaTest && submeshPipeline.desc.specializationConstants.size() > 2)
+		{
+			submeshPipeline.desc.specializationConstants[2] = 1;    // ShaderFeatures::alphaTest
+		}
+
+		const uint64_t key = submeshPipeline.desc.hash();
+		auto variant = std::find(variantKeys.begin(), variantKeys.end(), key);
+		submeshPipeline.pipelineId = static_cast<uint32_t>(variant - variantKeys.begin());
+		if (variant == variantKeys.end())
+		{
+			variantKeys.push_back(key);
+			m_PipelineManager.getPipeline(submeshPipeline.desc);    // ܂Ȃ΃obNOEhŃRpCJn
+		}
+		m_SubmeshPipelines.push_back(submeshPipeline);
 	}
+}
 
-	// pς݂̃VF[_[W[폜܂B
-	vkDestroyShaderModule(m_LogicalDevice, fragShaderModule, nullptr);
-	vkDestroyShaderModule(m_LogicalDevice, vertShaderModule, nullptr);
+// pCvCoAg̎擾FRpC̏ꍇ̓ftHgpCvCőp܂iCXbh͑҂܂j
+// Look up a pipeline variant without stalling; falls back to the default pipeline while it compiles
+VkPipeline CVulkanFramework::resolvePipeline(const GraphicsPipelineDesc& desc)
+{
+	const VkPipeline pipeline = m_PipelineManager.getPipeline(desc);
+	return (pipeline != VK_NULL_HANDLE) ? pipeline : m_GraphicsPipeline;
 }
 
-// }`TvOpJ[obt@[𐶐
-void CVulkanFramework::createColorResources()
+// GPUJOpRs[gpCvCiSwapChainɈˑȂ߁A1񂾂j
+// Compute pipeline for GPU-driven culling; independent of the swap chain, so created once
+void CVulkanFramework::createCullPipeline()
 {
-	VkFormat colorFormat = m_SwapChainImageFormat;
+	TRACE_FUNCTION();
 
-	createImage(
-		m_SwapChainExtent.width,
-		m_SwapChainExtent.height,
-		1,
-		m_MSAASamples,
-		colorFormat,
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		m_ColorImage,
-		m_ColorImageMemory
-	);
+	const std::vector<char> cullShaderCode = readFile("shaders/cull.spv");
+	VkShaderModule cullShaderModule = createShaderModule(cullShaderCode);
 
-	// }`TvOpC[Wr[̍ۂɃ~bv}bv́u1vɐݒ肵ȂƂ܂iVulkaň܂j
-	// ̃C[Wr[̓eNX`[ƂĎgȂ̂ŕ`iɉe܂
-	// Mipmap levels must be set to 1 when creating an image with more than one sample per pixel,
-	// as per Vulkan specifications.  As this image will not be used as a texture, it will not affect quality
-	m_ColorImageView = createImageView(m_ColorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	VkPipelineShaderStageCreateInfo cullShaderStageInfo{};
+	cullShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	cullShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	cullShaderStageInfo.module = cullShaderModule;
+	cullShaderStageInfo.pName = "main";
+
+	const VkPushConstantRange pushConstantRange = m_CullReflection.getPushConstantRange();
+	if (pushConstantRange.offset != 0 || pushConstantRange.size != sizeof(CullParams))
+	{
+		throw std::runtime_error("Culling shader push constant block does not match CullParams!");
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_CullDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(m_LogicalDevice, &pipelineLayoutInfo, m_Allocator, &m_CullPipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create culling pipeline layout!");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = cullShaderStageInfo;
+	pipelineInfo.layout = m_CullPipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	auto pipelineStartTime = std::chrono::high_resolution_clock::now();
+	if (vkCreateComputePipelines(m_LogicalDevice, m_PipelineCache, 1, &pipelineInfo, m_Allocator, &m_CullPipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create culling pipeline!");
+	}
+	m_PipelineBuildMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelineStartTime).count();
+
+	vkDestroyShaderModule(m_LogicalDevice, cullShaderModule, m_Allocator);
 }
 
-// fvX\[X
-void CVulkanFramework::createDepthResources()
+// }`TvOpJ[obt@[EfvX\[X𐶐
+// Create the MSAA color and depth attachments: one image per physical image of the frame graph's transients
+//   t[̃OtgWFg𓯂ɐ錾̂ŁA摜̊蓖Ă͓ł
+//   the per-frame graph declares the same transients in the same order, so it assigns the same physical images
+void CVulkanFramework::createAttachmentResources()
 {
-	VkFormat depthFormat = findDepthFormat();
-	createImage(
-		m_SwapChainExtent.width,
-		m_SwapChainExtent.height,
-		1,
-		m_MSAASamples,
-		depthFormat,
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		m_DepthImage,
-		m_DepthImageMemory
-	);
-	m_DepthImageView = createImageView(m_DepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+	TRACE_FUNCTION();
+
+	m_ColorAttachmentDesc = RenderGraphImageDesc{};
+	m_ColorAttachmentDesc.format = m_SwapChainImageFormat;
+	m_ColorAttachmentDesc.extent = m_SwapChainExtent;
+	m_ColorAttachmentDesc.samples = m_MSAASamples;
+	m_ColorAttachmentDesc.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	m_ColorAttachmentDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+	// }`TvOpC[W̃~bv}bv́u1viVulkaň܂j
+	// images with more than one sample per pixel must have a single mip level, as per Vulkan specifications
+	m_ColorAttachmentDesc.mipLevels = 1;
+
+	// CAEg̑Jڂ̓XeV܂߂܂ir[̓fvX̂݁j
+	// layout transitions cover the stencil aspect too; the view only uses depth
+	const VkFormat depthFormat = findDepthFormat();
+	m_DepthAttachmentDesc = m_ColorAttachmentDesc;
+	m_DepthAttachmentDesc.format = depthFormat;
+	m_DepthAttachmentDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	m_DepthAttachmentDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencilComponent(depthFormat) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+
+	CRenderGraph graph;
+	CRenderGraph::ResourceHandle color;
+	CRenderGraph::ResourceHandle depth;
+	addMainPass(graph, color, depth);
+	graph.compile();
+
+	m_AttachmentImages.resize(graph.getPhysicalImageCount());
+	m_AttachmentImagesMemory.resize(graph.getPhysicalImageCount());
+	for (uint32_t i = 0; i < graph.getPhysicalImageCount(); i++)
+	{
+		const RenderGraphImageDesc& desc = graph.getPhysicalImageDesc(i);
+		createImage(
+			desc.extent.width,
+			desc.extent.height,
+			desc.mipLevels,
+			desc.samples,
+			desc.format,
+			VK_IMAGE_TILING_OPTIMAL,
+			desc.usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			m_AttachmentImages[i],
+			m_AttachmentImagesMemory[i]
+		);
+	}
+
+	// ̃C[Wr[̓eNX`[ƂĎgȂ̂ŕ`iɉe܂
+	// As these views will not be used as textures, the single mip level does not affect quality
+	m_ColorImageView = createImageView(m_AttachmentImages[graph.getPhysicalImageIndex(color)], m_ColorAttachmentDesc.format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	m_DepthImageView = createImageView(m_AttachmentImages[graph.getPhysicalImageIndex(depth)], depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 }
 
 // t[obt@[
 void CVulkanFramework::createFramebuffers()
 {
+	TRACE_FUNCTION();
+
 	m_SwapChainFramebuffers.resize(m_SwapChainImageViews.size());
 
 	for (size_t i = 0; i < m_SwapChainImageViews.size(); i++)
@@ -1018,7 +1293,7 @@ void CVulkanFramework::createFramebuffers()
 		framebufferInfo.height = m_SwapChainExtent.height;
 		framebufferInfo.layers = 1;                         // 1: 1̃C[WȂꍇ Swap chain images as single images
 
-		if (vkCreateFramebuffer(m_LogicalDevice, &framebufferInfo, nullptr, &m_SwapChainFramebuffers[i]) != VK_SUCCESS)
+		if (vkCreateFramebuffer(m_LogicalDevice, &framebufferInfo, m_Allocator, &m_SwapChainFramebuffers[i]) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create framebuffer!");
 		}
@@ -1028,16 +1303,20 @@ void CVulkanFramework::createFramebuffers()
 // R}hobt@[i[R}hv[𐶐
 void CVulkanFramework::createCommandPool()
 {
+	TRACE_FUNCTION();
+
 	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(m_PhysicalDevice);
 
 	VkCommandPoolCreateInfo poolInfo{};    // R}hv[\
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();    // `悷邽߃OtBbNXL[I܂
 																			  // drawing commands: graphics queue family chosen
-	poolInfo.flags = 0;    // optional C
+	// R}hobt@[𖈃t[ēo^邽߁AʃZbg܂
+	// command buffers are re-recorded every frame, so allow resetting them individually
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 	// L̍\̂̏ɊÂĎۂ̃R}hv[𐶐܂B
-	if (vkCreateCommandPool(m_LogicalDevice, &poolInfo, nullptr, &m_CommandPool) != VK_SUCCESS)
+	if (vkCreateCommandPool(m_LogicalDevice, &poolInfo, m_Allocator, &m_CommandPool) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create graphics command pool!");
 	}
@@ -1046,6 +1325,8 @@ void CVulkanFramework::createCommandPool()
 // eNX`[}bsOp摜pӂ܂
 void CVulkanFramework::createTextureImage()
 {
+	TRACE_FUNCTION();
+
 	int texWidth, texHeight, texChannels;
 
 	// STBI_rgb_alpha: `lȂꍇAIɒǉ܂B
@@ -1077,6 +1358,7 @@ void CVulkanFramework::createTextureImage()
 	void* data;
 	vkMapMemory(m_LogicalDevice, stagingBufferMemory, 0, imageSize, 0, &data);
 	memcpy(data, pixels, static_cast<size_t>(imageSize));
+	m_UploadBytesMetric.add(imageSize);
 	vkUnmapMemory(m_LogicalDevice, stagingBufferMemory);
 
 	// pς݃sNZz폜
@@ -1096,38 +1378,57 @@ void CVulkanFramework::createTextureImage()
 		m_TextureImageMemory
 	);
 
-	transitionImageLayout(
-		m_TextureImage,
-		VK_FORMAT_R8G8B8A8_SRGB,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		m_MipLevels);
+	// Abv[hFCAEgJڂ̓_[OtvZ܂i~bv}bv܂1̒oj
+	// upload; the graph derives the layout transition, and the copy and mip generation share one submit
+	CRenderGraph uploadGraph;
+	const CRenderGraph::ResourceHandle staging = uploadGraph.importBuffer("staging", stagingBuffer);
+	const CRenderGraph::ResourceHandle texture = uploadGraph.importImage("texture", m_TextureImage, VK_IMAGE_ASPECT_COLOR_BIT, m_MipLevels,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);    // generateMipmaps()TRANSFER_DST
 
-	// Rs[s
-	copyBufferToImage(
-		stagingBuffer,
-		m_TextureImage,
-		static_cast<uint32_t>(texWidth),
-		static_cast<uint32_t>(texHeight)
-	);
+	// Rs[
+	const uint32_t uploadPass = uploadGraph.addPass("upload", [&](VkCommandBuffer commandBuffer)
+		{
+			copyBufferToImage(
+				commandBuffer,
+				stagingBuffer,
+				m_TextureImage,
+				static_cast<uint32_t>(texWidth),
+				static_cast<uint32_t>(texHeight)
+			);
+		});
+	uploadGraph.use(uploadPass, staging, ResourceUsage::TransferRead);
+	uploadGraph.use(uploadPass, texture, ResourceUsage::TransferWrite);
+	uploadGraph.compile();
 
-	// Еt
-	vkDestroyBuffer(m_LogicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(m_LogicalDevice, stagingBufferMemory, nullptr);
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	uploadGraph.execute(commandBuffer);
 
 	// ~bv}bv
-	generateMipmaps(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, m_MipLevels);
+	generateMipmaps(commandBuffer, m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, m_MipLevels);
+	endUploadCommands(commandBuffer);
+
+	// ЕtFAbv[h̊ɍ폜܂i҂܂j
+	// cleanup once the upload has completed on the timeline; no wait here
+	deferDestruction([this, stagingBuffer, stagingBufferMemory]()
+	{
+		vkDestroyBuffer(m_LogicalDevice, stagingBuffer, m_Allocator);
+		freeDeviceMemory(stagingBufferMemory);
+	});
 }
 
 // createTextureImage()̃C[WC[Wr[𐶐
 void CVulkanFramework::createTextureImageView()
 {
+	TRACE_FUNCTION();
+
 	m_TextureImageView = createImageView(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, m_MipLevels);
 }
 
 // eNX`[Tv[FFiltering (Bilinear, AnisotropicȂ)AAddressingModeȂ
 void CVulkanFramework::createTextureSampler()
 {
+	TRACE_FUNCTION();
+
 	VkSamplerCreateInfo samplerInfo{};    // Tv[\
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 
@@ -1172,7 +1473,7 @@ void CVulkanFramework::createTextureSampler()
 	samplerInfo.minLod = 0.0f;
 	samplerInfo.maxLod = static_cast<float>(m_MipLevels);
 
-	if (vkCreateSampler(m_LogicalDevice, &samplerInfo, nullptr, &m_TextureSampler) != VK_SUCCESS)
+	if (vkCreateSampler(m_LogicalDevice, &samplerInfo, m_Allocator, &m_TextureSampler) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create texture sampler!");
 	}
@@ -1180,23 +1481,43 @@ void CVulkanFramework::createTextureSampler()
 
 // f̃[h
 void CVulkanFramework::loadModel()
+{
+	TRACE_FUNCTION();
+
+	parseModel(MODEL_PATH, m_Vertices, m_Indices, m_Submeshes, m_ModelBoundingSphere, &m_SubmeshMaterials);
+	createSubmeshPipelines();    // pCvC̓fɐς
+}
+
+// OBJ̓ǂݍ݂ƒ_dtB^[iCPÛ݁AAZbgx`}[NĂяo܂j
+// OBJ parse and vertex dedup; CPU only, so the asset benchmark can run it without a device
+void CVulkanFramework::parseModel(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+	std::vector<Submesh>& submeshes, glm::vec4& boundingSphere, std::vector<SubmeshMaterial>* submeshMaterials)
 {
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
 	std::string warn, error;
 
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &error, MODEL_PATH.c_str()))    // Triangulate Faces by default
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &error, path.c_str()))    // Triangulate Faces by default
 	{
 		throw std::runtime_error(warn + error);
 	}
 
 	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	glm::vec3 modelBoundsMin(FLT_MAX);
+	glm::vec3 modelBoundsMax(-FLT_MAX);
 
 	// SĂ̎OpIterateāA1̃fɂ܂Ƃ߂܂
 	// Iterate over all the shapes to combine all the faces into a single model
 	for (const auto& shape : shapes)
 	{
+		// VFCvƂɃTubViCfbNX͈́EE{bNXjL^܂
+		// record each shape as a submesh (index range + bounds)
+		Submesh submesh{};
+		submesh.firstIndex = static_cast<uint32_t>(indices.size());
+		glm::vec3 boundsMin(FLT_MAX);
+		glm::vec3 boundsMax(-FLT_MAX);
+
 		for (const auto& index : shape.mesh.indices)
 		{
 			Vertex vertex{};
@@ -1217,23 +1538,68 @@ void CVulkanFramework::loadModel()
 			// _dtB^[
 			if (uniqueVertices.count(vertex) == 0)
 			{
-				uniqueVertices[vertex] = static_cast<uint32_t>(m_Vertices.size());
-				m_Vertices.push_back(vertex);
+				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertex);
 			}
-			m_Indices.push_back(uniqueVertices[vertex]);
+			indices.push_back(uniqueVertices[vertex]);
 
 			// tB^[Ȃ
-			//m_Vertices.push_back(vertex);
-			//m_Indices.push_back(m_Indices.size());
+			//vertices.push_back(vertex);
+			//indices.push_back(indices.size());
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				boundsMin[axis] = std::min(boundsMin[axis], vertex.pos[axis]);
+				boundsMax[axis] = std::max(boundsMax[axis], vertex.pos[axis]);
+			}
+		}
+
+		submesh.indexCount = static_cast<uint32_t>(indices.size()) - submesh.firstIndex;
+		if (submesh.indexCount == 0)
+		{
+			continue;
+		}
+
+		// EF{bNX̒SƑΊp̔
+		// bounding sphere: box center, half the diagonal
+		const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		submesh.boundingSphere = glm::vec4(center, glm::length(boundsMax - center));
+		submeshes.push_back(submesh);
+
+		// }eAFVFCv̍ŏ̖ʂ̂́iMTLȂFsj
+		// material of the shape's first face; opaque when there is no MTL
+		if (submeshMaterials != nullptr)
+		{
+			SubmeshMaterial submeshMaterial;
+			const int materialId = shape.mesh.material_ids.empty() ? -1 : shape.mesh.material_ids[0];
+			if (materialId >= 0 && materialId < static_cast<int>(materials.size()))
+			{
+				submeshMaterial.transparent = materials[materialId].dissolve < 1.0f;
+				submeshMaterial.alphaTest = materials[materialId].alpha_texname.empty() == false;
+			}
+			submeshMaterials->push_back(submeshMaterial);
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			modelBoundsMin[axis] = std::min(modelBoundsMin[axis], boundsMin[axis]);
+			modelBoundsMax[axis] = std::max(modelBoundsMax[axis], boundsMax[axis]);
 		}
 	}
+
+	// fŜ̋EiCPUJOpj
+	// whole-model bounding sphere, used by the CPU culler
+	const glm::vec3 modelCenter = (modelBoundsMin + modelBoundsMax) * 0.5f;
+	boundingSphere = glm::vec4(modelCenter, glm::length(modelBoundsMax - modelCenter));
 	// _mFEr
-	// std::cout << "_: "  << m_Vertices.size() << std::endl;
+	// std::cout << "_: "  << vertices.size() << std::endl;
 }
 
 // _obt@[
 void CVulkanFramework::createVertexBuffer()
 {
+	TRACE_FUNCTION();
+
 	// _P @z̗vf
 	VkDeviceSize bufferSize = sizeof(m_Vertices[0]) * m_Vertices.size();
 
@@ -1253,6 +1619,7 @@ void CVulkanFramework::createVertexBuffer()
 	// [Ƀ}bv
 	vkMapMemory(m_LogicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
 	memcpy(data, m_Vertices.data(), (size_t)bufferSize);
+	m_UploadBytesMetric.add(bufferSize);
 	vkUnmapMemory(m_LogicalDevice, stagingBufferMemory);
 
 	// _obt@[𐶐܂
@@ -1266,14 +1633,19 @@ void CVulkanFramework::createVertexBuffer()
 	// _f[^Xe[WOobt@[璸_obt@[Ɉڂ
 	copyBuffer(stagingBuffer, m_VertexBuffer, bufferSize);
 
-	// pς݂̃Xe[WOobt@[ƃ[̌Еt
-	vkDestroyBuffer(m_LogicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(m_LogicalDevice, stagingBufferMemory, nullptr);
+	// pς݂̃Xe[WOobt@[ƃ[̌ЕtiRs[̊A҂܂j
+	deferDestruction([this, stagingBuffer, stagingBufferMemory]()
+	{
+		vkDestroyBuffer(m_LogicalDevice, stagingBuffer, m_Allocator);
+		freeDeviceMemory(stagingBufferMemory);
+	});
 }
 
 // CfbNXobt@[F_obt@[ƂقړiႢ͔Ԍ@@AAŕ\Ă܂
 void CVulkanFramework::createIndexBuffer()
 {
+	TRACE_FUNCTION();
+
 	// CfbNXPʁ@@z̗vf
 	VkDeviceSize bufferSize = sizeof(m_Indices[0]) * m_Indices.size();    // ύX_@@AA
 
@@ -1290,6 +1662,7 @@ void CVulkanFramework::createIndexBuffer()
 	void* data;
 	vkMapMemory(m_LogicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
 	memcpy(data, m_Indices.data(), (size_t)bufferSize);        // ύX_@B vertices.data() --> indices.data()
+	m_UploadBytesMetric.add(bufferSize);
 	vkUnmapMemory(m_LogicalDevice, stagingBufferMemory);
 
 	// CfbNXobt@[𐶐܂
@@ -1303,14 +1676,95 @@ void CVulkanFramework::createIndexBuffer()
 	// CfbNXf[^Xe[WOobt@[CfbNXobt@[Ɉڂ
 	copyBuffer(stagingBuffer, m_IndexBuffer, bufferSize);    // ύX_@F@Rs[CfbNXobt@[
 
-	// pς݂̃Xe[WOobt@[ƃ[̌Еt
-	vkDestroyBuffer(m_LogicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(m_LogicalDevice, stagingBufferMemory, nullptr);
+	// pς݂̃Xe[WOobt@[ƃ[̌ЕtiRs[̊A҂܂j
+	deferDestruction([this, stagingBuffer, stagingBufferMemory]()
+	{
+		vkDestroyBuffer(m_LogicalDevice, stagingBuffer, m_Allocator);
+		freeDeviceMemory(stagingBufferMemory);
+	});
+}
+
+// TubVobt@[FGPUJOp̋EECfbNX͈́iCfbNXobt@[Ɠ菇j
+// Submesh buffer: bounds and index ranges for GPU culling (same staging steps as the index buffer)
+void CVulkanFramework::createSubmeshBuffer()
+{
+	TRACE_FUNCTION();
+
+	// pCvCoAgƂ1̊Ԑڕ`͈̔́Fobt@[̓oAgԍ̏i`L[Ɠjɕׂ܂
+	// one indirect draw range per pipeline variant; the buffer is laid out by variant number, the draw key's order
+	std::map<uint32_t, std::vector<uint32_t>> submeshesByVariant;
+	for (uint32_t submeshIndex = 0; submeshIndex < m_Submeshes.size(); submeshIndex++)
+	{
+		submeshesByVariant[m_SubmeshPipelines[submeshIndex].pipelineId].push_back(submeshIndex);
+	}
+
+	std::vector<Submesh> orderedSubmeshes;
+	m_DrawRanges.clear();
+	for (const auto& variant : submeshesByVariant)
+	{
+		DrawRange range{};
+		range.firstSlot = static_cast<uint32_t>(orderedSubmeshes.size());
+		range.submeshCount = static_cast<uint32_t>(variant.second.size());
+		range.submeshIndex = variant.second.front();
+
+		for (uint32_t submeshIndex : variant.second)
+		{
+			Submesh submesh = m_Submeshes[submeshIndex];
+			submesh.drawRange = static_cast<uint32_t>(m_DrawRanges.size());
+			submesh.drawRangeFirstSlot = range.firstSlot;
+			orderedSubmeshes.push_back(submesh);
+		}
+		m_DrawRanges.push_back(range);
+	}
+
+	if (m_DrawRanges.size() > MAX_DRAW_RANGES && m_GpuCullingSupported)
+	{
+		m_GpuCullingSupported = false;
+		if (m_GpuDrivenCulling)
+		{
+			std::cerr << "GPU-driven culling supports at most " << MAX_DRAW_RANGES << " pipeline variants (the model uses "
+				<< m_DrawRanges.size() << "); falling back to CPU-issued draws." << std::endl;
+		}
+	}
+
+	VkDeviceSize bufferSize = sizeof(orderedSubmeshes[0]) * orderedSubmeshes.size();
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(
+		bufferSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBuffer,
+		stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(m_LogicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
+	memcpy(data, orderedSubmeshes.data(), (size_t)bufferSize);
+	m_UploadBytesMetric.add(bufferSize);
+	vkUnmapMemory(m_LogicalDevice, stagingBufferMemory);
+
+	createBuffer(
+		bufferSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		m_SubmeshBuffer,
+		m_SubmeshBufferMemory);
+
+	copyBuffer(stagingBuffer, m_SubmeshBuffer, bufferSize);
+
+	deferDestruction([this, stagingBuffer, stagingBufferMemory]()
+	{
+		vkDestroyBuffer(m_LogicalDevice, stagingBuffer, m_Allocator);
+		freeDeviceMemory(stagingBufferMemory);
+	});
 }
 
 // jtH[obt@[FVF[_[pUBO(Uniform Buffer Object)f[^
 void CVulkanFramework::createUniformBuffers()
 {
+	TRACE_FUNCTION();
+
 	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
 	m_UniformBuffers.resize(m_SwapChainImages.size());
@@ -1329,84 +1783,114 @@ void CVulkanFramework::createUniformBuffers()
 	}
 }
 
-// fXNv^[Zbgi[ŃXNv^[v[𐶐
-void CVulkanFramework::createDescriptorPool()
+// CX^Xobt@[FSwapChain摜Ƃ1A펞}bvit[̃}bvEA}bv܂j
+// Instance buffers: one per swap chain image, persistently mapped so updates are a plain memcpy
+void CVulkanFramework::createInstanceBuffers()
 {
-	std::array<VkDescriptorPoolSize, 2> poolSizes{};    // et[1̃fXNv^[pӂ܂
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(m_SwapChainImages.size());
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(m_SwapChainImages.size());
+	TRACE_FUNCTION();
 
+	VkDeviceSize bufferSize = sizeof(InstanceData) * MAX_INSTANCE_COUNT;
 
-	VkDescriptorPoolCreateInfo poolInfo{};    // fXNv^[v[\
-	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(m_SwapChainImages.size());
+	m_InstanceBuffers.resize(m_SwapChainImages.size());
+	m_InstanceBuffersMemory.resize(m_SwapChainImages.size());
+	m_InstanceBuffersMapped.resize(m_SwapChainImages.size());
+	m_InstanceBuffersVersion.assign(m_SwapChainImages.size(), 0);    // 0F݁Ãt[ŕKXV
+	m_DrawInstanceCounts.assign(m_SwapChainImages.size(), 0);
 
-	if (vkCreateDescriptorPool(m_LogicalDevice, &poolInfo, nullptr, &m_DescriptorPool) != VK_SUCCESS)
+	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
 	{
-		throw std::runtime_error("Failed to create descriptor pool!");
+		createBuffer(
+			bufferSize,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,    // STORAGE: GPUJOœǂݍ
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_InstanceBuffers[i],
+			m_InstanceBuffersMemory[i]
+		);
+
+		// A}bvcleanupSwapChain()ōs܂
+		vkMapMemory(m_LogicalDevice, m_InstanceBuffersMemory[i], 0, bufferSize, 0, &m_InstanceBuffersMapped[i]);
 	}
 }
 
-// fXNv^[ZbgigXtH[j
-void CVulkanFramework::createDescriptorSets()
+// Ԑڕ`obt@[F擪256oCgɔ͈͂Ƃ̕`搔ǍVkDrawIndexedIndirectCommandzicull.comp݂܂j
+// Indirect draw buffers: one draw count per range in the first 256 bytes, then the VkDrawIndexedIndirectCommand array
+// written by cull.comp
+void CVulkanFramework::createIndirectBuffers()
 {
-	std::vector<VkDescriptorSetLayout> layouts(m_SwapChainImages.size(), m_DescriptorSetLayout);
+	TRACE_FUNCTION();
 
-	VkDescriptorSetAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocInfo.descriptorPool = m_DescriptorPool;    // fXNv^[v[
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(m_SwapChainImages.size());
-	allocInfo.pSetLayouts = layouts.data();
+	VkDeviceSize bufferSize = INDIRECT_COMMANDS_OFFSET
+		+ sizeof(VkDrawIndexedIndirectCommand) * MAX_INSTANCE_COUNT * m_Submeshes.size();
 
-	m_DescriptorSets.resize(m_SwapChainImages.size());
-	if (vkAllocateDescriptorSets(m_LogicalDevice, &allocInfo, m_DescriptorSets.data()) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate descriptor sets!");
-	}
+	m_IndirectBuffers.resize(m_SwapChainImages.size());
+	m_IndirectBuffersMemory.resize(m_SwapChainImages.size());
 
 	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
 	{
-		VkDescriptorBufferInfo bufferInfo{};
-		bufferInfo.buffer = m_UniformBuffers[i];
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);    // Sɏ㏑FVK_WHOLE_SIZEƓ
+		createBuffer(
+			bufferSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+			| VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,    // TRANSFER: `搔ZbgEؗp̓ǂݖ߂
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			m_IndirectBuffers[i],
+			m_IndirectBuffersMemory[i]
+		);
+	}
+}
+
+// fXNv^[AP[^[Fv[͎g؂ǉ̂ŁASwapChain̉摜Ɉˑ܂
+// Set up the descriptor allocator; its pools grow on demand, so they no longer depend on the swap chain image count
+void CVulkanFramework::createDescriptorAllocator()
+{
+	TRACE_FUNCTION();
+
+	// v[TCY̔䗦F`pEGPUJOpZbg1̕ρiނƁAtNVj
+	// pool ratio: the average of one draw set and one culling set, by descriptor type, from reflection
+	std::vector<VkDescriptorPoolSize> descriptorsPerSet;
+	CShaderReflection::addPoolSizes(descriptorsPerSet, m_GraphicsReflection.getBindings(0), 1);
+	CShaderReflection::addPoolSizes(descriptorsPerSet, m_CullReflection.getBindings(0), 1);
 
-		// Combined Image Sampler
-		VkDescriptorImageInfo imageInfo{};
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = m_TextureImageView;
-		imageInfo.sampler = m_TextureSampler;
+	m_DescriptorAllocator.init(m_LogicalDevice, m_FramesInFlight, descriptorsPerSet, m_Allocator);
+}
 
+// fXNv^[ZbgigXtH[jF\[X̃Zbg̓LbVėpA݂͍XVev[g
+// Get the per-image descriptor sets; identical ones come from the cache, new ones are written through update templates
+void CVulkanFramework::createDescriptorSets()
+{
+	TRACE_FUNCTION();
 
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};    // fXNv^[̐ݒERtBO[V\
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = m_DescriptorSets[i];
-		descriptorWrites[0].dstBinding = 0;                // jtH[obt@[oCfBOCfbNXu0v
-		descriptorWrites[0].dstArrayElement = 0;           // zgĂȂꍇAu0v
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].pBufferInfo = &bufferInfo;
+	const std::vector<VkDescriptorSetLayoutBinding>& bindings = m_GraphicsReflection.getBindings(0);
 
-		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = m_DescriptorSets[i];
-		descriptorWrites[1].dstBinding = 1;
-		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &imageInfo;
+	m_DescriptorSets.resize(m_SwapChainImages.size());
 
-		// fXNv^[ZbgXV܂
-		vkUpdateDescriptorSets(m_LogicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+	{
+		// tNṼoCfBOƂɁAނɍ\[Xׂ܂
+		// one resource for each reflected binding, chosen by descriptor type
+		std::vector<DescriptorInfo> infos;
+		for (const VkDescriptorSetLayoutBinding& binding : bindings)
+		{
+			switch (binding.descriptorType)
+			{
+			case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+				infos.push_back(DescriptorInfo::fromBuffer(m_UniformBuffers[i], 0, sizeof(UniformBufferObject)));    // Sɏ㏑FVK_WHOLE_SIZEƓ
+				break;
+			case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+				infos.push_back(DescriptorInfo::fromImage(m_TextureSampler, m_TextureImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+				break;
+			default:
+				throw std::runtime_error("No resource for a descriptor type declared in the shaders!");
+			}
+		}
+		m_DescriptorSets[i] = m_DescriptorAllocator.getSet(m_DescriptorSetLayout, bindings, infos);
 	}
 }
 
 // R}hv[̏񂩂R}hobt@[
 void CVulkanFramework::createCommandBuffers()
 {
+	TRACE_FUNCTION();
+
 	m_CommandBuffers.resize(m_SwapChainFramebuffers.size());    // t[obt@[TCYɍ킹
 
 	VkCommandBufferAllocateInfo allocInfo{};                    // [蓖ď\
@@ -1424,120 +1908,557 @@ void CVulkanFramework::createCommandBuffers()
 		throw std::runtime_error("Failed to allocate command buffers!");
 	}
 
+	// o^recordCommandBuffer()Ŗt[s܂
+	// recording happens per frame in recordCommandBuffer()
+}
+
+// R}hobt@[o^Ft[A`撼Oɓo^܂iCX^Xς邽߁j
+// Record the command buffer for one swap chain image; re-recorded every frame so the instance count can change
+void CVulkanFramework::recordCommandBuffer(uint32_t imageIndex)
+{
+	TRACE_FUNCTION();
+
+	VkCommandBuffer commandBuffer = m_CommandBuffers[imageIndex];
+	vkResetCommandBuffer(commandBuffer, 0);
+
 	// R}hobt@[o^Jn Starting command buffer recording
-	for (size_t i = 0; i < m_CommandBuffers.size(); i++)
+	VkCommandBufferBeginInfo beginInfo{};       // R}hobt@[Jn\
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;    // t[o^̂1̂ݒo
+	beginInfo.pInheritanceInfo = nullptr;       // pFSECONDARY̏ꍇ̂݁iǂ̃R}hobt@[Ăяoj
+												// only for secondary command buffers (which state to inherit from)
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
 	{
-		VkCommandBufferBeginInfo beginInfo{};       // R}hobt@[Jn\
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;                        // CӁ@optional
-		beginInfo.pInheritanceInfo = nullptr;       // pFSECONDARY̏ꍇ̂݁iǂ̃R}hobt@[Ăяoj
-													// only for secondary command buffers (which state to inherit from)
+		throw std::runtime_error("Failed to begin recording command buffer!");
+	}
 
-		if (vkBeginCommandBuffer(m_CommandBuffers[i], &beginInfo) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to begin recording command buffer!");
-		}
+	// GPUvFNG̃Zbg̓_[pX̊OŁBframeF̃R}hobt@[S
+	// GPU timing: queries are reset outside the render pass; "frame" spans this whole command buffer
+	m_GpuProfiler.resetQueries(commandBuffer);
+	const uint32_t frameScope = m_GpuProfiler.beginScope(commandBuffer, "frame");
+
+	// GPU쓮JOF_[pX̑OɃRs[gŊԐڕ`R}h𐶐܂
+	// GPU-driven culling: build the indirect draws in a compute pass before the render pass
+	const bool gpuDrivenCulling = m_GpuDrivenCulling && m_GpuCullingSupported;
+	const uint32_t objectCount = static_cast<uint32_t>(m_Snapshot->instances->size() * m_Submeshes.size());
+
+	// `搔GPUǂ߂ȂIuWFNgl߂ĒǉAłȂ΃IuWFNgƂ1Xbg
+	// compact the visible draws when the GPU can supply the draw count, otherwise keep one slot per object
+	const bool compactDraws = (m_pfnCmdDrawIndexedIndirectCount != nullptr) && (objectCount <= m_MaxDrawIndirectCount);
+
+	m_FrameGraph.reset();
+	CRenderGraph::ResourceHandle indirect = 0;
+	if (gpuDrivenCulling)
+	{
+		indirect = addCullingPasses(m_FrameGraph, imageIndex, objectCount, compactDraws);
+	}
+
+	// `pXFR}h͂̌̃_[pXœo^̂ŁAOtł̓oÂ
+	// the draw pass itself is recorded in the render pass below; in the graph it only contributes its barriers
+	CRenderGraph::ResourceHandle colorAttachment;
+	CRenderGraph::ResourceHandle depthAttachment;
+	const uint32_t drawPass = addMainPass(m_FrameGraph, colorAttachment, depthAttachment);
+	if (gpuDrivenCulling)
+	{
+		m_FrameGraph.use(drawPass, indirect, ResourceUsage::IndirectRead);
+		m_FrameGraph.use(drawPass, m_FrameGraph.importBuffer("instances", m_InstanceBuffers[imageIndex]), ResourceUsage::VertexBufferRead);
+	}
+	m_FrameGraph.compile();
+
+	// gWFg̎́FcreateAttachmentResources()Ɠ蓖
+	// the transients' images, assigned exactly as in createAttachmentResources()
+	if (m_FrameGraph.getPhysicalImageCount() != m_AttachmentImages.size())
+	{
+		throw std::runtime_error("Frame graph transients do not match the attachment images!");
+	}
+	for (uint32_t i = 0; i < m_FrameGraph.getPhysicalImageCount(); i++)
+	{
+		m_FrameGraph.setPhysicalImage(i, m_AttachmentImages[i]);
+	}
 
-		// _[pXJn
-		// Starting a render pass
-		VkRenderPassBeginInfo renderPassInfo{};		// _[pX\
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = m_RenderPass;
-		renderPassInfo.framebuffer = m_SwapChainFramebuffers[i];
+	if (gpuDrivenCulling)
+	{
+		CGpuScope cullScope(m_GpuProfiler, commandBuffer, "cull");    // ZbgEJOE`ÕoA
+		m_FrameGraph.execute(commandBuffer);
+	}
+	else
+	{
+		m_FrameGraph.execute(commandBuffer);
+	}
 
-		renderPassInfo.renderArea.offset = { 0, 0 };
+	// _[pXJn
+	// Starting a render pass
+	VkRenderPassBeginInfo renderPassInfo{};		// _[pX\
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = m_RenderPass;
+	renderPassInfo.framebuffer = m_SwapChainFramebuffers[imageIndex];
 
-		// ptH[}X̍œK̂߁A_[̈A^b`gTCYɍ킹܂B
-		// match render area to size of attachments for best performance
-		renderPassInfo.renderArea.extent = m_SwapChainExtent;
+	renderPassInfo.renderArea.offset = { 0, 0 };
 
-		// createRenderPass(): VK_ATTACHMENT_LOAD_OP_CLEAR̃NAl (clearColor)
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };    // 
-		clearValues[1].depthStencil = { 1.0f, 0 };            // fvXXeVNAl (1.0f: t@[ Far Plane)
+	// ptH[}X̍œK̂߁A_[̈A^b`gTCYɍ킹܂B
+	// match render area to size of attachments for best performance
+	renderPassInfo.renderArea.extent = m_SwapChainExtent;
 
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
+	// createRenderPass(): VK_ATTACHMENT_LOAD_OP_CLEAR̃NAl (clearColor)
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };    // 
+	clearValues[1].depthStencil = { 1.0f, 0 };            // fvXXeVNAl (1.0f: t@[ Far Plane)
 
-		// ۂ̃_[pXJn܂
-		vkCmdBeginRenderPass(m_CommandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfo.pClearValues = clearValues.data();
 
-		// OtBbNXpCvCƂȂ܂
-		vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
+	// render passFNAE`EMSAẢ܂݂܂idrawƂ̍[hEEXgA̎ԁj
+	// "render pass" includes the clears and the MSAA resolve; its difference from "draw" is load, resolve and store
+	const uint32_t renderPassScope = m_GpuProfiler.beginScope(commandBuffer, "render pass");
+	m_GpuProfiler.beginPipelineStatistics(commandBuffer);    // CpX̂݁iJÕfBXpb`͊܂݂܂j
 
-		// _obt@[oCh`̏͊ł
-		VkBuffer vertexBuffers[] = { m_VertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(m_CommandBuffers[i], 0, 1, vertexBuffers, offsets);
+	// ۂ̃_[pXJn܂
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	// r[|[gEVU[i_Ci~bNXe[gjF݂SwapChaiñTCY
+	// dynamic viewport and scissor, sized to the current swap chain
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)m_SwapChainExtent.width;
+	viewport.height = (float)m_SwapChainExtent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = m_SwapChainExtent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-		// CfbNXobt@[
-		vkCmdBindIndexBuffer(m_CommandBuffers[i], m_IndexBuffer, 0, VK_INDEX_TYPE_UINT32);    // VK_INDEX_TYPE_UINT16
+	// CfbNXobt@[iS`ŋʁj
+	vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, VK_INDEX_TYPE_UINT32);    // VK_INDEX_TYPE_UINT16
+
+	if (gpuDrivenCulling)
+	{
+		CGpuScope drawScope(m_GpuProfiler, commandBuffer, "draw");
+
+		// _obt@[oCh`̏͊ł
+		// oCfBO0F_obt@[AoCfBO1F̉摜̃CX^Xobt@[
+		// binding 0: vertex buffer, binding 1: this image's instance buffer
+		VkBuffer vertexBuffers[] = { m_VertexBuffer, m_InstanceBuffers[imageIndex] };
+		VkDeviceSize offsets[] = { 0, 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
 
 		// fXNv^[ZbgoCh܂
 		vkCmdBindDescriptorSets(
-			m_CommandBuffers[i],
+			commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			m_PipelineLayout,
 			0,
 			1,
-			&m_DescriptorSets[i],
+			&m_DescriptorSets[imageIndex],
 			0,
 			nullptr)
 			;
 
-		// `R}hiCfbNXobt@[j
-		vkCmdDrawIndexed(m_CommandBuffers[i], static_cast<uint32_t>(m_Indices.size()), 1, 0, 0, 0);
-		// @FR}hobt@[
-		//     AF_i_obt@[Ȃł_`悵Ă܂Bj
-		//     BFCX^XiCX^X_Opj
-		//     CFCfbNXobt@[̍ŏ_̃ItZbg
-		//     CFCfbNXobt@[ɑItZbg (g͂܂sj
-		//     CFCX^X̃ItZbgiCX^X_Opj
-
-		// arguments
-		// first    : commandBuffer
-		// second   : vertexCount  : even without vertex buffer, still drawing 3 vertices (triangle)
-		// third    : instanceCount: used for instanced rendering, otherwise 1)
-		// fourth   : firstIndexOffset : offset to start of index buffer (1 means GPU reads from second index)
-		// fifth    : indexAddOffset   : offset to add to indices (not sure what this is for)
-		// sixth    : instanceOffset   : used in instanced rendering
-
-		// _[pXI܂
-		vkCmdEndRenderPass(m_CommandBuffers[i]);
-
-		if (vkEndCommandBuffer(m_CommandBuffers[i]) != VK_SUCCESS)
+		// `悲Ƃ̃f[^ifsE}eAԍj̓vbV萔œn܂
+		// per-draw data goes through push constants rather than the UBO
+		DrawPushConstants pushConstants{};
+		pushConstants.model = m_ModelTransform;
+		pushConstants.materialIndex = 0;
+		vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			0, sizeof(DrawPushConstants), &pushConstants);
+
+		const VkBuffer indirectBuffer = m_IndirectBuffers[imageIndex];
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		const uint32_t instanceCount = static_cast<uint32_t>(m_Snapshot->instances->size());
+
+		// pCvCoAgƂ͈̔́FoAgoChāA͈̔͂̃R}ĥݕ`悵܂
+		// iCAEg͑SoAgʂȂ̂ŁAfXNv^[ZbgEvbV萔͂̂܂ܗLłj
+		// one range per pipeline variant: bind the variant, then draw only that range's commands; every variant shares
+		// the pipeline layout, so the descriptor set and push constants above stay bound
+		for (uint32_t rangeIndex = 0; rangeIndex < m_DrawRanges.size(); rangeIndex++)
 		{
-			throw std::runtime_error("Failed to record command buffer!");
+			const DrawRange& range = m_DrawRanges[rangeIndex];
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+				resolvePipeline(m_SubmeshPipelines[range.submeshIndex].desc));
+
+			const uint32_t firstSlot = range.firstSlot * instanceCount;
+			const uint32_t slotCount = range.submeshCount * instanceCount;
+			const VkDeviceSize rangeOffset = INDIRECT_COMMANDS_OFFSET + VkDeviceSize(stride) * firstSlot;
+
+			if (compactDraws)
+			{
+				// `搔̓obt@[擪iJǑʁA͈͂Ɓjǂݍ݂܂
+				// the range's draw count is read from the front of the buffer, as written by the cull pass
+				m_pfnCmdDrawIndexedIndirectCount(commandBuffer, indirectBuffer, rangeOffset,
+					indirectBuffer, sizeof(uint32_t) * rangeIndex, slotCount, stride);
+			}
+			else
+			{
+				// JOꂽXbginstanceCount = 0i`悵܂j
+				// 1񂠂maxDrawIndirectCounti65535ȏAcreateLogicalDevice()QƁjF100IuWFNg16{͈͐ȓ
+				// culled slots carry instanceCount = 0 and draw nothing; each call covers maxDrawIndirectCount
+				// (at least 65535, see createLogicalDevice()), so a million objects take at most 16 calls plus one per range
+				for (uint32_t first = 0; first < slotCount; first += m_MaxDrawIndirectCount)
+				{
+					const uint32_t drawCount = std::min(m_MaxDrawIndirectCount, slotCount - first);
+					vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, rangeOffset + VkDeviceSize(stride) * first,
+						drawCount, stride);
+				}
+			}
 		}
 	}
+	else
+	{
+		CGpuScope drawScope(m_GpuProfiler, commandBuffer, "draw");
+
+		// `R}hiCfbNXobt@[jFTubVƂ̃pPbg\[gēo^܂
+		// epPbg͑SCX^XiCPUJO͉̂݁j1̃h[R[ŕ`悵܂
+		// one packet per submesh, sorted by state key; each draws every (CPU-culled) instance in one call
+		queueDraws(imageIndex);
+		m_DrawQueue.sort();
+		m_DrawQueue.record(commandBuffer);
+
+		// h[R[EoCh̐igetDrawQueueStats()ƃgNXŎQƂ܂j
+		// draw and bind counts for this frame, read through getDrawQueueStats() and the metrics
+		const DrawQueueStats& stats = m_DrawQueue.getStats();
+		m_DrawCallMetric.set(stats.drawCount);
+		m_PipelineBindMetric.set(stats.pipelineBinds);
+		m_DescriptorSetBindMetric.set(stats.descriptorSetBinds);
+		m_VertexBufferBindMetric.set(stats.vertexBufferBinds);
+		m_BindsSavedMetric.set(stats.bindsSaved);
+	}
+	// @FR}hobt@[
+	//     AF_i_obt@[Ȃł_`悵Ă܂Bj
+	//     BFCX^XiCX^X_Opj
+	//     CFCfbNXobt@[̍ŏ_̃ItZbg
+	//     CFCfbNXobt@[ɑItZbg (g͂܂sj
+	//     CFCX^X̃ItZbgiCX^X_Opj
+
+	// arguments
+	// first    : commandBuffer
+	// second   : vertexCount  : even without vertex buffer, still drawing 3 vertices (triangle)
+	// third    : instanceCount: used for instanced rendering, otherwise 1)
+	// fourth   : firstIndexOffset : offset to start of index buffer (1 means GPU reads from second index)
+	// fifth    : indexAddOffset   : offset to add to indices (not sure what this is for)
+	// sixth    : instanceOffset   : used in instanced rendering
+
+	// _[pXI܂
+	vkCmdEndRenderPass(commandBuffer);
+	m_GpuProfiler.endPipelineStatistics(commandBuffer);
+	m_GpuProfiler.endScope(commandBuffer, renderPassScope);
+	m_GpuProfiler.endScope(commandBuffer, frameScope);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to record command buffer!");
+	}
+}
+
+// `pPbgo^FTubVƂ1pPbgAL[̓pCvCE}eAEbVEfvX
+// Queue one draw packet per submesh, keyed by pipeline, material, mesh and view depth
+void CVulkanFramework::queueDraws(uint32_t imageIndex)
+{
+	m_DrawQueue.clear();
+
+	const uint32_t instanceCount = m_DrawInstanceCounts[imageIndex];
+	if (instanceCount == 0)
+	{
+		return;
+	}
+
+	for (uint32_t submeshIndex = 0; submeshIndex < m_Submeshes.size(); submeshIndex++)
+	{
+		const Submesh& submesh = m_Submeshes[submeshIndex];
+
+		// fvXFTubVS̃NbvWi0`1j
+		// depth: the submesh center in clip space (0..1)
+		const glm::vec4 clipPosition = m_CullMatrix * glm::vec4(glm::vec3(submesh.boundingSphere), 1.0f);
+		const float depth = (clipPosition.w > 0.0f) ? clipPosition.z / clipPosition.w : 0.0f;
+
+		DrawPacket packet{};
+		// pCvCFTubṼ}eÃoAgiRpC̓ftHgőpj
+		// the pipeline is the variant for the submesh's material, with the default standing in while it compiles
+		const SubmeshPipeline& submeshPipeline = m_SubmeshPipelines[submeshIndex];
+		packet.key = CDrawQueue::makeKey(submeshPipeline.pipelineId, 0, submeshIndex, depth);    // }eAieNX`[j͌1̂
+		packet.pipeline = resolvePipeline(submeshPipeline.desc);
+		packet.pipelineLayout = m_PipelineLayout;
+		packet.descriptorSet = m_DescriptorSets[imageIndex];
+		packet.vertexBuffer = m_VertexBuffer;
+		packet.instanceBuffer = m_InstanceBuffers[imageIndex];
+		packet.indexCount = submesh.indexCount;
+		packet.firstIndex = submesh.firstIndex;
+		packet.instanceCount = instanceCount;
+		packet.pushConstants.model = m_ModelTransform;
+		packet.pushConstants.materialIndex = 0;
+		m_DrawQueue.submit(packet);
+	}
+}
+
+// GPUJÕpXOtɒǉF`搔Zbg  JOiRs[gjAԐڕ`obt@[Ԃ܂
+// Add the cull passes to a graph: reset the draw count, then dispatch cull.comp; returns the indirect buffer
+// ʂgpXiԐڕ`Eǂݖ߂j͌ĂяoǉāAoA̓OtvZ܂
+// the caller adds whichever pass consumes the results (indirect draw, readback) and the graph places the barriers
+CRenderGraph::ResourceHandle CVulkanFramework::addCullingPasses(CRenderGraph& graph, uint32_t imageIndex, uint32_t objectCount, bool compact)
+{
+	const VkBuffer indirectBuffer = m_IndirectBuffers[imageIndex];
+	const CRenderGraph::ResourceHandle indirect = graph.importBuffer("indirect", indirectBuffer);
+	const CRenderGraph::ResourceHandle uniforms = graph.importBuffer("uniforms", m_UniformBuffers[imageIndex]);
+	const CRenderGraph::ResourceHandle submeshes = graph.importBuffer("submeshes", m_SubmeshBuffer);
+	const CRenderGraph::ResourceHandle instances = graph.importBuffer("instances", m_InstanceBuffers[imageIndex]);
+
+	// ͈͂Ƃ̕`搔0ɃZbg
+	// reset the per-range draw counts to 0
+	const VkDeviceSize drawCountsSize = sizeof(uint32_t) * m_DrawRanges.size();
+	const uint32_t resetPass = graph.addPass("reset draw count", [indirectBuffer, drawCountsSize](VkCommandBuffer commandBuffer)
+		{
+			vkCmdFillBuffer(commandBuffer, indirectBuffer, 0, drawCountsSize, 0);
+		});
+	graph.use(resetPass, indirect, ResourceUsage::TransferWrite);
+
+	CullParams params{};
+	params.model = m_ModelTransform;
+	params.objectCount = objectCount;
+	params.submeshCount = static_cast<uint32_t>(m_Submeshes.size());
+	params.compact = compact ? 1 : 0;
+
+	// GPUJOpfXNv^[ZbgF̃t[̃v[mۂď݂܂ibeginFrame()ł܂Ƃ߂ĉj
+	// the culling descriptor set comes from this frame's pool and is written every frame; beginFrame() frees it wholesale
+	const std::vector<VkDescriptorSetLayoutBinding>& cullBindings = m_CullReflection.getBindings(0);
+	const std::vector<DescriptorInfo> cullInfos =
+	{
+		DescriptorInfo::fromBuffer(m_UniformBuffers[imageIndex], 0, sizeof(UniformBufferObject)),
+		DescriptorInfo::fromBuffer(m_SubmeshBuffer, 0, VK_WHOLE_SIZE),
+		DescriptorInfo::fromBuffer(m_InstanceBuffers[imageIndex], 0, VK_WHOLE_SIZE),
+		DescriptorInfo::fromBuffer(indirectBuffer, 0, VK_WHOLE_SIZE)
+	};
+	if (cullBindings.size() != cullInfos.size())
+	{
+		throw std::runtime_error("Culling shader bindings do not match the culling buffers!");
+	}
+	const VkDescriptorSet cullDescriptorSet = m_DescriptorAllocator.allocateTransient(m_CullDescriptorSetLayout);
+	m_DescriptorAllocator.write(cullDescriptorSet, m_CullDescriptorSetLayout, cullBindings, cullInfos);
+
+	const uint32_t cullPass = graph.addPass("cull", [this, cullDescriptorSet, objectCount, params](VkCommandBuffer commandBuffer)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipelineLayout,
+				0, 1, &cullDescriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, m_CullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParams), &params);
+			// xFCX^XAyFTubVi1ł100CX^Xŕۏؒl65535O[v𒴂܂j
+			// x: instances, y: submeshes; a 1D dispatch would pass the guaranteed 65535 groups at a million instances
+			const uint32_t instanceCount = (params.submeshCount > 0) ? objectCount / params.submeshCount : 0;
+			vkCmdDispatch(commandBuffer, (instanceCount + 63) / 64, params.submeshCount, 1);    // local_size_x = 64 (cull.comp)
+		});
+	graph.use(cullPass, uniforms, ResourceUsage::ComputeRead);
+	graph.use(cullPass, submeshes, ResourceUsage::ComputeRead);
+	graph.use(cullPass, instances, ResourceUsage::ComputeRead);
+	graph.use(cullPass, indirect, ResourceUsage::ComputeWrite);    // atomicAddi`搔j{R}h
+
+	return indirect;
+}
+
+// C̃_[pXOtɒǉFMSAAJ[EfvX̓gWFg摜ApX̔ԍԂ܂
+// Add the main render pass to a graph with the MSAA color and depth attachments as transients; returns the pass
+// _[pX̂͌Ăяoexecute()̌ɓo^܂iOt̓A^b`g̑JڂƑÕt[̑ҋ@̂݁j
+// the caller records the render pass itself after execute(); the graph only transitions the attachments and
+// orders them after the previous frame's use
+uint32_t CVulkanFramework::addMainPass(CRenderGraph& graph, CRenderGraph::ResourceHandle& color, CRenderGraph::ResourceHandle& depth)
+{
+	color = graph.createTransientImage("msaa color", m_ColorAttachmentDesc);
+	depth = graph.createTransientImage("depth", m_DepthAttachmentDesc);
+
+	const uint32_t drawPass = graph.addPass("draw", nullptr);
+	graph.use(drawPass, color, ResourceUsage::ColorAttachmentWrite);
+	graph.use(drawPass, depth, ResourceUsage::DepthAttachmentWrite);
+	return drawPass;
 }
 
 // ̐pIuWFNg
 void CVulkanFramework::createSyncObjects()
 {
-	m_ImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	m_RenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	m_InFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-	m_ImagesInFlight.resize(m_SwapChainImages.size(), VK_NULL_HANDLE);
+	TRACE_FUNCTION();
 
+	m_ImageAvailableSemaphores.resize(m_FramesInFlight);
+	m_RenderFinishedSemaphores.resize(m_FramesInFlight);
+	m_FrameSubmitSerials.assign(m_FramesInFlight, 0);
+	m_ImageSubmitSerials.resize(m_SwapChainImages.size(), 0);
+
+	// 擾E\p̓oCiZ}tHiXbv`FC̓^CCg܂j
+	// binary semaphores for acquire and present; the swap chain cannot use timeline semaphores
 	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (size_t i = 0; i < m_FramesInFlight; i++)
 	{
-		if (vkCreateSemaphore(m_LogicalDevice, &semaphoreInfo, nullptr, &m_ImageAvailableSemaphores[i]) != VK_SUCCESS
-			|| vkCreateSemaphore(m_LogicalDevice, &semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]) != VK_SUCCESS
-			|| vkCreateFence(m_LogicalDevice, &fenceInfo, nullptr, &m_InFlightFences[i]) != VK_SUCCESS)
+		if (vkCreateSemaphore(m_LogicalDevice, &semaphoreInfo, m_Allocator, &m_ImageAvailableSemaphores[i]) != VK_SUCCESS
+			|| vkCreateSemaphore(m_LogicalDevice, &semaphoreInfo, m_Allocator, &m_RenderFinishedSemaphores[i]) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create synchronization objects for a frame!");
 		}
 	}
 }
 
+// t[^CCFoƂ1lVOi܂itFX̑j
+// Frame timeline: each submit signals the next value, replacing the per-frame fences
+//   Abv[hVOîŁAŏ̃Abv[hieNX`[jɐ܂
+//   uploads signal it as well, so it is created before the first upload (the texture)
+void CVulkanFramework::createFrameTimeline()
+{
+	TRACE_FUNCTION();
+
+	VkSemaphoreTypeCreateInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = m_SubmitSerial;
+
+	VkSemaphoreCreateInfo timelineSemaphoreInfo{};
+	timelineSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	timelineSemaphoreInfo.pNext = &timelineInfo;
+
+	if (vkCreateSemaphore(m_LogicalDevice, &timelineSemaphoreInfo, m_Allocator, &m_FrameTimeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create frame timeline semaphore!");
+	}
+}
+
+// GPUvt@C[Ft[gƂ̃^CX^vNGv[iOtBbNXL[ŏ݁j
+// GPU profiler: one timestamp query pool per frame in flight, written on the graphics queue
+void CVulkanFramework::createGpuProfiler()
+{
+	TRACE_FUNCTION();
+
+	QueueFamilyIndices indices = findQueueFamilies(m_PhysicalDevice);
+	m_GpuProfiler.init(m_PhysicalDevice, m_LogicalDevice, indices.graphicsFamily.value(), m_FramesInFlight,
+		m_PipelineStatisticsSupported, m_Allocator);
+}
+
+// ^CCserialɒB܂ő҂܂iBĂΑ҂ɖ߂܂j
+// Block until the frame timeline reaches serial; returns at once if it already has
+void CVulkanFramework::waitForSerial(uint64_t serial)
+{
+	if (serial <= m_CompletedSerial)
+	{
+		return;
+	}
+
+	TRACE_SCOPE("vkWaitSemaphores");
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_FrameTimeline;
+	waitInfo.pValues = &serial;
+
+	if (vkWaitSemaphores(m_LogicalDevice, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to wait for the frame timeline!");
+	}
+	retireSerials(serial);
+}
+
+// oԍi߂āAt[̒xL^܂
+// Advance the completed serial and record the latency of the frames that finished
+void CVulkanFramework::retireSerials(uint64_t completedSerial)
+{
+	m_CompletedSerial = std::max(m_CompletedSerial, completedSerial);
+
+	const auto now = std::chrono::high_resolution_clock::now();
+	size_t retired = 0;
+	while (retired < m_PendingFrames.size() && m_PendingFrames[retired].latency.submitSerial <= m_CompletedSerial)
+	{
+		PendingFrame& frame = m_PendingFrames[retired++];
+		frame.latency.inputToCompleteMs = std::chrono::duration<double, std::milli>(now - frame.inputTime).count();
+		m_LastFrameLatency = frame.latency;
+
+		if (m_LatencyPolicy.reportPerFrame)
+		{
+			std::cout << "Frame " << frame.latency.submitSerial
+				<< ": queue depth " << frame.latency.queueDepth
+				<< ", input to submit " << frame.latency.inputToSubmitMs << " ms"
+				<< ", input to GPU complete " << frame.latency.inputToCompleteMs << " ms" << std::endl;
+		}
+	}
+	m_PendingFrames.erase(m_PendingFrames.begin(), m_PendingFrames.begin() + retired);
+}
+
+// gNXo^ďoXbhJn܂io͐悪ݒ肳Ăꍇ̂݁j
+// Register the metrics and start the exporter thread, only when an export target is set
+void CVulkanFramework::startMetricsExport()
+{
+	if (m_MetricsTarget.empty())
+	{
+		return;
+	}
+
+	m_Metrics.addHistogram("vulkan_frame_time_seconds", "CPU time between consecutive frames.", m_FrameTimeMetric, 1e-6);
+	m_Metrics.addHistogram("vulkan_present_wait_seconds", "Time blocked in vkAcquireNextImageKHR and vkQueuePresentKHR.", m_PresentWaitMetric, 1e-6);
+	m_Metrics.addCounter("vulkan_frames_total", "Frames rendered by the main loop.", m_FrameCountMetric);
+	m_Metrics.addCounter("vulkan_present_stalls_total", "Frames whose acquire and present blocked past the expected vblank interval.", m_PresentStallMetric);
+	m_Metrics.addCounter("vulkan_swapchain_recreations_total", "Swap chain recreations (resize, out of date, suboptimal).", m_SwapChainRecreateMetric);
+	m_Metrics.addCounter("vulkan_upload_bytes_total", "Bytes written into host-visible buffers for the GPU.", m_UploadBytesMetric);
+	m_Metrics.addGauge("vulkan_device_memory_bytes", "Device memory currently allocated through vkAllocateMemory.", m_DeviceMemoryMetric);
+	m_Metrics.addGauge("vulkan_host_memory_bytes", "Host memory the driver currently holds (only with --host-alloc).", m_HostMemoryMetric);
+	m_Metrics.addGauge("vulkan_draw_calls", "Draw calls recorded by the draw queue in the last frame.", m_DrawCallMetric);
+	m_Metrics.addGauge("vulkan_binds", "Bind calls recorded by the draw queue in the last frame.", m_PipelineBindMetric, "kind=\"pipeline\"");
+	m_Metrics.addGauge("vulkan_binds", "Bind calls recorded by the draw queue in the last frame.", m_DescriptorSetBindMetric, "kind=\"descriptor_set\"");
+	m_Metrics.addGauge("vulkan_binds", "Bind calls recorded by the draw queue in the last frame.", m_VertexBufferBindMetric, "kind=\"vertex_buffer\"");
+	m_Metrics.addGauge("vulkan_binds_saved", "Bind calls the draw queue sort elided in the last frame.", m_BindsSavedMetric);
+
+	const char* severities[] = { "error", "warning", "info", "verbose" };
+	for (size_t i = 0; i < m_ValidationMessageMetrics.size(); i++)
+	{
+		m_Metrics.addCounter("vulkan_validation_messages_total", "Validation and debug messages by severity.",
+			m_ValidationMessageMetrics[i], std::string("severity=\"") + severities[i] + "\"");
+	}
+
+	// ŐĂlo̒OɎʂ܂ioXbhAǂAg~bN̓ǂݍ݂̂݁j
+	// values counted elsewhere are copied in right before each export; both sources are plain atomic reads
+	m_Metrics.addCollector([this]()
+	{
+		const DebugMessageStats messages = m_DebugSink.getStats();
+		m_ValidationMessageMetrics[0].set(messages.error);
+		m_ValidationMessageMetrics[1].set(messages.warning);
+		m_ValidationMessageMetrics[2].set(messages.info);
+		m_ValidationMessageMetrics[3].set(messages.verbose);
+
+		if (m_Allocator != nullptr)
+		{
+			uint64_t hostBytes = 0;
+			for (VkSystemAllocationScope scope = VK_SYSTEM_ALLOCATION_SCOPE_COMMAND; scope <= VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE;
+				scope = static_cast<VkSystemAllocationScope>(scope + 1))
+			{
+				hostBytes += m_HostAllocator.getStats(scope).currentBytes;
+			}
+			m_HostMemoryMetric.set(static_cast<double>(hostBytes));
+		}
+	});
+
+	if (m_Metrics.startExporter(m_MetricsTarget, m_MetricsIntervalSeconds))
+	{
+		std::cout << "Exporting metrics to " << m_MetricsTarget << " every " << m_MetricsIntervalSeconds << " s" << std::endl;
+	}
+}
+
+// foCX[̊mہEigNX̎gpʂXV܂j
+// Device memory bookkeeping for the usage gauge
+void CVulkanFramework::trackDeviceMemory(VkDeviceMemory memory, VkDeviceSize size)
+{
+	m_DeviceMemorySizes[memory] = size;
+	m_DeviceMemoryBytes += size;
+	m_DeviceMemoryMetric.set(static_cast<double>(m_DeviceMemoryBytes));
+}
+
+void CVulkanFramework::freeDeviceMemory(VkDeviceMemory memory)
+{
+	const auto found = m_DeviceMemorySizes.find(memory);
+	if (found != m_DeviceMemorySizes.end())
+	{
+		m_DeviceMemoryBytes -= found->second;
+		m_DeviceMemorySizes.erase(found);
+		m_DeviceMemoryMetric.set(static_cast<double>(m_DeviceMemoryBytes));
+	}
+	vkFreeMemory(m_LogicalDevice, memory, m_Allocator);
+}
+
 
 
 //====================================================================================
@@ -1561,7 +2482,7 @@ VkImageView CVulkanFramework::createImageView(VkImage image, VkFormat format, Vk
 	viewInfo.subresourceRange.layerCount = 1;
 
 	VkImageView imageView;
-	if (vkCreateImageView(m_LogicalDevice, &viewInfo, nullptr, &imageView) != VK_SUCCESS)
+	if (vkCreateImageView(m_LogicalDevice, &viewInfo, m_Allocator, &imageView) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create texture image view!");
 	}
@@ -1587,7 +2508,7 @@ void CVulkanFramework::createImage(uint32_t width, uint32_t height, uint32_t mip
 	imageInfo.samples = numSamples;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	if (vkCreateImage(m_LogicalDevice, &imageInfo, nullptr, &image) != VK_SUCCESS)
+	if (vkCreateImage(m_LogicalDevice, &imageInfo, m_Allocator, &image) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create image!");
 	}
@@ -1600,10 +2521,11 @@ void CVulkanFramework::createImage(uint32_t width, uint32_t height, uint32_t mip
 	allocInfo.allocationSize = memRequirements.size;
 	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
-	if (vkAllocateMemory(m_LogicalDevice, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
+	if (vkAllocateMemory(m_LogicalDevice, &allocInfo, m_Allocator, &imageMemory) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to allocate image memory!");
 	}
+	trackDeviceMemory(imageMemory, allocInfo.allocationSize);
 
 	vkBindImageMemory(m_LogicalDevice, image, imageMemory, 0);
 }
@@ -1645,13 +2567,80 @@ VkShaderModule CVulkanFramework::createShaderModule(const std::vector<char>& cod
 
 	// L̍\̂ɊÂăVF[_[W[𐶐܂B
 	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(m_LogicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+	if (vkCreateShaderModule(m_LogicalDevice, &createInfo, m_Allocator, &shaderModule) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create shader module!");
 	}
 	return shaderModule;
 }
 
+// pCvCLbṼwb_[mFFʂGPUEhCo[̃LbV͎g܂
+// Check the cache header against this device; data from another GPU or driver is discarded
+bool CVulkanFramework::isPipelineCacheCompatible(const std::vector<char>& cacheData)
+{
+	VkPipelineCacheHeaderVersionOne header{};
+	if (cacheData.size() < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, cacheData.data(), sizeof(header));
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+
+	return header.headerSize >= sizeof(header)
+		&& header.headerSize <= cacheData.size()
+		&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& header.vendorID == properties.vendorID
+		&& header.deviceID == properties.deviceID
+		&& memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// pCvCLbV݁Fꎞt@CɏĂ烊l[irŏIĂꂽt@Cc܂j
+// Write the pipeline cache to a temporary file, then rename it over the old one so a crash never leaves a torn file
+void CVulkanFramework::savePipelineCache()
+{
+	if (m_PipelineCacheEnabled == false || m_PipelineCache == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	size_t dataSize = 0;
+	vkGetPipelineCacheData(m_LogicalDevice, m_PipelineCache, &dataSize, nullptr);
+	std::vector<char> cacheData(dataSize);
+	if (dataSize == 0 || vkGetPipelineCacheData(m_LogicalDevice, m_PipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to read pipeline cache data, cache file not written." << std::endl;
+		return;
+	}
+
+	const std::string& cachePath = m_PipelineCachePath.empty() ? PIPELINE_CACHE_PATH : m_PipelineCachePath;
+	const std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(cacheData.data(), dataSize);
+		if (file.good() == false)
+		{
+			std::cerr << "Failed to write " << tempPath << "!" << std::endl;
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);    // t@Cu܂ replaces the old file
+	if (error)
+	{
+		std::cerr << "Failed to replace " << cachePath << ": " << error.message() << std::endl;
+		std::filesystem::remove(tempPath, error);
+		return;
+	}
+
+	const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "Pipeline cache saved: " << dataSize << " bytes (" << milliseconds << " ms)" << std::endl;
+}
+
 // t@Cǂݍ
 std::vector<char> CVulkanFramework::readFile(const std::string& fileName)
 {
@@ -1660,7 +2649,7 @@ std::vector<char> CVulkanFramework::readFile(const std::string& fileName)
 
 	if (file.is_open() == false)
 	{
-		throw std::runtime_error("Failed to open file!");
+		throw std::runtime_error("Failed to open file: " + fileName + "!");
 	}
 
 	size_t fileSize = (size_t)file.tellg();     // telg(): CvbgXg[ʒu߂ returns input stream position. 
@@ -1691,7 +2680,7 @@ void CVulkanFramework::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
 	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;       // L[hiSwapChainƓjFOtBbNXL[p
 
 	// L̍\̂ɊÂĎۂ̃obt@[𐶐܂B
-	if (vkCreateBuffer(m_LogicalDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+	if (vkCreateBuffer(m_LogicalDevice, &bufferInfo, m_Allocator, &buffer) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create vertex buffer!");
 	}
@@ -1705,10 +2694,11 @@ void CVulkanFramework::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
 	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
 	// L̍\̂ɊÂĎۂ̃[mۏs܂B
-	if (vkAllocateMemory(m_LogicalDevice, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+	if (vkAllocateMemory(m_LogicalDevice, &allocInfo, m_Allocator, &bufferMemory) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to allocate vertex buffer memory!");
 	}
+	trackDeviceMemory(bufferMemory, allocInfo.allocationSize);
 
 	// mۂꂽ[蓖Ă𒸓_obt@[ɃoCh܂
 	vkBindBufferMemory(m_LogicalDevice, buffer, bufferMemory, 0);
@@ -1728,14 +2718,12 @@ void CVulkanFramework::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDevi
 	// Rs[̃obt@[̒gRs[̃obt@[ɃRs[R}hL^܂
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
-	endSingleTimeCommands(commandBuffer);
+	endUploadCommands(commandBuffer);    // ҂܂FRs[͌Ăяox폜܂
 }
 
 // obt@[C[WɈڂ
-void CVulkanFramework::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void CVulkanFramework::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
 {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
 	VkBufferImageCopy region{};    // Rs[\
 	region.bufferOffset = 0;
 	region.bufferRowLength = 0;
@@ -1758,64 +2746,6 @@ void CVulkanFramework::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_
 		1,
 		&region
 	);
-
-	endSingleTimeCommands(commandBuffer);
-}
-
-// C[WCAEg̃CAEgɑJڂ܂
-void CVulkanFramework::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
-{
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-	VkImageMemoryBarrier barrier{};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = oldLayout;
-	barrier.newLayout = newLayout;
-
-	// L[ςꍇAȉ̐ݒ肪Kvł
-	// ftHgł͂܂I@Kݒ肷邱
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-	barrier.image = image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = mipLevels;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-
-	VkPipelineStageFlags sourceStage;
-	VkPipelineStageFlags destinationStage;
-
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-	{
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	}
-	else
-	{
-		throw std::invalid_argument("Unsupported layout transition!");
-	}
-
-	vkCmdPipelineBarrier(
-		commandBuffer,
-		sourceStage, destinationStage,
-		0,              // VK_DEPENDENCY_BY_REGION_BIT
-		0, nullptr,     // [oA
-		0, nullptr,     // obt@[[oA
-		1, &barrier     // C[WoAiݎgpj
-	);
-
-	endSingleTimeCommands(commandBuffer);
 }
 
 // 񂾂gp\̃R}hJn܂
@@ -1839,13 +2769,26 @@ VkCommandBuffer CVulkanFramework::beginSingleTimeCommands()
 	return commandBuffer;
 }
 
-// 񂾂gp\̃R}hI܂
+// 񂾂gp\̃R}hI܂i܂ő҂܂Fʂǂݖ߂؁ES[f摜pj
+// End and submit one-time commands, then wait for them; for the validation and golden-image readbacks
 void CVulkanFramework::endSingleTimeCommands(VkCommandBuffer commandBuffer)
 {
 	vkEndCommandBuffer(commandBuffer);
 
+	// Ō̃Abv[h҂܂iL[̏Ԃł̓[̈ˑ֌WɂȂ܂j
+	// wait for the last upload on the timeline; submission order alone is no memory dependency
+	const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineSubmitInfo.waitSemaphoreValueCount = 1;
+	timelineSubmitInfo.pWaitSemaphoreValues = &m_UploadSerial;
+
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineSubmitInfo;
+	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.pWaitSemaphores = &m_FrameTimeline;
+	submitInfo.pWaitDstStageMask = &waitStage;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
@@ -1855,8 +2798,40 @@ void CVulkanFramework::endSingleTimeCommands(VkCommandBuffer commandBuffer)
 	vkFreeCommandBuffers(m_LogicalDevice, m_CommandPool, 1, &commandBuffer);
 }
 
+// Abv[h̃R}ho܂i҂܂jF^CC̎̔ԍVOiA
+// ̃t[i܂endSingleTimeCommands()j̒o̔ԍ҂܂BR}hobt@[͊ɉ
+// Submit upload commands without waiting: they signal the next timeline serial, which the next frame's submit
+// (or endSingleTimeCommands()) waits for; the command buffer is freed once the upload has completed
+void CVulkanFramework::endUploadCommands(VkCommandBuffer commandBuffer)
+{
+	vkEndCommandBuffer(commandBuffer);
+
+	const uint64_t uploadSerial = m_SubmitSerial + 1;
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineSubmitInfo.signalSemaphoreValueCount = 1;
+	timelineSubmitInfo.pSignalSemaphoreValues = &uploadSerial;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineSubmitInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &m_FrameTimeline;
+
+	if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit upload commands!");
+	}
+	m_SubmitSerial = uploadSerial;
+	m_UploadSerial = uploadSerial;
+
+	deferDestruction([this, commandBuffer]() { vkFreeCommandBuffers(m_LogicalDevice, m_CommandPool, 1, &commandBuffer); });
+}
+
 // ~bv}bv֐
-void CVulkanFramework::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
+void CVulkanFramework::generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
 {
 	// nꂽtH[}bgLinear BlittingT|[g邩mF
 	VkFormatProperties formatProperties;
@@ -1867,8 +2842,6 @@ void CVulkanFramework::generateMipmaps(VkImage image, VkFormat imageFormat, int3
 		throw std::runtime_error("Texture image format does not support linear blitting!");
 	}
 
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.image = image;
@@ -1965,8 +2938,6 @@ void CVulkanFramework::generateMipmaps(VkImage image, VkFormat imageFormat, int3
 		0, nullptr,
 		0, nullptr,
 		1, &barrier);
-
-	endSingleTimeCommands(commandBuffer);
 }
 
 //====================================================================================
@@ -1974,6 +2945,7 @@ void CVulkanFramework::generateMipmaps(VkImage image, VkFormat imageFormat, int3
 // Update Functions
 //====================================================================================
 
+#if !defined(HEADLESS_ONLY)
 // EBhETCYR[obN
 void CVulkanFramework::framebufferResizeCallback(GLFWwindow* window, int width, int height)
 {
@@ -1981,14 +2953,49 @@ void CVulkanFramework::framebufferResizeCallback(GLFWwindow* window, int width,
 	app->CVulkanFramework::m_FramebufferResized = true;
 }
 
-// SwapChainEBhET[tFXɑΉĂȂꍇiEChETCYjASwapChainĐ
-// Kv܂BSwapChain̓EBhETCYɈˑIuWFNgSwapChainƓ
-// ĐȂƂ܂B
-// Recreate swap chain and all creation functions for the object that depend on the swap chain or the window size.
-// This step is to be implemented when the swap chain is no longer compatible with the window surface;
-// i.e. window size changing (and thus the extent values are no longer consistent)
+// L[́FF12Ńg[X̏ŏo܂iJN̒ɉj
+// F12 writes the trace on demand, e.g. right after a hitch
+void CVulkanFramework::keyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+	CVulkanFramework* app = reinterpret_cast<CVulkanFramework*>(glfwGetWindowUserPointer(window));
+	if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+	{
+		app->writeTrace();
+	}
+}
+#endif
+
+// g[Xo܂ig[X̏ꍇ͉܂j
+// Write the trace file; does nothing when tracing is off
+void CVulkanFramework::writeTrace()
+{
+	if (m_TracePath.empty())
+	{
+		return;
+	}
+
+	if (CTrace::writeChromeJson(m_TracePath, m_TraceSeconds))
+	{
+		std::cout << "Trace written to " << m_TracePath << " (open in chrome://tracing or ui.perfetto.dev)" << std::endl;
+	}
+	else
+	{
+		std::cerr << "Failed to write trace file " << m_TracePath << std::endl;
+	}
+}
+
+// SwapChainEBhET[tFXɑΉĂȂꍇiEChETCYjASwapChainĐ
+// Kv܂BSwapChain̓EBhETCYɈˑIuWFNgSwapChainƓ
+// ĐȂƂ܂B
+// Recreate swap chain and all creation functions for the object that depend on the swap chain or the window size.
+// This step is to be implemented when the swap chain is no longer compatible with the window surface;
+// i.e. window size changing (and thus the extent values are no longer consistent)
 void CVulkanFramework::recreateSwapChain()
 {
+	TRACE_FUNCTION();
+	m_SwapChainRecreateMetric.add();
+
+#if !defined(HEADLESS_ONLY)
 	int width = 0, height = 0;
 	glfwGetFramebufferSize(m_Window, &width, &height);
 	while (width == 0 || height == 0)                       // EBhEŏԂ̏ꍇ window is minimized
@@ -1996,43 +3003,129 @@ void CVulkanFramework::recreateSwapChain()
 		glfwGetFramebufferSize(m_Window, &width, &height);  // ŏ̏O܂ŃEChEU~
 		glfwWaitEvents();                                   // window paused until window in foreground
 	}
+#endif
 
-	vkDeviceWaitIdle(m_LogicalDevice);    // gp̃\[X̏I܂ő҂ƁBdo not touch resources that are still in use, wait for them to complete.
+	// vkDeviceWaitIdle()ő҂ɁAÂ\[X͒x폜L[ɓāAgIĂ폜܂
+	// no vkDeviceWaitIdle(): retired resources go to the deferred deletion queue and are destroyed once the GPU is done with them
+	const VkFormat oldImageFormat = m_SwapChainImageFormat;
+	const size_t oldImageCount = m_SwapChainImages.size();
 
-	cleanupSwapChain();         // SwapChaiňЕt
-	createSwapChain();          // SwapChain̂Đ
+	retireSwapChainResources(); // TCYɈˑ摜Et[obt@[x폜
+	createSwapChain();          // SwapChain̂ĐioldSwapchainnāAÂ̂͒x폜j
 	createImageViews();         // SwapChain̉摜Ɉˑ
-	createRenderPass();         // SwapChain̉摜̃tH[}bgɈˑ
-	createGraphicsPipeline();   // r[|[gAScissorɈˑ
-	createColorResources();     // `揈ɉe܂ 
-	createDepthResources();     // fvXobt@[][VEChETCYɍ킹܂
+
+	// _[pXEpCvC̓tH[}bgςꍇ̂݁ir[|[gEVU[̓_Ci~bNj
+	// the render pass and pipeline only depend on the format; viewport and scissor are dynamic
+	if (m_SwapChainImageFormat != oldImageFormat)
+	{
+		// ÂtH[}bg̃pCvCCPipelineManagerɎc܂ĩtH[}bgɖ߂΍ėpj
+		// variants for the old format stay in CPipelineManager and are reused if the format comes back
+		VkRenderPass oldRenderPass = m_RenderPass;
+		deferDestruction([this, oldRenderPass]()
+		{
+			// [J[܂RpCɎgĂꍇ́AgICPipelineManager폜܂i҂܂j
+			// if a worker is still compiling against it, CPipelineManager destroys it when that compile ends; no wait here
+			m_PipelineManager.retireRenderPass(oldRenderPass);
+		});
+
+		createRenderPass();         // SwapChain̉摜̃tH[}bgɈˑ
+		createGraphicsPipeline();   // _[pX̌݊L[ς̂ŁAVoAg
+	}
+
+	createAttachmentResources();    // MSAAJ[EfvX̃TCYEChETCYɍ킹܂
 	createFramebuffers();       // SwapChain̉摜Ɉˑ
-	createUniformBuffers();     // SwapChain̉摜Ɉˑ
-	createDescriptorPool();     // SwapChain̉摜Ɉˑ
-	createDescriptorSets();     // SwapChain̉摜Ɉˑ
-	createCommandBuffers();     // SwapChain̉摜Ɉˑ
+
+	// 摜Ƃ̃obt@[EfXNv^[ER}hobt@[͉摜ςꍇ̂݁i܂j
+	// per-image buffers, descriptors and command buffers only change with the image count, which is rare
+	if (m_SwapChainImages.size() != oldImageCount)
+	{
+		vkDeviceWaitIdle(m_LogicalDevice);    // 摜Ƃ̃\[X͑St[ŎgĂ̂ŁA͑҂܂
+
+		cleanupPerImageResources();
+		createUniformBuffers();     // SwapChain̉摜Ɉˑ
+		createInstanceBuffers();    // SwapChain̉摜Ɉˑ
+		createIndirectBuffers();    // SwapChain̉摜Ɉˑ
+		createDescriptorSets();     // SwapChain̉摜Ɉˑiv[͍ėpj
+		createCommandBuffers();     // SwapChain̉摜Ɉˑ
+	}
+
+	// 摜Ƃ̃\[XŌɎgoԍ͎c܂i܂`撆̉\܂j
+	// keep the serials that last used each image's resources; those frames may still be in flight
+	m_ImageSubmitSerials.resize(m_SwapChainImages.size(), 0);
 }
 
-// jtH[obt@[XViUBOjF}gbNXgXtH[AJݒ
-void CVulkanFramework::updateUniformBuffer(uint32_t currentImage)
+// x폜L[ɒǉF݂܂łɒoR}hSĊĂs܂
+// Queue a destruction to run once every command buffer submitted so far has completed
+void CVulkanFramework::deferDestruction(std::function<void()> destroy)
+{
+	m_DeletionQueue.push_back({ m_SubmitSerial, std::move(destroy) });
+}
+
+// x폜L[̏F^CCŊmFoԍ܂ł̃\[X폜܂
+// Destroy the queued resources whose submissions the frame timeline shows as complete
+void CVulkanFramework::processDeletionQueue()
 {
+	// ^CČݒlF̔ԍ܂ł̒oSĊĂ܂
+	// the timeline's current value: every submission up to it has completed
+	uint64_t completedSerial;
+	if (vkGetSemaphoreCounterValue(m_LogicalDevice, m_FrameTimeline, &completedSerial) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to read the frame timeline!");
+	}
+	retireSerials(completedSerial);
+
+	auto completed = std::stable_partition(m_DeletionQueue.begin(), m_DeletionQueue.end(),
+		[this](const DeferredDeletion& deletion) { return deletion.submitSerial > m_CompletedSerial; });
+	for (auto it = completed; it != m_DeletionQueue.end(); ++it)
+	{
+		it->destroy();
+	}
+	m_DeletionQueue.erase(completed, m_DeletionQueue.end());
+}
+
+// x폜L[SĎsifoCXACh̏ꍇ̂݁FIj
+// Run every queued destruction; only valid while the device is idle (shutdown)
+void CVulkanFramework::flushDeletionQueue()
+{
+	for (DeferredDeletion& deletion : m_DeletionQueue)
+	{
+		deletion.destroy();
+	}
+	m_DeletionQueue.clear();
+	m_CompletedSerial = m_SubmitSerial;
+}
+
+// V[XVF}gbNXgXtH[AJݒACPUJOi`Xbh̃\[Xɂ͐G܂j
+// Scene update: transforms, camera and CPU culling, written only into the snapshot (no GPU resources touched)
+void CVulkanFramework::updateScene(FrameSnapshot& snapshot)
+{
+	TRACE_FUNCTION();
+
 	//// startTimeAcurrentTime̎ۂ̃f[^^: static std::chrono::time_point<std::chrono::steady_clock> 
 	static auto startTime = std::chrono::high_resolution_clock::now();
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
-	UniformBufferObject ubo{};  // MVPgXtH[\
+	// CX^Xz͋L|C^[Ŏ󂯎܂isetInstances()͐Vzɍւ邾j
+	// take a reference to the current instance list; setInstances() swaps in a new list rather than editing this one
+	{
+		std::lock_guard<std::mutex> lock(m_InstancesMutex);
+		snapshot.instances = m_Instances;
+		snapshot.instancesVersion = m_InstancesVersion;
+	}
+
+	UniformBufferObject& ubo = snapshot.ubo;  // VPgXtH[\
 
-	//// M(Model: t[AZX]
-	// ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	//// M(Model: t[AZX]iUBOł͂ȂAvbV萔ŕ`悲Ƃɓn܂j
+	//// the model matrix is pushed per draw in recordCommandBuffer() instead of living in the UBO
+	snapshot.modelTransform = glm::rotate(glm::mat4(1.0f), time * glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 	//
 	// V(View): @eyeʒu, centerʒu, up
 	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
 	// P(Projection): @45o[eBJFoV, AXyNgAjAAt@[r[v[
 	// arguments: field-of-view, aspect ratio, near and far view planes 
-	ubo.proj = glm::perspective(glm::radians(45.0f), m_SwapChainExtent.width / (float)m_SwapChainExtent.height, 0.1f, 10.0f);
+	ubo.proj = glm::perspective(glm::radians(45.0f), m_AspectRatio.load(), 0.1f, 10.0f);
 
 	//// XGLMOpelGLɑΉ邽߂ɐ݌vĂ܂iỸNbvWtɂȂĂ܂jB
 	//// VulkanɑΉ邽߂ɃNbvWYuɖ߂vłBȂƕ`͂ЂԂԂɂȂĂ܂܂B
@@ -2042,21 +3135,813 @@ void CVulkanFramework::updateUniformBuffer(uint32_t currentImage)
 	//// Not doing this results in an upside-down render.
 	ubo.proj[1][1] *= -1;
 
+	// CPUJOpFCX^XԂ̎proj * view * model璊o܂
+	// the CPU culler extracts its planes from proj * view * model (instance space)
+	snapshot.cullMatrix = ubo.proj * ubo.view * snapshot.modelTransform;
+
+	// GPUJO͑SCX^Xǂނ̂ŁACPUJOGPUJȌꍇ̂
+	// GPU culling reads every instance, so CPU culling only applies when GPU culling is off
+	snapshot.cpuCulled = m_CpuCulling && !(m_GpuDrivenCulling && m_GpuCullingSupported);
+	if (snapshot.cpuCulled)
+	{
+		cullInstances(snapshot);
+	}
+}
+
+// CPUJOFCX^X̃CfbNXXibvVbgɋl߂܂
+// CPU culling: store the indices of the visible instances, compacted, in the snapshot
+void CVulkanFramework::cullInstances(FrameSnapshot& snapshot)
+{
+	// CX^Xςꍇ̂݋EiSoAj蒼܂
+	// rebuild the SoA bounding spheres only when the instance list has changed
+	if (m_FrustumCullerVersion != snapshot.instancesVersion)
+	{
+		m_FrustumCuller.clear();
+		m_FrustumCuller.reserve(snapshot.instances->size());
+		for (const InstanceData& instance : *snapshot.instances)
+		{
+			const glm::mat4& model = instance.model;
+			const glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(m_ModelBoundingSphere), 1.0f));
+			const float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+			m_FrustumCuller.addSphere(center, m_ModelBoundingSphere.w * scale);
+		}
+		m_FrustumCullerVersion = snapshot.instancesVersion;
+	}
+
+	m_FrustumCuller.setPlanes(snapshot.cullMatrix);
+	snapshot.visibleInstances.resize(m_FrustumCuller.cull(snapshot.visibleInstances));
+}
+
+// XVXbhF`XbhÕXibvVbg󂯎A܂i1܂Łj
+// Update thread: build the next snapshot as soon as the render thread has taken the previous one
+// XVƕ`悪dȂ̂ŁA1t[̎Ԃ́uXV{`vł͂ȂxɂȂ܂
+// update and render overlap, so a frame costs the slower of the two rather than their sum
+void CVulkanFramework::updateLoop()
+{
+	CTrace::setThreadName("update");
+
+	while (m_SnapshotMailbox.waitForConsumer())
+	{
+		updateScene(m_SnapshotMailbox.getWriteSlot());
+		m_SnapshotMailbox.publish();
+	}
+}
+
+void CVulkanFramework::startUpdateThread()
+{
+	m_SnapshotMailbox.reset();
+	if (m_UpdateThreadEnabled)
+	{
+		m_UpdateThread = std::thread(&CVulkanFramework::updateLoop, this);
+	}
+}
+
+void CVulkanFramework::stopUpdateThread()
+{
+	if (m_UpdateThread.joinable())
+	{
+		m_SnapshotMailbox.close();
+		m_UpdateThread.join();
+	}
+}
+
+// ŐṼXibvVbg󂯎܂iXVXbhȂ΂ōXV܂j
+// Take the newest snapshot, updating the scene right here when there is no update thread
+void CVulkanFramework::acquireSnapshot()
+{
+	TRACE_FUNCTION();
+
+	if (m_UpdateThread.joinable() == false)
+	{
+		updateScene(m_SnapshotMailbox.getWriteSlot());
+		m_SnapshotMailbox.publish();
+	}
+
+	m_Snapshot = m_SnapshotMailbox.acquire(true);    // XV`xꍇ͂ő҂܂
+	if (m_Snapshot == nullptr)
+	{
+		throw std::runtime_error("Failed to acquire frame snapshot!");
+	}
+
+	m_ModelTransform = m_Snapshot->modelTransform;
+	m_CullMatrix = m_Snapshot->cullMatrix;
+}
+
+// jtH[obt@[XViUBOjFXibvVbgView/Projection
+// Copy the snapshot's view/projection into this image's uniform buffer
+void CVulkanFramework::updateUniformBuffer(uint32_t currentImage)
+{
 	//// UBÕ݂jtH[obt@[ɂ܂
 	void* data;
-	vkMapMemory(m_LogicalDevice, m_UniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-	memcpy(data, &ubo, sizeof(ubo));
+	vkMapMemory(m_LogicalDevice, m_UniformBuffersMemory[currentImage], 0, sizeof(UniformBufferObject), 0, &data);
+	memcpy(data, &m_Snapshot->ubo, sizeof(UniformBufferObject));
+	m_UploadBytesMetric.add(sizeof(UniformBufferObject));
 	vkUnmapMemory(m_LogicalDevice, m_UniformBuffersMemory[currentImage]);
 }
 
+// CX^Xobt@[XVF̉摜̃obt@[Âꍇ̂݃Rs[܂
+// Copy the instance list into this image's buffer, only if it has changed since that buffer was last written
+void CVulkanFramework::updateInstanceBuffer(uint32_t currentImage)
+{
+	const std::vector<InstanceData>& instances = *m_Snapshot->instances;
+
+	// CPUJOFCX^Xl߂ď݂܂
+	// CPU culling: write only the visible instances, compacted
+	if (m_Snapshot->cpuCulled)
+	{
+		InstanceData* mapped = static_cast<InstanceData*>(m_InstanceBuffersMapped[currentImage]);
+		for (size_t i = 0; i < m_Snapshot->visibleInstances.size(); i++)
+		{
+			mapped[i] = instances[m_Snapshot->visibleInstances[i]];
+		}
+
+		m_DrawInstanceCounts[currentImage] = static_cast<uint32_t>(m_Snapshot->visibleInstances.size());
+		m_InstanceBuffersVersion[currentImage] = 0;    // SCX^Xł͂Ȃ̂ŁAJOɏ܂
+		return;
+	}
+
+	m_DrawInstanceCounts[currentImage] = static_cast<uint32_t>(instances.size());
+	if (m_InstanceBuffersVersion[currentImage] == m_Snapshot->instancesVersion)
+	{
+		return;
+	}
+
+	memcpy(m_InstanceBuffersMapped[currentImage], instances.data(), sizeof(InstanceData) * instances.size());
+	m_UploadBytesMetric.add(sizeof(InstanceData) * instances.size());
+	m_InstanceBuffersVersion[currentImage] = m_Snapshot->instancesVersion;
+}
+
+// CX^XzݒFGPUւ̃Rs[͊e摜̎̃t[ōs܂
+// Set the instance list; each swap chain image picks it up the next time it is drawn
+void CVulkanFramework::setInstances(const std::vector<InstanceData>& instances)
+{
+	if (instances.size() > MAX_INSTANCE_COUNT)
+	{
+		throw std::runtime_error("Instance count exceeds instance buffer capacity!");
+	}
+
+	// z͍ւ邾FXVXbhE`撆̃XibvVbg͑O̔z܂܂ł
+	// swap in a new list; snapshots still being updated or drawn keep the previous one
+	std::lock_guard<std::mutex> lock(m_InstancesMutex);
+	m_Instances = std::make_shared<const std::vector<InstanceData>>(instances);
+	m_InstancesVersion++;
+}
+
+// pCvCLbVt@C̓ǂݏ̗LEirun()̑Oɐݒj
+void CVulkanFramework::setPipelineCacheEnabled(bool enable)
+{
+	m_PipelineCacheEnabled = enable;
+}
+
+// VF[_[@\̐ݒirun()̑OɐݒApCvC̓ꉻ萔ɂȂ܂j
+void CVulkanFramework::setShaderFeatures(const ShaderFeatures& features)
+{
+	m_ShaderFeatures = features;
+}
+
+// CeV[|V[̐ݒirun()̑OɐݒAt[1`MAX_FRAMES_IN_FLIGHTj
+void CVulkanFramework::setLatencyPolicy(const LatencyPolicy& policy)
+{
+	m_LatencyPolicy = policy;
+	m_FramesInFlight = std::min(std::max(policy.framesInFlight, 1u), MAX_FRAMES_IN_FLIGHT);
+}
+
+// GPU쓮JO̗LEirun()̑OłAΉ̃foCXł͒ʏ̕`̂܂܁j
+void CVulkanFramework::setGpuDrivenCulling(bool enable)
+{
+	m_GpuDrivenCulling = enable;
+}
+
+// CPUJO̗LEiGPU쓮JOLȏꍇ͂炪Dj
+void CVulkanFramework::setCpuCulling(bool enable)
+{
+	m_CpuCulling = enable;
+}
+
+// XVXbh̗LEirun()̑OɐݒAɂƍXVƕ`悪XbhŏԂɁj
+void CVulkanFramework::setUpdateThreadEnabled(bool enable)
+{
+	m_UpdateThreadEnabled = enable;
+}
+
+// GPUvt@C[̏WvIɏóiv̂͑ΉĂΏɍs܂j
+void CVulkanFramework::setGpuProfileReport(bool enable)
+{
+	m_GpuProfileReport = enable;
+}
+
+// zXg[virun()̑OɐݒF쐬ƍ폜œR[obNnKv܂j
+void CVulkanFramework::setHostAllocatorTracking(bool enable, bool pool)
+{
+	m_HostAllocator.setPoolEnabled(enable && pool);
+	m_Allocator = enable ? m_HostAllocator.getCallbacks() : nullptr;
+}
+
+// of[VbZ[WID1b̏o͏i0FȂj
+void CVulkanFramework::setDebugMessageRateLimit(uint32_t maxPerSecond)
+{
+	m_DebugSink.setRateLimit(maxPerSecond);
+}
+
+// gNX̏o͐irun()̑OɐݒAFo͂ȂjBgNX̂͏ɍXV܂
+void CVulkanFramework::setMetricsExport(const std::string& target, double intervalSeconds)
+{
+	m_MetricsTarget = target;
+	m_MetricsIntervalSeconds = intervalSeconds;
+}
+
+// ̒iKƂ̎Ԃŏ̃t[̎ɏóiv̂͏ɍs܂j
+void CVulkanFramework::setStartupReport(bool enable)
+{
+	m_StartupReport = enable;
+}
+
+// g[X̏o͐irun()̑OɐݒAFg[XjBlastSeconds0傫Β߂̂̕b̂
+void CVulkanFramework::setTraceOutput(const std::string& path, double lastSeconds)
+{
+	m_TracePath = path;
+	m_TraceSeconds = lastSeconds;
+}
+
+// CPU̎QƎFcull.compƓeXgBmargin͋Eƍł߂ʂƂ̗]TiFOj
+// CPU reference for cull.comp; margin is how far inside the closest plane the sphere is (negative: culled)
+static bool isSphereInFrustum(const glm::mat4& viewProj, const glm::vec3& center, float radius, float& margin)
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+	}
+
+	const glm::vec4 planes[6] =
+	{
+		rows[3] + rows[0], rows[3] - rows[0],    // left, right
+		rows[3] + rows[1], rows[3] - rows[1],    // bottom, top
+		rows[2],           rows[3] - rows[2]     // near (0..1 depth), far
+	};
+
+	margin = FLT_MAX;
+	for (const glm::vec4& plane : planes)
+	{
+		const glm::vec3 normal(plane.x, plane.y, plane.z);
+		const float distance = (glm::dot(normal, center) + plane.w) / glm::length(normal);
+		margin = std::min(margin, distance + radius);
+	}
+	return margin >= 0.0f;
+}
+
+// GPUJǑ؁FeXgObhJOāAʂCPU̎QƎƔr܂
+// Cull a test grid on the GPU, read the indirect buffer back and compare it with the CPU reference
+bool CVulkanFramework::validateGpuCulling()
+{
+	if (!m_GpuCullingSupported)
+	{
+		std::cerr << "GPU culling validation skipped: device lacks drawIndirectFirstInstance, multiDrawIndirect or compute "
+			"on the graphics queue, or the model has more than " << MAX_DRAW_RANGES << " pipeline variants." << std::endl;
+		return false;
+	}
+
+	vkDeviceWaitIdle(m_LogicalDevice);
+
+	// eXgV[FJ̎ɍLObhiꕔ͎̊Oj
+	// test scene: a grid wide enough that part of it falls outside the frustum
+	const std::vector<InstanceData> savedInstances = *m_Instances;
+	std::vector<InstanceData> testInstances;
+	const int gridSize = 64;
+	for (int y = 0; y < gridSize; y++)
+	{
+		for (int x = 0; x < gridSize; x++)
+		{
+			const glm::vec3 offset((x - gridSize / 2) * 1.5f, (y - gridSize / 2) * 1.5f, 0.0f);
+			testInstances.push_back({ glm::translate(glm::mat4(1.0f), offset) });
+		}
+	}
+	setInstances(testInstances);
+
+	const uint32_t imageIndex = 0;
+	acquireSnapshot();    // `惋[v̊OFXVXbhȂłōXV
+	updateUniformBuffer(imageIndex);
+	updateInstanceBuffer(imageIndex);
+
+	UniformBufferObject ubo;
+	void* uboData;
+	vkMapMemory(m_LogicalDevice, m_UniformBuffersMemory[imageIndex], 0, sizeof(ubo), 0, &uboData);
+	memcpy(&ubo, uboData, sizeof(ubo));
+	vkUnmapMemory(m_LogicalDevice, m_UniformBuffersMemory[imageIndex]);
+
+	const std::vector<InstanceData>& instances = *m_Snapshot->instances;
+	const uint32_t objectCount = static_cast<uint32_t>(instances.size() * m_Submeshes.size());
+	const bool compact = (m_pfnCmdDrawIndexedIndirectCount != nullptr) && (objectCount <= m_MaxDrawIndirectCount);
+	const VkDeviceSize readbackSize = INDIRECT_COMMANDS_OFFSET + sizeof(VkDrawIndexedIndirectCommand) * objectCount;
+
+	VkBuffer readbackBuffer;
+	VkDeviceMemory readbackBufferMemory;
+	createBuffer(
+		readbackSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		readbackBuffer,
+		readbackBufferMemory);
+
+	CRenderGraph cullGraph;
+	const CRenderGraph::ResourceHandle indirect = addCullingPasses(cullGraph, imageIndex, objectCount, compact);
+
+	const uint32_t readbackPass = cullGraph.addPass("readback", [&](VkCommandBuffer commandBuffer)
+		{
+			VkBufferCopy copyRegion{};
+			copyRegion.size = readbackSize;
+			vkCmdCopyBuffer(commandBuffer, m_IndirectBuffers[imageIndex], readbackBuffer, 1, &copyRegion);
+		});
+	cullGraph.use(readbackPass, indirect, ResourceUsage::TransferRead);
+	cullGraph.use(readbackPass, cullGraph.importBuffer("readback", readbackBuffer), ResourceUsage::TransferWrite);
+	cullGraph.compile();
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	cullGraph.execute(commandBuffer);
+	endSingleTimeCommands(commandBuffer);
+
+	// GPǓʁF`悳IuWFNgiCX^X, firstIndexj̏WA͈͂Ƃɕ`悳镪̂
+	// GPU result: the set of (instance, firstIndex) pairs that will actually draw, read range by range as the draw loop does
+	//   ͈͊ÕTubṼR}hiႤpCvCŕ`悳܂jsvƂĐ܂
+	//   a command for a submesh outside its range would draw with the wrong pipeline, so it counts as a mismatch too
+	std::set<std::pair<uint32_t, uint32_t>> gpuVisible;
+	uint32_t mismatches = 0;
+	const uint32_t instanceCount = static_cast<uint32_t>(instances.size());
+	void* data;
+	vkMapMemory(m_LogicalDevice, readbackBufferMemory, 0, readbackSize, 0, &data);
+	const uint32_t* gpuDrawCounts = static_cast<const uint32_t*>(data);
+	const VkDrawIndexedIndirectCommand* commands = reinterpret_cast<const VkDrawIndexedIndirectCommand*>(
+		static_cast<const char*>(data) + INDIRECT_COMMANDS_OFFSET);
+	for (uint32_t rangeIndex = 0; rangeIndex < m_DrawRanges.size(); rangeIndex++)
+	{
+		const DrawRange& range = m_DrawRanges[rangeIndex];
+		const uint32_t pipelineId = m_SubmeshPipelines[range.submeshIndex].pipelineId;
+		const uint32_t slotCount = range.submeshCount * instanceCount;
+		const uint32_t drawCount = compact ? std::min(gpuDrawCounts[rangeIndex], slotCount) : slotCount;
+
+		for (uint32_t i = range.firstSlot * instanceCount; i < range.firstSlot * instanceCount + drawCount; i++)
+		{
+			if (commands[i].instanceCount == 0)
+			{
+				continue;
+			}
+			gpuVisible.insert({ commands[i].firstInstance, commands[i].firstIndex });
+
+			const auto submesh = std::find_if(m_Submeshes.begin(), m_Submeshes.end(),
+				[&](const Submesh& candidate) { return candidate.firstIndex == commands[i].firstIndex; });
+			if (submesh == m_Submeshes.end() || m_SubmeshPipelines[submesh - m_Submeshes.begin()].pipelineId != pipelineId)
+			{
+				mismatches++;
+			}
+		}
+	}
+	vkUnmapMemory(m_LogicalDevice, readbackBufferMemory);
+
+	vkDestroyBuffer(m_LogicalDevice, readbackBuffer, m_Allocator);
+	freeDeviceMemory(readbackBufferMemory);
+
+	// CPU̎QƌʂƔriʂ肬̃IuWFNg͕_덷̂ߏOj
+	// compare with the CPU reference, skipping objects that sit on a plane within float tolerance
+	const glm::mat4 viewProj = ubo.proj * ubo.view;
+	uint32_t cpuVisibleCount = 0;
+	for (uint32_t instance = 0; instance < instances.size(); instance++)
+	{
+		const glm::mat4 world = m_ModelTransform * instances[instance].model;
+		const float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+
+		for (const Submesh& submesh : m_Submeshes)
+		{
+			const glm::vec3 center = glm::vec3(world * glm::vec4(glm::vec3(submesh.boundingSphere), 1.0f));
+			const float radius = submesh.boundingSphere.w * scale;
+
+			float margin;
+			const bool cpuVisible = isSphereInFrustum(viewProj, center, radius, margin);
+			cpuVisibleCount += cpuVisible ? 1 : 0;
+
+			const bool gpuResult = gpuVisible.count({ instance, submesh.firstIndex }) > 0;
+			if (cpuVisible != gpuResult && std::abs(margin) > 1e-3f * (radius + 1.0f))
+			{
+				mismatches++;
+			}
+		}
+	}
+
+	std::cout << "GPU culling validation (" << (compact ? "draw count" : "per-object slots") << ", "
+		<< m_DrawRanges.size() << " pipeline ranges): "
+		<< gpuVisible.size() << " / " << objectCount << " visible on GPU, "
+		<< cpuVisibleCount << " on CPU, " << mismatches << " mismatches" << std::endl;
+
+	setInstances(savedInstances);
+	return mismatches == 0;
+}
+
+// ؃[hFwbhXVulkanČ؂̂ݎs܂iEBhEESwapChainE`惋[vȂj
+// Validation mode: a headless init, one validateGpuCulling() and cleanup; no window, swap chain or main loop
+int CVulkanFramework::runCullValidation()
+{
+	m_Headless = true;
+	m_StartupQuiet = true;
+	m_StartTime = std::chrono::high_resolution_clock::now();
+	m_StartupStages.clear();
+
+	initVulkan();
+
+	const bool passed = validateGpuCulling();
+
+	vkDeviceWaitIdle(m_LogicalDevice);
+	cleanup();
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ŋߖTʖ@̃p[Z^Cisorted͏j
+// nearest-rank percentile of an ascending list
+static double percentile(const std::vector<double>& sorted, uint32_t percent)
+{
+	const size_t rank = (sorted.size() * percent + 99) / 100;
+	return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+// wbhXx`}[NFGLFWEVK_KHR_surfaceEVK_KHR_swapchaing킸ɕ`惋[v̂݌v܂
+// Headless benchmark: times the render loop alone, with no GLFW, VK_KHR_surface or VK_KHR_swapchain
+int CVulkanFramework::runHeadlessBenchmark(uint32_t frameCount)
+{
+	m_Headless = true;
+	m_StartTime = std::chrono::high_resolution_clock::now();
+	m_StartupStages.clear();
+	CTrace::setEnabled(m_TracePath.empty() == false);
+	CTrace::setThreadName("main");
+
+	initVulkan();
+
+	// ŏ1̓EH[AbvipCvC̃RpCELbVjƂďWv܂
+	// the first tenth is warm-up (pipeline compiles, caches) and left out of the statistics
+	const uint32_t warmupFrames = frameCount / 10;
+	std::vector<double> frameMilliseconds;
+	frameMilliseconds.reserve(frameCount);
+
+	startUpdateThread();
+	auto measuredStart = std::chrono::high_resolution_clock::now();
+	try
+	{
+		for (uint32_t frame = 0; frame < frameCount; frame++)
+		{
+			if (frame == warmupFrames)
+			{
+				measuredStart = std::chrono::high_resolution_clock::now();
+			}
+
+			m_InputTime = std::chrono::high_resolution_clock::now();
+			drawFrame();
+			const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_InputTime).count();
+			if (frame >= warmupFrames)
+			{
+				frameMilliseconds.push_back(milliseconds);
+			}
+		}
+	}
+	catch (...)
+	{
+		stopUpdateThread();
+		throw;
+	}
+	stopUpdateThread();
+
+	// Ō̃t[̊҂Ăv~߂܂iGPȔ܂߂FPSj
+	// stop the clock once the last frame has completed, so fps includes the GPU work
+	vkDeviceWaitIdle(m_LogicalDevice);
+	const double measuredSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - measuredStart).count();
+
+	// Ō̃t[̃^CX^vWv܂
+	// collect the timestamps of the last frames
+	for (uint32_t i = 0; i < m_FramesInFlight; i++)
+	{
+		m_GpuProfiler.beginFrame(i);
+	}
+
+	std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+	std::cout << "Headless benchmark: " << frameMilliseconds.size() << " frames (" << warmupFrames << " warm-up frames skipped), "
+		<< m_SwapChainExtent.width << "x" << m_SwapChainExtent.height << ", " << m_FramesInFlight << " frames in flight" << std::endl;
+	if (frameMilliseconds.empty() == false)
+	{
+		std::cout << std::fixed << std::setprecision(3)
+			<< "  fps            " << frameMilliseconds.size() / measuredSeconds << std::endl
+			<< "  CPU frame (ms) p50 " << percentile(frameMilliseconds, 50) << "  p95 " << percentile(frameMilliseconds, 95)
+			<< "  p99 " << percentile(frameMilliseconds, 99) << "  max " << frameMilliseconds.back() << std::endl
+			<< std::defaultfloat;
+	}
+	m_GpuProfiler.report(std::cout);
+
+	cleanup();
+	writeTrace();
+
+	return EXIT_SUCCESS;
+}
+
+// Nx`}[NFŏ̃t[܂łrunCountAR[hEEH[ŌvAiKƂ̒lo͂܂
+// Startup benchmark: initialization to first frame, runCount times cold and warm, reported as per-stage medians
+//   R[hFpCvCLbVt@CȂihCo[g̃VF[_[LbV͑ΏۊOj
+//   cold runs skip the pipeline cache file; the driver's own shader cache is outside our control
+//   EH[FvO1ŃLbVt@C݁Aȍ~͂ǂݍ݂܂
+//   warm runs load the cache file, written by one untimed priming run
+//   LbVt@C̓x`}[NpiBENCHMARK_PIPELINE_CACHE_PATHjŁAʏ̃t@C͕ύXAIɍ폜܂
+//   the cache file is benchmark-only (BENCHMARK_PIPELINE_CACHE_PATH), so the real one is untouched; it is removed at the end
+int CVulkanFramework::runStartupBenchmark(uint32_t runCount, bool headless)
+{
+	// 1̋NF  ŏ̃t[  ЕtBiK̎ԁiŌɍvEŏ̃t[jԂ܂
+	// one startup: init, first frame, cleanup; returns the stage times followed by the total and the first frame
+	auto startup = [headless](bool warm, std::vector<const char*>& names)
+	{
+		std::unique_ptr<CVulkanFramework> app = std::make_unique<CVulkanFramework>();
+		app->setPipelineCacheEnabled(warm);
+		app->m_PipelineCachePath = BENCHMARK_PIPELINE_CACHE_PATH;
+		app->m_Headless = headless;
+		app->m_StartupQuiet = true;
+		app->m_StartTime = std::chrono::high_resolution_clock::now();
+
+		if (headless == false)
+		{
+			app->runInitStage("initWindow", &CVulkanFramework::initWindow);
+		}
+		app->initVulkan();
+		while (app->m_FirstFramePresented == false)    // SwapChain̍ĐȂǂŕ\Ȃꍇ͎̃t[
+		{
+#if !defined(HEADLESS_ONLY)
+			if (headless == false)
+			{
+				glfwPollEvents();
+			}
+#endif
+			app->drawFrame();
+		}
+		vkDeviceWaitIdle(app->m_LogicalDevice);
+		app->cleanup();
+
+		std::vector<double> times;
+		double totalMilliseconds = 0.0;
+		names.clear();
+		for (const StartupStage& stage : app->m_StartupStages)
+		{
+			names.push_back(stage.name);
+			times.push_back(stage.milliseconds);
+			totalMilliseconds += stage.milliseconds;
+		}
+		times.push_back(totalMilliseconds);
+		times.push_back(app->m_FirstFrameMilliseconds);
+		return times;
+	};
+
+	std::vector<const char*> names;
+	std::vector<std::vector<double>> coldRuns, warmRuns;    // [iK][]
+	auto addRun = [](std::vector<std::vector<double>>& runs, const std::vector<double>& times)
+	{
+		runs.resize(times.size());
+		for (size_t i = 0; i < times.size(); i++)
+		{
+			runs[i].push_back(times[i]);
+		}
+	};
+
+	std::error_code error;
+	std::filesystem::remove(BENCHMARK_PIPELINE_CACHE_PATH, error);    // O̒fŎct@C
+
+	for (uint32_t i = 0; i < runCount; i++)
+	{
+		addRun(coldRuns, startup(false, names));
+	}
+	startup(true, names);    // LbVt@C̏݁ivȂj
+	for (uint32_t i = 0; i < runCount; i++)
+	{
+		addRun(warmRuns, startup(true, names));
+	}
+
+	std::filesystem::remove(BENCHMARK_PIPELINE_CACHE_PATH, error);
+
+	names.push_back("total");
+	names.push_back("first frame");
+
+	std::cout << "Startup benchmark: " << runCount << " cold and " << runCount << " warm runs"
+		<< (headless ? " (headless)" : "") << ", median ms" << std::endl
+		<< "  " << std::left << std::setw(28) << "stage" << std::right << std::setw(10) << "cold" << std::setw(10) << "warm" << std::endl
+		<< std::fixed << std::setprecision(3);
+	for (size_t i = 0; i < names.size() && i < coldRuns.size() && i < warmRuns.size(); i++)
+	{
+		std::sort(coldRuns[i].begin(), coldRuns[i].end());
+		std::sort(warmRuns[i].begin(), warmRuns[i].end());
+		std::cout << "  " << std::left << std::setw(28) << names[i] << std::right
+			<< std::setw(10) << percentile(coldRuns[i], 50) << std::setw(10) << percentile(warmRuns[i], 50) << std::endl;
+	}
+	std::cout << std::defaultfloat;
+
+	return EXIT_SUCCESS;
+}
+
+// S[f摜eXgFŒJiupdateScene()lookAtjŃwbhX1t[`悵Aǂݖ߂ăS[f摜Ɣr܂
+// Golden image test: render one headless frame from the fixed updateScene() camera, read it back and compare it
+// against the golden PNG; updateGolden writes the frame as the new golden image instead
+//   tolerancePercentFesvsNZ̊i%jBsNZƂ臒lCGoldenImage::compare()̊l
+//   tolerancePercent: share of mismatched pixels allowed, in percent; the per-pixel threshold is compare()'s default
+int CVulkanFramework::runGoldenImageTest(const std::string& goldenPath, double tolerancePercent, bool updateGolden)
+{
+	m_Headless = true;
+	m_StartupQuiet = true;
+	m_StartTime = std::chrono::high_resolution_clock::now();
+	m_StartupStages.clear();
+
+	initVulkan();
+
+	// `掞ԁFoGPŮ܂ŁiCPŰL^܂݂܂j
+	// render time runs from recording until the GPU has finished the frame
+	const uint32_t imageIndex = static_cast<uint32_t>(m_CurrentFrame);    // wbhXF摜t[g
+	const auto renderStartTime = std::chrono::high_resolution_clock::now();
+	drawFrame();
+	waitForSerial(m_SubmitSerial);
+	const double renderMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - renderStartTime).count();
+	m_GpuProfiler.beginFrame(imageIndex);    // ̃t[̃^CX^vWv
+
+	const uint32_t width = m_SwapChainExtent.width;
+	const uint32_t height = m_SwapChainExtent.height;
+	const std::vector<uint8_t> pixels = readbackOffscreenImage(imageIndex);
+
+	vkDeviceWaitIdle(m_LogicalDevice);
+	cleanup();
+
+	std::cout << "Golden image: rendered " << width << "x" << height << " in " << renderMilliseconds << " ms";
+	for (const GpuScopeStats& stats : m_GpuProfiler.getStats())
+	{
+		if (stats.name == "frame" && stats.sampleCount > 0)
+		{
+			std::cout << " (GPU " << stats.avgMs << " ms)";
+		}
+	}
+	std::cout << std::endl;
+
+	if (updateGolden)
+	{
+		// ŏ̃S[f摜FfBNgiFAsset/GoldenjȂ΍܂
+		// the first golden image may go into a directory that does not exist yet, e.g. Asset/Golden
+		const std::filesystem::path goldenDirectory = std::filesystem::path(goldenPath).parent_path();
+		std::error_code error;
+		if (goldenDirectory.empty() == false)
+		{
+			std::filesystem::create_directories(goldenDirectory, error);
+		}
+
+		if (CGoldenImage::save(goldenPath, width, height, pixels) == false)
+		{
+			throw std::runtime_error("Failed to write golden image!");
+		}
+		std::cout << "Golden image written to " << goldenPath << std::endl;
+		return EXIT_SUCCESS;
+	}
+
+	uint32_t goldenWidth = 0;
+	uint32_t goldenHeight = 0;
+	std::vector<uint8_t> goldenPixels;
+	if (CGoldenImage::load(goldenPath, goldenWidth, goldenHeight, goldenPixels) == false)
+	{
+		std::cerr << "Failed to load golden image " << goldenPath << " (write it with --golden-update)" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (goldenWidth != width || goldenHeight != height)
+	{
+		std::cerr << "Golden image is " << goldenWidth << "x" << goldenHeight << ", rendered " << width << "x" << height << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const ImageDifference difference = CGoldenImage::compare(goldenPixels, pixels, width, height);
+	const bool passed = difference.mismatchedPercent <= tolerancePercent;
+	std::cout << "Golden image " << (passed ? "PASSED" : "FAILED") << ": " << difference.mismatchedPixels << " mismatched pixels ("
+		<< difference.mismatchedPercent << " %, tolerance " << tolerancePercent << " %), mean delta " << difference.meanDelta
+		<< ", max delta " << difference.maxDelta << std::endl;
+
+	// sv̏ꍇ͕`挋ʂS[f摜ׂ̗ɏo܂irEXVpj
+	// on failure, write the rendered frame next to the golden image so the two can be compared
+	if (passed == false)
+	{
+		const std::string actualPath = goldenPath + ".actual.png";
+		if (CGoldenImage::save(actualPath, width, height, pixels))
+		{
+			std::cout << "Rendered frame written to " << actualPath << std::endl;
+		}
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// wbhX̃ItXN[摜zXgǂ߂obt@[ɃRs[ARGBA8ŕԂ܂
+// Copy a headless offscreen image into a host-visible buffer and return it as tightly packed RGBA8
+std::vector<uint8_t> CVulkanFramework::readbackOffscreenImage(uint32_t imageIndex)
+{
+	const uint32_t width = m_SwapChainExtent.width;
+	const uint32_t height = m_SwapChainExtent.height;
+	const VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height * 4;
+
+	VkBuffer readbackBuffer;
+	VkDeviceMemory readbackBufferMemory;
+	createBuffer(
+		imageSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		readbackBuffer,
+		readbackBufferMemory);
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+	// _[pX̏  Rs[̓ǂݍ݁iCAEg̓_[pX̍ŏICAEĝ܂܁j
+	// render pass writes before the copy reads; the image stays in the render pass's final layout
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = m_SwapChainImages[imageIndex];
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;      // 0Fl߂Ċi[
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, m_SwapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+
+	// Rs[݂̏zXg̓ǂݍ݂Ɍ悤ɂ܂
+	// make the copy's writes visible to the host read below
+	VkBufferMemoryBarrier hostBarrier{};
+	hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	hostBarrier.buffer = readbackBuffer;
+	hostBarrier.offset = 0;
+	hostBarrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+	endSingleTimeCommands(commandBuffer);    // L[̊܂ő҂܂
+
+	// B8G8R8A8  RGBA8BAt@͕sɂ܂iPNGœȂ悤Ɂj
+	// B8G8R8A8 to RGBA8; alpha is forced opaque so the PNG does not come out see-through
+	std::vector<uint8_t> pixels(static_cast<size_t>(imageSize));
+	void* data;
+	vkMapMemory(m_LogicalDevice, readbackBufferMemory, 0, imageSize, 0, &data);
+	const uint8_t* source = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < pixels.size(); i += 4)
+	{
+		pixels[i + 0] = source[i + 2];
+		pixels[i + 1] = source[i + 1];
+		pixels[i + 2] = source[i + 0];
+		pixels[i + 3] = 255;
+	}
+	vkUnmapMemory(m_LogicalDevice, readbackBufferMemory);
+
+	vkDestroyBuffer(m_LogicalDevice, readbackBuffer, m_Allocator);
+	freeDeviceMemory(readbackBufferMemory);
+
+	return pixels;
+}
+
 // t[`
 void CVulkanFramework::drawFrame()
 {
-	// tFX҂܂
-	vkWaitForFences(m_LogicalDevice, 1, &m_InFlightFences[m_CurrentFrame], VK_TRUE, UINT64_MAX);
-
-	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(m_LogicalDevice, m_SwapChain, UINT64_MAX, m_ImageAvailableSemaphores[m_CurrentFrame], VK_NULL_HANDLE, &imageIndex);
+	TRACE_FUNCTION();
+
+	// wbhXFt[gƂ̃ItXN[摜ɕ`悵܂ilE\Ȃj
+	// headless: each frame slot renders into its own offscreen image; nothing to acquire or present
+	uint32_t imageIndex = static_cast<uint32_t>(m_CurrentFrame);
+	VkResult result = VK_SUCCESS;
+
+	// l̑Oɂ̃t[g̑O̒o҂܂Fl̃Z}tH͑O̒ȏҋ@I܂ōăVOił܂
+	// iVUID-vkAcquireNextImageKHR-semaphore-01779jBZ}tHEt[Ƃ̃fXNv^[v[ōėp\ɂȂ܂
+	// wait for this frame slot's previous submit before acquiring: its acquire semaphore may not be signaled again
+	// until that submit's wait on it has executed (VUID-vkAcquireNextImageKHR-semaphore-01779); this also frees the
+	// slot's semaphores and descriptor pools for reuse
+	waitForSerial(m_FrameSubmitSerials[m_CurrentFrame]);
+	if (m_Headless == false)
+	{
+		TRACE_BEGIN("vkAcquireNextImageKHR");
+		const auto acquireStartTime = std::chrono::high_resolution_clock::now();
+		result = vkAcquireNextImageKHR(m_LogicalDevice, m_SwapChain, UINT64_MAX, m_ImageAvailableSemaphores[m_CurrentFrame], VK_NULL_HANDLE, &imageIndex);
+		m_PresentWaitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - acquireStartTime).count();
+		TRACE_END();
+	}
 
 	// SwapChainꂽꍇ  iꂽj
 	// check if swap chain is out of date
@@ -2070,48 +3955,98 @@ void CVulkanFramework::drawFrame()
 		throw std::runtime_error("Failed to acquire swap chain image!");
 	}
 
-	// jtH[obt@[XV
-	updateUniformBuffer(imageIndex);
-
-	// ݂̉摜ȑÕt[ŎgĂ邩itFX҂Ă邩j
-	// check if a previous frame is using this image (i.e. there is its fence to wait on)
-	if (m_ImagesInFlight[imageIndex] != VK_NULL_HANDLE)
+	// ̉摜Ogot[g̒ȍꍇ̂݁Ax҂܂iς݂Ȃ҂܂j
+	// wait again only when the last submit that used this image is later than the frame slot's; no wait once it has completed
+	if (m_ImageSubmitSerials[imageIndex] > m_FrameSubmitSerials[m_CurrentFrame])
 	{
-		vkWaitForFences(m_LogicalDevice, 1, &m_ImagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+		waitForSerial(m_ImageSubmitSerials[imageIndex]);
 	}
+	processDeletionQueue();    // TCYŊOꂽ\[XEAbv[h̃Xe[WÔAgÎ폜
+	m_DescriptorAllocator.beginFrame(static_cast<uint32_t>(m_CurrentFrame));    // ̃t[̃fXNv^[v[Zbg
+	m_GpuProfiler.beginFrame(static_cast<uint32_t>(m_CurrentFrame));            // ̃t[g̑Õ^CX^vWv
 
 	// ݂̉摜݂̃t[ŎgĂ悤ɎB
 	// mark the image as now being in use by this frame
-	m_ImagesInFlight[imageIndex] = m_InFlightFences[m_CurrentFrame];
+	const uint64_t submitSerial = m_SubmitSerial + 1;
+	m_ImageSubmitSerials[imageIndex] = submitSerial;
+
+	// ̉摜̃\[XGPUŎgĂȂƂm肵ĂXV܂
+	// only touch this image's buffers once the GPU is known to be done with them
+	acquireSnapshot();                    // ŐṼXibvVbgiXVXbhj
+	TRACE_BEGIN("updateBuffers");
+	updateUniformBuffer(imageIndex);      // jtH[obt@[XV
+	updateInstanceBuffer(imageIndex);     // CX^Xobt@[XV
+	TRACE_END();
+	recordCommandBuffer(imageIndex);      // R}hobt@[o^
 
 	VkSubmitInfo submitInfo{};    // L[Eo\
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore waitSemaphores[] = { m_ImageAvailableSemaphores[m_CurrentFrame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;    // sOɑ҂Z}tH@semaphore to wait on before execution
-	submitInfo.pWaitDstStageMask = waitStages;      // ҂pCvCXe[W@stage(s) of the pipeline to wait
+	// l摜ƁAŌ̃Abv[hi^CCAς݂Ȃ҂܂j҂܂
+	// wait for the acquired image and for the last upload on the timeline (free once it has completed)
+	// wbhXFl摜Ȃ̂ŁA^CĈ݁iz2Ԗڂj
+	// headless: there is no acquired image, so only the timeline (starting from the second element)
+	VkSemaphore waitSemaphores[] = { m_ImageAvailableSemaphores[m_CurrentFrame], m_FrameTimeline };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+	const uint32_t firstWait = m_Headless ? 1 : 0;
+	submitInfo.waitSemaphoreCount = 2 - firstWait;
+	submitInfo.pWaitSemaphores = waitSemaphores + firstWait;    // sOɑ҂Z}tH@semaphore to wait on before execution
+	submitInfo.pWaitDstStageMask = waitStages + firstWait;      // ҂pCvCXe[W@stage(s) of the pipeline to wait
 
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &m_CommandBuffers[imageIndex];
 
-	VkSemaphore signalSemaphores[] = { m_RenderFinishedSemaphores[m_CurrentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;    // ÎƂɋNZ}tH  semaphores to signal once command buffer(s) have finished execution
-
-	vkResetFences(m_LogicalDevice, 1, &m_InFlightFences[m_CurrentFrame]);
-
-	if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, m_InFlightFences[m_CurrentFrame]) != VK_SUCCESS)
+	// \p̃oCiZ}tHƁAt[^CCi̒o̔ԍjVOi܂
+	// signal the binary semaphore for presentation and the frame timeline with this submit's serial
+	// wbhXF\Ȃ̂ŁA^CĈ݁iz2Ԗڂj
+	// headless: nothing is presented, so only the timeline is signaled (starting from the second element)
+	VkSemaphore signalSemaphores[] = { m_RenderFinishedSemaphores[m_CurrentFrame], m_FrameTimeline };
+	const uint32_t firstSignal = m_Headless ? 1 : 0;
+	submitInfo.signalSemaphoreCount = 2 - firstSignal;
+	submitInfo.pSignalSemaphores = signalSemaphores + firstSignal;    // ÎƂɋNZ}tH  semaphores to signal once command buffer(s) have finished execution
+
+	const uint64_t waitValues[] = { 0, m_UploadSerial };     // oCiZ}tHFl͖܂
+	const uint64_t signalValues[] = { 0, submitSerial };
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineSubmitInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+	timelineSubmitInfo.pWaitSemaphoreValues = waitValues + firstWait;
+	timelineSubmitInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+	timelineSubmitInfo.pSignalSemaphoreValues = signalValues + firstSignal;
+	submitInfo.pNext = &timelineSubmitInfo;
+
+	TRACE_BEGIN("vkQueueSubmit");
+	const VkResult submitResult = vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	TRACE_END();
+	if (submitResult != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to submit draw command buffer!");
 	}
+	m_SubmitSerial = submitSerial;
+	m_FrameSubmitSerials[m_CurrentFrame] = submitSerial;    // ^CC̔ԍɒBÃt[͊
+
+	// L[[FGPUŖ̒oĩt[܂ށj
+	// queue depth: submits the GPU has not finished yet, this one included
+	PendingFrame pendingFrame;
+	pendingFrame.inputTime = m_InputTime;
+	pendingFrame.latency.submitSerial = submitSerial;
+	pendingFrame.latency.queueDepth = static_cast<uint32_t>(submitSerial - m_CompletedSerial);
+	pendingFrame.latency.inputToSubmitMs =
+		std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_InputTime).count();
+	m_PendingFrames.push_back(pendingFrame);
+
+	if (m_Headless)    // wbhXF\Ȃiŏ̃t[͒oj
+	{
+		m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesInFlight;
+		recordFirstFrame();
+		return;
+	}
 
 	VkPresentInfoKHR presentInfo{};    // v[g\
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
+	presentInfo.pWaitSemaphores = signalSemaphores;    // 擪Fm_RenderFinishedSemaphores
 
 	VkSwapchainKHR swapChains[] = { m_SwapChain };      // SwapChain\
 	presentInfo.swapchainCount = 1;                     // SwapChaini݁FPj
@@ -2123,7 +4058,20 @@ void CVulkanFramework::drawFrame()
 	presentInfo.pResults = nullptr;
 
 	// UgSwapChainɓnĕ`悵܂  submit the result back to the swap chain to have it show on screen
+	TRACE_BEGIN("vkQueuePresentKHR");
+	const auto presentStartTime = std::chrono::high_resolution_clock::now();
 	result = vkQueuePresentKHR(m_PresentQueue, &presentInfo);
+	m_PresentWaitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - presentStartTime).count();
+	TRACE_END();
+	const bool presented = (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR);
+
+	// \[hɂҋ@iFIFO̐A摜sȂǁjF擾ƕ\ő҂
+	// present-mode waits (FIFO vsync, too few images): the time blocked in acquire and present together
+	m_PresentWaitMetric.record(static_cast<uint64_t>(m_PresentWaitMilliseconds * 1000.0));
+	if (m_PresentWaitMilliseconds > m_ExpectedPresentWaitMilliseconds + PRESENT_STALL_MARGIN_MILLISECONDS)
+	{
+		m_PresentStallMetric.add();
+	}
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR    // SwapChainpꂽ
 		|| result == VK_SUBOPTIMAL_KHR           // SwapChainœKĂȂ
@@ -2137,7 +4085,59 @@ void CVulkanFramework::drawFrame()
 		throw std::runtime_error("Failed to present swap chain image!");
 	}
 
-	m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;    // ̃t[Ɉړ@advance to next frame
+	m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesInFlight;    // ̃t[Ɉړ@advance to next frame
+
+	if (presented)
+	{
+		recordFirstFrame();
+	}
+}
+
+// ŏ̃t[܂ł̎ԁipCvCLbVEȂ̔rpj
+// time to first frame, for comparing runs with and without the pipeline cache
+void CVulkanFramework::recordFirstFrame()
+{
+	if (m_FirstFramePresented == true)
+	{
+		return;
+	}
+
+	m_FirstFramePresented = true;
+	m_FirstFrameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_StartTime).count();
+	if (m_StartupQuiet == true)
+	{
+		return;
+	}
+
+	std::cout << "Time to first frame: " << m_FirstFrameMilliseconds << " ms (pipeline creation: "
+		<< m_PipelineBuildMilliseconds << " ms, pipeline cache: "
+		<< (m_PipelineCacheEnabled == false ? "disabled" : m_PipelineCacheLoadedSize > 0 ? "loaded" : "empty") << ")" << std::endl;
+	if (m_StartupReport == true)
+	{
+		reportStartup(std::cout);
+	}
+}
+
+// ̒iKƂ̎ԂƁAŜɑ΂銄
+// time of each initialization stage and its share of the total
+void CVulkanFramework::reportStartup(std::ostream& out) const
+{
+	double totalMilliseconds = 0.0;
+	for (const StartupStage& stage : m_StartupStages)
+	{
+		totalMilliseconds += stage.milliseconds;
+	}
+
+	out << "Startup stages (ms):" << std::endl << std::fixed << std::setprecision(3);
+	for (const StartupStage& stage : m_StartupStages)
+	{
+		out << "  " << std::left << std::setw(28) << stage.name << std::right << std::setw(10) << stage.milliseconds
+			<< std::setw(7) << std::setprecision(1) << (totalMilliseconds > 0.0 ? stage.milliseconds * 100.0 / totalMilliseconds : 0.0) << " %"
+			<< std::setprecision(3) << std::endl;
+	}
+	out << "  " << std::left << std::setw(28) << "total" << std::right << std::setw(10) << totalMilliseconds << std::endl
+		<< "  " << std::left << std::setw(28) << "first frame" << std::right << std::setw(10) << m_FirstFrameMilliseconds << std::endl
+		<< std::defaultfloat;
 }
 
 //====================================================================================
@@ -2200,9 +4200,9 @@ bool CVulkanFramework::isDeviceSuitable(VkPhysicalDevice device)
 
 	bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-	bool swapChainAdequate = false;     // Œ1̃C[WtH[}bg1̃v[e[V[hł܂
-										// At least one supported image format and one supported presentation mode given the window surface
-	if (extensionsSupported)
+	bool swapChainAdequate = m_Headless;     // Œ1̃C[WtH[}bg1̃v[e[V[hł܂
+										     // At least one supported image format and one supported presentation mode given the window surface
+	if (extensionsSupported && m_Headless == false)
 	{
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -2211,9 +4211,26 @@ bool CVulkanFramework::isDeviceSuitable(VkPhysicalDevice device)
 	VkPhysicalDeviceFeatures supportedFeatures;
 	vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+	// Vulkan 1.2F^CCZ}tHit[jAfXNv^[XVev[g
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+	bool apiVersionSupported = deviceProperties.apiVersion >= VK_API_VERSION_1_2;
+	if (apiVersionSupported)
+	{
+		VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(device, &features2);
+
+		apiVersionSupported = (timelineFeatures.timelineSemaphore == VK_TRUE);
+	}
+
 	// WIg[VF[_[݂̂IꍇG@sample if wanting to narrow down to geometry shaders:
 	// return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && deviceFeatures.geometryShader;		
-	return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+	return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy && apiVersionSupported;
 }
 
 // WJfoCXGNXeVɑΉł邩̊mF
@@ -2228,6 +4245,7 @@ bool CVulkanFramework::checkDeviceExtensionSupport(VkPhysicalDevice device)
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
 	// KvȃGNXeṼxNg
+	const std::vector<const char*> deviceExtensions = getDeviceExtensions();
 	std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
 	for (const VkExtensionProperties& extension : availableExtensions)
@@ -2240,6 +4258,37 @@ bool CVulkanFramework::checkDeviceExtensionSupport(VkPhysicalDevice device)
 	return isEmpty;                               // if all the required extension were present (and thus erased), returns true
 }
 
+// K{̃foCXGNXeViwbhXłSwapChaingȂ̂łȂj
+// required device extensions; none when headless, as there is no swap chain
+std::vector<const char*> CVulkanFramework::getDeviceExtensions() const
+{
+	if (m_Headless)
+	{
+		return {};
+	}
+	return deviceExtensions;
+}
+
+// Cӂ̃GNXeVg邩mFiK{ł͂Ȃ́j
+// check for a single optional extension
+bool CVulkanFramework::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const VkExtensionProperties& extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, extensionName) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 // L[ތEI
 QueueFamilyIndices CVulkanFramework::findQueueFamilies(VkPhysicalDevice device)
 {
@@ -2259,12 +4308,21 @@ QueueFamilyIndices CVulkanFramework::findQueueFamilies(VkPhysicalDevice device)
 			indices.graphicsFamily = i;
 		}
 
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
-
-		if (presentSupport = VK_TRUE)
+		// wbhXF\Ȃ̂ŁAv[gL[̓OtBbNXL[Ɠɂ܂
+		// headless: nothing is presented, so the present queue is simply the graphics queue
+		if (m_Headless)
 		{
-			indices.presentFamily = i;
+			indices.presentFamily = indices.graphicsFamily;
+		}
+		else
+		{
+			VkBool32 presentSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
+
+			if (presentSupport == VK_TRUE)
+			{
+				indices.presentFamily = i;
+			}
 		}
 
 		if (indices.isComplete())    // L[ނꍇAbreak / If queueFamily is found, exit early
@@ -2293,16 +4351,22 @@ VkSurfaceFormatKHR CVulkanFramework::chooseSwapSurfaceFormat(const std::vector<V
 }
 
 // Xbvv[g[hI
+// MAILBOXFgvobt@OiAxZj  triple buffering (less latency)
+// IMMEDIATEFȂieBAOAxŒZj  no vsync, may tear
+// FIFO_RELAXEDFAxꂽt[͂\  vsync, but late frames present immediately
+// FIFOFiKΉj  vsync, always available
 VkPresentModeKHR CVulkanFramework::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
+	// CeV[|V[̕\[h
+	// the mode the latency policy asks for
 	for (const VkPresentModeKHR& availablePresentMode : availablePresentModes)
 	{
-		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)    // gvobt@O@triple buffering (less latency)
+		if (availablePresentMode == m_LatencyPolicy.presentMode)
 		{
 			return availablePresentMode;
 		}
 	}
-	return VK_PRESENT_MODE_FIFO_KHR;    // if VK_PRESENT_MODE_MAILBOX_KHR is not available, use a guaranteed available mode
+	return VK_PRESENT_MODE_FIFO_KHR;    // if the policy's mode is not available, use a guaranteed available mode
 }
 
 // ][Vݒ  extent = resolution of the swap chain images
@@ -2322,8 +4386,10 @@ VkExtent2D CVulkanFramework::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& ca
 	}
 	else
 	{
-		int width, height;
+		int width = WIDTH, height = HEIGHT;
+#if !defined(HEADLESS_ONLY)
 		glfwGetFramebufferSize(m_Window, &width, &height);
+#endif
 
 		VkExtent2D actualExtent =
 		{
@@ -2382,44 +4448,90 @@ bool CVulkanFramework::hasStencilComponent(VkFormat format)
 
 // SwapChainĐOɌÂSwapChain폜֐
 // before recreating swap chain, call this to clean up older versions of it
+// ǏЕtifoCXACh̏ԂŌĂяo܂j
 void CVulkanFramework::cleanupSwapChain()
 {
-	vkDestroyImageView(m_LogicalDevice, m_ColorImageView, nullptr);
-	vkDestroyImage(m_LogicalDevice, m_ColorImage, nullptr);
-	vkFreeMemory(m_LogicalDevice, m_ColorImageMemory, nullptr);
+	retireSwapChainResources();
+	cleanupPerImageResources();
 
-	vkDestroyImageView(m_LogicalDevice, m_DepthImageView, nullptr);
-	vkDestroyImage(m_LogicalDevice, m_DepthImage, nullptr);
-	vkFreeMemory(m_LogicalDevice, m_DepthImageMemory, nullptr);
+	vkDestroyRenderPass(m_LogicalDevice, m_RenderPass, m_Allocator);
 
-	for (VkFramebuffer framebuffer : m_SwapChainFramebuffers)
+	if (m_Headless)    // wbhXFItXN[摜̓AvLĂ܂
+	{
+		for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+		{
+			vkDestroyImage(m_LogicalDevice, m_SwapChainImages[i], m_Allocator);
+			freeDeviceMemory(m_OffscreenImagesMemory[i]);
+		}
+		m_SwapChainImages.clear();
+		m_OffscreenImagesMemory.clear();
+	}
+	else
 	{
-		vkDestroyFramebuffer(m_LogicalDevice, framebuffer, nullptr);
+		vkDestroySwapchainKHR(m_LogicalDevice, m_SwapChain, m_Allocator);
+		m_SwapChain = VK_NULL_HANDLE;
 	}
 
+	flushDeletionQueue();
+}
+
+// EBhETCYɈˑ郊\[Xi摜r[EJ[^fvX摜Et[obt@[jx폜L[
+// Hand the extent-dependent resources (image views, color/depth images, framebuffers) to the deferred deletion queue
+void CVulkanFramework::retireSwapChainResources()
+{
+	VkImageView colorImageView = m_ColorImageView;
+	VkImageView depthImageView = m_DepthImageView;
+	std::vector<VkImage> attachmentImages = m_AttachmentImages;
+	std::vector<VkDeviceMemory> attachmentImagesMemory = m_AttachmentImagesMemory;
+	std::vector<VkFramebuffer> framebuffers = m_SwapChainFramebuffers;
+	std::vector<VkImageView> imageViews = m_SwapChainImageViews;
+
+	deferDestruction([=]()
+	{
+		vkDestroyImageView(m_LogicalDevice, colorImageView, m_Allocator);
+		vkDestroyImageView(m_LogicalDevice, depthImageView, m_Allocator);
+
+		for (size_t i = 0; i < attachmentImages.size(); i++)
+		{
+			vkDestroyImage(m_LogicalDevice, attachmentImages[i], m_Allocator);
+			freeDeviceMemory(attachmentImagesMemory[i]);
+		}
+
+		for (VkFramebuffer framebuffer : framebuffers)
+		{
+			vkDestroyFramebuffer(m_LogicalDevice, framebuffer, m_Allocator);
+		}
+
+		for (VkImageView imageView : imageViews)
+		{
+			vkDestroyImageView(m_LogicalDevice, imageView, m_Allocator);
+		}
+	});
+}
+
+// 摜Ƃ̃\[XijtH[ECX^XEԐڕ`obt@[AfXNv^[AR}hobt@[j폜
+// Destroy the per-image buffers, cached descriptor sets and command buffers; the device must not be using them
+void CVulkanFramework::cleanupPerImageResources()
+{
 	// R}hv[폜R}hobt@[JB̃v[VR}hobt@[Ŏg܂B
 	// Frees up command buffers without destroying the command pool; reuse the existing pool to allocate new command buffers
 	vkFreeCommandBuffers(m_LogicalDevice, m_CommandPool, static_cast<uint32_t>(m_CommandBuffers.size()),
 		m_CommandBuffers.data());
 
-	vkDestroyPipeline(m_LogicalDevice, m_GraphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(m_LogicalDevice, m_PipelineLayout, nullptr);
-	vkDestroyRenderPass(m_LogicalDevice, m_RenderPass, nullptr);
-
-	for (VkImageView imageView : m_SwapChainImageViews)
+	for (size_t i = 0; i < m_UniformBuffers.size(); i++)
 	{
-		vkDestroyImageView(m_LogicalDevice, imageView, nullptr);
-	}
+		vkDestroyBuffer(m_LogicalDevice, m_UniformBuffers[i], m_Allocator);
+		freeDeviceMemory(m_UniformBuffersMemory[i]);
 
-	vkDestroySwapchainKHR(m_LogicalDevice, m_SwapChain, nullptr);
+		vkUnmapMemory(m_LogicalDevice, m_InstanceBuffersMemory[i]);
+		vkDestroyBuffer(m_LogicalDevice, m_InstanceBuffers[i], m_Allocator);
+		freeDeviceMemory(m_InstanceBuffersMemory[i]);
 
-	for (size_t i = 0; i < m_SwapChainImages.size(); i++)
-	{
-		vkDestroyBuffer(m_LogicalDevice, m_UniformBuffers[i], nullptr);
-		vkFreeMemory(m_LogicalDevice, m_UniformBuffersMemory[i], nullptr);
+		vkDestroyBuffer(m_LogicalDevice, m_IndirectBuffers[i], m_Allocator);
+		freeDeviceMemory(m_IndirectBuffersMemory[i]);
 	}
 
-	vkDestroyDescriptorPool(m_LogicalDevice, m_DescriptorPool, nullptr);
+	m_DescriptorAllocator.resetCache();    // LbṼZbg͌Âobt@[wĂ܂
 }
 
 // ЂÂ
@@ -2428,40 +4540,71 @@ void CVulkanFramework::cleanup()
 {
 	cleanupSwapChain();
 	
-	vkDestroySampler(m_LogicalDevice, m_TextureSampler, nullptr);
-	vkDestroyImageView(m_LogicalDevice, m_TextureImageView, nullptr);
+	vkDestroySampler(m_LogicalDevice, m_TextureSampler, m_Allocator);
+	vkDestroyImageView(m_LogicalDevice, m_TextureImageView, m_Allocator);
+
+	vkDestroyImage(m_LogicalDevice, m_TextureImage, m_Allocator);
+	freeDeviceMemory(m_TextureImageMemory);
+
+	m_PipelineManager.shutdown();    // [J[IESoAg폜ipCvCLbVۑ̑Oj
+	vkDestroyPipelineLayout(m_LogicalDevice, m_PipelineLayout, m_Allocator);
 
-	vkDestroyImage(m_LogicalDevice, m_TextureImage, nullptr);
-	vkFreeMemory(m_LogicalDevice, m_TextureImageMemory, nullptr);
+	vkDestroyPipeline(m_LogicalDevice, m_CullPipeline, m_Allocator);
+	vkDestroyPipelineLayout(m_LogicalDevice, m_CullPipelineLayout, m_Allocator);
+	m_DescriptorAllocator.destroy();                     // v[EXVev[giCAEgɁj
+	m_GpuProfiler.destroy();                             // ^CX^vNGv[
+	m_DescriptorLayoutCache.destroy(m_LogicalDevice, m_Allocator);    // m_DescriptorSetLayoutEm_CullDescriptorSetLayout
 
-	vkDestroyDescriptorSetLayout(m_LogicalDevice, m_DescriptorSetLayout, nullptr);
+	vkDestroyBuffer(m_LogicalDevice, m_SubmeshBuffer, m_Allocator);
+	freeDeviceMemory(m_SubmeshBufferMemory);
 
-	vkDestroyBuffer(m_LogicalDevice, m_IndexBuffer, nullptr);
-	vkFreeMemory(m_LogicalDevice, m_IndexBufferMemory, nullptr);
+	vkDestroyBuffer(m_LogicalDevice, m_IndexBuffer, m_Allocator);
+	freeDeviceMemory(m_IndexBufferMemory);
 
-	vkDestroyBuffer(m_LogicalDevice, m_VertexBuffer, nullptr);
-	vkFreeMemory(m_LogicalDevice, m_VertexBufferMemory, nullptr);
+	vkDestroyBuffer(m_LogicalDevice, m_VertexBuffer, m_Allocator);
+	freeDeviceMemory(m_VertexBufferMemory);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (size_t i = 0; i < m_FramesInFlight; i++)
 	{
-		vkDestroySemaphore(m_LogicalDevice, m_RenderFinishedSemaphores[i], nullptr);
-		vkDestroySemaphore(m_LogicalDevice, m_ImageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(m_LogicalDevice, m_InFlightFences[i], nullptr);
+		vkDestroySemaphore(m_LogicalDevice, m_RenderFinishedSemaphores[i], m_Allocator);
+		vkDestroySemaphore(m_LogicalDevice, m_ImageAvailableSemaphores[i], m_Allocator);
 	}
+	vkDestroySemaphore(m_LogicalDevice, m_FrameTimeline, m_Allocator);
 
-	vkDestroyCommandPool(m_LogicalDevice, m_CommandPool, nullptr);
+	vkDestroyCommandPool(m_LogicalDevice, m_CommandPool, m_Allocator);
 
-	vkDestroyDevice(m_LogicalDevice, nullptr);
+	savePipelineCache();
+	vkDestroyPipelineCache(m_LogicalDevice, m_PipelineCache, m_Allocator);
+
+	vkDestroyDevice(m_LogicalDevice, m_Allocator);
 
 	if (enableValidationLayers)
 	{
-		DestroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, nullptr);
+		DestroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, m_Allocator);
+	}
+	if (m_Headless == false)    // wbhXFT[tFXEEBhEȂ
+	{
+		vkDestroySurfaceKHR(m_Instance, m_Surface, m_Allocator);
 	}
-	vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
-	vkDestroyInstance(m_Instance, nullptr);
+	vkDestroyInstance(m_Instance, m_Allocator);
+	m_DebugSink.stop();    // c̃bZ[WƏWvo
 
+	// zXg[vFCX^X폜͑SĉĂ͂
+	// host allocation tracking: nothing should remain allocated once the instance is gone
+	if (m_Allocator != nullptr)
+	{
+		m_HostAllocator.report(std::cout);
+		m_HostAllocator.checkLeaks(std::cerr);
+	}
+	if (m_Headless)
+	{
+		return;
+	}
+
+#if !defined(HEADLESS_ONLY)
 	glfwDestroyWindow(m_Window);	// uninit window
 	glfwTerminate();				// uninit glfw
+#endif
 }
 
 
@@ -5,15 +5,40 @@ Last Modified:	2020.12.13
 =======================================================================*/
 #pragma once
 
+// HEADLESS_ONLYFGLFWȂ̃rhi--headlessE--goldenE--validate-cull̂݁AEBhE\͕sj
+// HEADLESS_ONLY builds without GLFW: only the offscreen paths (--headless, --golden, --validate-cull, ...) work
+#if defined(HEADLESS_ONLY)
+#include <vulkan/vulkan.h>
+struct GLFWwindow;             // |C^[̂݁igp܂j
+#else
 #define GLFW_INCLUDE_VULKAN    // VulkanSDKGLFWƈꏏɃCN[h܂B
 #include <GLFW/glfw3.h>        // replaces #include <vulkan/vulkan.h> and automatically bundles it with glfw include
+#endif
 
 #include <glm/glm.hpp>                      // glmCN[h
 #include <glm/gtc/matrix_transform.hpp>     // fgXtH[
 #include <glm/gtx/hash.hpp>
 
+#include "FrustumCuller.h"
+#include "DrawQueue.h"          // DrawPushConstants
+#include "PipelineManager.h"    // pCvCoAgǗ
+#include "ShaderReflection.h"   // SPIR-VtNVEfXNv^[ZbgCAEgLbV
+#include "RenderGraph.h"        // oA̎vZ
+#include "DescriptorAllocator.h"    // fXNv^[v[EZbgLbV
+#include "SnapshotMailbox.h"        // XVXbh  `Xbh
+#include "GpuProfiler.h"            // ^CX^vɂGPUv
+#include "HostAllocator.h"          // VkAllocationCallbacksɂzXg[v
+#include "DebugMessageSink.h"        // of[VbZ[W̔񓯊o
+#include "MetricsRegistry.h"         // Prometheus`̃gNX
+
 #include <array>
 #include <optional>
+#include <chrono>    // NԌv startup timing
+#include <functional>    // std::function : x폜L[
+#include <memory>        // std::shared_ptr : XibvVbg̃CX^Xz
+#include <thread>        // XVXbh
+#include <atomic>
+#include <unordered_map>    // foCX[̃TCYigNXj
 #include <iostream>  // std::cerr, try to migrate out of debug callback
 
 struct Vertex
@@ -23,47 +48,8 @@ struct Vertex
 	glm::vec3 color;
 	glm::vec2 texCoord;
 
-	// VF[_[GPUɓǂݍ܂ꂽA_VF[_[ɓn֐2
-	// Two functions to tell Vulkan how to pass the shader data once it's been uploaded to the GPU
-
-	// @ _oCfBOF̓ǂݍޗ@istride, _ƁECX^XƁj
-	// Vertex Binding: Which rate to load data from memory throughout the vertices (stride, by vertex or by instance)
-	static VkVertexInputBindingDescription getBindingDescription()
-	{
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;                                // z1iCfbNX 0j
-		bindingDescription.stride = sizeof(Vertex);                    // stride: ̗vf܂ł̃oCg  number of bytes from one entry to the next
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;    // RATE_INSTANCEiCX^X_Oj
-
-		return bindingDescription;
-	}
-
-	// AAgr[gfXNv^[F_oCfBOǂݍ񂾒_f[^̈
-	// Attribute Descriptor: how to handle vertex input
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
-	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-
-		// attributeDescriptions[0]: ʒu@Position
-		// bindingDescriptionƓl: _VF[_[ (location = 0) in	
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;    // 3DWIg[	
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		// attributeDescriptions[1]: J[@Color@iLƂقړj
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-		return attributeDescriptions;
-	}
+	// _oCfBOEAgr[gshaders.vert̃tNV܂iP[Vɋl߂CAEgj
+	// Vertex bindings and attributes are reflected from shaders.vert; members must stay packed in location order
 
 	// Iy[^I[o[Ch: == A_rpidj
 	// Operator Override for vertex comparison: equals == 
@@ -88,14 +74,154 @@ namespace std
 	};
 }
 
-// UBO (UniformBufferObject): }gNXϊEMVP Transform
+// CX^Xf[^FCX^XƂ̃f}gNXiCX^X_Opj
+// Per-instance data: one model matrix per instance, read at VK_VERTEX_INPUT_RATE_INSTANCE
+struct InstanceData
+{
+	glm::mat4 model;    // oCfBO1AP[V3`6imat4͗񂲂Ƃ1P[Vj
+};
+
+// TubVFf1̃VFCṽCfbNX͈͂ƋEiGPUJOpAstd430ƓCAEgj
+// Submesh: index range and bounding sphere of one shape in the model (same layout as the std430 struct in cull.comp)
+struct Submesh
+{
+	glm::vec4 boundingSphere;    // xyz: [JS local center, w: a radius
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t drawRange;             // GPUJOFԐڕ`͈̔͂̔ԍicreateSubmeshBuffer()ݒj
+	uint32_t drawRangeFirstSlot;    // ͈̔͂̍ŏ̃TubViTubVobt@[̈ʒuj
+};
+
+// TubṼ}eAiCPÛ݁jF`pPbg̃pCvCoAgIт܂
+// Submesh material, CPU side only; selects the pipeline variant of the submesh's draw packet
+struct SubmeshMaterial
+{
+	bool transparent = false;    // dissolve < 1FAt@uhEfvX݂Ȃi}jtFXg blend=1 depthWrite=0j
+	bool alphaTest = false;      // At@eNX`[FAt@eXgiꉻ萔 constant_id 2j
+};
+
+// TubṼpCvCoAgFXe[gƁA`L[ɓoAgԍ
+// A submesh's pipeline variant: the state, plus the variant number that goes into the draw key
+struct SubmeshPipeline
+{
+	GraphicsPipelineDesc desc;
+	uint32_t             pipelineId = 0;    // 0FftHgAXe[g͓ԍ
+};
+
+// GPUJO̊Ԑڕ`͈̔́FpCvCoAg̃TubViTubVobt@[ŘAj
+// An indirect draw range for GPU culling: the submeshes sharing one pipeline variant, contiguous in the submesh buffer
+struct DrawRange
+{
+	uint32_t firstSlot;        // TubVobt@[̍ŏ̈ʒu
+	uint32_t submeshCount;
+	uint32_t submeshIndex;     // \̃TubVim_SubmeshPipelines̔ԍApCvC̎擾pj
+};
+
+// JOpRs[gVF[_[̃vbV萔
+// Push constants for the culling compute shader
+struct CullParams
+{
+	glm::mat4 model;          // fsiOtBbNX̃vbV萔Ɠj
+	uint32_t objectCount;     // CX^X ~ TubViTubVF͈͂ƂɘAj
+	uint32_t submeshCount;
+	uint32_t compact;         // 1: IuWFNĝݔ͈͂ƂɒǉiDrawIndirectCountj, 0: IuWFNgƂ1Xbg
+};
+
+// UBO (UniformBufferObject): t[Ƃ̃}gNXϊEView/Projection Transform
 struct UniformBufferObject
 {
-	alignas(16) glm::mat4 model;
 	alignas(16) glm::mat4 view;
 	alignas(16) glm::mat4 proj;
 };
 
+// t[XibvVbgFXVXbhA`XbhǂނiȂj
+// Frame snapshot: produced by the update stage, read-only for the render stage
+struct FrameSnapshot
+{
+	UniformBufferObject   ubo;
+	glm::mat4             modelTransform = glm::mat4(1.0f);    // vbV萔
+	glm::mat4             cullMatrix = glm::mat4(1.0f);        // proj * view * model
+	std::shared_ptr<const std::vector<InstanceData>> instances;    // setInstances()̔ziLAύX܂j
+	uint64_t              instancesVersion = 0;
+	bool                  cpuCulled = false;                   // trueFvisibleInstanceŝݕ`
+	std::vector<uint32_t> visibleInstances;                    // CPUJOʁiinstances̃CfbNXj
+};
+
+// VF[_[@\Fꉻ萔ƂăpCvCƂɌŒ肳܂iȂAgȂpX̓hCo[폜j
+// Shader features baked into each pipeline as specialization constants; no runtime branches, unused paths are eliminated
+struct ShaderFeatures
+{
+	uint32_t textureTiling = 1;         // constant_id 0 : UV̌JԂ texture repeat count
+	bool     useVertexColor = false;    // constant_id 1 : eNX`[ɒ_J[| modulate by vertex color
+	bool     alphaTest = false;         // constant_id 2 : At@0.5j discard alpha below 0.5
+	bool     debugUV = false;           // constant_id 3 : UVFƂďo output UVs as color
+
+	// shaders.fragconstant_id̏ԁiCPipelineManager0, 1, 2...̏Ɋ蓖Ă܂j
+	// in constant_id order, as CPipelineManager assigns ids 0, 1, 2...
+	std::vector<uint32_t> getSpecializationConstants() const
+	{
+		return { textureTiling, useVertexColor ? 1u : 0u, alphaTest ? 1u : 0u, debugUV ? 1u : 0u };
+	}
+};
+
+// CeV[|V[Fɏt[ESwapChain̉摜E\[hirun()̑Oɐݒj
+// Latency policy: frames in flight, swap chain image count and present mode; set before run()
+struct LatencyPolicy
+{
+	uint32_t         framesInFlight = 2;                           // 1`MAX_FRAMES_IN_FLIGHT
+	uint32_t         swapChainImages = 0;                          // 0FminImageCount + 1iΉ͈͂Ɏ߂܂j
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;    // ΉȂFIFOiKΉj
+	bool             waitBeforeInput = false;                      // ͂̎擾OɃt[̊҂܂i͂\܂ł̒xŏɁj
+	bool             reportPerFrame = false;                       // t[Ƃ̃L[[Exo
+
+	// ΘbpF1t[̂ݏA͂̒Oɑ҂AMAILBOXi\҂ɍŐV̉摜\j
+	// interactive: one frame in flight, wait right before input, MAILBOX so the newest image is shown without blocking
+	static LatencyPolicy lowLatency()
+	{
+		LatencyPolicy policy;
+		policy.framesInFlight = 1;
+		policy.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+		policy.waitBeforeInput = true;
+		return policy;
+	}
+
+	// ItXN[EX[vbgpF3t[A摜𑽂߂ɁAFIFO
+	// offscreen/throughput: three frames in flight, extra images, FIFO
+	static LatencyPolicy throughput()
+	{
+		LatencyPolicy policy;
+		policy.framesInFlight = 3;
+		policy.swapChainImages = 4;
+		policy.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+		return policy;
+	}
+};
+
+// t[Ƃ̌vli͎glfwPollEvents()̒Oj
+// Per-frame measurements; input time is taken right before glfwPollEvents()
+struct FrameLatency
+{
+	uint64_t submitSerial = 0;
+	uint32_t queueDepth = 0;              // oGPUŖ̃t[ĩt[܂ށj
+	double   inputToSubmitMs = 0.0;
+	double   inputToCompleteMs = 0.0;     // GPŮCPUmF܂Łilj
+};
+
+// ̒iKƂ̎ԁiinitWindowAinitVulkan()̊e֐j
+// Time spent in one initialization stage: initWindow or one of the functions initVulkan() calls
+struct StartupStage
+{
+	const char* name;          // ֐
+	double      milliseconds;
+};
+
+// x폜FGPUgIĂit[̃^CCŊmFj폜郊\[X
+// Deferred deletion: a resource destroyed once the GPU has finished with it, as shown by the frame timeline
+struct DeferredDeletion
+{
+	uint64_t              submitSerial;    // ̒oԍ܂Ŋ폜ł܂
+	std::function<void()> destroy;
+};
 
 // Vulkan̂鏈̓L[ŏĂ܂BɂăL[̎ނقȂ܂B
 struct QueueFamilyIndices
@@ -157,24 +283,40 @@ public:
 	void createLogicalDevice();          // 106 WJfoCXifoCXoj
 	void createSwapChain();              // 107 Xbv`FC
 	void createImageViews();             // 108 C[Wr[
+	void createOffscreenTargets();       // wbhXFSwapChain̑̃ItXN[摜
+	std::vector<uint8_t> readbackOffscreenImage(uint32_t imageIndex);    // wbhXF摜RGBA8œǂݖ߂
+	void runInitStage(const char* name, void (CVulkanFramework::*stage)());    // iK̎Ԃm_StartupStagesɋL^
 	void createRenderPass();             // _[pX
 	void createDescriptorSetLayout();    // \[XŃXNv^[CAEg 
-	void createGraphicsPipeline();       // OtBbNXpCvC
-	void createColorResources();         // J[\[XiMSAA)
-	void createDepthResources();         // fvX\[X
+	void createPipelineCache();          // pCvCLbViLbVt@Cǂݍ݁j
+	void createPipelineManager();        // pCvCRpCp[J[XbhN
+	void createPipelineLayout();         // pCvCCAEg
+	void createGraphicsPipeline();       // OtBbNXpCvCiftHgEppCvCj
+	VkPipeline resolvePipeline(const GraphicsPipelineDesc& desc);    // RpC̓ftHgőp
+	void createSubmeshPipelines();       // TubVƂ̃oAgiftHg̃Xe[g{}eAj
+	void createAttachmentResources();    // MSAAJ[EfvXi_[Ot̃gWFg摜j
 	void createFramebuffers();           // t[obt@ifvX\[X̌j
 	void createCommandPool();            // R}hobt@[i[v[𐶐
 	void createTextureImage();           // eNX`[}bsOp摜
 	void createTextureImageView();       // eNX`[ANZX邽߂̃C[Wr[
 	void createTextureSampler();         // eNX`[Tv[
 	void loadModel();                    // ff[^ǂݍ
+	static void parseModel(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+		std::vector<Submesh>& submeshes, glm::vec4& boundingSphere,
+		std::vector<SubmeshMaterial>* submeshMaterials = nullptr);    // OBJǂݍ݁E_dtB^[ifoCXsvj
 	void createVertexBuffer();           // _obt@[
 	void createIndexBuffer();		     // CfbNXobt@[
 	void createUniformBuffers();         // jtH[obt@[
-	void createDescriptorPool();         // fXNv^[Zbgi[v[𐶐
+	void createInstanceBuffers();        // CX^Xobt@[i펞}bvj
+	void createDescriptorAllocator();    // fXNv^[Zbgi[v[it[ƁELbVj
 	void createDescriptorSets();         // fXNv^[Zbg𐶐
+	void createSubmeshBuffer();          // TubViEjobt@[
+	void createCullPipeline();           // GPUJOpRs[gpCvC
+	void createIndirectBuffers();        // Ԑڕ`obt@[
 	void createCommandBuffers();         // R}hobt@[
+	void createFrameTimeline();          // t[^CCioԍ̃Z}tHjAAbv[h
 	void createSyncObjects();            // IuWFNg
+	void createGpuProfiler();            // ^CX^vNGv[it[Ɓj
 	
 
 	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
@@ -183,20 +325,24 @@ public:
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 	
 	static std::vector<char> readFile(const std::string& fileName);
+	bool isPipelineCacheCompatible(const std::vector<char>& cacheData);
+	void savePipelineCache();
 	
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
 		VkBuffer& buffer, VkDeviceMemory& bufferMemory);
 	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+	void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 	VkCommandBuffer beginSingleTimeCommands();
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-	void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	void endUploadCommands(VkCommandBuffer commandBuffer);    // ô݁i҂ɁAɃR}hobt@[j
+	void generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
 
 	//----------------
 
 	bool isDeviceSuitable(VkPhysicalDevice device);
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	std::vector<const char*> getDeviceExtensions() const;
+	bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
 	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 	VkSampleCountFlagBits getMaxUseableSampleCount();
@@ -211,9 +357,118 @@ public:
 
 	static void framebufferResizeCallback
 	    (GLFWwindow* window, int width, int height);
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	void writeTrace();
+	void recordFirstFrame();
 	void recreateSwapChain();
+	void retireSwapChainResources();
+	void cleanupPerImageResources();
+	void deferDestruction(std::function<void()> destroy);
+	void processDeletionQueue();
+	void waitForSerial(uint64_t serial);
+	void retireSerials(uint64_t completedSerial);
+	void startMetricsExport();
+	void trackDeviceMemory(VkDeviceMemory memory, VkDeviceSize size);
+	void freeDeviceMemory(VkDeviceMemory memory);    // vkFreeMemory(){gpʂ̍XV
+	void flushDeletionQueue();
+	void updateScene(FrameSnapshot& snapshot);
+	void cullInstances(FrameSnapshot& snapshot);
+	void updateLoop();
+	void startUpdateThread();
+	void stopUpdateThread();
+	void acquireSnapshot();
 	void updateUniformBuffer(uint32_t currentImage);
+	void updateInstanceBuffer(uint32_t currentImage);
+	void queueDraws(uint32_t imageIndex);
+	void recordCommandBuffer(uint32_t imageIndex);
+	CRenderGraph::ResourceHandle addCullingPasses(CRenderGraph& graph, uint32_t imageIndex, uint32_t objectCount, bool compact);
+	uint32_t addMainPass(CRenderGraph& graph, CRenderGraph::ResourceHandle& color, CRenderGraph::ResourceHandle& depth);
 	void drawFrame();
+
+	// CX^Xzݒĩt[甽fA1̃h[R[ŕ`j
+	// Replace the instance list; picked up by each swap chain image on its next frame and drawn in a single call
+	void setInstances(const std::vector<InstanceData>& instances);
+
+	// GPU쓮JOFRs[gŃJOĊԐڕ`iΉ̃foCXł͖܂j
+	// GPU-driven culling: cull in a compute pass and draw indirectly (ignored if the device lacks support)
+	void setGpuDrivenCulling(bool enable);
+	// CPUJOFSIMDŉCX^XCX^Xobt@[ɋl߂܂iGPU쓮JODj
+	// CPU culling: SIMD frustum test, only visible instances are written to the instance buffer
+	void setCpuCulling(bool enable);
+
+	// pCvCLbVt@C̓ǂݏiɂƖVF[_[RpCANԂ̔rpj
+	// load/save the pipeline cache file; disable to measure a cold start
+	void setPipelineCacheEnabled(bool enable);
+
+	// VF[_[@\iꉻ萔jFftHgpCvCɔf܂
+	// shader features (specialization constants) used by the default pipeline
+	void setShaderFeatures(const ShaderFeatures& features);
+
+	// CeV[|V[Ft[E摜E\[hE͑Ȏҋ@
+	// latency policy: frames in flight, image count, present mode and the wait before input
+	void setLatencyPolicy(const LatencyPolicy& policy);
+
+	// XVXbhFV[̍XViJECPUJOj`ƕsčs܂iFXbhŏԂɁj
+	// update thread: scene update (camera, CPU culling) overlaps rendering; disabled runs both serially on one thread
+	void setUpdateThreadEnabled(bool enable);
+
+	// GPUvt@C[̏WviXR[vƂmin/avg/p99jIɏo͂܂
+	// print the GPU profiler's per-scope min/avg/p99 when the main loop exits
+	void setGpuProfileReport(bool enable);
+	const CGpuProfiler& getGpuProfiler() const { return m_GpuProfiler; }
+
+	// zXg[vFSĂVulkanIuWFNgVkAllocationCallbacksnAIɏWvƖ̊mۂo͂܂
+	// host allocation tracking: every Vulkan object is created with our VkAllocationCallbacks, and the per-scope
+	// totals plus any leaks are printed after vkDestroyInstance(); pool also routes small allocations through size classes
+	void setHostAllocatorTracking(bool enable, bool pool = false);
+	const CHostAllocator& getHostAllocator() const { return m_HostAllocator; }
+
+	// of[VbZ[WFmessageIdNumber1b̏o͏i0FȂAF5j
+	// validation messages: how often one messageIdNumber may print per second; 0 prints everything (default 5)
+	void setDebugMessageRateLimit(uint32_t maxPerSecond);
+	DebugMessageStats getDebugMessageStats() const { return m_DebugSink.getStats(); }    // dvxƂ̐
+
+	// `L[FOɋL^t[̃h[R[EoCh̐i`XbhA܂run()̌ɌĂяo܂j
+	// draw queue: draw and bind counts of the last recorded frame; call from the render thread or after run()
+	DrawQueueStats getDrawQueueStats() const { return m_DrawQueue.getStats(); }
+
+	// gNXFmainLoop()̊ԁAintervalSecondsbƂPrometheus̃eLXg`ŏo܂
+	// itargetFt@C̃pXA܂"unix:pX"Unix\Pbgj
+	// metrics: exported in the Prometheus text format every intervalSeconds while mainLoop() runs;
+	// target is a file path, or "unix:PATH" for a local Unix socket
+	void setMetricsExport(const std::string& target, double intervalSeconds = 10.0);
+
+	// CPUg[XiChrome/Perfetto JSONjFIF12L[ŏo܂ilastSeconds > 0F߂̕b̂݁j
+	// CPU trace (Chrome/Perfetto JSON), written on exit and whenever F12 is pressed; lastSeconds > 0 keeps only that window
+	void setTraceOutput(const std::string& path, double lastSeconds = 0.0);
+	const FrameLatency& getLastFrameLatency() const { return m_LastFrameLatency; }    // ŌGPUŊt[
+
+	bool validateGpuCulling();           // GPUJOʂCPU̎QƎƔr
+	int runCullValidation();             //   validateGpuCulling()  Еti`惋[vȂj
+
+	// wbhXx`}[NFEBhEESwapChainȂŃItXN[摜frameCountt[`悵A
+	// FPSECPUt[Ԃ̃p[Z^CEGPUԂo͂܂ilavapipeA\̂Ȃpj
+	// headless benchmark: renders frameCount frames into offscreen images without GLFW or a swap chain and reports
+	// fps, CPU frame time percentiles and GPU time; runs on display-less drivers such as lavapipe
+	int runHeadlessBenchmark(uint32_t frameCount);
+
+	// Nx`}[NFŏ̃t[܂łR[hipCvCLbVȂjEEH[runCount񂸂vA
+	// iKƂ̒lo͂܂iݒ͊lAheadlessFEBhEȂj
+	// startup benchmark: init to first frame, runCount times cold (no pipeline cache) and warm, printed as per-stage
+	// medians; every run uses default settings, headless runs skip the window
+	static int runStartupBenchmark(uint32_t runCount, bool headless);
+
+	// S[f摜eXgFwbhX1t[`悵AS[f摜iPNGjƒmoIȐFŔr܂
+	// iupdateGoldenFrɃS[f摜݂܂jBsvsNZtolerancePercent %𒴂Ǝs
+	// golden image test: render one headless frame and compare it with the golden PNG by perceptual color delta,
+	// failing when more than tolerancePercent % of pixels differ; updateGolden writes the golden image instead
+	int runGoldenImageTest(const std::string& goldenPath, double tolerancePercent, bool updateGolden);
+
+	// ŏ̃t[̎ɏ̒iKƂ̎Ԃo͂܂
+	// print the per-stage initialization times along with the time to first frame
+	void setStartupReport(bool enable);
+	const std::vector<StartupStage>& getStartupStages() const { return m_StartupStages; }
+	void reportStartup(std::ostream& out) const;
 	
 	void cleanup();
 	void cleanupSwapChain();
@@ -224,10 +479,22 @@ public:
 
 private:
 
+	// oς݃t[̌v̒l
+	// a submitted frame still being measured
+	struct PendingFrame
+	{
+		FrameLatency                                   latency;
+		std::chrono::high_resolution_clock::time_point inputTime;
+	};
+
 	GLFWwindow*                     m_Window;                // WINDOWSł͂ȂGLFW;@NXvbgtH[Ή
 	VkInstance                      m_Instance;              // CX^XFAvP[VSDK̂Ȃ
 
+	CHostAllocator                  m_HostAllocator;         // zXg[vim_Instance蒷j
+	const VkAllocationCallbacks*    m_Allocator = nullptr;   // SĂvkCreate*EvkDestroy*ɓninullptrFhCo[̊j
+
 	VkDebugUtilsMessengerEXT        m_DebugMessenger;        // fobOR[obN
+	CDebugMessageSink               m_DebugSink;             // debugCallback()  K[XbhibNȂ̃Oj
 
 	VkSurfaceKHR                    m_Surface;               // GLFW -> WSI (Windows System Integration) -> EBhE
 
@@ -236,23 +503,32 @@ private:
 	VkQueue                         m_GraphicsQueue;         // OtBbNXpL[
 	VkQueue                         m_PresentQueue;          // v[gi`jpL[
 
-	VkSwapchainKHR                  m_SwapChain;             // \\̉摜̃L[
+	VkSwapchainKHR                  m_SwapChain = VK_NULL_HANDLE;    // \\̉摜̃L[
 	std::vector<VkImage>            m_SwapChainImages;	     // L[摜
 	VkFormat                        m_SwapChainImageFormat;  // 摜tH[}bg
 	VkExtent2D                      m_SwapChainExtent;       // extent : 摜][ViʏAEBhEƓj
 
+	bool                            m_Headless = false;      // EBhEET[tFXESwapChainȂirunHeadlessBenchmarkj
+	std::vector<VkDeviceMemory>     m_OffscreenImagesMemory; // wbhXFm_SwapChainImages̃
+
 	std::vector<VkImageView>   m_SwapChainImageViews;        // VkImagẽnhG摜gpۂɃANZXir[̂́j
 	std::vector<VkFramebuffer> m_SwapChainFramebuffers;      // SwapChaiñt[obt@
 
 	VkRenderPass                    m_RenderPass;            // _[pX
-	VkDescriptorSetLayout           m_DescriptorSetLayout;   // ŃXNv^[ZbgCAEg
+	VkDescriptorSetLayout           m_DescriptorSetLayout;   // ŃXNv^[ZbgCAEgim_DescriptorLayoutCacheLj
+	CDescriptorLayoutCache          m_DescriptorLayoutCache; // oCfBÕCAEgL
+	CShaderReflection               m_GraphicsReflection;    // shaders.vert + shaders.frag
+	CShaderReflection               m_CullReflection;        // cull.comp
 	VkPipelineLayout                m_PipelineLayout;        // OtBbNXpCvCCAEg
-	VkPipeline                      m_GraphicsPipeline;      // OtBbNXpCvC
+	VkPipeline                      m_GraphicsPipeline;      // OtBbNXpCvĆiCPipelineManagerLj
+	GraphicsPipelineDesc            m_GraphicsPipelineDesc;  // ftHgpCvC̃Xe[g
+	ShaderFeatures                  m_ShaderFeatures;        // ftHgpCvC̓ꉻ萔
+	CPipelineManager                m_PipelineManager;       // pCvCoAgi[J[XbhŃRpCj
 
 	VkCommandPool                   m_CommandPool;           // CommandPool : R}hobt@[AĂ̊蓖ĂǗA
 	std::vector<VkCommandBuffer>    m_CommandBuffers;
 
-	VkDescriptorPool                m_DescriptorPool;        // DescriptorPool : fXNv^[ZbgAĂ̊蓖ĂǗ
+	CDescriptorAllocator            m_DescriptorAllocator;   // fXNv^[v[iȂΒǉjEZbgLbV
 	std::vector<VkDescriptorSet>    m_DescriptorSets;
 
 	std::vector<Vertex>             m_Vertices;              // _f[^ifpj
@@ -266,9 +542,57 @@ private:
 	std::vector<VkBuffer>           m_UniformBuffers;
 	std::vector<VkDeviceMemory>     m_UniformBuffersMemory;
 
-	VkImage                         m_DepthImage;            // Z\[gȂǂ̃fvXobt@Op@Depth Buffering
-	VkDeviceMemory                  m_DepthImageMemory;
-	VkImageView                     m_DepthImageView;
+	std::shared_ptr<const std::vector<InstanceData>> m_Instances =
+		std::make_shared<const std::vector<InstanceData>>(1, InstanceData{ glm::mat4(1.0f) });    // CX^Xf[^iCPUAlF1́j
+	uint64_t                        m_InstancesVersion = 1;       // setInstances()̂тɑ
+	std::mutex                      m_InstancesMutex;             // m_InstancesEm_InstancesVersioniXVXbhǂ݂܂j
+	std::vector<VkBuffer>           m_InstanceBuffers;            // SwapChain摜Ƃ̃CX^Xobt@[
+	std::vector<VkDeviceMemory>     m_InstanceBuffersMemory;
+	std::vector<void*>              m_InstanceBuffersMapped;      // 펞}bṽ|C^[ persistently mapped
+	std::vector<uint64_t>           m_InstanceBuffersVersion;     // eobt@[ɏ܂ꂽo[W
+	std::vector<uint32_t>           m_DrawInstanceCounts;         // eobt@[̕`CX^X
+
+	CFrustumCuller                  m_FrustumCuller;              // CPUJOiCX^X̋EASoAjAXVXbĥ
+	uint64_t                        m_FrustumCullerVersion = 0;   // ECX^X̃o[W
+	glm::mat4                       m_CullMatrix = glm::mat4(1.0f);    // proj * view * modeli`撆̃XibvVbgj
+	glm::mat4                       m_ModelTransform = glm::mat4(1.0f);    // fsivbV萔ŕ`悲Ƃɓn܂j
+
+	CSnapshotMailbox<FrameSnapshot> m_SnapshotMailbox;            // XVXbh  `Xbhigvobt@[j
+	const FrameSnapshot*            m_Snapshot = nullptr;         // `撆̃XibvVbgidrawFrame()Ŏ󂯎j
+	std::thread                     m_UpdateThread;
+	bool                            m_UpdateThreadEnabled = true;
+	std::atomic<float>              m_AspectRatio{ 1.0f };        // SwapChain̏ciXVXbhǂ݂܂j
+	glm::vec4                       m_ModelBoundingSphere = glm::vec4(0.0f);    // fŜ̋E
+	bool                            m_CpuCulling = false;         // CPUJOL
+
+	CDrawQueue                      m_DrawQueue;                  // `pPbgiL[Ń\[gAdoChȗj
+	CRenderGraph                    m_FrameGraph;                 // _[pXƂ̑ÕpXiJOj̃oAAt[蒼
+	CGpuProfiler                    m_GpuProfiler;                // t[Ƃ̃^CX^viframeEcullErender passEdrawj
+	bool                            m_GpuProfileReport = false;   // IɏWvo
+	std::string                     m_TracePath;                  // g[X̏o͐iFj
+	double                          m_TraceSeconds = 0.0;         // 0FOɎcĂSCxg
+
+	std::vector<Submesh>            m_Submeshes;                  // TubViVFCvƁj
+	std::vector<SubmeshMaterial>    m_SubmeshMaterials;           // TubVƁim_SubmeshesƓj
+	std::vector<SubmeshPipeline>    m_SubmeshPipelines;           // TubVƂ̃pCvCoAg
+	std::vector<DrawRange>          m_DrawRanges;                 // GPUJOFpCvCoAgƂ̊Ԑڕ`͈̔
+	VkBuffer                        m_SubmeshBuffer;              // TubṼXg[Wobt@[
+	VkDeviceMemory                  m_SubmeshBufferMemory;
+
+	VkDescriptorSetLayout           m_CullDescriptorSetLayout;    // GPUJOpfXNv^[ZbgCAEg
+	VkPipelineLayout                m_CullPipelineLayout;
+	VkPipeline                      m_CullPipeline;               // GPUJOpRs[gpCvC
+	std::vector<VkBuffer>           m_IndirectBuffers;            // Ԑڕ`R}hi擪256oCgF͈͂Ƃ̕`搔j
+	std::vector<VkDeviceMemory>     m_IndirectBuffersMemory;
+
+	bool m_GpuDrivenCulling = false;              // GPU쓮JOL
+	bool m_GpuCullingSupported = false;           // drawIndirectFirstInstance + multiDrawIndirect + Rs[gΉ
+	bool m_MultiDrawIndirectSupported = false;    // ̊Ԑڕ`1̃R}h
+	bool m_PipelineStatisticsSupported = false;   // pCvCvNGiCGpuProfilerj
+	uint32_t m_MaxDrawIndirectCount = 1;          // 1̊Ԑڕ`R}h̍ő`搔
+	PFN_vkCmdDrawIndexedIndirectCountKHR m_pfnCmdDrawIndexedIndirectCount = nullptr;    // VK_KHR_draw_indirect_count
+
+	VkImageView                     m_DepthImageView;        // Z\[gȂǂ̃fvXobt@Op@Depth Buffering
 
 	uint32_t                        m_MipLevels;             // ~bv}bvp
 	VkImage                         m_TextureImage;          // eNX`[}bsOpiTexelAȂǁj
@@ -277,18 +601,72 @@ private:
 	VkSampler                       m_TextureSampler;
 
 	VkSampleCountFlagBits           m_MSAASamples = VK_SAMPLE_COUNT_1_BIT;    // }`TvOrbg  Multisampling bit count 
-	VkImage                         m_ColorImage;                             // }`TvOobt@[p
-	VkDeviceMemory                  m_ColorImageMemory;                       // }`TvOobt@[p
 	VkImageView                     m_ColorImageView;                         // }`TvOobt@[p
 
+	// MSAAJ[EfvXF_[Ot̃gWFgB摜̓Ot̕摜ƁidȂȂdl͋Lj
+	// MSAA color and depth are render graph transients; one image per physical image the graph assigns
+	RenderGraphImageDesc            m_ColorAttachmentDesc;
+	RenderGraphImageDesc            m_DepthAttachmentDesc;
+	std::vector<VkImage>            m_AttachmentImages;
+	std::vector<VkDeviceMemory>     m_AttachmentImagesMemory;
+
 	// SemaphoreFȒPɁuVOivB𓯊邽߂ɗp܂B
-	// Fence: GPU-CPŮԂ̓@\GQ[gȃXgbp[łB
+	// Timeline SemaphoreFGPUi߂JE^[BCPUvkWaitSemaphores()Œl҂܂B
 	std::vector<VkSemaphore>        m_ImageAvailableSemaphores;    // C[W`揀Z}tH
 	std::vector<VkSemaphore>        m_RenderFinishedSemaphores;    // _OZ}tH
-	std::vector<VkFence>            m_InFlightFences;              // ÑtFX
-	std::vector<VkFence>            m_ImagesInFlight;              // ̉摜
+	VkSemaphore                     m_FrameTimeline;               // t[^CCi^CCZ}tHAloԍj
+	std::vector<uint64_t>           m_ImageSubmitSerials;          // e摜ŌɎgoԍ
 	size_t                          m_CurrentFrame = 0;            // ݂t[JE^[
 
+	std::vector<DeferredDeletion>   m_DeletionQueue;               // TCYŊOꂽ\[X
+	uint64_t                        m_SubmitSerial = 0;            // ot[̔ԍi^CCŃVOiŌ̒lj
+	uint64_t                        m_CompletedSerial = 0;         // GPUŊoԍ
+	uint64_t                        m_UploadSerial = 0;            // Ō̃Abv[h̒oԍi̒o͂҂܂j
+	std::vector<uint64_t>           m_FrameSubmitSerials;          // et[gōŌɒoԍ
+
+	LatencyPolicy                   m_LatencyPolicy;
+	uint32_t                        m_FramesInFlight = 2;          // m_LatencyPolicy.framesInFlighti͈͓Ɏ߂lj
+	std::chrono::high_resolution_clock::time_point m_InputTime;    // ̃t[͎̓擾
+	std::vector<PendingFrame>       m_PendingFrames;               // oς݂Ŗ̃t[ioj
+	FrameLatency                    m_LastFrameLatency;
+
 	bool m_FramebufferResized = false;    // EEBhETCYύX
 
+	VkPipelineCache                 m_PipelineCache = VK_NULL_HANDLE;    // SpCvCŋL
+	bool                            m_PipelineCacheEnabled = true;       // LbVt@C̓ǂݏ
+	std::string                     m_PipelineCachePath;                 // LbVt@CiFPIPELINE_CACHE_PATHj
+	size_t                          m_PipelineCacheLoadedSize = 0;       // ǂݍ񂾃LbṼTCYi0F󂩂Jnj
+
+	std::chrono::high_resolution_clock::time_point m_StartTime;         // run()Jn
+	double                          m_PipelineBuildMilliseconds = 0.0;  // pCvC̍v
+	bool                            m_FirstFramePresented = false;
+	double                          m_FirstFrameMilliseconds = 0.0;     // Jnŏ̕\iwbhXFoj܂
+	std::vector<StartupStage>       m_StartupStages;                    // s
+	bool                            m_StartupReport = false;            // ŏ̃t[̎ɒiKƂ̎Ԃo
+	bool                            m_StartupQuiet = false;             // Nx`}[NFŏ̃t[̏o͂Ȃ
+
+	// gNXiɍXVAo͂m_MetricsTargetݒ肳Ăꍇ̂݁jBm_Metrics͍Ōɐ錾iŏɔjj
+	// metrics are always updated but only exported with a target set; m_Metrics is declared last so it stops first
+	CMetricHistogram                m_FrameTimeMetric;                  // }CNb
+	CMetricHistogram                m_PresentWaitMetric;                // }CNb
+	CMetricCounter                  m_FrameCountMetric;
+	CMetricCounter                  m_PresentStallMetric;
+	CMetricCounter                  m_SwapChainRecreateMetric;
+	CMetricCounter                  m_UploadBytesMetric;
+	CMetricGauge                    m_DeviceMemoryMetric;
+	CMetricGauge                    m_HostMemoryMetric;
+	CMetricGauge                    m_DrawCallMetric;                   // Õt[i`L[j
+	CMetricGauge                    m_PipelineBindMetric;
+	CMetricGauge                    m_DescriptorSetBindMetric;
+	CMetricGauge                    m_VertexBufferBindMetric;
+	CMetricGauge                    m_BindsSavedMetric;
+	std::array<CMetricCounter, 4>   m_ValidationMessageMetrics;         // errorEwarningEinfoEverbose
+	double                          m_PresentWaitMilliseconds = 0.0;    // ̃t[̎擾{\
+	double                          m_ExpectedPresentWaitMilliseconds = 0.0;    // FIFOF̊Ԋui؂̔pj
+	std::unordered_map<VkDeviceMemory, VkDeviceSize> m_DeviceMemorySizes;
+	VkDeviceSize                    m_DeviceMemoryBytes = 0;
+	std::string                     m_MetricsTarget;
+	double                          m_MetricsIntervalSeconds = 10.0;
+	CMetricsRegistry                m_Metrics;
+
 };
\ No newline at end of file
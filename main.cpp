@@ -7,13 +7,263 @@ Last Modified:	2020.12.13
 =======================================================================*/
 #include "VulkanFramework.h"
 
+#include <string>
+#include <cctype>
+#include <stdexcept>
+#include <algorithm>
+
 // C֐
-int main(void)
+// R}hCF
+//   --gpu-cull       GPU쓮JOiRs[g{Ԑڕ`jLɂ܂idrawIndirectFirstInstanceEmultiDrawIndirectKvj
+//   --validate-cull  GPUJOCPU̎QƎƔrďI܂iwbhXAEBhEE`惋[vȂj
+//   --cpu-cull       CPUiSIMDjJOLɂ܂
+//   --no-pipeline-cache  pCvCLbVt@Cg܂iŏ̃t[܂ł̎Ԃ̔rpj
+//   --bench-cull [N] CPUJÕJ[lƂ̏xvďI܂iNFIuWFNgj
+//   --tiling N       eNX`[NJԂ܂iꉻ萔j
+//   --vertex-color   eNX`[ɒ_J[|܂iꉻ萔j
+//   --alpha-test     At@0.5̃tOgj܂iꉻ萔j
+//   --debug-uv       UVFƂďo͂܂iꉻ萔j
+//   --latency low|throughput   CeV[|V[̃vZbgilowFΘbpAthroughputFX[vbgpj
+//   --frames-in-flight N       ɏt[i1`4j
+//   --swapchain-images N       SwapChain̉摜iΉ͈͂Ɏ߂܂j
+//   --present-mode mailbox|fifo|fifo-relaxed|immediate   \[hiΉȂfifoj
+//   --wait-before-input        ͂̎擾OɃt[̊҂܂
+//   --report-latency           t[Ƃ̃L[[Exo͂܂
+//   --no-update-thread         V[̍XVƕ`𓯂XbhŏԂɍs܂ipCvCƂ̔rpj
+//   --gpu-profile              IGPŨXR[vƂ̎ԁimin/avg/p99jo͂܂
+//   --host-alloc               VkAllocationCallbacksŃzXg[̊mۂvAIɏWvƖ̊mۂo͂܂
+//   --host-alloc-pool          --host-allocɉāAȊmۂTCYNX̃v[犄蓖Ă܂
+//   --validation-rate-limit N  of[VbZ[W1bN܂ŏo͂܂i0FSďóAF5j
+//   --metrics TARGET           gNXPrometheus̃eLXg`ŒIɏo܂iTARGETFt@CA܂unix:pXj
+//                              iunix:pXWindowsȊÔ݁j
+//   --metrics-interval S       gNX̏oԊuibA0傫lAF10j
+//   --trace FILE               CPUg[XiChrome/Perfetto JSONjIF12L[ŏo܂
+//   --trace-seconds N          g[X𒼋Nb̂ݏo܂
+//   --headless [N]             EBhEESwapChainȂNt[`悵AFPSEt[Ԃo͂ďI܂
+//   --startup-report           ŏ̃t[̎ɏ̒iKƂ̎Ԃo͂܂
+//   --golden FILE              wbhX1t[`悵AS[f摜iPNGjƔrďI܂isFFILE.actual.pngɏój
+//   --golden-update            --golden̉摜rɕ`挋ʂŏ܂
+//   --golden-tolerance P       esvsNZ̊i%AF0.1j
+//   --bench-startup [N]        ŏ̃t[܂łR[hEEH[N񂸂vďI܂i--headlessƕpj
+int main(int argc, char* argv[])
 {
 	CVulkanFramework mainProgram;
+	bool validateCulling = false;
+	size_t benchCullCount = 0;
+	uint32_t headlessFrameCount = 0;
+	uint32_t benchStartupCount = 0;
+	std::string goldenPath;
+	bool goldenUpdate = false;
+	double goldenTolerance = 0.1;
+	ShaderFeatures shaderFeatures;
+	LatencyPolicy latencyPolicy;
+	std::string tracePath;
+	double traceSeconds = 0.0;
+	std::string metricsTarget;
+	double metricsInterval = 10.0;
+
+	// l̈std::stoul/std::stodœǂݍނ߁A͈͊OȂǂ̗O͂ŕ߂܂ďI܂
+	// numeric values go through std::stoul/std::stod, so out-of-range values are caught here instead of escaping main()
+	try
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string argument = argv[i];
+			if (argument == "--gpu-cull")
+			{
+				mainProgram.setGpuDrivenCulling(true);
+			}
+			else if (argument == "--validate-cull")
+			{
+				validateCulling = true;
+			}
+			else if (argument == "--no-pipeline-cache")
+			{
+				mainProgram.setPipelineCacheEnabled(false);
+			}
+			else if (argument == "--cpu-cull")
+			{
+				mainProgram.setCpuCulling(true);
+			}
+			else if (argument == "--tiling" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+			{
+				shaderFeatures.textureTiling = static_cast<uint32_t>(std::max(1ul, std::stoul(argv[++i])));
+			}
+			else if (argument == "--vertex-color")
+			{
+				shaderFeatures.useVertexColor = true;
+			}
+			else if (argument == "--alpha-test")
+			{
+				shaderFeatures.alphaTest = true;
+			}
+			else if (argument == "--debug-uv")
+			{
+				shaderFeatures.debugUV = true;
+			}
+			else if (argument == "--latency" && i + 1 < argc)
+			{
+				const std::string preset = argv[++i];
+				if (preset == "low")
+				{
+					latencyPolicy = LatencyPolicy::lowLatency();
+				}
+				else if (preset == "throughput")
+				{
+					latencyPolicy = LatencyPolicy::throughput();
+				}
+			}
+			else if (argument == "--frames-in-flight" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+			{
+				latencyPolicy.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else if (argument == "--swapchain-images" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+			{
+				latencyPolicy.swapChainImages = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else if (argument == "--present-mode" && i + 1 < argc)
+			{
+				const std::string mode = argv[++i];
+				if (mode == "mailbox")
+				{
+					latencyPolicy.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+				}
+				else if (mode == "fifo")
+				{
+					latencyPolicy.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+				}
+				else if (mode == "fifo-relaxed")
+				{
+					latencyPolicy.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+				}
+				else if (mode == "immediate")
+				{
+					latencyPolicy.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+				}
+			}
+			else if (argument == "--wait-before-input")
+			{
+				latencyPolicy.waitBeforeInput = true;
+			}
+			else if (argument == "--report-latency")
+			{
+				latencyPolicy.reportPerFrame = true;
+			}
+			else if (argument == "--no-update-thread")
+			{
+				mainProgram.setUpdateThreadEnabled(false);
+			}
+			else if (argument == "--gpu-profile")
+			{
+				mainProgram.setGpuProfileReport(true);
+			}
+			else if (argument == "--host-alloc")
+			{
+				mainProgram.setHostAllocatorTracking(true);
+			}
+			else if (argument == "--host-alloc-pool")
+			{
+				mainProgram.setHostAllocatorTracking(true, true);
+			}
+			else if (argument == "--validation-rate-limit" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+			{
+				mainProgram.setDebugMessageRateLimit(static_cast<uint32_t>(std::stoul(argv[++i])));
+			}
+			else if (argument == "--metrics" && i + 1 < argc)
+			{
+				metricsTarget = argv[++i];
+			}
+			else if (argument == "--metrics-interval" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+			{
+				metricsInterval = std::stod(argv[++i]);
+				if (metricsInterval <= 0.0)
+				{
+					throw std::invalid_argument("--metrics-interval must be greater than 0");
+				}
+			}
+			else if (argument == "--trace" && i + 1 < argc)
+			{
+				tracePath = argv[++i];
+			}
+			else if (argument == "--trace-seconds" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+			{
+				traceSeconds = std::stod(argv[++i]);
+			}
+			else if (argument == "--bench-cull")
+			{
+				benchCullCount = 1000000;
+				if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+				{
+					benchCullCount = std::stoul(argv[++i]);
+				}
+			}
+			else if (argument == "--startup-report")
+			{
+				mainProgram.setStartupReport(true);
+			}
+			else if (argument == "--golden" && i + 1 < argc)
+			{
+				goldenPath = argv[++i];
+			}
+			else if (argument == "--golden-update")
+			{
+				goldenUpdate = true;
+			}
+			else if (argument == "--golden-tolerance" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+			{
+				goldenTolerance = std::stod(argv[++i]);
+			}
+			else if (argument == "--bench-startup")
+			{
+				benchStartupCount = 5;
+				if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+				{
+					benchStartupCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+				}
+			}
+			else if (argument == "--headless")
+			{
+				headlessFrameCount = 500;
+				if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+				{
+					headlessFrameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+				}
+			}
+		}
+	}
+	catch (const std::logic_error& e)
+	{
+		std::cerr << "Invalid command line value (" << e.what() << ")" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	mainProgram.setShaderFeatures(shaderFeatures);
+	mainProgram.setLatencyPolicy(latencyPolicy);
+	mainProgram.setTraceOutput(tracePath, traceSeconds);
+	mainProgram.setMetricsExport(metricsTarget, metricsInterval);
 
 	try
 	{
+		if (benchCullCount > 0)
+		{
+			return CFrustumCuller::runBenchmark(benchCullCount);
+		}
+		if (goldenPath.empty() == false)
+		{
+			return mainProgram.runGoldenImageTest(goldenPath, goldenTolerance, goldenUpdate);
+		}
+		if (benchStartupCount > 0)
+		{
+			return CVulkanFramework::runStartupBenchmark(benchStartupCount, headlessFrameCount > 0);
+		}
+		if (headlessFrameCount > 0)
+		{
+			return mainProgram.runHeadlessBenchmark(headlessFrameCount);
+		}
+		if (validateCulling)
+		{
+			return mainProgram.runCullValidation();
+		}
 		mainProgram.run();
 	}
 	catch (const std::exception& e)